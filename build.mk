@@ -32,6 +32,14 @@ CFLAGS += -Werror
 CFLAGS += -Wno-unused-but-set-variable
 CFLAGS += -Wno-strict-aliasing
 
+# Libraries used for HTTP content-coding (gzip/deflate, br).
+# zstd is optional, build with SID_HTTP_HAVE_ZSTD=1 if libzstd development files are installed
+SID_HTTP_CODEC_LIBS = -lz -lbrotlidec -lbrotlienc
+ifdef SID_HTTP_HAVE_ZSTD
+CPPFLAGS += -DSID_HTTP_HAVE_ZSTD
+SID_HTTP_CODEC_LIBS += -lzstd
+endif
+
 ifdef DEBUG_BUILD
 CPPFLAGS += -DDEBUG -D_DEBUG -DR_DEBUG
 else
@@ -0,0 +1,102 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@file arena.hpp
+@brief Bump allocator whose memory is released all at once
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file  arena.hpp
+ * @brief Bump allocator whose memory is released all at once
+ */
+#ifndef _SID_ARENA_HPP_
+#define _SID_ARENA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sid {
+
+/**
+ * @class arena
+ * @brief Allocates by moving a pointer through large blocks. Nothing is freed on its own: clear() and the destructor
+ *        release all the blocks in one go. Objects placed in it are never destroyed, so they must be trivially
+ *        destructible. Requests larger than a quarter of the block size get a block of their own.
+ */
+class arena
+{
+public:
+  explicit arena(size_t _blockSize = 64 * 1024);
+  ~arena();
+
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+  arena(arena&& _obj) noexcept;
+  arena& operator=(arena&& _obj) noexcept;
+
+  /**
+   * @fn void* allocate(size_t _size, size_t _align = alignof(std::max_align_t));
+   * @brief Get _size bytes aligned to _align (a power of 2). std::bad_alloc is thrown if there is no memory.
+   */
+  void* allocate(size_t _size, size_t _align = alignof(std::max_align_t));
+
+  //! Get space for _count objects of type T (not constructed)
+  template <typename T> T* allocate(size_t _count) { return static_cast<T*>(allocate(sizeof(T) * _count, alignof(T))); }
+
+  //! Copy the characters and terminate them with a null character
+  const char* copy(const char* _data, size_t _len);
+
+  //! Release all the memory
+  void clear();
+
+  size_t used() const { return m_used; }         //! Bytes given out
+  size_t reserved() const { return m_reserved; } //! Bytes held in blocks, including their headers
+  size_t blocks() const { return m_blocks; }     //! Number of blocks (heap allocations)
+
+private:
+  struct block
+  {
+    block* next;
+  };
+  char* p_new_block(size_t _size, bool _isCurrent);
+
+private:
+  size_t m_blockSize;
+  block* m_head;     //! List of blocks, the current one first
+  char*  m_ptr;      //! Next free byte in the current block
+  char*  m_end;      //! End of the current block
+  size_t m_used;
+  size_t m_reserved;
+  size_t m_blocks;
+};
+
+} // namespace sid
+
+#endif // _SID_ARENA_HPP_
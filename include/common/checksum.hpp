@@ -0,0 +1,138 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief C++ Wrapper for various hash functions like MD<xxx>, SHA<xxx>
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file checksum.hpp
+ * @brief CRC32C and CRC64/NVMe checksums of payloads
+ */
+
+#ifndef _SID_CHECKSUM_H_
+#define _SID_CHECKSUM_H_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace sid {
+namespace checksum {
+
+/**
+ * @enum type
+ * @brief Checksum algorithms. Both are reflected CRCs with an initial value and a final XOR of all ones.
+ *        crc32c uses the Castagnoli polynomial (iSCSI, ext4) and crc64nvme the polynomial of NVMe (0xAD93D23594C93659).
+ */
+enum class type : uint8_t { none, crc32c, crc64nvme };
+
+//! Name of the algorithm ("crc32c", "crc64nvme" or "" for none)
+std::string to_str(type _type);
+//! Algorithm of the name (case insensitive). Returns false if the name is not known.
+bool from_str(const std::string& _name, type& _type);
+//! Number of bytes of the checksum
+size_t length(type _type);
+
+/**
+ * @fn uint32_t crc32c(const void* _data, size_t _dataLen, uint32_t _crc = 0) noexcept;
+ * @brief CRC32C of the data. Pass the CRC of the previous data as _crc to continue it.
+ *        The SSE4.2 crc32 instruction is used on 3 streams at a time when the CPU has it, and the CRCs of the streams
+ *        are merged with PCLMULQDQ. Otherwise tables are used (8 bytes at a time).
+ */
+uint32_t crc32c(const void* _data, size_t _dataLen, uint32_t _crc = 0) noexcept;
+
+/**
+ * @fn uint64_t crc64nvme(const void* _data, size_t _dataLen, uint64_t _crc = 0) noexcept;
+ * @brief CRC64/NVMe of the data. Pass the CRC of the previous data as _crc to continue it.
+ *        The data is folded 64 bytes at a time with PCLMULQDQ when the CPU has it. Otherwise tables are used.
+ */
+uint64_t crc64nvme(const void* _data, size_t _dataLen, uint64_t _crc = 0) noexcept;
+
+/**
+ * @fn uint32_t crc32c_combine(uint32_t _crc1, uint32_t _crc2, uint64_t _length2) noexcept;
+ * @brief CRC of the data of _crc1 followed by the _length2 bytes of _crc2, so that the CRCs of the parts
+ *        of a payload can be computed in parallel. It takes O(log(_length2)) time.
+ */
+uint32_t crc32c_combine(uint32_t _crc1, uint32_t _crc2, uint64_t _length2) noexcept;
+uint64_t crc64nvme_combine(uint64_t _crc1, uint64_t _crc2, uint64_t _length2) noexcept;
+
+//! Checks whether the CPU has the instructions used by the accelerated CRCs (SSE4.2 and PCLMULQDQ)
+bool hardware_supported();
+//! Use the accelerated CRCs (if supported) or the tables, and return the previous choice. Meant for tests and benchmarks.
+bool use_hardware(bool _enable);
+
+/**
+ * @class crc
+ * @brief Streaming checksum of one of the algorithms.
+ *
+ *   sid::checksum::crc c(sid::checksum::type::crc32c);
+ *   c.update(part1).update(part2);
+ *   request.headers("x-amz-checksum-crc32c", c.to_base64());
+ */
+class crc
+{
+public:
+  explicit crc(type _type = type::crc32c) : m_type(_type), m_value(0), m_length(0) {}
+
+  type get_type() const { return m_type; }
+
+  //! Number of bytes added so far
+  uint64_t length() const { return m_length; }
+
+  //! CRC of the data added so far
+  uint64_t value() const { return m_value; }
+
+  //! Start again
+  void reset() { m_value = 0; m_length = 0; }
+
+  //! Add the data
+  crc& update(const void* _data, size_t _dataLen);
+  crc& update(const std::string& _data) { return update(_data.data(), _data.length()); }
+
+  //! Add the data of the other object (of the same type) as if it followed the data of this one
+  crc& append(const crc& _other);
+
+  //! CRC in big-endian byte order
+  std::string to_bytes() const;
+  //! Base64 of the big-endian CRC, as in the x-amz-checksum-* headers
+  std::string to_base64() const;
+  //! Hex of the CRC in lower case
+  std::string to_hex_str() const;
+
+private:
+  type     m_type;
+  uint64_t m_value;
+  uint64_t m_length;
+};
+
+} // namespace checksum
+} // namespace sid
+
+#endif // _SID_CHECKSUM_H_
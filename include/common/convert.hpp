@@ -357,8 +357,44 @@ namespace base64
 {
   std::string encode(const std::string& _input);
   std::string encode(const char* _input, size_t _inputLen = std::string::npos);
+  //! Throws sid::exception if the input is not valid base64 (with padding)
   std::string decode(const std::string& _input);
   std::string decode(const char* _input, size_t _inputLen = std::string::npos);
+
+  //! Number of characters of the encoded input, with padding
+  inline size_t encoded_length(size_t _inputLen) { return (_inputLen + 2) / 3 * 4; }
+  //! Maximum number of bytes decoded from the characters
+  inline size_t decoded_length(size_t _inputLen) { return _inputLen / 4 * 3; }
+
+  /**
+   * @fn size_t encode(const void* _input, size_t _inputLen, char* _output) noexcept;
+   * @brief Write the base64 of the input into _output, which must have room for encoded_length(_inputLen) characters.
+   *        Returns the number of characters written.
+   */
+  size_t encode(const void* _input, size_t _inputLen, char* _output) noexcept;
+
+  /**
+   * @fn bool decode(const char* _input, size_t _inputLen, void* _output, size_t& _outputLen) noexcept;
+   * @brief Write the bytes of the base64 input into _output, which must have room for decoded_length(_inputLen) bytes.
+   *        Returns false if the length is not a multiple of 4, a character is not in the alphabet or the padding is misplaced.
+   */
+  bool decode(const char* _input, size_t _inputLen, void* _output, size_t& _outputLen) noexcept;
+}
+
+namespace codec
+{
+  /**
+   * @enum simd
+   * @brief Instruction set used by the base64 and hex functions. The best one supported by the CPU is chosen at runtime.
+   */
+  enum class simd { none, ssse3, avx2 };
+
+  //! Best instruction set supported by the CPU
+  simd supported();
+  //! Instruction set in use
+  simd active();
+  //! Use the instruction set (limited to the supported one) and return the previous one. Meant for tests and benchmarks.
+  simd set_active(simd _simd);
 }
 
 namespace rc4
@@ -438,8 +474,22 @@ bool to_size(const std::string& _input, uint64_t& _outVal, const uint64_t _defau
 
   std::string bytes_to_hex(const std::string& _input);
   bool bytes_to_hex(const std::string& _input, std::string& _output, std::string* _pcsError = nullptr) noexcept;
+  //! Throws sid::exception if the length is odd or a character is not a hex digit
   std::string hex_to_bytes(const std::string& _input);
   bool hex_to_bytes(const std::string& _input, std::string& _output, std::string* _pcsError = nullptr) noexcept;
+
+  /**
+   * @fn void bytes_to_hex(const void* _input, size_t _inputLen, char* _output, bool _lowerCase = false) noexcept;
+   * @brief Write the hex of the bytes into _output, which must have room for 2 * _inputLen characters.
+   */
+  void bytes_to_hex(const void* _input, size_t _inputLen, char* _output, bool _lowerCase = false) noexcept;
+
+  /**
+   * @fn bool hex_to_bytes(const char* _input, size_t _inputLen, void* _output) noexcept;
+   * @brief Write the bytes of the hex string (either case) into _output, which must have room for _inputLen / 2 bytes.
+   *        Returns false if the length is odd or a character is not a hex digit.
+   */
+  bool hex_to_bytes(const char* _input, size_t _inputLen, void* _output) noexcept;
 } // namespace sid
 
 #endif // _SID_CONVERT_H_
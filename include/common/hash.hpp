@@ -40,6 +40,8 @@ LICENSE: END
 
 #include <string>
 #include <openssl/rsa.h>
+#include <openssl/hmac.h>
+#include <openssl/evp.h>
 #include <openssl/crypto.h>
 #include <openssl/x509.h>
 #include <openssl/pem.h>
@@ -50,6 +52,11 @@ LICENSE: END
 namespace sid {
 namespace hash {
 
+/**
+ * @fn void init();
+ * @brief Register the digests and look up the ones used by the md_algorithm classes (sha256, sha1, md5, sha512)
+ *        once, so that creating an algorithm object or a hasher does not look them up again.
+ */
 void init();
 
 /**
@@ -75,7 +82,8 @@ public:
     { m_data.assign((const char*) _pdata, _dataLen); m_type = _type; }
 
 
-  std::string to_hex_str() const;
+  //! Hex of the digest, in upper case unless _lowerCase is set
+  std::string to_hex_str(bool _lowerCase = false) const;
   std::string to_base64() const;
 
 private:
@@ -90,10 +98,16 @@ private:
 class md_algorithm
 {
 public:
-  md_algorithm(int _nid) : m_nid(_nid) {}
+  md_algorithm(int _nid);
 
   std::string name() const;
 
+  //! OpenSSL nid of the algorithm (eg: NID_sha256)
+  int nid() const { return m_nid; }
+
+  //! Digest of the algorithm. Throws sid::exception if it is not available.
+  const EVP_MD* md() const;
+
   digest get_hash(const uint8_t* _data, uint64_t _dataLen);
   digest get_hash(const std::string& _data)
     { return get_hash((const uint8_t*) _data.c_str(), _data.length()); }
@@ -103,7 +117,96 @@ public:
     { return get_hmac((const uint8_t*) _key.c_str(), _key.length(), (const uint8_t*) _data.c_str(), _data.length()); };
 
 protected:
-  int m_nid;
+  int           m_nid;
+  const EVP_MD* m_md;  //! Resolved once, as the lookup by nid is not free
+};
+
+/**
+ * @class hasher
+ * @brief Streaming message digest or HMAC. The object owns its contexts and is reused from one message to
+ *        the next without allocating: reset() and final() start a new message from a template context set up
+ *        at construction (which holds the key for an HMAC). An object must not be shared between threads.
+ *
+ *   sid::hash::hasher h{sid::hash::sha256()};
+ *   h.update(part1).update(part2);
+ *   sid::hash::digest d = h.final();  // h is ready for the next message
+ */
+class hasher
+{
+public:
+  //! Message digest of the algorithm
+  explicit hasher(const md_algorithm& _algorithm);
+  //! HMAC of the algorithm with the key
+  hasher(const md_algorithm& _algorithm, const uint8_t* _key, uint64_t _keyLen);
+  hasher(const md_algorithm& _algorithm, const std::string& _key)
+    : hasher(_algorithm, (const uint8_t*) _key.data(), _key.length()) {}
+  //! Copy of the contexts of _obj (the key and the data added so far)
+  hasher(const hasher& _obj);
+  ~hasher();
+
+  hasher& operator=(const hasher&) = delete;
+
+  //! Checks whether it is an HMAC
+  bool is_hmac() const { return m_hmac != nullptr; }
+
+  //! Name of the result (eg: "SHA256" or "HMAC-SHA256")
+  const std::string& type() const { return m_type; }
+
+  //! Number of bytes added to the current message
+  uint64_t length() const { return m_length; }
+
+  /**
+   * @fn void reset();
+   * @brief Start a new message, discarding the data added so far. Throws sid::exception on failure.
+   */
+  void reset();
+
+  /**
+   * @fn hasher& update(const void* _data, uint64_t _dataLen);
+   * @brief Add the data to the message. Throws sid::exception on failure.
+   */
+  hasher& update(const void* _data, uint64_t _dataLen);
+  hasher& update(const std::string& _data) { return update(_data.data(), _data.length()); }
+
+  /**
+   * @fn digest final();
+   * @brief Finish the message and return its digest. The object is reset for the next message.
+   *        Throws sid::exception on failure.
+   */
+  digest final();
+
+private:
+  EVP_MD_CTX*  m_template;  //! Initialized digest context (nullptr for an HMAC)
+  EVP_MD_CTX*  m_ctx;       //! Digest context of the current message
+  EVP_MAC_CTX* m_hmac;      //! HMAC context holding the key, of the current message (nullptr for a digest)
+  std::string  m_type;
+  uint64_t     m_length;
+};
+
+/**
+ * @class hmac_key
+ * @brief HMAC with a fixed key. The key is set up once in a keyed hasher, and each HMAC starts from a
+ *        copy of it instead of hashing the key again. The object is thread-safe once constructed.
+ *
+ *   sid::hash::hmac_key key(sid::hash::sha256(), signingKey);
+ *   sid::hash::digest d = key.get_hmac(stringToSign);
+ */
+class hmac_key
+{
+public:
+  hmac_key(const md_algorithm& _algorithm, const uint8_t* _key, uint64_t _keyLen);
+  hmac_key(const md_algorithm& _algorithm, const std::string& _key)
+    : hmac_key(_algorithm, (const uint8_t*) _key.data(), _key.length()) {}
+
+  hmac_key(const hmac_key&) = delete;
+  hmac_key& operator=(const hmac_key&) = delete;
+
+  digest get_hmac(const uint8_t* _data, uint64_t _dataLen) const;
+  digest get_hmac(const std::string& _data) const
+    { return get_hmac((const uint8_t*) _data.data(), _data.length()); }
+
+private:
+  const hasher m_template;  //! HMAC holding the key. It is only copied from.
 };
 
 #define define_md_algorithm(class_name, nid) \
@@ -116,6 +219,8 @@ define_md_algorithm(sha256, NID_sha256);
 define_md_algorithm(sha1, NID_sha1);
 //! @class md5
 define_md_algorithm(md5, NID_md5);
+//! @class sha512
+define_md_algorithm(sha512, NID_sha512);
 
 } // namespace hash
 } // namespace sid
@@ -0,0 +1,175 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief C++ Wrapper for various hash functions like MD<xxx>, SHA<xxx>
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+/**
+ * @file hash_batch.hpp
+ * @brief Digests of many independent buffers on a pool of worker threads
+ */
+
+#ifndef _SID_HASH_BATCH_H_
+#define _SID_HASH_BATCH_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "hash.hpp"
+
+namespace sid {
+namespace hash {
+
+/**
+ * @enum batch_kernel
+ * @brief How a worker hashes its buffers
+ */
+enum class batch_kernel
+{
+  automatic,     //! Multi-buffer kernel when it is faster than the scalar digest on this CPU
+  scalar,        //! One buffer at a time (OpenSSL)
+  multi_buffer   //! Multi-buffer kernel whenever the CPU and the algorithm support it
+};
+
+/**
+ * @struct batch_config
+ * @brief Tuning parameters of a batch_digest
+ */
+struct batch_config
+{
+  uint32_t     threads;  //! Number of worker threads (0 uses the number of CPUs)
+  batch_kernel kernel;   //! Kernel used by the workers
+
+  batch_config() : threads(0), kernel(batch_kernel::automatic) {}
+};
+
+/**
+ * @struct tree_digest
+ * @brief Digest of an object hashed as independent chunks. The root is the digest of the chunk digests concatenated.
+ */
+struct tree_digest
+{
+  uint64_t            chunk_size;  //! Size of each chunk (the last chunk can be smaller)
+  std::vector<digest> chunks;      //! Digest of each chunk
+  digest              root;        //! Digest of the chunk digests
+
+  tree_digest() : chunk_size(0) {}
+};
+
+/**
+ * @class batch_digest
+ * @brief Computes the digests of many independent buffers on a pool of worker threads.
+ *        The buffers are submitted as they become available, so that the caller can read the next buffer while
+ *        the previous ones are hashed, and the digests are collected in the order of submission.
+ *
+ *        For MD5 and SHA-256 a worker can hash up to 8 buffers together with an AVX2 multi-buffer kernel, one
+ *        message per 32-bit lane. It is used by default for MD5, and for SHA-256 only if the CPU does not have
+ *        the SHA extensions used by OpenSSL. The other algorithms are hashed one buffer at a time.
+ *
+ *   sid::hash::batch_digest batch{sid::hash::md5()};
+ *   for ( const buffer& buf : buffers ) batch.submit(buf.data(), buf.size());
+ *   std::vector<sid::hash::digest> digests = batch.wait();
+ */
+class batch_digest
+{
+public:
+  batch_digest(const md_algorithm& _algorithm, const batch_config& _config = batch_config());
+  ~batch_digest();
+
+  batch_digest(const batch_digest&) = delete;
+  batch_digest& operator=(const batch_digest&) = delete;
+
+  //! Checks whether the workers use the multi-buffer kernel
+  bool is_multi_buffer() const { return m_multiBuffer; }
+
+  //! Number of worker threads
+  size_t threads() const { return m_workers.size(); }
+
+  /**
+   * @fn size_t submit(const void* _data, uint64_t _dataLen);
+   * @brief Queue the buffer to be hashed and return its position in the result of wait().
+   *        The buffer must stay valid and unchanged until wait() returns.
+   */
+  size_t submit(const void* _data, uint64_t _dataLen);
+
+  /**
+   * @fn std::vector<digest> wait();
+   * @brief Wait for the submitted buffers to be hashed and return their digests in the order of submission.
+   *        The buffers can be reused after this, and the next submit() starts a new batch.
+   *        Throws sid::exception if a buffer could not be hashed.
+   */
+  std::vector<digest> wait();
+
+  /**
+   * @fn std::vector<digest> get_hash(const std::vector<std::string>& _buffers);
+   * @brief Hash the buffers and return their digests in the same order.
+   */
+  std::vector<digest> get_hash(const std::vector<std::string>& _buffers);
+
+  /**
+   * @fn tree_digest get_tree_hash(const void* _data, uint64_t _dataLen, uint64_t _chunkSize);
+   * @brief Hash the object as chunks of _chunkSize in parallel, and the chunk digests to get the root.
+   *        There must not be any buffer submitted and not waited for. Throws sid::exception on failure.
+   */
+  tree_digest get_tree_hash(const void* _data, uint64_t _dataLen, uint64_t _chunkSize);
+
+private:
+  struct job
+  {
+    const uint8_t* data;
+    uint64_t       length;
+  };
+
+  void p_worker();
+  bool p_next(size_t& _index, job& _job);
+  void p_done(size_t _index, const digest& _digest, bool _isFailed = false);
+  void p_run_scalar();
+  void p_run_multi_buffer();
+
+private:
+  md_algorithm             m_algorithm;
+  bool                     m_multiBuffer;
+  std::vector<std::thread> m_workers;
+  std::mutex               m_lock;
+  std::condition_variable  m_ready;     //! Signals the workers that there are jobs (or to stop)
+  std::condition_variable  m_finished;  //! Signals wait() that a job is done
+  std::vector<job>         m_jobs;      //! Jobs of the current batch
+  std::vector<digest>      m_digests;   //! Digests of the jobs, in the same order
+  size_t                   m_next;      //! Next job to be picked up
+  size_t                   m_done;      //! Number of jobs done
+  size_t                   m_failed;    //! Number of jobs that could not be hashed
+  bool                     m_stop;
+};
+
+} // namespace hash
+} // namespace sid
+
+#endif // _SID_HASH_BATCH_H_
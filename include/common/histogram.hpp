@@ -0,0 +1,110 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief Latency histogram with log-linear buckets
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+/**
+ * @file histogram.hpp
+ * @brief histogram class declaration
+ *        Distribution of values (typically latencies) with bounded relative error
+ */
+
+#ifndef _SID_HISTOGRAM_H_
+#define _SID_HISTOGRAM_H_
+
+#include <string>
+#include <cstdint>
+
+namespace sid {
+
+/**
+ * @class histogram
+ * @brief Records unsigned values into log-linear buckets. Every power of two is split into 16 linear
+ *        sub-buckets, so a percentile is reported within 1/16 (6.25%) of the recorded value while the
+ *        whole 64-bit range is covered by a fixed array. Recording is a couple of shifts and an increment.
+ *
+ *        The object is not thread safe. Callers sharing it must serialize access.
+ */
+class histogram
+{
+public:
+  //! Default constructor
+  histogram();
+
+  //! Clear the object so that it can be reused again
+  void clear();
+
+  //! Record a value
+  void record(uint64_t _value);
+
+  //! Add the values recorded by another histogram
+  void merge(const histogram& _other);
+
+  //! Number of values recorded
+  uint64_t count() const { return m_count; }
+  //! Smallest value recorded (0 if empty)
+  uint64_t min() const { return m_count? m_min : 0; }
+  //! Largest value recorded (0 if empty)
+  uint64_t max() const { return m_max; }
+  //! Average of the values recorded (0 if empty)
+  double mean() const { return m_count? static_cast<double>(m_sum) / m_count : 0; }
+
+  /**
+   * @fn uint64_t percentile(double _percent) const;
+   * @brief Value at or below which _percent (0 to 100) of the recorded values lie.
+   *        The upper bound of the bucket is returned, capped by the largest value recorded.
+   */
+  uint64_t percentile(double _percent) const;
+
+  /**
+   * @fn std::string to_str(const std::string& _unit = std::string()) const;
+   * @brief Summary of the distribution (count, min, mean, p50, p90, p99, p99.9, max), with the unit appended to the values
+   */
+  std::string to_str(const std::string& _unit = std::string()) const;
+
+private:
+  static const int SUB_BUCKET_BITS = 4;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  static int p_index(uint64_t _value);
+  static uint64_t p_upper_bound(int _index);
+
+private:
+  uint64_t m_counts[BUCKETS]; //! Number of values in each bucket
+  uint64_t m_count;           //! Number of values recorded
+  uint64_t m_sum;             //! Sum of the values recorded
+  uint64_t m_min;             //! Smallest value recorded
+  uint64_t m_max;             //! Largest value recorded
+};
+
+} // namespace sid
+
+#endif // _SID_HISTOGRAM_H_
@@ -99,6 +99,8 @@ struct parser_stats
   uint64_t nulls;
   uint64_t keys;
   uint64_t time_ms;
+  uint64_t memory;      //! Bytes held by the parsed document (json::document)
+  uint64_t allocations; //! Heap allocations made for the parsed document (json::document)
 
   parser_stats();
   void clear();
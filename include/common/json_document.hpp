@@ -0,0 +1,229 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief Json handling using c++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file json_document.hpp
+ * @brief Read-only json document kept in an arena, with objects stored as flat arrays of members
+ */
+#pragma once
+
+#include <string>
+#include <ostream>
+#include "json.hpp"
+#include "arena.hpp"
+
+namespace sid {
+namespace json {
+
+struct member;
+
+/**
+ * @struct key_data
+ * @brief Key of an object member. Keys are interned: every occurrence of a key in a document shares one copy.
+ */
+struct key_data
+{
+  uint32_t hash;    //! Hash of the key, used by the index of large objects
+  uint32_t length;
+  char     str[1];  //! Null terminated key (the rest follows in the arena)
+};
+
+/**
+ * @class node
+ * @brief A value in a json::document. Accessors behave like those of json::value and throw sid::exception
+ *        for a wrong type, a missing key or an index out of range.
+ *        Members of an object are in the order of the document. Objects with index_threshold or more members
+ *        have a hash index, smaller ones are searched in order.
+ */
+class node
+{
+public:
+  //! Objects with this many members or more get a hash index
+  static constexpr uint32_t index_threshold = 16;
+
+  node() : m_type(json::element::null), m_size(0), m_u64(0) {}
+
+  json::element type() const { return m_type; }
+  bool is_null() const { return m_type == json::element::null; }
+  bool is_string() const { return m_type == json::element::string; }
+  bool is_signed() const { return m_type == json::element::_signed; }
+  bool is_unsigned() const { return m_type == json::element::_unsigned; }
+  bool is_double() const { return m_type == json::element::_double; }
+  bool is_num() const { return is_signed() || is_unsigned() || is_double(); }
+  bool is_bool() const { return m_type == json::element::boolean; }
+  bool is_array() const { return m_type == json::element::array; }
+  bool is_object() const { return m_type == json::element::object; }
+  bool is_basic_type() const { return ! ( is_array() || is_object() ); }
+
+  //! Number of elements of an array or members of an object
+  size_t size() const;
+
+  //! Element of an array
+  const node& operator[](const size_t _index) const;
+  //! Value of the key in an object
+  const node& operator[](const std::string& _key) const;
+  //! Value of the key in an object, nullptr if it does not exist
+  const node* find(const char* _key, size_t _len) const;
+  const node* find(const std::string& _key) const { return find(_key.data(), _key.length()); }
+  bool has_key(const std::string& _key) const { return find(_key) != nullptr; }
+  //! Member of an object by its position
+  const json::member& member(const size_t _index) const;
+
+  //! get functions. Numbers are converted between signed, unsigned and double.
+  int64_t get_int64() const;
+  uint64_t get_uint64() const;
+  long double get_double() const;
+  bool get_bool() const;
+  std::string get_str() const;
+  std::string as_str() const;
+  //! The string without a copy (null terminated) and its length
+  const char* c_str() const;
+  size_t length() const;
+
+  //! get functions with arguments, as in json::value
+  //    0 : doesn't exist
+  //    1 : Exists with non-null value
+  //   -1 : Exists but it has null value
+  template <typename T> int get_value(T& _val) const
+  {
+    if ( is_null() )
+      return -1;
+    if ( std::is_floating_point<T>::value )
+      _val = static_cast<T>(get_double());
+    else if ( std::is_signed<T>::value )
+      _val = static_cast<T>(get_int64());
+    else
+      _val = static_cast<T>(get_uint64());
+    return 1;
+  }
+  int get_value(bool& _val) const;
+  int get_value(std::string& _val) const;
+  template <typename T> int get_value(const std::string& _key, T& _val) const
+  {
+    const node* jval = find(_key);
+    return ( jval != nullptr )? jval->get_value(_val) : 0;
+  }
+
+  //! Copy to a json::value
+  json::value to_value() const;
+  //! Convert to compact json. Members are written in the order of the document.
+  std::string to_str() const;
+  void write(std::ostream& _out) const;
+
+private:
+  friend class document;
+  const uint32_t* p_index() const;
+  void p_to_value(json::value& _jout) const;
+  void p_write(std::ostream& _out) const;
+
+  json::element m_type;
+  uint32_t      m_size;   //! Length of a string, number of elements of an array or members of an object
+  union
+  {
+    int64_t            m_i64;
+    uint64_t           m_u64;
+    bool               m_bval;
+    const long double* m_dbl;
+    const char*        m_str;
+    const node*        m_arr;
+    const json::member* m_members;
+  };
+};
+
+/**
+ * @struct member
+ * @brief Member (key and value) of an object in a json::document
+ */
+struct member
+{
+  const key_data* key;
+  json::node      value;
+
+  const char* key_str() const { return key->str; }
+  size_t key_length() const { return key->length; }
+};
+
+/**
+ * @class document
+ * @brief A json document parsed into an arena. Compared to json::value it takes a few large allocations instead
+ *        of one or more per value, keeps objects as arrays of members in the order of the document (with a hash
+ *        index for large objects), stores each distinct key once, and frees the whole document at once.
+ *        The document is read-only: use node::to_value() to get a json::value that can be changed.
+ *
+ *   json::document doc;
+ *   json::parser_stats stats;
+ *   doc.parse(stats, input);
+ *   for ( size_t i = 0; i < doc.root().size(); i++ )
+ *     cout << doc.root()[i]["name"].as_str() << endl;
+ *
+ * Parsing is done by json::stream_parser and accepts the same input and parser_control modes. For duplicate keys,
+ * ignore keeps the first value, append makes an array of the values and reject throws a sid::exception, as in
+ * json::value::parse(). accept differs: the last value replaces the earlier one in its place, whereas
+ * json::value::parse() parses it into the earlier value, which merges two objects ({"k":{"a":1},"k":{"b":2}} gives
+ * {"a":1,"b":2}), concatenates two arrays ([1] and [2] give [1,2]) and keeps the earlier value for a null.
+ */
+class document
+{
+public:
+  explicit document(size_t _blockSize = 64 * 1024) : m_arena(_blockSize) {}
+  document(const document&) = delete;
+  document& operator=(const document&) = delete;
+  document(document&&) = default;
+  document& operator=(document&&) = default;
+
+  /**
+   * @fn bool parse(parser_stats& _stats, const std::string& _value, const parser_control& _ctrl = parser_control());
+   * @brief Parse the json string into the document, replacing what it had. A sid::exception is thrown on error.
+   *
+   * @param _stats [out] Parser statistics, with the memory held by the document
+   */
+  bool parse(const std::string& _value, const parser_control& _ctrl = parser_control());
+  bool parse(parser_stats& _stats, const std::string& _value, const parser_control& _ctrl = parser_control());
+
+  const json::node& root() const { return m_root; }
+  bool empty() const { return m_root.is_null(); }
+
+  //! Free the whole document
+  void clear() { m_root = json::node(); m_arena.clear(); }
+
+  //! Memory held by the document
+  size_t memory() const { return m_arena.reserved(); }
+
+private:
+  class builder;
+  sid::arena m_arena;
+  json::node m_root;
+};
+
+} // namespace json
+} // namespace sid
@@ -0,0 +1,212 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief Json handling using c++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file json_stream.hpp
+ * @brief Event based (SAX style) json parser that takes the input in pieces
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include "json.hpp"
+
+namespace sid {
+namespace json {
+
+/**
+ * @class handler
+ * @brief Callbacks of the stream_parser, in the order of the document. Return false from any of them to stop the parser.
+ *        Numbers are reported the same way json::value::parse() stores them: negative integers as signed,
+ *        other integers as unsigned, and numbers with a fraction or an exponent as double.
+ */
+class handler
+{
+public:
+  virtual ~handler() = default;
+
+  virtual bool start_object() { return true; }
+  virtual bool end_object() { return true; }
+  virtual bool start_array() { return true; }
+  virtual bool end_array() { return true; }
+  //! Key of the next value of the object
+  virtual bool key(const std::string& _key) { return true; }
+  virtual bool string(const std::string& _value) { return true; }
+  virtual bool number_signed(int64_t _value) { return true; }
+  virtual bool number_unsigned(uint64_t _value) { return true; }
+  virtual bool number_double(long double _value) { return true; }
+  virtual bool boolean(bool _value) { return true; }
+  virtual bool null() { return true; }
+};
+
+/**
+ * @class stream_parser
+ * @brief Parses a json document given in pieces of any size (split anywhere, even within a token) and reports it
+ *        to the handler as it goes, without building a tree. It accepts what json::value::parse() accepts:
+ *        the parser_control modes, comments and trailing commas. The document must be an object or an array,
+ *        and only spaces and comments can follow it.
+ *
+ *   MyHandler h;
+ *   json::stream_parser parser(h);
+ *   while ( (n = ::read(fd, buffer, sizeof(buffer))) > 0 )
+ *     parser.parse(buffer, n);
+ *   parser.finish();
+ *
+ * Duplicate keys are rejected with parser_control::dup_key::reject, and skipped along with their values
+ * (no events) with dup_key::ignore. Keys are tracked for this only in those modes.
+ * With accept and append every key is reported, and it is for the handler to decide.
+ *
+ * Errors are thrown as sid::exception, with the line and position in the document.
+ */
+class stream_parser
+{
+public:
+  stream_parser(json::handler& _handler, const parser_control& _ctrl = parser_control());
+
+  //! Start a new document
+  void reset();
+
+  /**
+   * @fn bool parse(const char* _data, size_t _len);
+   * @brief Parse the next piece of the document.
+   *
+   * @return false if the handler stopped the parser (further input is ignored), true otherwise.
+   */
+  bool parse(const char* _data, size_t _len);
+  bool parse(const std::string& _data) { return parse(_data.data(), _data.length()); }
+
+  /**
+   * @fn bool finish();
+   * @brief Indicate the end of the document. A sid::exception is thrown if the document is not complete.
+   *
+   * @return false if the handler stopped the parser, true otherwise.
+   */
+  bool finish();
+
+  //! Whether the document has been parsed completely
+  bool is_complete() const { return m_state == state::done; }
+  //! Whether the handler stopped the parser
+  bool is_stopped() const { return m_isStopped; }
+  //! Number of objects and arrays that are open
+  size_t depth() const { return m_stack.size(); }
+  //! Statistics of the document so far. time_ms is the time spent in parse().
+  const parser_stats& stats() const { return m_stats; }
+
+private:
+  enum class state : uint8_t
+  {
+    start,          //! Before the document
+    value,          //! Expecting a value (or the end of an array)
+    key,            //! Expecting a key (or the end of an object)
+    colon,          //! Expecting : after a key
+    next,           //! Expecting , or the end of the container after a value
+    string,         //! In a quoted string
+    token,          //! In a number, literal or an unquoted (flexible) key or string
+    comment_start,  //! After /
+    line_comment,   //! In a // comment
+    block_comment,  //! In a block comment
+    block_comment_end, //! After * in a block comment
+    done            //! After the document
+  };
+
+  void p_char(char _ch);
+  void p_start_container(char _ch);
+  void p_end_container(char _ch);
+  void p_end_value();
+  void p_key(const std::string& _key);
+  void p_string_end();
+  void p_token_end();
+  void p_number(const std::string& _str);
+  const std::string& p_decode(const std::string& _raw);
+  void p_check(bool _continue) { if ( ! _continue ) m_isStopped = true; }
+  std::string loc_str() const;
+
+private:
+  json::handler&       m_handler;
+  json::parser_control m_ctrl;
+  json::parser_stats   m_stats;
+  state                m_state;
+  state                m_returnState;  //! State to return to after a comment
+  bool                 m_isKey;        //! The string or token is a key
+  bool                 m_isNumber;     //! The token is a number
+  bool                 m_isEscape;     //! The previous character of the string or token was a \ (escape)
+  bool                 m_hasEscape;    //! The string or token has escape sequences
+  bool                 m_isStopped;
+  bool                 m_isIgnoring;   //! The value of a duplicate key is being skipped (dup_key::ignore)
+  size_t               m_ignoreLevel;  //! Depth of the object with the duplicate key
+  uint64_t             m_line;         //! Current line number
+  uint64_t             m_pos;          //! Position of the current character in the line
+  uint64_t             m_commentLine;  //! Where the block comment started
+  uint64_t             m_commentPos;
+  uint64_t             m_timeUs;       //! Time spent in parse()
+  std::string          m_buffer;       //! String or token being read, as it is in the input (it can span pieces)
+  std::string          m_value;        //! String or key with the escape sequences decoded
+  std::vector<char>    m_stack;        //! Open containers ({ or [)
+  std::vector<std::set<std::string>> m_keys; //! Keys of the open objects (dup_key::reject and ignore only)
+};
+
+/**
+ * @class value_builder
+ * @brief Handler that builds a json::value, so that a tree can be parsed from pieces too.
+ *        The value of a duplicate key replaces the earlier value (dup_key::append is handled as accept). Unlike
+ *        json::value::parse() with dup_key::accept, two objects or two arrays of the same key are not merged.
+ */
+class value_builder : public handler
+{
+public:
+  explicit value_builder(json::value& _jout) : m_jroot(_jout) { m_jroot.clear(); }
+
+  bool start_object() override;
+  bool end_object() override { m_stack.pop_back(); return true; }
+  bool start_array() override;
+  bool end_array() override { m_stack.pop_back(); return true; }
+  bool key(const std::string& _key) override { m_key = _key; return true; }
+  bool string(const std::string& _value) override { p_next() = _value; return true; }
+  bool number_signed(int64_t _value) override { p_next() = _value; return true; }
+  bool number_unsigned(uint64_t _value) override { p_next() = _value; return true; }
+  bool number_double(long double _value) override { p_next() = _value; return true; }
+  bool boolean(bool _value) override { p_next() = _value; return true; }
+  bool null() override { p_next().clear(); return true; }
+
+private:
+  json::value& p_next();
+
+private:
+  json::value&              m_jroot;
+  std::vector<json::value*> m_stack;
+  std::string               m_key;
+};
+
+} // namespace json
+} // namespace sid
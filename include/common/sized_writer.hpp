@@ -0,0 +1,171 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief Single-pass sized serialization buffer
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file  sized_writer.hpp
+ * @brief Writer that serializes into an exactly sized buffer
+ */
+
+#ifndef _SID_SIZED_WRITER_HPP_
+#define _SID_SIZED_WRITER_HPP_
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include "exception.hpp"
+
+namespace sid {
+
+/**
+ * @class sized_writer
+ * @brief Writer used for serializing data without std::ostringstream.
+ *
+ *        The same serialization function is run twice. The first time with a measuring writer
+ *        (no buffer) that only computes the length, and the second time with a writer on a buffer
+ *        of exactly that length. So there is a single allocation and no copy at the end.
+ *        Use sid::serialize() to do both the passes.
+ */
+class sized_writer
+{
+public:
+  //! Measuring writer. Nothing is written, only the length is computed.
+  sized_writer() : m_buffer(nullptr), m_size(0), m_length(0) {}
+
+  //! Writer using the given buffer. A sid::exception is thrown if the data does not fit in the buffer.
+  sized_writer(char* _buffer, size_t _size) : m_buffer(_buffer), m_size(_size), m_length(0) {}
+
+  //! Checks whether the writer is only measuring the length
+  bool is_measuring() const { return m_buffer == nullptr; }
+
+  //! Number of bytes written (or to be written if measuring)
+  size_t length() const { return m_length; }
+
+  sized_writer& write(const char* _data, size_t _len)
+  {
+    if ( m_buffer )
+    {
+      if ( _len > m_size - m_length )
+        throw sid::exception("sized_writer: Buffer is too small");
+      ::memcpy(m_buffer + m_length, _data, _len);
+    }
+    m_length += _len;
+    return *this;
+  }
+  sized_writer& write(const std::string& _data) { return write(_data.data(), _data.length()); }
+  sized_writer& write(const char* _str) { return write(_str, ::strlen(_str)); }
+  sized_writer& write(char _ch)
+  {
+    if ( m_buffer )
+    {
+      if ( m_length == m_size )
+        throw sid::exception("sized_writer: Buffer is too small");
+      m_buffer[m_length] = _ch;
+    }
+    m_length++;
+    return *this;
+  }
+
+  //! Write the number in decimal
+  sized_writer& write_num(uint64_t _num)
+  {
+    char tmp[20];
+    char* p = tmp + sizeof(tmp);
+    do { *--p = static_cast<char>('0' + (_num % 10)); _num /= 10; } while ( _num != 0 );
+    return write(p, tmp + sizeof(tmp) - p);
+  }
+  sized_writer& write_num(int64_t _num)
+  {
+    if ( _num >= 0 ) return write_num(static_cast<uint64_t>(_num));
+    write('-');
+    return write_num(static_cast<uint64_t>(0) - static_cast<uint64_t>(_num));
+  }
+
+  //! Write the byte as two hex digits
+  sized_writer& write_hex(uint8_t _byte, bool _upperCase = false)
+  {
+    const char* digits = _upperCase? "0123456789ABCDEF" : "0123456789abcdef";
+    char hex[2] = { digits[_byte >> 4], digits[_byte & 0x0F] };
+    return write(hex, 2);
+  }
+
+  sized_writer& operator<<(const std::string& _data) { return write(_data); }
+  sized_writer& operator<<(const char* _str) { return write(_str); }
+  sized_writer& operator<<(char _ch) { return write(_ch); }
+
+private:
+  char*  m_buffer;
+  size_t m_size;
+  size_t m_length;
+};
+
+/**
+ * @fn std::string serialize(const FN& _fn);
+ * @brief Run the serialization function _fn(sid::sized_writer&) to measure the length, and then to write
+ *        into a string of that length.
+ */
+template <typename FN>
+std::string serialize(const FN& _fn)
+{
+  sized_writer measure;
+  _fn(measure);
+  std::string out(measure.length(), '\0');
+  if ( ! out.empty() )
+  {
+    sized_writer writer(&out[0], out.length());
+    _fn(writer);
+  }
+  return out;
+}
+
+/**
+ * @fn size_t serialize(char* _buffer, size_t _size, const FN& _fn);
+ * @brief Run the serialization function _fn(sid::sized_writer&) to write into a caller-supplied buffer.
+ *
+ * @return The length of the serialized data. If it is more than _size, nothing is written to the buffer.
+ */
+template <typename FN>
+size_t serialize(char* _buffer, size_t _size, const FN& _fn)
+{
+  sized_writer measure;
+  _fn(measure);
+  if ( measure.length() <= _size )
+  {
+    sized_writer writer(_buffer, _size);
+    _fn(writer);
+  }
+  return measure.length();
+}
+
+} // namespace sid
+
+#endif // _SID_SIZED_WRITER_HPP_
@@ -36,6 +36,7 @@ LICENSE: END
 
 #include <string>
 #include <vector>
+#include <functional>
 #include "exception.hpp"
 
 namespace sid {
@@ -51,6 +52,17 @@ struct command
   static command execute(const std::string& _cmd);
   static command execute(const std::string& _cmd, const std::vector<std::string>& _params);
 
+  /**
+   * @brief Callback that receives the output of the command as it is read. Return false to stop receiving it.
+   *        The rest of the output is then discarded, and the command still runs to completion.
+   *        The output passed to the callback is not stored in the response.
+   */
+  using FNOutput = std::function<bool(const char* _data, size_t _len)>;
+
+  //! Execute the given command and pass its output to the callback
+  static command execute(const std::string& _cmd, const FNOutput& _fnOutput);
+  static command execute(const std::string& _cmd, const std::vector<std::string>& _params, const FNOutput& _fnOutput);
+
   //! Copy constructor
   command(const command&) = default;
   //! Copy operator
@@ -0,0 +1,147 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file auth_cache.hpp
+ * @brief Defines the client-side authentication cache.
+ */
+#ifndef _SID_HTTP_AUTH_CACHE_H_
+#define _SID_HTTP_AUTH_CACHE_H_
+
+#include "request.hpp"
+#include "response.hpp"
+#include "www_authenticate.hpp"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+namespace sid {
+namespace http {
+
+/**
+ * @struct auth_stats
+ * @brief Counters of the authentication cache.
+ */
+struct auth_stats
+{
+  uint64_t preemptive;  //! Requests authorized from the cache, without waiting for a challenge
+  uint64_t challenges;  //! Challenges (401) answered
+  uint64_t next_nonces; //! Nonces updated from Authentication-Info
+  uint64_t sessions;    //! Sessions held
+
+  auth_stats() { clear(); }
+  void clear() { preemptive = challenges = next_nonces = sessions = 0; }
+  std::string to_str() const;
+};
+
+/**
+ * @class auth_cache
+ * @brief Authentication cache used by http::client. The object is thread-safe and can be shared by clients.
+ *
+ * The challenge answered for a host is kept along with the credentials, so that the next requests in its
+ * protection space carry the Authorization header from the start and do not wait for a 401. The protection space
+ * of Basic is the directory of the challenged URI (RFC 7617), and that of Digest is the "domain" of the challenge,
+ * or the whole host without it (RFC 7616). Digest requests use the next nonce count with the same client nonce,
+ * and HA1 is computed once. A 401 to a preemptive request (a stale nonce) refreshes the session and is answered
+ * once, and a nextnonce in Authentication-Info replaces the nonce.
+ *
+ *   auto auth = std::make_shared<http::auth_cache>();
+ *   http::client client;
+ *   client.auth = auth;
+ *   client.request.userName = "user";
+ *   client.request.password = "secret";
+ *   ...
+ *   client.run();  // only the first request to the host is challenged
+ */
+class auth_cache
+{
+public:
+  //! Constructor
+  auth_cache() = default;
+
+  //! Not copyable
+  auth_cache(const auth_cache&) = delete;
+  auth_cache& operator=(const auth_cache&) = delete;
+
+  /**
+   * @fn bool apply(http::request& _request, const std::string& _host);
+   * @brief Add the Authorization header to the request if a session of the host covers its URI
+   *        and has the credentials of the request.
+   *
+   * @param _host [in] Server and port of the connection ("server:port")
+   *
+   * @return true if the header was added.
+   */
+  bool apply(http::request& _request, const std::string& _host);
+
+  /**
+   * @fn bool challenge(http::request& _request, const std::string& _host, const std::string& _wwwAuth);
+   * @brief Answer the WWW-Authenticate header of a 401 with the credentials of the request, and keep the session.
+   *        The Authorization header of the request is replaced.
+   *
+   * @return false if the header has no challenge.
+   */
+  bool challenge(http::request& _request, const std::string& _host, const std::string& _wwwAuth);
+
+  //! Take the next nonce from the Authentication-Info header of a response to an authorized request
+  void update(const http::request& _request, const std::string& _host, const http::response& _response);
+
+  //! Remove the sessions of the host
+  void remove(const std::string& _host);
+
+  //! Get a snapshot of the statistics
+  auth_stats stats() const;
+
+  //! Remove all the sessions
+  void clear();
+
+private:
+  struct entry
+  {
+    std::vector<std::string> prefixes;  //! Protection space: the URIs starting with one of them
+    auth_session             session;
+  };
+
+  entry* p_find(const std::string& _host, const http::request& _request);
+
+private:
+  mutable std::mutex m_mutex;
+  auth_stats         m_stats;
+  std::unordered_map<std::string, std::vector<entry>> m_entries; //! Sessions of each host
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_AUTH_CACHE_H_
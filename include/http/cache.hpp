@@ -0,0 +1,178 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file cache.hpp
+ * @brief Defines the client-side HTTP response cache.
+ */
+#ifndef _SID_HTTP_CACHE_H_
+#define _SID_HTTP_CACHE_H_
+
+#include "request.hpp"
+#include "response.hpp"
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <functional>
+
+namespace sid {
+namespace http {
+
+class client;
+
+/**
+ * @struct cache_config
+ * @brief Limits and options used by cache.
+ */
+struct cache_config
+{
+  uint64_t    max_memory;      //! Bytes of the responses held in memory (default: 64 MB)
+  uint64_t    max_entry_size;  //! Larger payloads are kept only on the disk tier (default: 8 MB)
+  std::string disk_path;       //! Directory of the on-disk tier. The tier is disabled if empty (default).
+  uint64_t    max_disk;        //! Bytes of the payloads held on disk (default: 1 GB)
+  bool        shared;          //! Behave as a shared cache: "private" responses are not stored and s-maxage applies (default: false)
+  double      heuristic_ratio; //! Share of the age of Last-Modified used as freshness when none is given (default: 0.1)
+
+  //! Default constructor
+  cache_config();
+  //! Reset to the default values
+  void clear();
+};
+
+/**
+ * @struct cache_stats
+ * @brief Counters of the cache.
+ */
+struct cache_stats
+{
+  uint64_t hits;          //! Requests answered from the cache without contacting the server
+  uint64_t misses;        //! Requests sent to the server with no usable response in the cache
+  uint64_t revalidations; //! Conditional requests sent to validate a stale response
+  uint64_t not_modified;  //! Revalidations answered with 304, so the stored payload was used
+  uint64_t stores;        //! Responses stored
+  uint64_t evictions;     //! Responses removed to stay within the limits
+  uint64_t invalidations; //! Responses removed by an unsafe request on their URI
+  uint64_t disk_hits;     //! Payloads served from the on-disk tier
+  uint64_t memory_bytes;  //! Bytes held in memory
+  uint64_t disk_bytes;    //! Bytes held on disk
+
+  cache_stats() { clear(); }
+  void clear() { hits = misses = revalidations = not_modified = stores = evictions = invalidations = disk_hits = memory_bytes = disk_bytes = 0; }
+  std::string to_str() const;
+};
+
+struct cache_entry;
+
+/**
+ * @class cache
+ * @brief HTTP response cache used by http::client (RFC 9111). The object is thread-safe and can be shared by clients.
+ *
+ * Responses to GET are stored as per Cache-Control (no-store, private, max-age, s-maxage), Expires and, for
+ * the statuses that are cacheable by default, a heuristic freshness based on Last-Modified. Variants are
+ * told apart by the request headers named in Vary. A fresh response is served without contacting the server,
+ * with an Age header. A stale one with an ETag or Last-Modified is revalidated with If-None-Match or
+ * If-Modified-Since, and a 304 refreshes it. The request directives no-cache, no-store, max-age, min-fresh,
+ * max-stale and only-if-cached are honoured. A successful unsafe request (POST, PUT, DELETE...) invalidates
+ * the responses stored for its URI. Requests with Range or with conditional headers of their own, and responses
+ * with a sink, are passed through.
+ *
+ * Payloads are held in an LRU list in memory. With disk_path set, the entries evicted from memory (and the
+ * payloads larger than max_entry_size) are written to files, which are mapped when they are served. The disk
+ * tier is an extension of the memory of the process, so its files are removed with the cache.
+ *
+ *   auto cache = std::make_shared<http::cache>();
+ *   http::client client;
+ *   client.cache = cache;
+ *   ...
+ *   client.run();  // served from the cache when possible
+ *   cout << cache->stats().to_str() << endl;
+ */
+class cache
+{
+public:
+  //! Constructor
+  cache(const cache_config& _config = cache_config());
+  //! Destructor. Removes the files of the disk tier.
+  ~cache();
+
+  //! Not copyable
+  cache(const cache&) = delete;
+  cache& operator=(const cache&) = delete;
+
+  //! Configuration of the cache
+  const cache_config& config() const { return m_config; }
+
+  /**
+   * @fn bool exchange(http::client& _client, const std::function<bool()>& _fnExchange);
+   * @brief Answer the request of the client from the cache, or through _fnExchange (which sends it to the server)
+   *        and store the response. Called by client::run() when the client has a cache.
+   *
+   * @return true if the response is 2xx, same as client::run().
+   */
+  bool exchange(http::client& _client, const std::function<bool()>& _fnExchange);
+
+  //! Get a snapshot of the statistics
+  cache_stats stats() const;
+
+  //! Remove all the entries
+  void clear();
+
+private:
+  using entry_ptr = std::shared_ptr<cache_entry>;
+  using entry_list = std::list<entry_ptr>;
+
+  entry_ptr p_lookup(const std::string& _key, const http::request& _request);
+  void p_store(const std::string& _key, const http::request& _request, const http::response& _response, time_t _requestTime, time_t _responseTime);
+  void p_refresh(const entry_ptr& _entry, const http::response& _notModified, time_t _requestTime, time_t _responseTime);
+  void p_remove(const std::string& _key);
+  void p_unlink(const entry_ptr& _entry);
+  void p_trim();
+  bool p_load(const entry_ptr& _entry, http::response& _response);
+  std::string p_write(const std::string& _data);
+
+private:
+  cache_config        m_config;
+  mutable std::mutex  m_mutex;
+  cache_stats         m_stats;
+  entry_list          m_memory;     //! Entries with the payload in memory. Most recently used entry is in the front.
+  entry_list          m_disk;       //! Entries with the payload on disk. Most recently used entry is in the front.
+  std::unordered_map<std::string, std::vector<entry_ptr>> m_entries; //! Variants of each URI
+  uint64_t            m_fileCount;  //! Used to name the files of the disk tier
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_CACHE_H_
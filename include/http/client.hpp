@@ -41,8 +41,11 @@ LICENSE: END
 #include "connection.hpp"
 #include "request.hpp"
 #include "response.hpp"
+#include "cache.hpp"
+#include "auth_cache.hpp"
 #include <string>
 #include <functional>
+#include <memory>
 
 namespace sid {
 namespace http {
@@ -50,6 +53,8 @@ namespace http {
 // A lambda function for redirect callback
 using FNRedirectCallback = std::function<void(request&)>;
 
+class http2_session;
+
 /**
  * @class client
  * @brief Definition of HTTP client object.
@@ -60,9 +65,29 @@ public:
   http::connection_ptr conn;      //! HTTP connection pointer
   http::request        request;   //! HTTP request object
   http::response       response;  //! HTTP response object
+  bool                 decode_content; //! Negotiate Accept-Encoding and decode compressed responses (default: true)
+  uint32_t             continue_timeout_ms; //! Time to wait for "100 Continue" before sending the payload anyway (default: 1000)
+  std::shared_ptr<http::cache> cache; //! Response cache used by run(). None by default. It can be shared by clients.
+  std::shared_ptr<http::auth_cache> auth; //! Authentication cache used by run() to authorize requests without a challenge. None by default.
+  http::request_timing timing;    //! Timing of the last exchange of run(), if the connection records it (see connection::set_timing())
 
 private:
-  sid::exception m_exception; //! Last exception
+  sid::exception                 m_exception;  //! Last exception
+  std::shared_ptr<http2_session> m_http2;      //! HTTP/2 session, when the connection speaks HTTP/2
+  http::connection_ptr           m_http2Conn;  //! Connection on which m_http2 was created
+  std::string                    m_authorization; //! Authorization header added by the authentication cache
+
+  //! Exchange the request and response over HTTP/2 if the connection has negotiated it (or is using prior knowledge)
+  bool p_exchange_http2(http::connection_ptr _conn);
+
+  //! Exchange the request and response over HTTP/1.x. The payload is held back until "100 Continue" if the request expects it.
+  void p_exchange_http1(http::connection_ptr _conn, bool _expect100Continue);
+
+  //! Send the request and receive the response (with authentication and redirects). Called by run() when the cache cannot answer.
+  bool p_run(FNRedirectCallback& _fnRedirectCallback, bool _followRedirects);
+
+  //! Reset the request phases of the timing recorded by the connection before an exchange
+  void p_start_timing(http::request_timing& _timing);
 
 public:
   //! Default constructor
@@ -90,6 +115,9 @@ public:
    *
    * @return true if exchange was successful, false otherwise.
    *         exception() will contain the last exception object in case of failure.
+   *
+   * @note HTTP/2 is used if the connection negotiated "h2" through ALPN, or if the request version is HTTP/2
+   *       on a plain connection (prior knowledge). Otherwise an HTTP/2 request version falls back to HTTP/1.1.
    */
   bool run(bool _followRedirects = false);
 
@@ -104,6 +132,10 @@ public:
    *
    * @return true if exchange was successful, false otherwise.
    *         exception() will contain the last exception object in case of failure.
+   *
+   * @note If the client has a cache, the response may come from it (see http::cache).
+   *       If it has an authentication cache, a request covered by an earlier challenge is authorized
+   *       without waiting for a 401 (see http::auth_cache).
    */
   bool run(FNRedirectCallback& _fnRedirectCallback, bool _followRedirects = false);
 };
@@ -43,6 +43,8 @@ LICENSE: END
 #include <string>
 #include <iostream>
 #include <ctime>
+#include <cstdint>
+#include "common/checksum.hpp"
 
 using namespace std;
 
@@ -62,9 +64,63 @@ std::string date_to_str(const time_t& _tt);
 bool date_from_str(const std::string& _input, struct tm& _tm);
 bool date_from_str(const std::string& _input, time_t& _tt);
 
-std::string url_encode(const std::string& _input);
+/**
+ * @enum url_encoding
+ * @brief Characters that are percent-encoded by url_encode()
+ */
+enum class url_encoding : uint8_t
+{
+  reserved,     //! The reserved characters " !'();:@&+$,?%#[]/\"" as %xx (lower case hex)
+  rfc3986_path, //! Everything other than the RFC 3986 path characters (unreserved, sub-delims, ':', '@' and '/')
+  aws,          //! Everything other than the unreserved characters (A-Z a-z 0-9 - _ . ~), as the SigV4 UriEncode()
+  aws_path      //! As aws, but '/' is kept (the SigV4 canonical URI of S3)
+};
+
+/**
+ * @fn std::string url_encode(const std::string& _input, url_encoding _encoding = url_encoding::reserved);
+ * @brief Percent-encode the input. The characters are classified with a lookup table, and the hex digits are
+ *        upper case for all but url_encoding::reserved.
+ */
+std::string url_encode(const std::string& _input, url_encoding _encoding = url_encoding::reserved);
+
+/**
+ * @fn const std::string& url_encode(const std::string& _input, url_encoding _encoding, std::string& _buffer);
+ * @brief Percent-encode the input into _buffer and return it. If nothing needs to be encoded the input itself
+ *        is returned and _buffer is not touched, so the common case does not copy.
+ */
+const std::string& url_encode(const std::string& _input, url_encoding _encoding, std::string& _buffer);
+
+/**
+ * @fn size_t url_encode(const char* _input, size_t _inputLen, char* _output, url_encoding _encoding) noexcept;
+ * @brief Percent-encode the input into the output, which must have room for url_encoded_length() (3 x _inputLen
+ *        at most) characters. Returns the number of characters written.
+ */
+size_t url_encode(const char* _input, size_t _inputLen, char* _output, url_encoding _encoding) noexcept;
+size_t url_encoded_length(const char* _input, size_t _inputLen, url_encoding _encoding) noexcept;
+
+/**
+ * @fn std::string url_decode(const std::string& _input);
+ * @brief Decode the %xx sequences of the input. If there is an invalid sequence a sid::exception is thrown.
+ */
 std::string url_decode(const std::string& _input);
 
+/**
+ * @fn const std::string& url_decode(const std::string& _input, std::string& _buffer);
+ * @brief Decode the input into _buffer and return it, or return the input itself if it has no '%'.
+ *        If there is an invalid sequence a sid::exception is thrown.
+ */
+const std::string& url_decode(const std::string& _input, std::string& _buffer);
+
+/**
+ * @fn bool url_decode(const char* _input, size_t _inputLen, char* _output, size_t& _outputLen) noexcept;
+ * @brief Decode the input into the output, which must have room for _inputLen characters.
+ *        Returns false if there is an invalid %xx sequence.
+ */
+bool url_decode(const char* _input, size_t _inputLen, char* _output, size_t& _outputLen) noexcept;
+
+//! Field carrying the checksum of a payload, in a header or a trailer (x-amz-checksum-crc32c or x-amz-checksum-crc64nvme)
+std::string checksum_header(sid::checksum::type _type);
+
 } // namespace http
 } // namespace sid
 
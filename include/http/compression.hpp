@@ -0,0 +1,289 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file compression.hpp
+ * @brief Defines the streaming codecs used for HTTP content-coding (Content-Encoding).
+ */
+#ifndef _SID_HTTP_COMPRESSION_H_
+#define _SID_HTTP_COMPRESSION_H_
+
+#include "headers.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+namespace sid {
+namespace http {
+
+/**
+ * @class content_decoder
+ * @brief Streaming decoder for the payload of a response (or request) that has a Content-Encoding header.
+ *
+ *        The data is decoded as it arrives, so the compressed payload is never held in memory as a whole.
+ *        Stacked encodings (for example "gzip, br") are decoded in the reverse order of application.
+ *        If there is an error while decoding a sid::exception is thrown.
+ */
+class content_decoder
+{
+public:
+  //! Default constructor
+  content_decoder();
+
+  //! Destructor
+  ~content_decoder();
+
+  //! Not copyable
+  content_decoder(const content_decoder&) = delete;
+  content_decoder& operator=(const content_decoder&) = delete;
+
+  /**
+   * @fn bool set(const std::string& _contentEncoding);
+   * @brief Prepare the decoder for the given Content-Encoding header value. Any previous state is discarded.
+   *
+   * @param _contentEncoding [in] Value of the Content-Encoding header.
+   *
+   * @return true if every encoding in the list is supported, false otherwise.
+   *         On a false return the decoder stays empty and the payload must be used as it is.
+   */
+  bool set(const std::string& _contentEncoding);
+
+  //! Clear the decoder state
+  void clear();
+
+  //! Checks whether there is anything to decode
+  bool empty() const { return m_codecs.empty(); }
+
+  /**
+   * @fn void decode(const char* _data, size_t _len, std::string& _out);
+   * @brief Decode the next piece of the encoded payload.
+   *
+   * @param _data [in] Encoded data.
+   * @param _len [in] Length of the encoded data.
+   * @param _out [out] The decoded data is appended to this string.
+   */
+  void decode(const char* _data, size_t _len, std::string& _out);
+
+  /**
+   * @fn void finish();
+   * @brief Call at the end of the payload. Throws a sid::exception if the encoded stream is truncated.
+   */
+  void finish();
+
+  /**
+   * @fn void update_headers(http::headers& _headers) const;
+   * @brief Call once the payload is decoded, so that the headers describe the decoded payload: Content-Encoding
+   *        is removed and Content-Length (if it is present) is set to the decoded length.
+   */
+  void update_headers(http::headers& _headers) const;
+
+  //! Total number of encoded bytes given to the decoder
+  uint64_t bytes_in() const { return m_bytesIn; }
+
+  //! Total number of decoded bytes produced by the decoder
+  uint64_t bytes_out() const { return m_bytesOut; }
+
+  //! Checks whether the given content-coding can be decoded
+  static bool is_supported(const http::content_encoding& _encoding);
+
+  //! Returns the value to be used in the Accept-Encoding header for all the supported encodings
+  static const std::string& accept_encoding();
+
+public:
+  //! Internal codec interface
+  struct codec;
+
+private:
+  std::vector< std::unique_ptr<codec> > m_codecs; //! Codecs in the order of decoding
+  std::vector<std::string>              m_stage;  //! Intermediate buffers for stacked encodings
+  uint64_t                              m_bytesIn;
+  uint64_t                              m_bytesOut;
+};
+
+/**
+ * @class content_encoder
+ * @brief Streaming encoder for a payload that needs a Content-Encoding.
+ *        If there is an error while encoding a sid::exception is thrown.
+ */
+class content_encoder
+{
+public:
+  //! Default constructor
+  content_encoder();
+
+  //! Destructor
+  ~content_encoder();
+
+  //! Not copyable
+  content_encoder(const content_encoder&) = delete;
+  content_encoder& operator=(const content_encoder&) = delete;
+
+  /**
+   * @fn void set(const http::content_encoding& _encoding, int _level = -1);
+   * @brief Prepare the encoder for the given content-coding. Any previous state is discarded.
+   *
+   * @param _encoding [in] Content-coding to be used. Throws a sid::exception if it is not supported.
+   * @param _level [in] Compression level of the codec. If it is negative the default level of the codec is used.
+   *                    (gzip/deflate: 1-9, br: 0-11, zstd: 1-22)
+   */
+  void set(const http::content_encoding& _encoding, int _level = -1);
+
+  //! Clear the encoder state
+  void clear();
+
+  //! Checks whether the encoder is set
+  bool empty() const { return !m_codec; }
+
+  //! Encode the next piece of the payload. The encoded data is appended to _out.
+  void encode(const char* _data, size_t _len, std::string& _out);
+
+  //! Call at the end of the payload to flush the remaining encoded data to _out.
+  void finish(std::string& _out);
+
+  //! Checks whether the given content-coding can be encoded
+  static bool is_supported(const http::content_encoding& _encoding);
+
+  //! Encode the complete payload in one go
+  static std::string encode(const http::content_encoding& _encoding, int _level, const std::string& _data);
+
+public:
+  //! Internal codec interface
+  struct codec;
+
+private:
+  std::unique_ptr<codec> m_codec;
+};
+
+/**
+ * @struct compression_config
+ * @brief Configuration for compressing the responses sent by a server.
+ */
+struct compression_config
+{
+  std::vector<http::content_encoding> encodings;  //! Encodings in the order of preference of the server
+  int                                 level;      //! Compression level (negative for default level of the codec)
+  size_t                              min_size;   //! Payloads smaller than this are sent as they are
+  std::vector<std::string>            mime_types; //! Compressible types. "text/*" matches all the subtypes of text
+  size_t                              cache_size; //! Maximum bytes of compressed data held in the cache (0 disables it)
+
+  //! Default constructor sets the recommended values
+  compression_config();
+  //! Checks whether the given Content-Type value is compressible
+  bool is_compressible(const std::string& _contentType) const;
+};
+
+/**
+ * @struct compression_stats
+ * @brief Statistics of a response compressor.
+ */
+struct compression_stats
+{
+  uint64_t responses;    //! Number of responses looked at
+  uint64_t compressed;   //! Number of responses sent with a Content-Encoding
+  uint64_t cache_hits;   //! Number of compressed responses served from the cache
+  uint64_t cache_misses; //! Number of compressed responses that had to be encoded
+  uint64_t bytes_in;     //! Total size of the payloads before compression
+  uint64_t bytes_out;    //! Total size of the payloads after compression
+  uint64_t cpu_usecs;    //! CPU time spent in encoding (micro-seconds)
+
+  compression_stats() { clear(); }
+  void clear() { responses = compressed = cache_hits = cache_misses = bytes_in = bytes_out = cpu_usecs = 0; }
+  //! Compression ratio (bytes_in/bytes_out) of the compressed responses
+  double ratio() const { return bytes_out == 0? 0.0 : static_cast<double>(bytes_in) / bytes_out; }
+  std::string to_str() const;
+};
+
+/**
+ * @class response_compressor
+ * @brief Compresses the payload of the server responses as per the Accept-Encoding header of the request.
+ *
+ *        The compressed representations are held in an LRU cache keyed by (payload hash, encoding), so that
+ *        identical payloads are compressed only once. The object is thread-safe.
+ */
+class response_compressor
+{
+public:
+  //! Constructor
+  response_compressor(const compression_config& _config = compression_config());
+
+  //! Not copyable
+  response_compressor(const response_compressor&) = delete;
+  response_compressor& operator=(const response_compressor&) = delete;
+
+  //! Configuration of the compressor
+  const compression_config& config() const { return m_config; }
+
+  /**
+   * @fn bool compress(const http::request& _request, http::response& _response);
+   * @brief Compress the response payload if the client accepts one of the configured encodings.
+   *        The Content-Encoding, Content-Length and Vary headers are updated accordingly, and a strong ETag
+   *        gets the encoding as a suffix ("v1" becomes "v1-gzip") so that it differs from the identity one.
+   *
+   * @return true if the payload was compressed, false if it is left as it is.
+   */
+  bool compress(const http::request& _request, /*in/out*/ http::response& _response);
+
+  //! Select the encoding to be used for the given Accept-Encoding header value (identity if nothing matches)
+  http::content_encoding select(const std::string& _acceptEncoding) const;
+
+  //! Get a snapshot of the statistics
+  compression_stats stats() const;
+
+  //! Remove all the entries from the cache
+  void clear_cache();
+
+private:
+  struct cache_entry
+  {
+    std::string key;
+    std::string data;
+  };
+  using cache_list = std::list<cache_entry>;
+
+  compression_config  m_config;
+  mutable std::mutex  m_mutex;
+  compression_stats   m_stats;
+  cache_list          m_cache;      //! Most recently used entry is in the front
+  std::unordered_map<std::string, cache_list::iterator> m_cacheMap;
+  size_t              m_cacheBytes; //! Bytes held in the cache
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_COMPRESSION_H_
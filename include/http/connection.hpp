@@ -43,9 +43,13 @@ LICENSE: END
 
 #include "method.hpp"
 #include "status.hpp"
+#include "timing.hpp"
 #include <common/smart_ptr.hpp>
 #include <string>
+#include <vector>
+#include <memory>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #define DEFAULT_PORT_HTTP  80
 #define DEFAULT_PORT_HTTPS 443
@@ -109,6 +113,9 @@ enum connection_type : uint8_t { http, https };
 //! Available connection families
 enum connection_family : uint8_t { none = 0, ip_v4 = 4, ip_v6 = 6 };
 
+//! Outcome of a single non-blocking I/O step (see connection::open_async())
+enum class io_status : uint8_t { done, want_read, want_write, closed };
+
 /**
  * @class connection_description
  * @brief Description of the connection
@@ -224,6 +231,26 @@ public:
    */
   virtual ssize_t write(const void* _buffer, size_t _count) = 0;
 
+  /**
+   * @fn ssize_t writev(const struct iovec* _iov, int _iovcnt);
+   * @brief Write the buffers to the connection object in one system call (gathered write).
+   *        The default implementation copies the buffers into one and calls write().
+   *
+   * @return The number of bytes written, which can be less than the total of the buffers.
+   *         On error, -1 is returned, and errno is set appropriately.
+   */
+  virtual ssize_t writev(const struct iovec* _iov, int _iovcnt);
+
+  /**
+   * @fn void write_fully(const void* _buffer, size_t _count);
+   * @brief Write the whole buffer to the connection object, calling write() again after a partial write.
+   *        In case of error it throws a sid::exception.
+   *
+   * @param _buffer [in] pointer to the data to be written
+   * @param _count [in] length of data to be written
+   */
+  void write_fully(const void* _buffer, size_t _count);
+
   /**
    * @fn ssize_t read(void* _buffer, size_t _count);
    * @brief Read data from the connection object.
@@ -257,6 +284,45 @@ public:
 
   //! Accept - SSL-specific
   virtual void accept() {}
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Non-blocking interface used by event-driven engines (see http::multi_client).
+  // None of these functions wait for the socket. Errors are thrown as sid::exception.
+
+  //! Socket descriptor of the connection (-1 if the connection is not open)
+  virtual int descriptor() const = 0;
+
+  /**
+   * @fn io_status open_async(const std::string& _server, const unsigned short& _port = 0);
+   * @brief Start a non-blocking connect to the given server. The name resolution is done synchronously.
+   *
+   * @return io_status::done if the connection is established (including SSL handshake for https).
+   *         Otherwise wait for the descriptor to be ready for the returned I/O and call open_continue().
+   */
+  virtual io_status open_async(const std::string& _server, const unsigned short& _port = 0) = 0;
+
+  /**
+   * @fn io_status open_continue();
+   * @brief Continue the connect started by open_async(). Returns io_status::done once the connection is usable.
+   *        If the connect fails, the next resolved address of the server is tried over a new socket. So, the
+   *        descriptor can change between the calls.
+   */
+  virtual io_status open_continue() = 0;
+
+  /**
+   * @fn io_status read_some(void* _buffer, size_t _count, size_t& _nread);
+   * @brief Read whatever is available without waiting.
+   *
+   * @return io_status::done if _nread bytes were read, io_status::closed if the peer closed the connection,
+   *         io_status::want_read or io_status::want_write if the operation must be retried when the descriptor is ready.
+   */
+  virtual io_status read_some(void* _buffer, size_t _count, size_t& _nread) = 0;
+
+  /**
+   * @fn io_status write_some(const void* _buffer, size_t _count, size_t& _nwritten);
+   * @brief Write as much as possible without waiting. Return values are the same as read_some().
+   */
+  virtual io_status write_some(const void* _buffer, size_t _count, size_t& _nwritten) = 0;
   //
   ////////////////////////////////////////////////////////////////////////////
 
@@ -284,12 +350,35 @@ public:
   //! Get the actual server port in use.
   const unsigned int port() const { return m_port; }
 
+  //! Keep bytes that were read past the end of a message. The next message is parsed from them first (pipelining).
+  void unread(const std::string& _data) { m_unread.insert(0, _data); }
+
+  //! Take the bytes kept by unread()
+  std::string take_unread() { std::string data; data.swap(m_unread); return data; }
+
   //! Checks if the error is a retryable error so that applications can retry the last method.
   const bool is_retryable() const { return m_retryable; }
 
   // Certificate used
   const ssl::certificate& certificate() const { return m_sslCert; }
 
+  //! Set the protocols offered through ALPN in the order of preference (https only). Must be set before open().
+  void set_alpn(const std::vector<std::string>& _protocols) { m_alpn = _protocols; }
+
+  //! Protocol selected by the server through ALPN (empty if none was selected)
+  const std::string& alpn_protocol() const { return m_alpnProtocol; }
+
+  /**
+   * @fn void set_timing(bool _enable);
+   * @brief Record the timestamps of the phases of open() and of the requests sent on the connection,
+   *        along with the I/O done in each phase (see http::client::timing). Enable it before open()
+   *        to include the DNS, connect and TLS phases. When disabled (default) nothing is recorded.
+   */
+  void set_timing(bool _enable) { if ( ! _enable ) m_timing.reset(); else if ( ! m_timing ) m_timing.reset(new request_timing); }
+
+  //! Timing being recorded, or nullptr if it is not enabled
+  request_timing* timing() const { return m_timing.get(); }
+
   /**
    * @fn connection_ptr create(const connection_type& _type, const connection_family& _family);
    * @brief Creates a connection object based on the connection type specified. In case of error it throws a sid::exception.
@@ -331,9 +420,13 @@ protected:
   std::string       m_error;         //! Last error
   unsigned short    m_port;          //! Port connected to at the server
   bool              m_retryable;     //! Retryable error or not? Set by implemented virtual function.
+  std::string       m_unread;        //! Bytes read past the end of the last message (see unread())
   bool              m_isBlocking;    //! Set blocking I/O. Internally it is non-blocking, but for blocking we just keep looping over infinitely.
   uint32_t          m_ioTimeout;     //! I/O timeout in seconds.
   ssl::certificate  m_sslCert;       //! SSL Certificate to be used for https
+  std::vector<std::string> m_alpn;   //! Protocols offered through ALPN (https only)
+  std::string       m_alpnProtocol;  //! Protocol selected by the server through ALPN
+  std::unique_ptr<request_timing> m_timing; //! Timing of the phases. Null when it is not recorded.
 };
 
 } // namespace http
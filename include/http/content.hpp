@@ -40,6 +40,10 @@ LICENSE: END
 
 #include <string>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include "common/checksum.hpp"
 
 namespace sid {
 namespace http {
@@ -95,6 +99,13 @@ public:
    */
   std::string to_str() const;
 
+  /**
+   * @fn const std::string& data() const;
+   * @brief Return a reference to the content if it is a string, without making a copy.
+   *        If the content is in a file it returns an empty string.
+   */
+  const std::string& data() const;
+
   /**
    * @fn void append(const std::string& _data, size_t _pos = 0, size_t _len = std::string::npos);
    * @brief Appends data to the end.
@@ -107,6 +118,9 @@ public:
    */
   void append(const std::string& _data, size_t _pos = 0, size_t _len = std::string::npos);
 
+  //! Append _len bytes from the buffer
+  void append(const char* _data, size_t _len);
+
   //! Checks whether the content is empty or has data
   bool empty() const { return (m_length == 0); }
 
@@ -122,11 +136,104 @@ public:
   //! Gets the file path if the content is a file, otherwise it returns an empty string
   std::string file_path() const { return m_dataIsFilePath? m_data : std::string(); }
 
+  /**
+   * @fn sid::checksum::crc checksum(sid::checksum::type _type) const;
+   * @brief Checksum of the content. Content in a file is read from it.
+   *        If there is an error reading the file a sid::exception is thrown.
+   */
+  sid::checksum::crc checksum(sid::checksum::type _type) const;
+
 private:
   bool         m_dataIsFilePath; //! Indicates whether the m_data variable is a file path or not
   std::string  m_data;           //! Actual data or full path to the file that has data
   size_t       m_length;         //! Length of the data
-  std::fstream m_file;           //! File stream (used when file path is used)
+  mutable std::fstream m_file;   //! File stream (used when file path is used). Flushed before the file is read.
+};
+
+class headers;
+
+/**
+ * @fn bool verify_checksum(const http::headers& _headers, const http::content& _content, std::string* _pError = nullptr);
+ * @brief Verify the content against the x-amz-checksum-crc32c or x-amz-checksum-crc64nvme field of the headers
+ *        (trailer fields are added to the headers when a payload is received).
+ *
+ * @return true if the checksums match or there is none, false otherwise with the reason in _pError.
+ */
+bool verify_checksum(const http::headers& _headers, const http::content& _content, std::string* _pError = nullptr);
+
+/**
+ * @fn size_t FNBodyReader(void* _buffer, size_t _count);
+ * @brief Reads the next piece of a streamed payload into the buffer.
+ *
+ * @return The number of bytes read (at most _count). 0 marks the end of the payload.
+ *         Errors are reported by throwing a sid::exception.
+ */
+using FNBodyReader = std::function<size_t(void* _buffer, size_t _count)>;
+
+/**
+ * @class body_source
+ * @brief Source of a payload that is streamed in pieces instead of being held in memory.
+ *        The payload is read from a callback, a file descriptor or a range of a file.
+ *        Copies of the object share the same read position.
+ */
+class body_source
+{
+public:
+  //! Default constructor (empty source)
+  body_source();
+
+  /**
+   * @fn body_source from_reader(const FNBodyReader& _reader, uint64_t _length = unknown_length);
+   * @brief Create a source that reads from the callback.
+   *        If the length is not known, the payload is sent with "Transfer-Encoding: chunked".
+   *        The source cannot be rewound.
+   */
+  static body_source from_reader(const FNBodyReader& _reader, uint64_t _length = unknown_length);
+
+  /**
+   * @fn body_source from_fd(int _fd, uint64_t _offset, uint64_t _length);
+   * @brief Create a source that reads _length bytes at _offset of the descriptor using pread.
+   *        The descriptor is not closed by the source.
+   */
+  static body_source from_fd(int _fd, uint64_t _offset, uint64_t _length);
+
+  /**
+   * @fn body_source from_file(const std::string& _filePath, uint64_t _offset = 0, uint64_t _length = unknown_length);
+   * @brief Create a source that reads the range of the file. The default range is from _offset till the end of the file.
+   *        If the file cannot be opened a sid::exception is thrown.
+   */
+  static body_source from_file(const std::string& _filePath, uint64_t _offset = 0, uint64_t _length = unknown_length);
+
+  //! Checks whether a source is set
+  bool empty() const { return !m_reader; }
+
+  //! Checks whether the length of the payload is known
+  bool has_length() const { return m_length != unknown_length; }
+
+  //! Length of the payload (unknown_length if it is not known)
+  uint64_t length() const { return m_length; }
+
+  /**
+   * @fn size_t read(void* _buffer, size_t _count);
+   * @brief Read the next piece of the payload. Returns 0 at the end of the payload.
+   *        If the source returns more or fewer bytes than its length a sid::exception is thrown.
+   */
+  size_t read(void* _buffer, size_t _count);
+
+  /**
+   * @fn bool rewind();
+   * @brief Go back to the start of the payload so that it can be sent again (redirects and authentication).
+   *        Returns false if the source cannot be rewound.
+   */
+  bool rewind();
+
+  static const uint64_t unknown_length = static_cast<uint64_t>(-1);
+
+private:
+  FNBodyReader                m_reader;  //! Reader of the payload
+  std::function<bool()>       m_rewind;  //! Rewinds the reader (empty if it cannot be rewound)
+  uint64_t                    m_length;  //! Length of the payload, if known
+  std::shared_ptr<uint64_t>   m_read;    //! Number of bytes read so far (shared by the copies)
 };
 
 } // namespace http
@@ -68,6 +68,7 @@ public:
   bool set(const std::string& _value);
   void clear();
   std::string to_str(bool _forRequest = true) const;
+  void write(sid::sized_writer& _out, bool _forRequest = true) const;
   bool is_expired() const;
   bool equals(const std::string& _name) const;
 
@@ -77,6 +78,7 @@ public:
     bool empty() const { return name.empty(); }
     void clear() { name.clear(); value.clear(); }
     std::string to_str() const { return empty()? "" : (name + "=" + value); }
+    void write(sid::sized_writer& _out) const { if ( !empty() ) _out << name << '=' << value; }
   };
   struct expiration_info
   {
@@ -95,6 +97,9 @@ public:
   std::string      path;
   expiration_info  expiration;
   time_t           time_received;
+
+private:
+  void p_write(sid::sized_writer& _out, bool _forRequest, const std::string& _expires) const;
 };
 
 /**
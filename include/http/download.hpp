@@ -0,0 +1,147 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file download.hpp
+ * @brief Defines the parallel ranged download manager.
+ */
+#ifndef _SID_HTTP_DOWNLOAD_H_
+#define _SID_HTTP_DOWNLOAD_H_
+
+#include "connection.hpp"
+#include "request.hpp"
+#include <string>
+
+namespace sid {
+namespace http {
+
+/**
+ * @struct download_config
+ * @brief Limits and options used by downloader.
+ */
+struct download_config
+{
+  uint32_t          connections;    //! Number of parallel connections (default: 8)
+  uint64_t          part_size;      //! Size of the first range, which is also the probe (default: 8 MB)
+  uint64_t          min_part_size;  //! Lower bound of an adaptive range size (default: 1 MB)
+  uint64_t          max_part_size;  //! Upper bound of an adaptive range size (default: 64 MB)
+  uint32_t          part_time_ms;   //! Range sizes are adapted so that each takes about this long on its connection (default: 1000)
+  uint32_t          max_retries;    //! Number of times a failed range is retried (default: 3)
+  uint32_t          timeout;        //! I/O timeout of a connection in seconds (default: DEFAULT_IO_TIMEOUT_SECS)
+  bool              verify_md5;     //! Verify the content against the ETag if it is a plain MD5 (S3 style) (default: false)
+  connection_family family;         //! Connection family to use
+  ssl::certificate  certificate;    //! SSL certificate to be used for https connections
+
+  //! Default constructor
+  download_config();
+  //! Reset to the default values
+  void clear();
+};
+
+/**
+ * @struct download_stats
+ * @brief Outcome of the last download.
+ */
+struct download_stats
+{
+  uint64_t    size;        //! Size of the object
+  std::string etag;        //! ETag of the object (empty if the server did not send one)
+  uint32_t    parts;       //! Number of ranges downloaded (excluding the retries)
+  uint32_t    retries;     //! Number of ranges that were retried
+  uint32_t    connections; //! Number of connections used
+  uint64_t    elapsed_us;  //! Time taken in micro-seconds
+
+  download_stats() { clear(); }
+  void clear() { size = 0; etag.clear(); parts = retries = connections = 0; elapsed_us = 0; }
+  std::string to_str() const;
+};
+
+class download_job;
+
+/**
+ * @class downloader
+ * @brief Downloads a large object over parallel connections using Range requests.
+ *
+ * The first range doubles as the probe. Its Content-Range gives the size of the object and its ETag pins
+ * the version (subsequent ranges are sent with If-Match). The rest of the object is split into ranges that
+ * are fetched by http::client objects, one per connection, and written at their offsets with pwrite() (or
+ * into the buffer). The range size of each connection follows its observed throughput and failed ranges are
+ * retried on their own. If the server does not support ranges, the whole object is written as the probe receives it.
+ *
+ *   http::downloader dl;
+ *   dl.config.connections = 16;
+ *   if ( ! dl.download("https://bucket.s3.amazonaws.com/key", "/tmp/key") )
+ *     cerr << dl.exception().what() << endl;
+ */
+class downloader
+{
+public:
+  //! Default constructor
+  downloader();
+
+  /**
+   * @fn bool download(const std::string& _url, const std::string& _filePath);
+   * @brief Download the object at the URL into the file. The file is created or truncated.
+   *
+   * @return true on success, false otherwise. exception() will contain the last exception object in case of failure.
+   */
+  bool download(const std::string& _url, const std::string& _filePath);
+
+  /**
+   * @fn bool download_to_buffer(const std::string& _url, std::string& _buffer);
+   * @brief Download the object at the URL into the buffer.
+   */
+  bool download_to_buffer(const std::string& _url, /*out*/ std::string& _buffer);
+
+  //! Statistics of the last download
+  const download_stats& stats() const { return m_stats; }
+
+  //! Returns the last exception object
+  const sid::exception& exception() const { return m_exception; }
+
+public:
+  download_config config;  //! Limits and options
+  http::request   request; //! Headers (and credentials) added to every range request. Method, uri and Range are set internally.
+
+private:
+  bool p_download(const std::string& _url, download_job& _job);
+
+private:
+  download_stats m_stats;     //! Statistics of the last download
+  sid::exception m_exception; //! Last exception
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_DOWNLOAD_H_
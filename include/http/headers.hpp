@@ -43,14 +43,21 @@ LICENSE: END
 #include <common/simple_types.hpp>
 #include <common/exception.hpp>
 #include <common/optional.hpp>
+#include <common/sized_writer.hpp>
 
 namespace sid {
 namespace http {
 
 //! content encoding
-enum class content_encoding : uint8_t { identity, gzip, compress, deflate, br };
+enum class content_encoding : uint8_t { identity, gzip, compress, deflate, br, zstd };
 using content_encoding_opt = sid::optional<content_encoding>;
 
+//! Get the content_encoding for the given token. Returns false if the token is not a known content-coding.
+bool get_content_encoding(const std::string& _token, /*out*/ http::content_encoding& _encoding);
+
+//! Get the token used in the headers for the given content_encoding
+std::string content_encoding_to_str(const http::content_encoding& _encoding);
+
 //! Transfer encoding method
 enum class transfer_encoding : uint8_t { none = 0, chunked, compress, deflate, gzip, identity };
 using transfer_encoding_opt = sid::optional<transfer_encoding>;
@@ -123,6 +130,9 @@ public:
   //! Return the key/value pair as string
   std::string to_str() const;
 
+  //! Write the key/value pair to the writer
+  void write(sid::sized_writer& _out) const { _out << key << ": " << value; }
+
   //! Get the header object using the given key/value string data.
   static header get(const std::string& _data);
 
@@ -242,6 +252,9 @@ public:
   //! Return a CRLF separated list of header key/value pair as string.
   std::string to_str() const;
 
+  //! Write a CRLF separated list of header key/value pair to the writer.
+  void write(sid::sized_writer& _out) const;
+
   // Get the "Content-Length" header. Returns 0 if it is not found. Check for *_pisFound for existence
   uint64_t content_length(bool* _pisFound = nullptr) const;
 
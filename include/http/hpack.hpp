@@ -0,0 +1,165 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file hpack.hpp
+ * @brief Defines the HPACK header compression used by HTTP/2 (RFC 7541).
+ */
+#ifndef _SID_HTTP_HPACK_H_
+#define _SID_HTTP_HPACK_H_
+
+#include "headers.hpp"
+#include <string>
+#include <deque>
+
+#define HPACK_DEFAULT_TABLE_SIZE 4096
+
+namespace sid {
+namespace http {
+
+/**
+ * @class hpack_table
+ * @brief The dynamic table shared by the encoder and decoder.
+ *        Index 1 to 61 refer to the static table and the dynamic entries follow.
+ */
+class hpack_table
+{
+public:
+  hpack_table(uint32_t _maxSize = HPACK_DEFAULT_TABLE_SIZE);
+
+  //! Get the entry at the given index (1-based). Throws sid::exception if the index is invalid.
+  const http::header& get(size_t _index) const;
+
+  //! Add a new entry, evicting the oldest entries as required
+  void add(const std::string& _name, const std::string& _value);
+
+  /**
+   * @fn size_t find(const std::string& _name, const std::string& _value, bool& _isValueMatched) const;
+   * @brief Find the best matching entry.
+   *
+   * @return Index of the entry (0 if the name is not found). _isValueMatched is set if the value matches as well.
+   */
+  size_t find(const std::string& _name, const std::string& _value, bool& _isValueMatched) const;
+
+  //! Change the maximum size of the dynamic table, evicting entries as required
+  void set_max_size(uint32_t _maxSize);
+  uint32_t max_size() const { return m_maxSize; }
+  uint32_t size() const { return m_size; }
+
+  //! Number of entries in the static table
+  static size_t static_count();
+
+private:
+  void evict(uint32_t _maxSize);
+
+private:
+  std::deque<http::header> m_entries; //! Dynamic entries (newest first)
+  uint32_t                 m_size;    //! Current size as per RFC 7541 section 4.1
+  uint32_t                 m_maxSize; //! Maximum size
+};
+
+/**
+ * @class hpack_encoder
+ * @brief Encodes header lists into HPACK header blocks.
+ */
+class hpack_encoder
+{
+public:
+  hpack_encoder(uint32_t _maxTableSize = HPACK_DEFAULT_TABLE_SIZE);
+
+  /**
+   * @fn void set_max_table_size(uint32_t _maxSize);
+   * @brief Limit the dynamic table to the size advertised by the peer (SETTINGS_HEADER_TABLE_SIZE).
+   *        The size update is signalled at the start of the next header block.
+   */
+  void set_max_table_size(uint32_t _maxSize);
+
+  /**
+   * @fn void encode(const std::string& _name, const std::string& _value, std::string& _out);
+   * @brief Append the encoded field to _out. The name must be in lowercase.
+   *        Sensitive fields (authorization, cookie with short values) are never indexed.
+   */
+  void encode(const std::string& _name, const std::string& _value, /*out*/ std::string& _out);
+
+  //! Append the encoded header list to _out. The header names are converted to lowercase.
+  void encode(const http::headers& _headers, /*out*/ std::string& _out);
+
+private:
+  void p_begin_block(std::string& _out);
+
+private:
+  hpack_table m_table;          //! Dynamic table
+  uint32_t    m_pendingSize;    //! Table size to be signalled (UINT32_MAX if none)
+};
+
+/**
+ * @class hpack_decoder
+ * @brief Decodes HPACK header blocks.
+ */
+class hpack_decoder
+{
+public:
+  hpack_decoder(uint32_t _maxTableSize = HPACK_DEFAULT_TABLE_SIZE);
+
+  /**
+   * @fn void decode(const char* _data, size_t _len, http::headers& _headers);
+   * @brief Decode a complete header block and append the fields to _headers.
+   *        Throws sid::exception on a compression error (which is fatal for the HTTP/2 connection).
+   */
+  void decode(const char* _data, size_t _len, /*out*/ http::headers& _headers);
+
+private:
+  hpack_table m_table;        //! Dynamic table
+  uint32_t    m_maxTableSize; //! Upper limit allowed for the dynamic table size updates
+};
+
+namespace hpack {
+
+//! Append the Huffman encoding of _input to _out
+void huffman_encode(const std::string& _input, /*out*/ std::string& _out);
+
+//! Number of bytes needed for the Huffman encoding of _input
+size_t huffman_length(const std::string& _input);
+
+//! Append the decoded Huffman data to _out. Throws sid::exception if the data is invalid.
+void huffman_decode(const char* _data, size_t _len, /*out*/ std::string& _out);
+
+//! Append an integer with the given prefix bits (RFC 7541 section 5.1). _flags go in the bits above the prefix.
+void encode_integer(uint64_t _value, uint8_t _prefixBits, uint8_t _flags, /*out*/ std::string& _out);
+
+} // namespace hpack
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_HPACK_H_
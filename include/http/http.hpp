@@ -44,14 +44,25 @@ LICENSE: END
 #include "version.hpp"
 #include "headers.hpp"
 #include "content.hpp"
+#include "compression.hpp"
 #include "request.hpp"
+#include "request_template.hpp"
 #include "connection.hpp"
 #include "response.hpp"
 #include "cookies.hpp"
 #include "status.hpp"
 #include "url.hpp"
 #include "www_authenticate.hpp"
+#include "auth_cache.hpp"
 #include "client.hpp"
+#include "multi_client.hpp"
+#include "hpack.hpp"
+#include "http2.hpp"
+#include "download.hpp"
+#include "retry.hpp"
+#include "pipeline.hpp"
+#include "cache.hpp"
+#include "timing.hpp"
 #include "server.hpp"
 #include "common.hpp"
 
@@ -0,0 +1,172 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file http2.hpp
+ * @brief Defines the HTTP/2 (RFC 9113) session used for multiplexing requests over a single connection.
+ */
+#ifndef _SID_HTTP_HTTP2_H_
+#define _SID_HTTP_HTTP2_H_
+
+#include "connection.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include "multi_client.hpp"
+#include <string>
+#include <functional>
+#include <memory>
+
+//! ALPN protocol identifier for HTTP/2 over TLS
+#define HTTP2_ALPN_PROTOCOL "h2"
+
+namespace sid {
+namespace http {
+
+//! HTTP/2 error codes (RFC 9113 section 7)
+enum class http2_error : uint32_t
+{
+  no_error = 0, protocol_error, internal_error, flow_control_error, settings_timeout, stream_closed,
+  frame_size_error, refused_stream, cancel, compression_error, connect_error, enhance_your_calm,
+  inadequate_security, http_1_1_required
+};
+
+/**
+ * @struct http2_settings
+ * @brief HTTP/2 SETTINGS parameters (RFC 9113 section 6.5.2)
+ */
+struct http2_settings
+{
+  uint32_t header_table_size;      //! SETTINGS_HEADER_TABLE_SIZE
+  uint32_t enable_push;            //! SETTINGS_ENABLE_PUSH
+  uint32_t max_concurrent_streams; //! SETTINGS_MAX_CONCURRENT_STREAMS
+  uint32_t initial_window_size;    //! SETTINGS_INITIAL_WINDOW_SIZE
+  uint32_t max_frame_size;         //! SETTINGS_MAX_FRAME_SIZE
+  uint32_t max_header_list_size;   //! SETTINGS_MAX_HEADER_LIST_SIZE
+
+  //! Default constructor. Sets the initial values defined by the RFC.
+  http2_settings();
+  void clear();
+};
+
+//! Server request handler. It fills the response for the given request.
+using FNHttp2Handler = std::function<void(const http::request& _request, http::response& _response)>;
+
+class http2_engine;
+
+/**
+ * @class http2_session
+ * @brief An HTTP/2 session over an open connection.
+ *
+ * On the client side, requests are submitted as streams and are multiplexed over the connection,
+ * honouring the flow control windows and the concurrent stream limit of the server. For https the
+ * connection must have negotiated "h2" through ALPN (see connection::set_alpn()). For http it is
+ * used with prior knowledge (h2c).
+ *
+ *   http::http2_session session(conn);
+ *   for ( const std::string& key : keys )
+ *     session.submit(request, [&](http::multi_result& _result) { ... });
+ *   if ( ! session.run() )
+ *     throw sid::exception(session.error());
+ *
+ * On the server side, serve() processes the requests of the connection until the client goes away.
+ */
+class http2_session
+{
+public:
+  enum class role : uint8_t { client, server };
+
+  /**
+   * @param _conn [in] Open connection. Nothing is sent until submit()/run()/serve() is called.
+   * @param _role [in] Client or server side of the connection
+   */
+  http2_session(connection_ptr _conn, role _role = role::client);
+  ~http2_session();
+
+  //! Decode the content as per Content-Encoding header (client only, default: true)
+  void set_decode_content(bool _decodeContent);
+
+  /**
+   * @fn uint32_t submit(const http::request& _request, const FNMultiCallback& _fnCallback);
+   * @brief Queue a request on a new stream (client only). The callback is called from run().
+   *
+   * @return Identifier of the request (also available in multi_result::id)
+   */
+  uint32_t submit(const http::request& _request, const FNMultiCallback& _fnCallback);
+
+  /**
+   * @fn bool run();
+   * @brief Run the session until all the submitted requests are complete (client only).
+   *
+   * @return true if the connection is still usable, false otherwise. error() has the reason for the failure.
+   *         Requests that could not be completed are reported to their callbacks.
+   */
+  bool run();
+
+  /**
+   * @fn bool exchange(const http::request& _request, http::response& _response);
+   * @brief Send the request and wait for its response (client only).
+   *
+   * @return true if the response was received, false otherwise. error() has the reason for the failure.
+   */
+  bool exchange(const http::request& _request, http::response& _response);
+
+  /**
+   * @fn bool serve(const FNHttp2Handler& _fnHandler);
+   * @brief Process the requests of the connection until the client closes it (server only).
+   *        Expects the client connection preface as the first data on the connection.
+   *
+   * @return true if the client closed the connection gracefully, false otherwise.
+   */
+  bool serve(const FNHttp2Handler& _fnHandler);
+
+  //! Returns true if the connection can still be used for new requests
+  bool is_usable() const;
+
+  //! Settings received from the peer
+  const http2_settings& peer_settings() const;
+
+  //! Reason for the last failure
+  const std::string& error() const;
+
+private:
+  http2_session(const http2_session&) = delete;
+  http2_session& operator=(const http2_session&) = delete;
+
+private:
+  std::unique_ptr<http2_engine> m_engine; //! Protocol implementation
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_HTTP2_H_
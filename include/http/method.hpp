@@ -63,11 +63,20 @@ public:
   method_type& type() { return m_type; }
 
   //! Get the string name of the method
-  std::string to_str() const;
+  const std::string& to_str() const;
+
+  //! Safe methods do not change the state of the server: GET, HEAD, OPTIONS and TRACE (RFC 9110 section 9.2.1)
+  bool is_safe() const;
+
+  //! Idempotent methods have the same effect when repeated, so they can be retried: the safe methods, PUT and DELETE (RFC 9110 section 9.2.2)
+  bool is_idempotent() const;
 
   //! Get the method object using the given method name.
   static method get(const std::string& _name, const sid::match_case& _matchCase = sid::match_case::exact);
 
+  //! Get the method object using the given method name of _len bytes (need not be null terminated).
+  static method get(const char* _name, size_t _len, const sid::match_case& _matchCase = sid::match_case::exact);
+
 public:
   //! Default constructor
   method();
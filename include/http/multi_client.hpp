@@ -0,0 +1,177 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file multi_client.hpp
+ * @brief Defines an event-driven engine that runs many HTTP requests concurrently from a single thread.
+ */
+#ifndef _SID_HTTP_MULTI_CLIENT_H_
+#define _SID_HTTP_MULTI_CLIENT_H_
+
+#include "connection.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include <string>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace sid {
+namespace http {
+
+/**
+ * @struct multi_result
+ * @brief Outcome of a request run by multi_client.
+ */
+struct multi_result
+{
+  uint64_t       id;        //! Identifier returned by multi_client::add()
+  bool           success;   //! Set if a complete response was received (irrespective of the status code)
+  http::response response;  //! Response received from the server
+  std::string    error;     //! Reason for the failure if success is not set
+
+  multi_result() : id(0), success(false), response(), error() {}
+};
+
+//! Completion callback. It is called from the thread that runs multi_client::run() or multi_client::poll().
+using FNMultiCallback = std::function<void(multi_result& _result)>;
+
+/**
+ * @struct multi_config
+ * @brief Limits and options used by multi_client.
+ */
+struct multi_config
+{
+  uint32_t          max_in_flight;  //! Maximum number of requests in flight across all hosts (default: 1024)
+  uint32_t          max_per_host;   //! Maximum number of connections in use per host (default: 64)
+  uint32_t          timeout;        //! Inactivity timeout of a request in seconds (default: DEFAULT_IO_TIMEOUT_SECS)
+  bool              decode_content; //! Negotiate Accept-Encoding and decode compressed responses (default: true)
+  connection_family family;         //! Connection family to use
+  ssl::certificate  certificate;    //! SSL certificate to be used for https connections
+
+  //! Default constructor
+  multi_config();
+  //! Reset to the default values
+  void clear();
+};
+
+class multi_engine;
+
+/**
+ * @class multi_client
+ * @brief Runs many HTTP requests concurrently, in the spirit of curl-multi.
+ *
+ * Requests are queued with add() (which may be called from any thread, including a completion callback).
+ * All the connections are driven from a single epoll loop using non-blocking connect, SSL handshake and I/O,
+ * when run() or poll() is called. Connections are kept alive and reused for requests to the same host.
+ *
+ *   http::multi_client multi;
+ *   multi.config.max_per_host = 32;
+ *   for ( const std::string& key : keys )
+ *     multi.add("http://127.0.0.1:9000/bucket/" + key, request, [&](http::multi_result& _result) { ... });
+ *   multi.run();
+ */
+class multi_client
+{
+public:
+  //! Default constructor
+  multi_client();
+  //! Destructor. Requests that are not complete yet are dropped without calling their callbacks.
+  ~multi_client();
+
+  /**
+   * @fn uint64_t add(const std::string& _url, const http::request& _request, const FNMultiCallback& _fnCallback);
+   * @brief Queue a request. If the uri of the request is not set, it is taken from the URL.
+   *        If the method is not set, GET is used.
+   *        The Host header is added if it is not set. Throws sid::exception if the URL is invalid.
+   *
+   * @param _url [in] URL of the server (only the connection type, server and port are used if the request has a uri)
+   * @param _request [in] Request to be sent (including the content)
+   * @param _fnCallback [in] Called once the request completes or fails
+   *
+   * @return Identifier of the request (also available in multi_result::id)
+   */
+  uint64_t add(const std::string& _url, const http::request& _request, const FNMultiCallback& _fnCallback);
+
+  /**
+   * @fn std::future<multi_result> add(const std::string& _url, const http::request& _request);
+   * @brief Same as above, but the result is delivered through a future.
+   *        Note that the future is satisfied only while run() or poll() is being called.
+   */
+  std::future<multi_result> add(const std::string& _url, const http::request& _request);
+
+  /**
+   * @fn bool run();
+   * @brief Run the event loop until all the queued requests are complete or stop() is called.
+   *
+   * @return true on success, false otherwise. exception() will contain the last exception object in case of failure.
+   */
+  bool run();
+
+  /**
+   * @fn size_t poll(int _timeoutMs);
+   * @brief Run one iteration of the event loop waiting at most _timeoutMs milliseconds for I/O.
+   *        Throws sid::exception if the event loop itself fails.
+   *
+   * @return Number of requests that are not complete yet.
+   */
+  size_t poll(int _timeoutMs);
+
+  //! Make run() return at the earliest. Can be called from any thread.
+  void stop();
+
+  //! Number of requests that are not complete yet
+  size_t pending() const;
+
+  //! Number of requests currently in flight
+  size_t in_flight() const;
+
+  //! Returns the last exception object
+  const sid::exception& exception() const { return m_exception; }
+
+public:
+  multi_config config; //! Limits and options. They are applied when the requests are started.
+
+private:
+  multi_client(const multi_client&) = delete;
+  multi_client& operator=(const multi_client&) = delete;
+
+private:
+  std::unique_ptr<multi_engine> m_engine;    //! Event loop implementation
+  sid::exception                m_exception; //! Last exception
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_MULTI_CLIENT_H_
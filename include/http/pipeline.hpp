@@ -0,0 +1,145 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file pipeline.hpp
+ * @brief Defines the HTTP/1.1 request pipeline.
+ */
+#ifndef _SID_HTTP_PIPELINE_H_
+#define _SID_HTTP_PIPELINE_H_
+
+#include "connection.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include <string>
+#include <vector>
+
+namespace sid {
+namespace http {
+
+/**
+ * @class pipeline
+ * @brief Sends a queue of idempotent requests on a persistent HTTP/1.1 connection without waiting for the
+ *        responses (RFC 9112 section 9.3.2), so that small requests do not pay a round trip each.
+ *
+ * Requests are serialized and written back-to-back with a single writev(), keeping up to max_depth of them
+ * ahead of their responses. The responses are matched to the requests in FIFO order, with the bytes that follow
+ * a response kept on the connection for the next one (see connection::unread()). If the server closes the connection (or answers with "Connection: close")
+ * before answering all the requests, the unanswered ones are replayed on a new connection to the same server.
+ *
+ *   http::pipeline pl;
+ *   pl.conn = http::connection::create(http::connection_type::http);
+ *   pl.conn->open("example.com");
+ *   for ( const std::string& uri : uris )
+ *   {
+ *     http::request request;
+ *     request.method = http::method_type::get;
+ *     request.uri = uri;
+ *     request.headers("Host", "example.com");
+ *     pl.add(request);
+ *   }
+ *   if ( ! pl.run() )
+ *     cerr << pl.exception().what() << endl;
+ *   for ( const http::response& response : pl.responses() ) ...
+ */
+class pipeline
+{
+public:
+  http::connection_ptr conn;           //! HTTP connection pointer. It must be open before run().
+  bool                 decode_content; //! Negotiate Accept-Encoding and decode compressed responses (default: true)
+  uint32_t             max_depth;      //! Requests written ahead of their responses (default: 16)
+  uint32_t             max_replays;    //! Connections tried in a row without getting a response before giving up (default: 3)
+
+public:
+  //! Default constructor
+  pipeline();
+
+  //! Clear the requests and responses so that the object can be reused again. The connection is kept.
+  void clear();
+
+  /**
+   * @fn void add(const http::request& _request);
+   * @brief Queue the request. Only idempotent requests without a streamed payload can be pipelined, as they
+   *        may have to be replayed. A sid::exception is thrown otherwise.
+   */
+  void add(const http::request& _request);
+
+  //! Number of requests queued
+  size_t size() const { return m_requests.size(); }
+
+  /**
+   * @fn bool run();
+   * @brief Send the queued requests and receive their responses.
+   *
+   * @return true if a response was received for every request (whatever its status), false otherwise.
+   *         The responses received so far are available in either case, and exception() will contain the
+   *         last exception object in case of failure.
+   */
+  bool run();
+
+  //! Responses in the order of the requests. Only the first completed() are valid.
+  const std::vector<http::response>& responses() const { return m_responses; }
+
+  //! Number of requests answered
+  size_t completed() const { return m_completed; }
+
+  //! Number of requests that were sent again on a new connection
+  size_t replayed() const { return m_replayed; }
+
+  //! Returns the last exception object
+  const sid::exception& exception() const { return m_exception; }
+
+private:
+  //! Write the queued requests from m_sent onwards, up to max_depth ahead of the first unanswered one
+  void p_send();
+  //! Receive the response of the first unanswered request. Returns false if the connection closed before it.
+  bool p_recv();
+  //! Open a new connection to the server, to replay the unanswered requests
+  void p_reopen();
+
+private:
+  std::vector<http::request>  m_requests;   //! Queued requests
+  std::vector<std::string>    m_wire;       //! Serialized requests
+  std::vector<http::response> m_responses;  //! Responses of the requests
+  size_t                      m_completed;  //! Requests answered
+  size_t                      m_sent;       //! Requests written on the current connection (from the start of the queue)
+  size_t                      m_replayed;   //! Requests sent again on a new connection
+  std::string                 m_server;     //! Server of the connection, to reopen it
+  unsigned short              m_port;       //! Port of the connection, to reopen it
+  sid::exception              m_exception;  //! Last exception
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_PIPELINE_H_
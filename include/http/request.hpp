@@ -43,11 +43,23 @@ LICENSE: END
 #include "headers.hpp"
 #include "content.hpp"
 #include "connection.hpp"
+#include "common/checksum.hpp"
 #include <string>
 
 namespace sid {
 namespace http {
 
+/**
+ * @enum checksum_location
+ * @brief Where request::set_checksum() sends the checksum of the payload
+ */
+enum class checksum_location : uint8_t
+{
+  header,      //! x-amz-checksum-<type> header, computed before the request is sent
+  trailer,     //! Trailer of the chunked (HTTP/1.1) payload. S3 does not accept it.
+  aws_chunked  //! Trailer of the aws-chunked payload named in x-amz-trailer (STREAMING-UNSIGNED-PAYLOAD-TRAILER), as S3 expects it
+};
+
 /**
  * @class request
  * @brief Definition of HTTP request object.
@@ -87,6 +99,12 @@ public:
   std::string to_str() const;
   std::string to_str(bool _withContent) const;
 
+  /**
+   * @fn void write(sid::sized_writer& _out, bool _withContent) const;
+   * @brief Write the complete HTTP request to the writer. Use sid::serialize() to write into a caller-supplied buffer.
+   */
+  void write(sid::sized_writer& _out, bool _withContent) const;
+
   /**
    * @fn void set_content(const std::string& data, size_t len);
    * @brief Sets the payload of the request
@@ -98,6 +116,34 @@ public:
    */
   void set_content(const std::string& _data, size_t _len = std::string::npos);
 
+  /**
+   * @fn void set_content(const http::body_source& _source);
+   * @brief Sets a payload that is streamed from the source when the request is sent.
+   *
+   * @note This sets "Content-Length" if the length of the source is known, otherwise "Transfer-Encoding: chunked".
+   */
+  void set_content(const http::body_source& _source);
+
+  /**
+   * @fn void set_checksum(sid::checksum::type _type, checksum_location _location = checksum_location::header);
+   * @brief Send the checksum of the payload in the x-amz-checksum-<type> field (see http::checksum_header()).
+   *        Call it after the payload is set. By default the checksum is computed now and sent as a header,
+   *        and a streamed payload is read once for it (it must be rewindable). In a trailer, a streamed payload
+   *        is sent chunked with the checksum computed while it is sent:
+   *        - checksum_location::trailer uses the HTTP/1.1 chunked encoding with a Trailer header.
+   *        - checksum_location::aws_chunked uses the aws-chunked encoding of S3 in 64 KB chunks. The source must have
+   *          a known length, which is sent in x-amz-decoded-content-length. Content-Length is the encoded length.
+   *          The request must be signed with x-amz-content-sha256 as set here (STREAMING-UNSIGNED-PAYLOAD-TRAILER).
+   *        If there is an error a sid::exception is thrown.
+   */
+  void set_checksum(sid::checksum::type _type, checksum_location _location = checksum_location::header);
+
+  /**
+   * @fn bool verify_checksum(std::string* _pError = nullptr) const;
+   * @brief Verify a received payload against its x-amz-checksum-* header or trailer. True if there is none.
+   */
+  bool verify_checksum(std::string* _pError = nullptr) const;
+
   /**
    * @fn const http::content& content() const;
    * @brief Gets the payload of the request.
@@ -108,16 +154,33 @@ public:
   bool send(connection_ptr _conn);
   bool send(connection_ptr _conn, const std::string& _data);
   bool send(connection_ptr _conn, const void* _buffer, size_t _count);
+
+  /**
+   * @fn bool send_body(connection_ptr _conn);
+   * @brief Send the payload alone (the request line and headers must have been sent already).
+   *        A streamed payload is read and written in bounded pieces, each write waiting for the connection
+   *        to accept the previous one, and is chunk encoded if its length is not known.
+   */
+  bool send_body(connection_ptr _conn);
+
+  /**
+   * @fn bool recv(connection_ptr _conn);
+   * @brief Receive a request. "Expect: 100-continue" is answered before the payload is read, and a chunked
+   *        payload is decoded (the request then carries Content-Length instead of Transfer-Encoding).
+   */
   bool recv(connection_ptr _conn);
 
 private:
   http::content m_content;   //! HTTP request payload
+  sid::checksum::type m_trailerChecksum; //! Checksum sent in a trailer of the streamed payload
+  bool          m_isAwsChunked; //! The streamed payload is sent aws-chunked (with m_trailerChecksum)
 
 public:
   http::method  method;      //! HTTP method in Line-1 of request
   std::string   uri;         //! resource identifier in Line-1 of request
   http::version version;     //! HTTP version
   http::headers headers;     //! List of request headers
+  http::body_source body;    //! Streamed payload. When set, it is sent instead of the content.
   std::string   userName;    //! Username for challenge authentication (used in www_authenticate)
   std::string   password;    //! Password for challenge authentication
   bool          content_is_file_path;
@@ -0,0 +1,133 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file request_template.hpp
+ * @brief Defines a request template that is serialized once and reused for similar requests.
+ */
+#ifndef _SID_HTTP_REQUEST_TEMPLATE_H_
+#define _SID_HTTP_REQUEST_TEMPLATE_H_
+
+#include "request.hpp"
+#include "connection.hpp"
+#include <string>
+#include <vector>
+
+namespace sid {
+namespace http {
+
+/**
+ * @class request_template
+ * @brief Pre-serialized form of a request where only the URI and a few headers change for every request.
+ *
+ *        The start-line fragments and the constant header block are serialized once. For every request
+ *        only the URI and the values of the variable headers (for example Date, Authorization) are
+ *        copied into a reusable output buffer whose exact size is computed up front.
+ *
+ * @example
+ *        http::request_template tmpl;
+ *        tmpl.set(prototype, {"x-amz-date", "Authorization"});
+ *        std::vector<std::string> values(2);
+ *        for ( ... )
+ *        {
+ *          values[0] = amzDate; values[1] = authStr;
+ *          tmpl.send(conn, uri, values);
+ *        }
+ */
+class request_template
+{
+public:
+  //! Default constructor
+  request_template();
+
+  /**
+   * @fn void set(const http::request& _prototype, const std::vector<std::string>& _variableHeaders);
+   * @brief Serialize the constant parts of the given request.
+   *
+   * @param _prototype [in] Request with the method, version and the constant headers.
+   *                        The URI and the content of the prototype are not used.
+   * @param _variableHeaders [in] Keys of the headers whose values are given for every request.
+   *                              These are removed from the constant header block if they exist in the prototype.
+   */
+  void set(const http::request& _prototype, const std::vector<std::string>& _variableHeaders = std::vector<std::string>());
+
+  //! Clear the template
+  void clear();
+
+  //! Number of variable headers
+  size_t variable_count() const { return m_keys.size(); }
+
+  //! Returns the position of the variable header in the values list, or std::string::npos if it is not a variable header
+  size_t index(const std::string& _key) const;
+
+  //! Returns the length of the serialized request for the given URI and header values
+  size_t length(const std::string& _uri, const std::vector<std::string>& _values) const;
+
+  /**
+   * @fn void render(std::string& _out, const std::string& _uri, const std::vector<std::string>& _values) const;
+   * @brief Serialize the request head (start-line, headers and the empty line) into _out.
+   *        The existing data in _out is discarded, but its capacity is reused.
+   *
+   * @param _out [out] Output buffer
+   * @param _uri [in] Request URI
+   * @param _values [in] Values of the variable headers in the order given in set(). An empty value drops the header.
+   */
+  void render(std::string& _out, const std::string& _uri, const std::vector<std::string>& _values) const;
+
+  /**
+   * @fn size_t render(char* _buffer, size_t _size, const std::string& _uri, const std::vector<std::string>& _values) const;
+   * @brief Serialize the request head into a caller-supplied buffer.
+   *
+   * @return The number of bytes written. If the buffer is not big enough nothing is written and it returns 0.
+   */
+  size_t render(char* _buffer, size_t _size, const std::string& _uri, const std::vector<std::string>& _values) const;
+
+  /**
+   * @fn void send(connection_ptr _conn, const std::string& _uri, const std::vector<std::string>& _values, const std::string& _content);
+   * @brief Serialize the request using the internal buffer and send it (followed by the content) on the connection.
+   *        If there is an error a sid::exception is thrown.
+   */
+  void send(connection_ptr _conn, const std::string& _uri, const std::vector<std::string>& _values,
+            const std::string& _content = std::string());
+
+private:
+  std::string              m_prefix;  //! "<METHOD> "
+  std::string              m_suffix;  //! " <VERSION>\r\n" followed by the constant headers
+  std::vector<std::string> m_keys;    //! "<KEY>: " of each variable header
+  std::string              m_buffer;  //! Reusable output buffer used by send()
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_REQUEST_TEMPLATE_H_
@@ -45,10 +45,23 @@ LICENSE: END
 #include "content.hpp"
 #include "connection.hpp"
 #include <string>
+#include <memory>
+#include <functional>
 
 namespace sid {
 namespace http {
 
+class response;
+
+/**
+ * @fn bool FNResponseSink(const response& _response, const char* _data, size_t _len);
+ * @brief Receives the payload of a successful (2xx) response as it arrives (decoded, if it is decoded).
+ *        The status and headers of the response are already set.
+ *
+ * @return false to stop receiving the response, in which case recv() fails.
+ */
+using FNResponseSink = std::function<bool(const response& _response, const char* _data, size_t _len)>;
+
 /**
  * @class response
  * @brief Definition of HTTP response object.
@@ -79,15 +92,94 @@ public:
    */
   std::string to_str(bool _showContent = true) const;
 
+  /**
+   * @fn void write(sid::sized_writer& _out, bool _showContent = true) const;
+   * @brief Write the complete HTTP response to the writer. Use sid::serialize() to write into a caller-supplied buffer.
+   */
+  void write(sid::sized_writer& _out, bool _showContent = true) const;
+
   bool send(connection_ptr _conn);
-  bool recv(connection_ptr _conn, const method& _requestMethod);
+
+  /**
+   * @fn bool recv(connection_ptr _conn, const method& _requestMethod, bool _decodeContent = true);
+   * @brief Receive the response from the connection.
+   *
+   * @param _conn [in] Connection object
+   * @param _requestMethod [in] Method used in the request
+   * @param _decodeContent [in] If set, the content is decoded (as it arrives) using the Content-Encoding header.
+   *                            The "decoded" member is set if the content was decoded.
+   */
+  bool recv(connection_ptr _conn, const method& _requestMethod, bool _decodeContent = true);
+
+  /**
+   * @fn bool verify_checksum(std::string* _pError = nullptr) const;
+   * @brief Verify the content against its x-amz-checksum-* header or trailer. True if there is none.
+   */
+  bool verify_checksum(std::string* _pError = nullptr) const;
 
 public:
   http::version version;    //! HTTP version in Line-1 of response
   http::status  status;     //! Status code and message in Line-1 of response
   http::headers headers;    //! List of response headers
   http::content content;    //! HTTP response payload
+  bool          decoded;    //! Set if the payload was decoded using the Content-Encoding header
   std::string   error;
+  http::FNResponseSink sink; //! If set, the payload of a 2xx response is passed to it instead of being kept in content.
+                             //! Other responses are kept in content as usual. clear() does not remove it.
+};
+
+class response_handler;
+
+/**
+ * @class response_parser
+ * @brief Incremental response parser for callers that drive the connection themselves
+ *        (for example the http::multi_client event loop). response::recv() uses the same parser.
+ */
+class response_parser
+{
+public:
+  /**
+   * @param _conn [in] Connection object (used for session cookies)
+   * @param _requestMethod [in] Method used in the request
+   * @param _decodeContent [in] If set, the content is decoded using the Content-Encoding header.
+   */
+  response_parser(connection_ptr _conn, const method& _requestMethod, bool _decodeContent = true);
+  ~response_parser();
+
+  /**
+   * @fn bool parse(const char* _buffer, size_t _len, response& _response);
+   * @brief Parse the next block of data received on the connection. Throws sid::exception on error.
+   *
+   * @return true if more data is expected, false if the response is complete.
+   */
+  bool parse(const char* _buffer, size_t _len, /*in/out*/ response& _response);
+
+  /**
+   * @fn void end_of_input(response& _response);
+   * @brief To be called when the peer closed the connection. Throws sid::exception if the response is incomplete.
+   */
+  void end_of_input(/*in/out*/ response& _response);
+
+  //! Returns true if the complete response has been received
+  bool is_complete() const;
+
+  /**
+   * @fn std::string take_unparsed();
+   * @brief Bytes received after the end of the complete response. On a pipelined connection they are the
+   *        start of the next response, and must be parsed before reading from the connection again.
+   */
+  std::string take_unparsed();
+
+  //! Returns true if the connection can be reused for another request after this response
+  static bool keep_alive(const response& _response);
+
+private:
+  response_parser(const response_parser&) = delete;
+  response_parser& operator=(const response_parser&) = delete;
+
+private:
+  std::unique_ptr<response_handler> m_handler;       //! Parser implementation
+  http::method                      m_requestMethod; //! Method used in the request
 };
 
 } // namespace http
@@ -0,0 +1,169 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file retry.hpp
+ * @brief Defines the retry, backoff and hedging policy for HTTP requests.
+ */
+#ifndef _SID_HTTP_RETRY_H_
+#define _SID_HTTP_RETRY_H_
+
+#include "connection.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include "status.hpp"
+#include "common/histogram.hpp"
+#include <string>
+#include <set>
+#include <memory>
+
+namespace sid {
+namespace http {
+
+/**
+ * @struct retry_policy
+ * @brief When and how often requests are retried or hedged by retry_client.
+ */
+struct retry_policy
+{
+  uint32_t              max_attempts;         //! Number of attempts including the first one (default: 3)
+  uint32_t              base_delay_ms;        //! Backoff ceiling of the first retry. It doubles with every retry (default: 100)
+  uint32_t              max_delay_ms;         //! Upper bound of the backoff ceiling (default: 5000)
+  uint32_t              max_retry_after_secs; //! A longer Retry-After is not waited for and the response is returned (default: 30)
+  double                budget_ratio;         //! Retry tokens earned by every request (default: 0.1)
+  double                budget_tokens;        //! Capacity of the retry budget, which starts full (default: 10)
+  bool                  retry_non_idempotent; //! Retry POST, PATCH etc. even when the server could have acted on them (default: false)
+  std::set<status_code> retry_status;         //! Responses that are retried (default: 429, 502, 503 and 504)
+  bool                  hedge;                //! Send a duplicate of a slow idempotent request (default: false)
+  double                hedge_percentile;     //! The duplicate is sent once the request is slower than this latency percentile (default: 95)
+  uint32_t              hedge_min_samples;    //! Latencies observed before the percentile is trusted (default: 20)
+  uint32_t              hedge_min_delay_ms;   //! Lower bound of the hedge delay (default: 1)
+  uint32_t              max_hedges;           //! Number of duplicates sent for a request (default: 1)
+  uint32_t              max_idle;             //! Idle connections kept for each server (default: 8)
+  uint32_t              timeout;              //! I/O timeout of a connection in seconds (default: DEFAULT_IO_TIMEOUT_SECS)
+  connection_family     family;               //! Connection family to use
+  ssl::certificate      certificate;          //! SSL certificate to be used for https connections
+
+  //! Default constructor
+  retry_policy();
+  //! Reset to the default values
+  void clear();
+};
+
+/**
+ * @struct retry_stats
+ * @brief Counters of a retry_client. They accumulate over all the requests run by it.
+ */
+struct retry_stats
+{
+  uint64_t requests;         //! Requests run
+  uint64_t attempts;         //! Attempts made, excluding the hedges
+  uint64_t retries;          //! Attempts that were retries
+  uint64_t hedges;           //! Duplicate requests sent
+  uint64_t hedge_wins;       //! Requests answered first by a duplicate
+  uint64_t budget_exhausted; //! Retries or hedges denied by the retry budget
+  uint64_t failures;         //! Requests that failed in the end
+
+  retry_stats() { clear(); }
+  void clear() { requests = attempts = retries = hedges = hedge_wins = budget_exhausted = failures = 0; }
+  std::string to_str() const;
+};
+
+class retry_state;
+
+/**
+ * @class retry_client
+ * @brief Runs requests over a pool of keep-alive connections, retrying them as per the retry_policy.
+ *
+ * A failed attempt is retried if it is safe to do so. Connection failures are always retried since the request
+ * never reached the server. Failures after that (timeout, reset or close by the peer, as given by
+ * connection::is_retryable()) and the responses in retry_status are retried only for idempotent methods, unless
+ * retry_non_idempotent is set. 429 is the exception as the server states that it has not processed the request.
+ *
+ * The wait before a retry is the Retry-After of the response if there is one, else a random value up to the
+ * backoff ceiling ("full jitter"), which doubles with each retry. Retries draw from a token bucket that every
+ * request refills by budget_ratio, so that a failing server sees at most that share of extra load.
+ *
+ * With hedging enabled, an idempotent request without a streamed body that has not been answered within the
+ * hedge_percentile of the latencies observed so far is sent again on another connection, and the first response
+ * is taken. The slower attempt is left to complete in the background and its connection goes back to the pool.
+ *
+ *   http::retry_client rc;
+ *   rc.policy.hedge = true;
+ *   http::request request;
+ *   http::response response;
+ *   if ( ! rc.run("http://host/key", request, response) )
+ *     cerr << rc.exception().what() << endl;
+ *
+ * run() can be called by several threads, sharing the pool, the budget and the latencies.
+ */
+class retry_client
+{
+public:
+  //! Default constructor
+  retry_client();
+
+  //! Destructor. Waits for the attempts still running in the background.
+  ~retry_client();
+
+  /**
+   * @fn bool run(const std::string& _url, const http::request& _request, http::response& _response);
+   * @brief Send the request to the URL and receive the response. Method, headers and payload are taken from the
+   *        request. The uri and the Host header are set from the URL.
+   *
+   * @return true if a 2xx response was received, false otherwise. As with client::run(), the response is
+   *         populated for any status, and exception() will contain the last exception object in case of failure.
+   */
+  bool run(const std::string& _url, const http::request& _request, /*out*/ http::response& _response);
+
+  //! Counters of all the requests run so far
+  retry_stats stats() const;
+
+  //! Latencies of the successful attempts in micro-seconds
+  sid::histogram latency() const;
+
+  //! Returns the last exception object
+  const sid::exception& exception() const { return m_exception; }
+
+public:
+  retry_policy policy; //! Retry and hedging policy. Must not be changed while requests are running.
+
+private:
+  std::shared_ptr<retry_state> m_state;     //! Pool, budget, latencies and counters shared with the attempts
+  sid::exception               m_exception; //! Last exception
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_RETRY_H_
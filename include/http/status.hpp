@@ -42,6 +42,7 @@ LICENSE: END
 
 #include <string>
 #include <common/exception.hpp>
+#include <common/sized_writer.hpp>
 
 namespace sid {
 namespace http {
@@ -165,14 +166,20 @@ public:
   //! Return the complete message (<id> <message>)
   std::string to_str() const;
 
+  //! Write the complete message (<id> <message>) to the writer
+  void write(sid::sized_writer& _out) const;
+
   //! Get the string name of the status object
   const std::string& message() const;
 
   //! Check whether the current status is a redirect request
   bool is_redirect(redirect_info* predirectInfo = nullptr) const;
 
-  //! Get the status object using the given input.
-  static status get(const std::string& input);
+  //! Get the status object using the given input (<code> <reason phrase>).
+  static status get(const std::string& _input);
+
+  //! Get the status object using the given input of _len bytes (need not be null terminated).
+  static status get(const char* _input, size_t _len);
 
 public:
   //! Default constructor
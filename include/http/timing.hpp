@@ -0,0 +1,151 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file timing.hpp
+ * @brief Defines the timing breakdown of a request.
+ */
+#ifndef _SID_HTTP_TIMING_H_
+#define _SID_HTTP_TIMING_H_
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <sys/types.h>
+
+namespace sid {
+namespace http {
+
+//! Phases of a request that I/O is counted against
+enum class timing_phase : uint8_t { connect = 0, handshake, send, receive };
+
+/**
+ * @struct io_counter
+ * @brief Number of I/O calls and bytes transferred in a phase.
+ */
+struct io_counter
+{
+  uint64_t reads;         //! Reads that returned data
+  uint64_t writes;        //! Writes that sent data
+  uint64_t bytes_read;    //! Bytes received
+  uint64_t bytes_written; //! Bytes sent
+
+  io_counter() { clear(); }
+  void clear() { reads = writes = bytes_read = bytes_written = 0; }
+};
+
+/**
+ * @struct request_timing
+ * @brief Monotonic timestamps of the phases of a request, and the I/O done in each phase.
+ *        A timestamp is left unset (time_point()) if the phase did not happen, for example
+ *        the connect phases of a request sent on a connection that was already open.
+ *
+ *   open_start -> resolved -> connected -> handshaken : connection::open() (DNS, TCP, TLS)
+ *   request_start -> sent                             : request line, headers and payload sent
+ *   sent -> first_byte                                : server think time
+ *   first_byte -> done                                : transfer of the response
+ *
+ * For https the handshake bytes are those counted by the SSL BIO (the number of calls is not known),
+ * and the bytes of the other phases are counted before encryption.
+ * An HTTP/2 exchange records the I/O and the total, but not the send/wait/transfer split.
+ */
+struct request_timing
+{
+  using clock = std::chrono::steady_clock;
+
+  clock::time_point open_start;    //! connection::open() was called
+  clock::time_point resolved;      //! Server name was resolved
+  clock::time_point connected;     //! TCP connection was established
+  clock::time_point handshaken;    //! TLS handshake was complete (https only)
+  clock::time_point request_start; //! The request started to be sent
+  clock::time_point sent;          //! The request, including the payload, was sent
+  clock::time_point first_byte;    //! The first byte of the response was parsed
+  clock::time_point done;          //! The response data was complete
+  timing_phase      phase;         //! Phase that the I/O is counted against
+  io_counter        io[4];         //! I/O of each phase, indexed by timing_phase
+
+  request_timing() { clear(); }
+
+  //! Clear all the timestamps and counters
+  void clear();
+
+  //! I/O of the phase
+  const io_counter& counter(timing_phase _phase) const { return io[static_cast<int>(_phase)]; }
+
+  //! Durations of the phases in microseconds (0 if the phase did not happen)
+  uint64_t dns_us() const { return p_us(open_start, resolved); }
+  uint64_t connect_us() const { return p_us(resolved, connected); }
+  uint64_t tls_us() const { return p_us(connected, handshaken); }
+  uint64_t send_us() const { return p_us(request_start, sent); }
+  uint64_t wait_us() const { return p_us(sent, first_byte); }
+  uint64_t transfer_us() const { return p_us(first_byte, done); }
+  //! From the start of open() (or of the request, if the connection was open) to the end of the response
+  uint64_t total_us() const { return p_us(open_start != clock::time_point()? open_start : request_start, done); }
+
+  //! Summary of the durations and the I/O of the phases
+  std::string to_str() const;
+
+  //! Used by the library to record the I/O and the phases
+  void on_read(ssize_t _count)
+    {
+      if ( _count <= 0 ) return;
+      io_counter& c = io[static_cast<int>(phase)];
+      c.reads++;
+      c.bytes_read += _count;
+    }
+  void on_write(ssize_t _count)
+    {
+      if ( _count <= 0 ) return;
+      io_counter& c = io[static_cast<int>(phase)];
+      c.writes++;
+      c.bytes_written += _count;
+    }
+  void on_first_byte()
+    {
+      // Interim responses (100 Continue) arrive before the request is sent completely and are not counted
+      if ( sent != clock::time_point() && first_byte == clock::time_point() )
+        first_byte = clock::now();
+    }
+
+private:
+  static uint64_t p_us(const clock::time_point& _from, const clock::time_point& _to)
+    {
+      if ( _from == clock::time_point() || _to == clock::time_point() || _to < _from ) return 0;
+      return std::chrono::duration_cast<std::chrono::microseconds>(_to - _from).count();
+    }
+};
+
+} // namespace http
+} // namespace sid
+
+#endif // _SID_HTTP_TIMING_H_
@@ -45,7 +45,7 @@ namespace sid {
 namespace http {
 
 //! HTTP version ID
-enum class version_id : uint8_t { v10, v11 };
+enum class version_id : uint8_t { v10, v11, v20 };
 
 /**
  * @class version
@@ -61,10 +61,13 @@ public:
   version_id& id() { return m_id; }
 
   //! Get the string name of the version
-  std::string to_str() const;
+  const std::string& to_str() const;
 
-  //! Get the version object using the given name.
-  static version get(const std::string& name);
+  //! Get the version object using the given name (HTTP/1.x, 1.x, HTTP/2, HTTP/2.0, 2 or 2.0).
+  static version get(const std::string& _name);
+
+  //! Get the version object using the given name of _len bytes (need not be null terminated).
+  static version get(const char* _name, size_t _len);
 
 public:
   //! Default constructor
@@ -57,6 +57,36 @@ struct www_authenticate
   void clear() { type.clear(); info.clear(); }
   bool empty() const { return type.empty(); }
   bool exists(const std::string& _key, std::string& _value) const;
+  //! Authorization header value for a single request (Digest uses a new client nonce and a nonce count of 1)
+  std::string get_auth_string(const http::request& _request);
+};
+
+/**
+ * @struct auth_session
+ * @brief State kept between the requests answering the same challenge, so that they can be authorized without
+ *        a new challenge: the nonce count and client nonce of Digest, and HA1 = MD5(username:realm:password).
+ */
+struct auth_session
+{
+  www_authenticate challenge;  //! Challenge of the server (realm, nonce, opaque, qop, algorithm)
+  std::string      userName;   //! Credentials of the session
+  std::string      password;
+  std::string      cnonce;     //! Client nonce. A new one is chosen with each nonce.
+  uint32_t         nc;         //! Number of requests sent with the nonce
+  std::string      ha1;        //! HA1 of the credentials and realm (Digest)
+
+  auth_session() : nc(0) {}
+
+  /**
+   * @fn void set(const www_authenticate& _challenge, const std::string& _userName, const std::string& _password);
+   * @brief Start the session with the challenge. HA1 is kept if the credentials and realm are the same.
+   */
+  void set(const www_authenticate& _challenge, const std::string& _userName, const std::string& _password);
+
+  //! Use the nonce given by the server (a new challenge or Authentication-Info nextnonce). The nonce count restarts.
+  void set_nonce(const std::string& _nonce);
+
+  //! Authorization header value for the request. Each call uses the next nonce count.
   std::string get_auth_string(const http::request& _request);
 };
 
@@ -6,6 +6,8 @@
 #include <fstream>
 #include <block/block.hpp>
 #include <common/hash.hpp>
+#include <common/hash_batch.hpp>
+#include <common/checksum.hpp>
 #include <common/util.hpp>
 
 #include "main.h"
@@ -75,22 +77,38 @@ void call_using_block(block::device_ptr dev)
   cout << "Device USN........: " << wwn << endl;
 
   {
-    sid::io_buffer ioBuffer(10*1024*1024);
+    // The reads are hashed on the worker threads while the next ones are read into the other buffers.
+    // The device digest is the MD5 of the MD5s of the 10 MB reads.
+    // The CRC32C of the device is computed inline as each read completes, to verify the data read.
+    const size_t bufferCount = 8;
+    std::vector<sid::io_buffer> ioBuffers(bufferCount, sid::io_buffer(10*1024*1024));
+    sid::hash::batch_digest batch{sid::hash::md5()};
+    sid::hash::hasher deviceMd5{sid::hash::md5()};
+    sid::checksum::crc deviceCrc(sid::checksum::type::crc32c);
     uint64_t totalSize = 0;
     block::io_byte_unit io_byte_unit;
-    sid::hash::md5 md5;
     for ( size_t i = 0; i < 1024; i++ )
     {
+      sid::io_buffer& ioBuffer = ioBuffers[i % bufferCount];
       io_byte_unit.data_processed = 0;
       io_byte_unit.offset = totalSize;
       io_byte_unit.length = ioBuffer.wr_length();
       io_byte_unit.data = ioBuffer.wr_data();
       if ( ! dev->read(io_byte_unit) )
         throw dev->exception();
-      //cout << "@" << totalSize << ": " << md5.get_hash(ioBuffer.wr_data(), io_byte_unit.data_processed).to_hex_str() << endl;
+      deviceCrc.update(ioBuffer.wr_data(), io_byte_unit.data_processed);
+      batch.submit(ioBuffer.wr_data(), io_byte_unit.data_processed);
       totalSize += io_byte_unit.data_processed;
+      // The buffers are reused once all of them are hashed
+      if ( (i + 1) % bufferCount == 0 )
+        for ( const sid::hash::digest& digest : batch.wait() )
+          deviceMd5.update(digest.data());
     }
+    for ( const sid::hash::digest& digest : batch.wait() )
+      deviceMd5.update(digest.data());
     cout << "Device Size Read..: " << totalSize << endl;
+    cout << "Device MD5 Tree...: " << deviceMd5.final().to_hex_str() << endl;
+    cout << "Device CRC32C.....: " << deviceCrc.to_hex_str() << endl;
   }
 }
 
@@ -40,6 +40,7 @@ LICENSE: END
 #include <block/device.hpp>
 #include <common/util.hpp>
 #include <common/json.hpp>
+#include <common/json_stream.hpp>
 
 #include <sstream>
 
@@ -241,37 +242,106 @@ void s_fill_missing_details(device_detail& deviceDetail)
   }
 }
 
-bool s_enum_block_devices(const std::string& _path, FNDeviceDetailCallback& _fnDeviceDetailCallback)
+/**
+ * @class lsblk_handler
+ * @brief Builds each element of "blockdevices" in the lsblk output as it is parsed and passes it to the callback,
+ *        so that the whole output is never held in memory.
+ */
+class lsblk_handler : public json::handler
 {
-  const std::string script = "/usr/bin/lsblk --bytes --output-all --json " + _path;
-  util::command cmdOut = util::command::execute(script);
-  if ( cmdOut.retVal )
-    throw sid::exception(-1, cmdOut.error);
+public:
+  lsblk_handler(FNDeviceDetailCallback& _fnDeviceDetailCallback)
+    : m_fnDeviceDetailCallback(_fnDeviceDetailCallback), m_builder(m_jdevice), m_depth(0), m_isDevices(false) {}
 
-  json::value jroot;
-  json::value::parse(jroot, cmdOut.response);
-  const json::value& jdevices = jroot["blockdevices"];
-  for ( size_t i = 0; i < jdevices.size(); i++ )
+  bool start_object() override
+  {
+    ++m_depth;
+    return p_in_device()? m_builder.start_object() : true;
+  }
+  bool end_object() override
+  {
+    bool isOk = true;
+    if ( p_in_device() )
+    {
+      m_builder.end_object();
+      // The device object is complete
+      if ( m_depth == 3 )
+        isOk = p_device_detail(m_jdevice);
+    }
+    --m_depth;
+    return isOk;
+  }
+  bool start_array() override
+  {
+    ++m_depth;
+    return p_in_device()? m_builder.start_array() : true;
+  }
+  bool end_array() override
+  {
+    if ( p_in_device() )
+      m_builder.end_array();
+    --m_depth;
+    return true;
+  }
+  bool key(const std::string& _key) override
+  {
+    if ( m_depth == 1 )
+      m_isDevices = ( _key == "blockdevices" );
+    return p_in_device()? m_builder.key(_key) : true;
+  }
+  bool string(const std::string& _val) override { return p_in_device()? m_builder.string(_val) : true; }
+  bool number_signed(int64_t _val) override { return p_in_device()? m_builder.number_signed(_val) : true; }
+  bool number_unsigned(uint64_t _val) override { return p_in_device()? m_builder.number_unsigned(_val) : true; }
+  bool number_double(long double _val) override { return p_in_device()? m_builder.number_double(_val) : true; }
+  bool boolean(bool _val) override { return p_in_device()? m_builder.boolean(_val) : true; }
+  bool null() override { return p_in_device()? m_builder.null() : true; }
+
+private:
+  //! Inside an element of the "blockdevices" array
+  bool p_in_device() const { return m_isDevices && m_depth >= 3; }
+
+  bool p_device_detail(const json::value& _jdevice)
   {
-    const json::value& jdevice = jdevices[i];
     device_detail deviceDetail;
-    jdevice.get_value("name", deviceDetail.name);
-    jdevice.get_value("path", deviceDetail.path);
-    jdevice.get_value("size", deviceDetail.size);
-    jdevice.get_value("phy-sec", deviceDetail.blockSize);
-    jdevice.get_value("ro", deviceDetail.isReadOnly);
-    jdevice.get_value("model", deviceDetail.model);
-    jdevice.get_value("serial", deviceDetail.serial);
-    jdevice.get_value("wwn", deviceDetail.wwn);
-    jdevice.get_value("label", deviceDetail.label);
-    jdevice.get_value("mountpoint", deviceDetail.mountPoint);
+    _jdevice.get_value("name", deviceDetail.name);
+    _jdevice.get_value("path", deviceDetail.path);
+    _jdevice.get_value("size", deviceDetail.size);
+    _jdevice.get_value("phy-sec", deviceDetail.blockSize);
+    _jdevice.get_value("ro", deviceDetail.isReadOnly);
+    _jdevice.get_value("model", deviceDetail.model);
+    _jdevice.get_value("serial", deviceDetail.serial);
+    _jdevice.get_value("wwn", deviceDetail.wwn);
+    _jdevice.get_value("label", deviceDetail.label);
+    _jdevice.get_value("mountpoint", deviceDetail.mountPoint);
 
     // Fill any missing details using another command
     s_fill_missing_details(deviceDetail);
 
-    if ( !_fnDeviceDetailCallback(deviceDetail) )
-      break;
+    return m_fnDeviceDetailCallback(deviceDetail);
   }
 
+private:
+  FNDeviceDetailCallback& m_fnDeviceDetailCallback;
+  json::value             m_jdevice;   //! Device that is being parsed
+  json::value_builder     m_builder;
+  size_t                  m_depth;
+  bool                    m_isDevices; //! Within the value of "blockdevices"
+};
+
+bool s_enum_block_devices(const std::string& _path, FNDeviceDetailCallback& _fnDeviceDetailCallback)
+{
+  // The output is parsed as it is read. Parsing stops when the callback returns false.
+  lsblk_handler handler(_fnDeviceDetailCallback);
+  json::stream_parser parser(handler);
+  const std::string script = "/usr/bin/lsblk --bytes --output-all --json " + _path;
+  util::command cmdOut = util::command::execute(script, [&](const char* _data, size_t _len)
+    {
+      return parser.parse(_data, _len);
+    });
+  if ( cmdOut.retVal )
+    throw sid::exception(-1, cmdOut.error);
+  if ( ! parser.is_stopped() )
+    parser.finish();
+
   return true;
 }
@@ -0,0 +1,151 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@file arena.cpp
+@brief Implementation of the bump allocator
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file  arena.cpp
+ * @brief Implementation of the bump allocator
+ */
+#include <common/arena.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace sid;
+
+//! Round the pointer up to the alignment (a power of 2)
+static inline char* align_ptr(char* _p, size_t _align)
+{
+  return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(_p) + _align - 1) & ~static_cast<uintptr_t>(_align - 1));
+}
+
+arena::arena(size_t _blockSize/* = 64 * 1024*/)
+  : m_blockSize(_blockSize), m_head(nullptr), m_ptr(nullptr), m_end(nullptr), m_used(0), m_reserved(0), m_blocks(0)
+{
+}
+
+arena::~arena()
+{
+  clear();
+}
+
+arena::arena(arena&& _obj) noexcept
+  : m_blockSize(_obj.m_blockSize), m_head(_obj.m_head), m_ptr(_obj.m_ptr), m_end(_obj.m_end),
+    m_used(_obj.m_used), m_reserved(_obj.m_reserved), m_blocks(_obj.m_blocks)
+{
+  _obj.m_head = nullptr;
+  _obj.clear();
+}
+
+arena& arena::operator=(arena&& _obj) noexcept
+{
+  if ( this != &_obj )
+  {
+    clear();
+    m_blockSize = _obj.m_blockSize;
+    m_head = _obj.m_head;
+    m_ptr = _obj.m_ptr;
+    m_end = _obj.m_end;
+    m_used = _obj.m_used;
+    m_reserved = _obj.m_reserved;
+    m_blocks = _obj.m_blocks;
+    _obj.m_head = nullptr;
+    _obj.clear();
+  }
+  return *this;
+}
+
+void arena::clear()
+{
+  while ( m_head != nullptr )
+  {
+    block* next = m_head->next;
+    ::free(m_head);
+    m_head = next;
+  }
+  m_ptr = m_end = nullptr;
+  m_used = m_reserved = m_blocks = 0;
+}
+
+char* arena::p_new_block(size_t _size, bool _isCurrent)
+{
+  const size_t headerSize = (sizeof(block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+  block* newBlock = static_cast<block*>(::malloc(headerSize + _size));
+  if ( newBlock == nullptr )
+    throw std::bad_alloc();
+  m_reserved += headerSize + _size;
+  ++m_blocks;
+  char* data = reinterpret_cast<char*>(newBlock) + headerSize;
+  if ( _isCurrent || m_head == nullptr )
+  {
+    newBlock->next = m_head;
+    m_head = newBlock;
+    if ( _isCurrent )
+    {
+      m_ptr = data;
+      m_end = data + _size;
+    }
+  }
+  else
+  {
+    // A block of its own goes behind the current block, which still has space
+    newBlock->next = m_head->next;
+    m_head->next = newBlock;
+  }
+  return data;
+}
+
+void* arena::allocate(size_t _size, size_t _align/* = alignof(std::max_align_t)*/)
+{
+  m_used += _size;
+  char* p = align_ptr(m_ptr, _align);
+  if ( m_ptr != nullptr && p + _size <= m_end )
+  {
+    m_ptr = p + _size;
+    return p;
+  }
+  // Blocks are aligned to std::max_align_t, so only a larger alignment needs extra space
+  if ( _size > m_blockSize / 4 )
+    return align_ptr(p_new_block(_size + _align, false), _align);
+  p = align_ptr(p_new_block(m_blockSize, true), _align);
+  m_ptr = p + _size;
+  return p;
+}
+
+const char* arena::copy(const char* _data, size_t _len)
+{
+  char* p = static_cast<char*>(allocate(_len + 1, 1));
+  ::memcpy(p, _data, _len);
+  p[_len] = '\0';
+  return p;
+}
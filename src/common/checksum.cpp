@@ -0,0 +1,389 @@
+/**
+ * @file checksum.cpp
+ * @brief CRC32C and CRC64/NVMe checksums of payloads
+ */
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief List of common functions in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "common/checksum.hpp"
+#include "common/convert.hpp"
+#include <cstring>
+#include <strings.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SID_CRC_HARDWARE
+#include <immintrin.h>
+#endif
+
+using namespace sid;
+using namespace sid::checksum;
+
+namespace {
+
+const uint32_t CRC32C_POLY = 0x82F63B78;            //! Castagnoli polynomial, reflected
+const uint64_t CRC64NVME_POLY = 0x9A6C9329AC4BC9B5; //! NVMe polynomial, reflected
+
+/*
+ * Polynomials over GF(2) modulo the CRC polynomial, in the reflected order of the CRC:
+ * the most significant bit is the coefficient of x^0. They are used to shift a CRC over
+ * a number of zero bits (combine, and merging the streams of the accelerated CRCs).
+ */
+template <typename T, T POLY>
+struct gf2
+{
+  static const T one = static_cast<T>(1) << (sizeof(T) * 8 - 1);
+
+  //! a * b modulo the polynomial
+  static T multiply(T _a, T _b)
+  {
+    T m = one, p = 0;
+    for ( ;; )
+    {
+      if ( _a & m )
+      {
+        p ^= _b;
+        if ( (_a & (m - 1)) == 0 ) break;
+      }
+      m >>= 1;
+      _b = (_b & 1)? (_b >> 1) ^ POLY : (_b >> 1);
+    }
+    return p;
+  }
+
+  //! x^n modulo the polynomial
+  static T x_pow(uint64_t _n)
+  {
+    T result = one, base = one >> 1;  // x^0 and x^1
+    for ( ; _n != 0; _n >>= 1 )
+    {
+      if ( _n & 1 )
+        result = multiply(result, base);
+      base = multiply(base, base);
+    }
+    return result;
+  }
+};
+
+using gf2_32 = gf2<uint32_t, CRC32C_POLY>;
+using gf2_64 = gf2<uint64_t, CRC64NVME_POLY>;
+
+//! Tables to process 8 bytes at a time ("slicing-by-8")
+template <typename T, T POLY>
+struct crc_tables
+{
+  T table[8][256];
+
+  crc_tables()
+  {
+    for ( uint32_t i = 0; i < 256; i++ )
+    {
+      T crc = i;
+      for ( int bit = 0; bit < 8; bit++ )
+        crc = (crc & 1)? (crc >> 1) ^ POLY : (crc >> 1);
+      table[0][i] = crc;
+    }
+    for ( uint32_t i = 0; i < 256; i++ )
+      for ( int k = 1; k < 8; k++ )
+        table[k][i] = (table[k-1][i] >> 8) ^ table[0][table[k-1][i] & 0xFF];
+  }
+
+  //! Continue the CRC (without the final XOR) with the data
+  T update(T _crc, const uint8_t* _data, size_t _dataLen) const
+  {
+    for ( ; _dataLen >= 8; _data += 8, _dataLen -= 8 )
+    {
+      uint64_t word = 0;
+      ::memcpy(&word, _data, 8);
+      word ^= _crc;
+      _crc = table[7][word & 0xFF] ^ table[6][(word >> 8) & 0xFF] ^ table[5][(word >> 16) & 0xFF]
+           ^ table[4][(word >> 24) & 0xFF] ^ table[3][(word >> 32) & 0xFF] ^ table[2][(word >> 40) & 0xFF]
+           ^ table[1][(word >> 48) & 0xFF] ^ table[0][word >> 56];
+    }
+    for ( ; _dataLen > 0; _data++, _dataLen-- )
+      _crc = (_crc >> 8) ^ table[0][(_crc ^ *_data) & 0xFF];
+    return _crc;
+  }
+};
+
+const crc_tables<uint32_t, CRC32C_POLY>& crc32c_tables()
+{
+  static const crc_tables<uint32_t, CRC32C_POLY> tables;
+  return tables;
+}
+
+const crc_tables<uint64_t, CRC64NVME_POLY>& crc64nvme_tables()
+{
+  static const crc_tables<uint64_t, CRC64NVME_POLY> tables;
+  return tables;
+}
+
+#ifdef SID_CRC_HARDWARE
+
+#define CRC_HW __attribute__((target("sse4.2,pclmul")))
+
+/*
+ * CRC32C: the crc32 instruction has a latency of 3 cycles and a throughput of 1, so 3 independent streams
+ * over consecutive blocks keep it busy. The CRCs of the first two streams are then shifted over the blocks
+ * that follow them and merged: for a 32-bit CRC a, clmul(a, x^(8n-33)) reduced with crc32 is a * x^(8n).
+ */
+struct crc32c_shift
+{
+  size_t   block;   //! Bytes of each stream
+  uint64_t k1, k2;  //! Constants to shift over 2 blocks and 1 block
+
+  explicit crc32c_shift(size_t _block)
+    : block(_block), k1(gf2_32::x_pow(8 * 2 * _block - 33)), k2(gf2_32::x_pow(8 * _block - 33)) {}
+};
+
+CRC_HW inline uint64_t load64(const uint8_t* _data)
+{
+  uint64_t word;
+  ::memcpy(&word, _data, 8);
+  return word;
+}
+
+CRC_HW uint32_t crc32c_streams(uint32_t _crc, const uint8_t*& _data, size_t& _dataLen, const crc32c_shift& _shift)
+{
+  const size_t block = _shift.block;
+  const __m128i k1 = _mm_cvtsi64_si128(static_cast<long long>(_shift.k1));
+  const __m128i k2 = _mm_cvtsi64_si128(static_cast<long long>(_shift.k2));
+  for ( ; _dataLen >= 3 * block; _data += 3 * block, _dataLen -= 3 * block )
+  {
+    uint64_t a = _crc, b = 0, c = 0;
+    for ( size_t i = 0; i < block; i += 8 )
+    {
+      a = _mm_crc32_u64(a, load64(_data + i));
+      b = _mm_crc32_u64(b, load64(_data + block + i));
+      c = _mm_crc32_u64(c, load64(_data + 2 * block + i));
+    }
+    __m128i shifted = _mm_xor_si128(_mm_clmulepi64_si128(_mm_cvtsi64_si128(static_cast<long long>(a)), k1, 0x00),
+                                    _mm_clmulepi64_si128(_mm_cvtsi64_si128(static_cast<long long>(b)), k2, 0x00));
+    _crc = static_cast<uint32_t>(_mm_crc32_u64(0, static_cast<uint64_t>(_mm_cvtsi128_si64(shifted))) ^ c);
+  }
+  return _crc;
+}
+
+CRC_HW uint32_t crc32c_hardware(uint32_t _crc, const uint8_t* _data, size_t _dataLen)
+{
+  static const crc32c_shift large(8192), small(256);
+  _crc = crc32c_streams(_crc, _data, _dataLen, large);
+  _crc = crc32c_streams(_crc, _data, _dataLen, small);
+  uint64_t crc = _crc;
+  for ( ; _dataLen >= 8; _data += 8, _dataLen -= 8 )
+    crc = _mm_crc32_u64(crc, load64(_data));
+  _crc = static_cast<uint32_t>(crc);
+  for ( ; _dataLen > 0; _data++, _dataLen-- )
+    _crc = _mm_crc32_u8(_crc, *_data);
+  return _crc;
+}
+
+/*
+ * CRC64/NVMe: the data is folded 128 bits at a time (Intel, "Fast CRC Computation for Generic Polynomials
+ * Using PCLMULQDQ Instruction"). A 128-bit value v that is followed by d bits is replaced by v * x^d, which is
+ * clmul(low half, x^(d+63)) ^ clmul(high half, x^(d-1)) in the reflected order, and added to the data d bits
+ * later. The last 128 bits are reduced with the tables.
+ */
+CRC_HW inline __m128i fold(__m128i _value, __m128i _k)
+{
+  return _mm_xor_si128(_mm_clmulepi64_si128(_value, _k, 0x00), _mm_clmulepi64_si128(_value, _k, 0x11));
+}
+
+inline __m128i fold_constants(uint64_t _bits)
+{
+  return _mm_set_epi64x(static_cast<long long>(gf2_64::x_pow(_bits - 1)), static_cast<long long>(gf2_64::x_pow(_bits + 63)));
+}
+
+CRC_HW uint64_t crc64nvme_hardware(uint64_t _crc, const uint8_t* _data, size_t _dataLen)
+{
+  if ( _dataLen < 64 )
+    return crc64nvme_tables().update(_crc, _data, _dataLen);
+
+  static const __m128i k128 = fold_constants(128), k256 = fold_constants(256), k384 = fold_constants(384), k512 = fold_constants(512);
+  auto load = [](const uint8_t* _p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(_p)); };
+
+  // The CRC so far is added to the first 64 bits of the data
+  __m128i x0 = _mm_xor_si128(load(_data), _mm_cvtsi64_si128(static_cast<long long>(_crc)));
+  __m128i x1 = load(_data + 16), x2 = load(_data + 32), x3 = load(_data + 48);
+  for ( _data += 64, _dataLen -= 64; _dataLen >= 64; _data += 64, _dataLen -= 64 )
+  {
+    x0 = _mm_xor_si128(fold(x0, k512), load(_data));
+    x1 = _mm_xor_si128(fold(x1, k512), load(_data + 16));
+    x2 = _mm_xor_si128(fold(x2, k512), load(_data + 32));
+    x3 = _mm_xor_si128(fold(x3, k512), load(_data + 48));
+  }
+  __m128i x = _mm_xor_si128(_mm_xor_si128(fold(x0, k384), fold(x1, k256)), _mm_xor_si128(fold(x2, k128), x3));
+  for ( ; _dataLen >= 16; _data += 16, _dataLen -= 16 )
+    x = _mm_xor_si128(fold(x, k128), load(_data));
+
+  uint8_t last[16];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(last), x);
+  _crc = crc64nvme_tables().update(0, last, sizeof(last));
+  return crc64nvme_tables().update(_crc, _data, _dataLen);
+}
+
+#undef CRC_HW
+
+#endif // SID_CRC_HARDWARE
+
+bool detect_hardware()
+{
+#ifdef SID_CRC_HARDWARE
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+#else
+  return false;
+#endif
+}
+
+bool g_hardware = detect_hardware();
+
+} // anonymous namespace
+
+std::string sid::checksum::to_str(type _type)
+{
+  switch ( _type )
+  {
+  case type::crc32c:    return "crc32c";
+  case type::crc64nvme: return "crc64nvme";
+  default:              break;
+  }
+  return std::string();
+}
+
+bool sid::checksum::from_str(const std::string& _name, type& _type)
+{
+  if ( ::strcasecmp(_name.c_str(), "crc32c") == 0 )
+    _type = type::crc32c;
+  else if ( ::strcasecmp(_name.c_str(), "crc64nvme") == 0 )
+    _type = type::crc64nvme;
+  else
+    return false;
+  return true;
+}
+
+size_t sid::checksum::length(type _type)
+{
+  return ( _type == type::crc32c )? 4 : ( _type == type::crc64nvme )? 8 : 0;
+}
+
+bool sid::checksum::hardware_supported()
+{
+  static const bool isSupported = detect_hardware();
+  return isSupported;
+}
+
+bool sid::checksum::use_hardware(bool _enable)
+{
+  bool previous = g_hardware;
+  g_hardware = _enable && hardware_supported();
+  return previous;
+}
+
+uint32_t sid::checksum::crc32c(const void* _data, size_t _dataLen, uint32_t _crc/* = 0*/) noexcept
+{
+  const uint8_t* data = static_cast<const uint8_t*>(_data);
+#ifdef SID_CRC_HARDWARE
+  if ( g_hardware )
+    return ~crc32c_hardware(~_crc, data, _dataLen);
+#endif
+  return ~crc32c_tables().update(~_crc, data, _dataLen);
+}
+
+uint64_t sid::checksum::crc64nvme(const void* _data, size_t _dataLen, uint64_t _crc/* = 0*/) noexcept
+{
+  const uint8_t* data = static_cast<const uint8_t*>(_data);
+#ifdef SID_CRC_HARDWARE
+  if ( g_hardware )
+    return ~crc64nvme_hardware(~_crc, data, _dataLen);
+#endif
+  return ~crc64nvme_tables().update(~_crc, data, _dataLen);
+}
+
+/*
+ * With the same initial value and final XOR, crc(A + B) = crc(A) * x^(8 * length(B)) + crc(B),
+ * as the effect of the initial value on B cancels out with that of the final XOR on A.
+ */
+uint32_t sid::checksum::crc32c_combine(uint32_t _crc1, uint32_t _crc2, uint64_t _length2) noexcept
+{
+  return gf2_32::multiply(gf2_32::x_pow(8 * _length2), _crc1) ^ _crc2;
+}
+
+uint64_t sid::checksum::crc64nvme_combine(uint64_t _crc1, uint64_t _crc2, uint64_t _length2) noexcept
+{
+  return gf2_64::multiply(gf2_64::x_pow(8 * _length2), _crc1) ^ _crc2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// crc
+//
+crc& crc::update(const void* _data, size_t _dataLen)
+{
+  if ( m_type == type::crc32c )
+    m_value = crc32c(_data, _dataLen, static_cast<uint32_t>(m_value));
+  else if ( m_type == type::crc64nvme )
+    m_value = crc64nvme(_data, _dataLen, m_value);
+  m_length += _dataLen;
+  return *this;
+}
+
+crc& crc::append(const crc& _other)
+{
+  if ( m_type == type::crc32c )
+    m_value = crc32c_combine(static_cast<uint32_t>(m_value), static_cast<uint32_t>(_other.m_value), _other.m_length);
+  else if ( m_type == type::crc64nvme )
+    m_value = crc64nvme_combine(m_value, _other.m_value, _other.m_length);
+  m_length += _other.m_length;
+  return *this;
+}
+
+std::string crc::to_bytes() const
+{
+  std::string out(checksum::length(m_type), '\0');
+  for ( size_t i = 0; i < out.length(); i++ )
+    out[i] = static_cast<char>(m_value >> (8 * (out.length() - 1 - i)));
+  return out;
+}
+
+std::string crc::to_base64() const
+{
+  return sid::base64::encode(to_bytes());
+}
+
+std::string crc::to_hex_str() const
+{
+  std::string bytes = to_bytes(), out(2 * bytes.length(), '\0');
+  sid::bytes_to_hex(bytes.data(), bytes.length(), &out[0], true);
+  return out;
+}
@@ -0,0 +1,539 @@
+/**
+ * @file codec.cpp
+ * @brief Table-driven and SIMD hex and base64 codecs
+ */
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief List of common functions in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "common/convert.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SID_CODEC_SIMD
+#include <immintrin.h>
+#endif
+
+using namespace sid;
+
+namespace {
+
+const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char BASE64_PAD = '=';
+const uint8_t INVALID = 0xFF;
+
+/**
+ * @struct tables
+ * @brief Lookup tables of the scalar codecs
+ */
+struct tables
+{
+  char    hexUpper[256][2];  //! Hex digits of a byte
+  char    hexLower[256][2];
+  uint8_t hexValue[256];     //! Value of a hex digit (INVALID otherwise)
+  uint8_t base64Value[256];  //! Value of a base64 character (INVALID otherwise)
+
+  tables()
+  {
+    const char upper[] = "0123456789ABCDEF", lower[] = "0123456789abcdef";
+    for ( size_t i = 0; i < 256; i++ )
+    {
+      hexUpper[i][0] = upper[i >> 4]; hexUpper[i][1] = upper[i & 0x0F];
+      hexLower[i][0] = lower[i >> 4]; hexLower[i][1] = lower[i & 0x0F];
+    }
+    ::memset(hexValue, INVALID, sizeof(hexValue));
+    for ( uint8_t i = 0; i < 16; i++ )
+    {
+      hexValue[static_cast<uint8_t>(upper[i])] = i;
+      hexValue[static_cast<uint8_t>(lower[i])] = i;
+    }
+    ::memset(base64Value, INVALID, sizeof(base64Value));
+    for ( uint8_t i = 0; i < 64; i++ )
+      base64Value[static_cast<uint8_t>(BASE64_ALPHABET[i])] = i;
+  }
+};
+
+const tables& get_tables()
+{
+  static tables t;
+  return t;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Scalar kernels. They process the whole input, or what is left by the SIMD kernels.
+//
+void hex_encode_scalar(const uint8_t* _input, size_t _inputLen, char* _output, bool _lowerCase)
+{
+  const char (*table)[2] = _lowerCase? get_tables().hexLower : get_tables().hexUpper;
+  for ( size_t i = 0; i < _inputLen; i++, _output += 2 )
+  {
+    _output[0] = table[_input[i]][0];
+    _output[1] = table[_input[i]][1];
+  }
+}
+
+//! Decodes _outputLen bytes. _input must have 2 * _outputLen characters.
+bool hex_decode_scalar(const char* _input, size_t _outputLen, uint8_t* _output)
+{
+  const uint8_t* value = get_tables().hexValue;
+  for ( size_t i = 0; i < _outputLen; i++, _input += 2 )
+  {
+    uint8_t hi = value[static_cast<uint8_t>(_input[0])], lo = value[static_cast<uint8_t>(_input[1])];
+    if ( (hi | lo) == INVALID ) return false;
+    _output[i] = static_cast<uint8_t>((hi << 4) | lo);
+  }
+  return true;
+}
+
+//! Encodes the complete groups of 3 bytes and returns the number of bytes encoded
+size_t base64_encode_scalar(const uint8_t* _input, size_t _inputLen, char* _output)
+{
+  size_t i = 0;
+  for ( ; i + 3 <= _inputLen; i += 3, _output += 4 )
+  {
+    uint32_t triple = (_input[i] << 16) | (_input[i+1] << 8) | _input[i+2];
+    _output[0] = BASE64_ALPHABET[(triple >> 18) & 0x3F];
+    _output[1] = BASE64_ALPHABET[(triple >> 12) & 0x3F];
+    _output[2] = BASE64_ALPHABET[(triple >> 6) & 0x3F];
+    _output[3] = BASE64_ALPHABET[triple & 0x3F];
+  }
+  return i;
+}
+
+//! Decodes groups of 4 characters without padding. _input must have a multiple of 4 characters.
+bool base64_decode_scalar(const char* _input, size_t _inputLen, uint8_t* _output)
+{
+  const uint8_t* value = get_tables().base64Value;
+  for ( size_t i = 0; i < _inputLen; i += 4, _output += 3 )
+  {
+    uint8_t a = value[static_cast<uint8_t>(_input[i])], b = value[static_cast<uint8_t>(_input[i+1])];
+    uint8_t c = value[static_cast<uint8_t>(_input[i+2])], d = value[static_cast<uint8_t>(_input[i+3])];
+    if ( (a | b | c | d) == INVALID ) return false;
+    uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+    _output[0] = static_cast<uint8_t>(triple >> 16);
+    _output[1] = static_cast<uint8_t>(triple >> 8);
+    _output[2] = static_cast<uint8_t>(triple);
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// SIMD kernels. Each returns the number of input bytes (encode) or characters (decode) it processed,
+// and leaves the rest to the scalar kernel. A decoder stops at the first block with an invalid character.
+//
+#ifdef SID_CODEC_SIMD
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+SSSE3 size_t hex_encode_ssse3(const uint8_t* _input, size_t _inputLen, char* _output, bool _lowerCase)
+{
+  const __m128i digits = _lowerCase? _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f')
+                                   : _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  size_t i = 0;
+  for ( ; i + 16 <= _inputLen; i += 16, _output += 32 )
+  {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_input + i));
+    __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(in, 4), nibble));
+    __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(in, nibble));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_output), _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_output + 16), _mm_unpackhi_epi8(hi, lo));
+  }
+  return i;
+}
+
+AVX2 size_t hex_encode_avx2(const uint8_t* _input, size_t _inputLen, char* _output, bool _lowerCase)
+{
+  const __m256i digits = _lowerCase? _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+                                                      '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f')
+                                   : _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+                                                      '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  size_t i = 0;
+  for ( ; i + 32 <= _inputLen; i += 32, _output += 64 )
+  {
+    // Quadwords 0,2,1,3 so that the in-lane unpacks produce the characters in order
+    __m256i in = _mm256_permute4x64_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_input + i)), 0xD8);
+    __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble));
+    __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(in, nibble));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_output), _mm256_unpacklo_epi8(hi, lo));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_output + 32), _mm256_unpackhi_epi8(hi, lo));
+  }
+  return i;
+}
+
+//! Values of 16 hex digits. Sets _isValid to false if any of them is not a hex digit.
+SSSE3 inline __m128i hex_values_ssse3(__m128i _in, bool& _isValid)
+{
+  __m128i digit = _mm_sub_epi8(_in, _mm_set1_epi8('0'));
+  __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(_in, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(_in, _mm_set1_epi8('9' + 1)));
+  __m128i lower = _mm_or_si128(_in, _mm_set1_epi8(0x20));
+  __m128i alpha = _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10));
+  __m128i isAlpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+  _isValid = ( _mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha)) == 0xFFFF );
+  return _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isAlpha, alpha));
+}
+
+SSSE3 size_t hex_decode_ssse3(const char* _input, size_t _inputLen, uint8_t* _output)
+{
+  // Each pair of values (hi, lo) becomes hi * 16 + lo
+  const __m128i weights = _mm_set1_epi16(0x0110);
+  size_t i = 0;
+  for ( ; i + 32 <= _inputLen; i += 32, _output += 16 )
+  {
+    bool isValid1 = false, isValid2 = false;
+    __m128i v1 = hex_values_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_input + i)), isValid1);
+    __m128i v2 = hex_values_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_input + i + 16)), isValid2);
+    if ( ! isValid1 || ! isValid2 ) break;
+    __m128i bytes = _mm_packus_epi16(_mm_maddubs_epi16(v1, weights), _mm_maddubs_epi16(v2, weights));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_output), bytes);
+  }
+  return i;
+}
+
+AVX2 inline __m256i hex_values_avx2(__m256i _in, bool& _isValid)
+{
+  __m256i digit = _mm256_sub_epi8(_in, _mm256_set1_epi8('0'));
+  __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(_in, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), _in));
+  __m256i lower = _mm256_or_si256(_in, _mm256_set1_epi8(0x20));
+  __m256i alpha = _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10));
+  __m256i isAlpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+  _isValid = ( _mm256_movemask_epi8(_mm256_or_si256(isDigit, isAlpha)) == -1 );
+  return _mm256_or_si256(_mm256_and_si256(isDigit, digit), _mm256_and_si256(isAlpha, alpha));
+}
+
+AVX2 size_t hex_decode_avx2(const char* _input, size_t _inputLen, uint8_t* _output)
+{
+  const __m256i weights = _mm256_set1_epi16(0x0110);
+  size_t i = 0;
+  for ( ; i + 64 <= _inputLen; i += 64, _output += 32 )
+  {
+    bool isValid1 = false, isValid2 = false;
+    __m256i v1 = hex_values_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_input + i)), isValid1);
+    __m256i v2 = hex_values_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_input + i + 32)), isValid2);
+    if ( ! isValid1 || ! isValid2 ) break;
+    // The pack works within the 128-bit lanes, so the quadwords are put back in order
+    __m256i bytes = _mm256_packus_epi16(_mm256_maddubs_epi16(v1, weights), _mm256_maddubs_epi16(v2, weights));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_output), _mm256_permute4x64_epi64(bytes, 0xD8));
+  }
+  return i;
+}
+
+/*
+ * base64 with pshufb (W. Mula and D. Lemire, "Faster Base64 Encoding and Decoding Using AVX2 Instructions").
+ * Encoding spreads each 3 bytes over 4 bytes holding a 6-bit index each, and adds to every index the offset of
+ * its range in the alphabet. Decoding validates each character against the range of its high nibble, and
+ * subtracts the offset of the range. The 6-bit values are then merged with multiply-adds.
+ */
+
+//! Characters of 16 indices (0..63)
+SSSE3 inline __m128i base64_chars_ssse3(__m128i _indices)
+{
+  // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+  __m128i range = _mm_subs_epu8(_indices, _mm_set1_epi8(51));
+  range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), _indices), _mm_set1_epi8(13)));
+  const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(_indices, _mm_shuffle_epi8(offsets, range));
+}
+
+//! 6-bit indices of the 12 bytes in each group of 16 (bytes 0..11 are used)
+SSSE3 inline __m128i base64_indices_ssse3(__m128i _in)
+{
+  _in = _mm_shuffle_epi8(_in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(_in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+  __m128i t1 = _mm_mullo_epi16(_mm_and_si128(_in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t0, t1);
+}
+
+SSSE3 size_t base64_encode_ssse3(const uint8_t* _input, size_t _inputLen, char* _output)
+{
+  // 16 bytes are loaded for every 12 encoded
+  size_t i = 0;
+  for ( ; i + 16 <= _inputLen; i += 12, _output += 16 )
+  {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_input + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_output), base64_chars_ssse3(base64_indices_ssse3(in)));
+  }
+  return i;
+}
+
+AVX2 inline __m256i base64_chars_avx2(__m256i _indices)
+{
+  __m256i range = _mm256_subs_epu8(_indices, _mm256_set1_epi8(51));
+  range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), _indices), _mm256_set1_epi8(13)));
+  const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                           'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm256_add_epi8(_indices, _mm256_shuffle_epi8(offsets, range));
+}
+
+AVX2 size_t base64_encode_avx2(const uint8_t* _input, size_t _inputLen, char* _output)
+{
+  // Each 128-bit lane takes 12 bytes, loaded as 16
+  const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                          10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  size_t i = 0;
+  for ( ; i + 28 <= _inputLen; i += 24, _output += 32 )
+  {
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_input + i))),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(_input + i + 12)), 1);
+    in = _mm256_shuffle_epi8(in, shuffle);
+    __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+    __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_output), base64_chars_avx2(_mm256_or_si256(t0, t1)));
+  }
+  return i;
+}
+
+//! 6-bit values of 16 base64 characters. Sets _isValid to false if any of them is not in the alphabet.
+SSSE3 inline __m128i base64_values_ssse3(__m128i _in, bool& _isValid)
+{
+  const __m128i lowerBound = _mm_setr_epi8(1, 1, 0x2B, 0x30, 0x41, 0x50, 0x61, 0x70, 1, 1, 1, 1, 1, 1, 1, 1);
+  const __m128i upperBound = _mm_setr_epi8(0, 0, 0x2B, 0x39, 0x4F, 0x5A, 0x6F, 0x7A, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i shift = _mm_setr_epi8(0, 0, 0x3E - 0x2B, 0x34 - 0x30, 0x00 - 0x41, 0x0F - 0x50, 0x1A - 0x61, 0x29 - 0x70,
+                                      0, 0, 0, 0, 0, 0, 0, 0);
+  __m128i hiNibble = _mm_and_si128(_mm_srli_epi32(_in, 4), _mm_set1_epi8(0x0F));
+  // '/' is the only character above the range of its high nibble ('+')
+  __m128i isSlash = _mm_cmpeq_epi8(_in, _mm_set1_epi8('/'));
+  __m128i outside = _mm_or_si128(_mm_cmplt_epi8(_in, _mm_shuffle_epi8(lowerBound, hiNibble)),
+                                 _mm_cmpgt_epi8(_in, _mm_shuffle_epi8(upperBound, hiNibble)));
+  _isValid = ( _mm_movemask_epi8(_mm_andnot_si128(isSlash, outside)) == 0 );
+  __m128i values = _mm_add_epi8(_in, _mm_shuffle_epi8(shift, hiNibble));
+  return _mm_add_epi8(values, _mm_and_si128(isSlash, _mm_set1_epi8(-3)));
+}
+
+//! Bytes of 16 6-bit values, in the first 12 bytes
+SSSE3 inline __m128i base64_pack_ssse3(__m128i _values)
+{
+  __m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(_values, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+  return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+//! _inputLen excludes the last group of 4 characters, which can have padding
+SSSE3 size_t base64_decode_ssse3(const char* _input, size_t _inputLen, uint8_t* _output)
+{
+  // 16 bytes are stored for every 12 decoded, so 4 more characters must follow the block
+  size_t i = 0;
+  for ( ; i + 20 <= _inputLen; i += 16, _output += 12 )
+  {
+    bool isValid = false;
+    __m128i values = base64_values_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_input + i)), isValid);
+    if ( ! isValid ) break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_output), base64_pack_ssse3(values));
+  }
+  return i;
+}
+
+AVX2 size_t base64_decode_avx2(const char* _input, size_t _inputLen, uint8_t* _output)
+{
+  const __m256i lowerBound = _mm256_setr_epi8(1, 1, 0x2B, 0x30, 0x41, 0x50, 0x61, 0x70, 1, 1, 1, 1, 1, 1, 1, 1,
+                                              1, 1, 0x2B, 0x30, 0x41, 0x50, 0x61, 0x70, 1, 1, 1, 1, 1, 1, 1, 1);
+  const __m256i upperBound = _mm256_setr_epi8(0, 0, 0x2B, 0x39, 0x4F, 0x5A, 0x6F, 0x7A, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 0, 0x2B, 0x39, 0x4F, 0x5A, 0x6F, 0x7A, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i shift = _mm256_setr_epi8(0, 0, 0x3E - 0x2B, 0x34 - 0x30, 0x00 - 0x41, 0x0F - 0x50, 0x1A - 0x61, 0x29 - 0x70,
+                                         0, 0, 0, 0, 0, 0, 0, 0,
+                                         0, 0, 0x3E - 0x2B, 0x34 - 0x30, 0x00 - 0x41, 0x0F - 0x50, 0x1A - 0x61, 0x29 - 0x70,
+                                         0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  // Each 128-bit lane gives 12 bytes, stored as 16, so 4 more characters must follow the block
+  size_t i = 0;
+  for ( ; i + 36 <= _inputLen; i += 32, _output += 24 )
+  {
+    __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_input + i));
+    __m256i hiNibble = _mm256_and_si256(_mm256_srli_epi32(in, 4), _mm256_set1_epi8(0x0F));
+    __m256i isSlash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+    __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_shuffle_epi8(lowerBound, hiNibble), in),
+                                      _mm256_cmpgt_epi8(in, _mm256_shuffle_epi8(upperBound, hiNibble)));
+    if ( _mm256_movemask_epi8(_mm256_andnot_si256(isSlash, outside)) != 0 ) break;
+    __m256i values = _mm256_add_epi8(_mm256_add_epi8(in, _mm256_shuffle_epi8(shift, hiNibble)),
+                                     _mm256_and_si256(isSlash, _mm256_set1_epi8(-3)));
+    __m256i merged = _mm256_madd_epi16(_mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+    merged = _mm256_shuffle_epi8(merged, pack);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_output), _mm256_castsi256_si128(merged));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(_output + 12), _mm256_extracti128_si256(merged, 1));
+  }
+  return i;
+}
+
+#undef SSSE3
+#undef AVX2
+
+#endif // SID_CODEC_SIMD
+
+codec::simd detect_simd()
+{
+#ifdef SID_CODEC_SIMD
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports("avx2") ) return codec::simd::avx2;
+  if ( __builtin_cpu_supports("ssse3") ) return codec::simd::ssse3;
+#endif
+  return codec::simd::none;
+}
+
+codec::simd g_simd = detect_simd();
+
+} // anonymous namespace
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Dispatch
+//
+codec::simd codec::supported()
+{
+  static const simd best = detect_simd();
+  return best;
+}
+
+codec::simd codec::active()
+{
+  return g_simd;
+}
+
+codec::simd codec::set_active(simd _simd)
+{
+  simd previous = g_simd;
+  g_simd = ( static_cast<int>(_simd) > static_cast<int>(supported()) )? supported() : _simd;
+  return previous;
+}
+
+void sid::bytes_to_hex(const void* _input, size_t _inputLen, char* _output, bool _lowerCase/* = false*/) noexcept
+{
+  const uint8_t* input = static_cast<const uint8_t*>(_input);
+  size_t done = 0;
+#ifdef SID_CODEC_SIMD
+  if ( g_simd == codec::simd::avx2 )
+    done = hex_encode_avx2(input, _inputLen, _output, _lowerCase);
+  else if ( g_simd == codec::simd::ssse3 )
+    done = hex_encode_ssse3(input, _inputLen, _output, _lowerCase);
+#endif
+  hex_encode_scalar(input + done, _inputLen - done, _output + 2 * done, _lowerCase);
+}
+
+bool sid::hex_to_bytes(const char* _input, size_t _inputLen, void* _output) noexcept
+{
+  if ( _inputLen % 2 != 0 ) return false;
+  uint8_t* output = static_cast<uint8_t*>(_output);
+  size_t done = 0;
+#ifdef SID_CODEC_SIMD
+  if ( g_simd == codec::simd::avx2 )
+    done = hex_decode_avx2(_input, _inputLen, output);
+  else if ( g_simd == codec::simd::ssse3 )
+    done = hex_decode_ssse3(_input, _inputLen, output);
+#endif
+  return hex_decode_scalar(_input + done, (_inputLen - done) / 2, output + done / 2);
+}
+
+size_t sid::base64::encode(const void* _input, size_t _inputLen, char* _output) noexcept
+{
+  const uint8_t* input = static_cast<const uint8_t*>(_input);
+  size_t done = 0;
+#ifdef SID_CODEC_SIMD
+  if ( g_simd == codec::simd::avx2 )
+    done = base64_encode_avx2(input, _inputLen, _output);
+  else if ( g_simd == codec::simd::ssse3 )
+    done = base64_encode_ssse3(input, _inputLen, _output);
+#endif
+  done += base64_encode_scalar(input + done, _inputLen - done, _output + done / 3 * 4);
+
+  // The last 1 or 2 bytes are padded
+  char* out = _output + done / 3 * 4;
+  switch ( _inputLen - done )
+  {
+  case 1:
+    out[0] = BASE64_ALPHABET[input[done] >> 2];
+    out[1] = BASE64_ALPHABET[(input[done] & 0x03) << 4];
+    out[2] = out[3] = BASE64_PAD;
+    break;
+  case 2:
+    out[0] = BASE64_ALPHABET[input[done] >> 2];
+    out[1] = BASE64_ALPHABET[((input[done] & 0x03) << 4) | (input[done+1] >> 4)];
+    out[2] = BASE64_ALPHABET[(input[done+1] & 0x0F) << 2];
+    out[3] = BASE64_PAD;
+    break;
+  default:
+    break;
+  }
+  return encoded_length(_inputLen);
+}
+
+bool sid::base64::decode(const char* _input, size_t _inputLen, void* _output, size_t& _outputLen) noexcept
+{
+  _outputLen = 0;
+  if ( _inputLen % 4 != 0 ) return false;
+  if ( _inputLen == 0 ) return true;
+
+  uint8_t* output = static_cast<uint8_t*>(_output);
+  // The last group can have padding, and is decoded separately
+  const size_t bodyLen = _inputLen - 4;
+  size_t done = 0;
+#ifdef SID_CODEC_SIMD
+  if ( g_simd == codec::simd::avx2 )
+    done = base64_decode_avx2(_input, bodyLen, output);
+  else if ( g_simd == codec::simd::ssse3 )
+    done = base64_decode_ssse3(_input, bodyLen, output);
+#endif
+  if ( ! base64_decode_scalar(_input + done, bodyLen - done, output + done / 4 * 3) )
+    return false;
+
+  const char* last = _input + bodyLen;
+  uint8_t* out = output + bodyLen / 4 * 3;
+  const uint8_t* value = get_tables().base64Value;
+  uint8_t a = value[static_cast<uint8_t>(last[0])], b = value[static_cast<uint8_t>(last[1])];
+  if ( a == INVALID || b == INVALID ) return false;
+  out[0] = static_cast<uint8_t>((a << 2) | (b >> 4));
+  size_t lastLen = 1;
+  if ( last[2] == BASE64_PAD )
+  {
+    if ( last[3] != BASE64_PAD ) return false;
+  }
+  else
+  {
+    uint8_t c = value[static_cast<uint8_t>(last[2])];
+    if ( c == INVALID ) return false;
+    out[lastLen++] = static_cast<uint8_t>((b << 4) | (c >> 2));
+    if ( last[3] != BASE64_PAD )
+    {
+      uint8_t d = value[static_cast<uint8_t>(last[3])];
+      if ( d == INVALID ) return false;
+      out[lastLen++] = static_cast<uint8_t>((c << 6) | d);
+    }
+  }
+  _outputLen = bodyLen / 4 * 3 + lastLen;
+  return true;
+}
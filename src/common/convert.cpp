@@ -37,6 +37,7 @@ LICENSE: END
 */
 
 #include "common/convert.hpp"
+#include "common/sized_writer.hpp"
 #include <iostream>
 
 // C++ includes
@@ -213,17 +214,10 @@ std::string sid::to_errno_str(int _errno, const std::string& _prefix/* = std::st
 //
 std::string sid::bytes_to_hex(const std::string& _input)
 {
-  std::ostringstream out;
-  std::string csHex;
-
-  for ( size_t i = 0; i < _input.length(); i++ )
-  {
-    unsigned char ch = (unsigned char) _input[i];
-    csHex = sid::to_str(ch, num_base::hex);
-    if ( csHex.length() == 1 ) csHex = "0" + csHex;
-    out << csHex;
-  }
-  return out.str();
+  // The length is known up front, so write directly into the output
+  std::string out(2 * _input.length(), '\0');
+  sid::bytes_to_hex(_input.data(), _input.length(), &out[0]);
+  return out;
 }
 
 bool sid::bytes_to_hex(const std::string& _input, std::string& _output, std::string* _pcsError/* = nullptr*/) noexcept
@@ -245,19 +239,10 @@ bool sid::bytes_to_hex(const std::string& _input, std::string& _output, std::str
 
 std::string sid::hex_to_bytes(const std::string& _input)
 {
-  std::ostringstream out;
-  unsigned char ch = 0;
-  std::string csError;
-
-  for ( size_t i = 0; i < _input.length(); )
-  {
-    char szHex[3] = {0};
-    szHex[0] = _input[i++]; szHex[1] = _input[i++];
-    if ( ! sid::to_num(szHex, num_base::hex, /*out*/ ch, &csError) )
-      throw sid::exception(std::string(__func__) + ": " + csError);
-    out << ((char) ch);
-  }
-  return out.str();
+  std::string out(_input.length() / 2, '\0');
+  if ( ! sid::hex_to_bytes(_input.data(), _input.length(), &out[0]) )
+    throw sid::exception(EINVAL, std::string(__func__) + ": Invalid hex string");
+  return out;
 }
 
 bool sid::hex_to_bytes(const std::string& _input, std::string& _output, std::string* _pcsError/* = nullptr*/) noexcept
@@ -410,104 +395,38 @@ bool sid::equals(const char* _primary, const char* _secondary, const match_case&
 
 //////////////////////////////////////////////////////////////////////////////////
 //
-// base64 conversion functions
+// base64 conversion functions. The kernels are in codec.cpp
 //
-const static char encodeLookup[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-const static char padCharacter = '=';
-
 std::string sid::base64::encode(const std::string& _input)
 {
-  std::ostringstream out;
-
-  uint32_t temp;
-  size_t i = 0;
-  for ( size_t idx = 0; idx < _input.size()/3; idx++ )
-  {
-    temp  = ( (unsigned char) _input[i++]) << 16; // Convert to big endian
-    temp += ( (unsigned char) _input[i++]) << 8;
-    temp += ( (unsigned char) _input[i++]);
-    out << encodeLookup[(temp & 0x00FC0000) >> 18]
-        << encodeLookup[(temp & 0x0003F000) >> 12]
-        << encodeLookup[(temp & 0x00000FC0) >> 6 ]
-        << encodeLookup[(temp & 0x0000003F)      ];
-  }
-
-  switch( _input.size() % 3 )
-  {
-  case 1:
-    temp  = ( (unsigned char) _input[i++]) << 16; // Convert to big endian
-    out << encodeLookup[(temp & 0x00FC0000) >> 18]
-        << encodeLookup[(temp & 0x0003F000) >> 12]
-        << padCharacter
-        << padCharacter;
-    break;
-  case 2:
-    temp  = ( (unsigned char) _input[i++]) << 16; // Convert to big endian
-    temp += ( (unsigned char) _input[i++]) << 8;
-    out << encodeLookup[(temp & 0x00FC0000) >> 18]
-        << encodeLookup[(temp & 0x0003F000) >> 12]
-        << encodeLookup[(temp & 0x00000FC0) >> 6 ]
-        << padCharacter;
-    break;
-  }
-
-  return out.str();
+  return encode(_input.data(), _input.length());
 }
 
 std::string sid::base64::encode(const char* _input, size_t _inputLen)
 {
   if ( _input && _inputLen == std::string::npos )
     _inputLen = ::strlen(_input);
-  std::string csInput(_input, _inputLen);
-  return encode(csInput);
+  std::string out(encoded_length(_inputLen), '\0');
+  if ( _inputLen != 0 )
+    encode(static_cast<const void*>(_input), _inputLen, &out[0]);
+  return out;
 }
 
 std::string sid::base64::decode(const std::string& _input)
 {
-  std::ostringstream out;
-
-  if ( _input.length() % 4 != 0 )
-    throw sid::exception(EINVAL, "base64::decode: Invalid input");
-
-  // allocate memory on the stack
-  char* decoding_table = (char *) alloca(256);
-  if ( decoding_table == NULL )
-    throw sid::exception(ENOMEM, "base64::decode: Unable to allocate memory");
-
-  for ( size_t x = 0; x < 64; x++ )
-    decoding_table[(unsigned char) encodeLookup[x]] = x;
-
-  size_t input_length = _input.length();
-  size_t output_length = _input.length() / 4 * 3;
-  if ( _input[input_length - 1] == padCharacter ) (output_length)--;
-  if ( _input[input_length - 2] == padCharacter ) (output_length)--;
-
-  for ( size_t i = 0, j = 0; i < input_length; )
-  {
-    uint32_t sextet_a = (_input[i] == padCharacter)? 0 & i++ : decoding_table[(unsigned char) _input[i++]];
-    uint32_t sextet_b = (_input[i] == padCharacter)? 0 & i++ : decoding_table[(unsigned char) _input[i++]];
-    uint32_t sextet_c = (_input[i] == padCharacter)? 0 & i++ : decoding_table[(unsigned char) _input[i++]];
-    uint32_t sextet_d = (_input[i] == padCharacter)? 0 & i++ : decoding_table[(unsigned char) _input[i++]];
-
-    uint32_t triple = (sextet_a << 3 * 6)
-      + (sextet_b << 2 * 6)
-      + (sextet_c << 1 * 6)
-      + (sextet_d << 0 * 6);
-
-    if ( j < output_length ) { ++j; out << (char) ((triple >> 2 * 8) & 0xFF); }
-    if ( j < output_length ) { ++j; out << (char) ((triple >> 1 * 8) & 0xFF); }
-    if ( j < output_length ) { ++j; out << (char) ((triple >> 0 * 8) & 0xFF); }
-  }
-
-  return out.str();
+  return decode(_input.data(), _input.length());
 }
 
 std::string sid::base64::decode(const char* _input, size_t _inputLen)
 {
   if ( _input && _inputLen == std::string::npos )
     _inputLen = ::strlen(_input);
-  std::string csInput(_input, _inputLen);
-  return decode(csInput);
+  std::string out(decoded_length(_inputLen), '\0');
+  size_t outLen = 0;
+  if ( _inputLen != 0 && ! decode(_input, _inputLen, &out[0], outLen) )
+    throw sid::exception(EINVAL, "base64::decode: Invalid input");
+  out.resize(outLen);
+  return out;
 }
 
 #define RC4_BYTES 256
@@ -38,23 +38,81 @@ LICENSE: END
 
 #include "common/convert.hpp"
 #include "common/hash.hpp"
+#include <openssl/core_names.h>
+#include <map>
+#include <memory>
 
 using namespace std;
 using namespace sid::hash;
 
+namespace {
+
+/**
+ * @struct digest_table
+ * @brief Digests of the md_algorithm classes, looked up once
+ */
+struct digest_table
+{
+  const EVP_MD* sha256;
+  const EVP_MD* sha1;
+  const EVP_MD* md5;
+  const EVP_MD* sha512;
+
+  digest_table()
+    : sha256(EVP_get_digestbynid(NID_sha256)), sha1(EVP_get_digestbynid(NID_sha1)),
+      md5(EVP_get_digestbynid(NID_md5)), sha512(EVP_get_digestbynid(NID_sha512)) {}
+
+  const EVP_MD* get(int _nid) const
+  {
+    switch ( _nid )
+    {
+    case NID_sha256: return sha256;
+    case NID_sha1:   return sha1;
+    case NID_md5:    return md5;
+    case NID_sha512: return sha512;
+    default: break;
+    }
+    return nullptr;
+  }
+};
+
+const digest_table& digests()
+{
+  static digest_table table;
+  return table;
+}
+
+//! Digest of the nid, from the table if it is one of the cached digests
+const EVP_MD* get_digest(int _nid)
+{
+  const EVP_MD* md = digests().get(_nid);
+  return md? md : EVP_get_digestbynid(_nid);
+}
+
+//! HMAC implementation, fetched once
+EVP_MAC* get_hmac_mac()
+{
+  static EVP_MAC* mac = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+  return mac;
+}
+
+} // anonymous namespace
+
 void sid::hash::init()
 {
   OpenSSL_add_all_digests();
+  digests();
+  get_hmac_mac();
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 //
 // Implementation of digest
 //
-std::string digest::to_hex_str() const
+std::string digest::to_hex_str(bool _lowerCase/* = false*/) const
 {
-  std::string out;
-  sid::bytes_to_hex(m_data, out);
+  std::string out(2 * m_data.length(), '\0');
+  sid::bytes_to_hex(m_data.data(), m_data.length(), &out[0], _lowerCase);
   return out;
 }
 
@@ -69,43 +127,52 @@ std::string digest::to_base64() const
 //
 static const uint8_t* uint8_t_empty = (const uint8_t*) "";
 
+md_algorithm::md_algorithm(int _nid) : m_nid(_nid), m_md(get_digest(_nid))
+{
+}
+
 std::string md_algorithm::name() const
 {
   return std::string(OBJ_nid2sn(m_nid));
 }
 
-digest md_algorithm::get_hash(const uint8_t* _data, uint64_t _dataLen)
+const EVP_MD* md_algorithm::md() const
 {
-  digest md_digest;
-
-  const EVP_MD* md = EVP_get_digestbynid(m_nid);
+  // The digests may not have been registered when the object was created
+  const EVP_MD* md = m_md? m_md : get_digest(m_nid);
   if ( !md )
     throw sid::exception(std::string("Failed to get digest for nid ") + sid::to_str(m_nid) + ". Ensure sid::hash::init() is called before using");
+  return md;
+}
 
-  EVP_MD_CTX* ctx = EVP_MD_CTX_create();
-  EVP_MD_CTX_init(ctx);
-  if ( 1 == EVP_DigestInit_ex(ctx, md, nullptr) )
-  {
-    unsigned char out[EVP_MAX_MD_SIZE] = {0};
-    unsigned int out_len = EVP_MD_size(md);
+digest md_algorithm::get_hash(const uint8_t* _data, uint64_t _dataLen)
+{
+  // Each thread keeps a hasher per algorithm, so that a digest does not set up a new context
+  static thread_local std::map<int, std::unique_ptr<hasher>> hashers;
 
-    int s1 = EVP_DigestUpdate(ctx, (void*) (_data? _data:uint8_t_empty), _dataLen);
-    int s2 = EVP_DigestFinal_ex(ctx, out, &out_len);
-    if ( s1 == 1 && s2 == 1 )
-      md_digest.set(out, out_len, EVP_MD_name(md));
-  }
-  EVP_MD_CTX_destroy(ctx);
+  // Throws if the digest is not available
+  this->md();
 
-  return md_digest;
+  std::unique_ptr<hasher>& md_hasher = hashers[m_nid];
+  try
+  {
+    if ( !md_hasher )
+      md_hasher.reset(new hasher(*this));
+    return md_hasher->update((_data? _data:uint8_t_empty), _dataLen).final();
+  }
+  catch (const sid::exception&)
+  {
+    // The context is in an unknown state
+    md_hasher.reset();
+  }
+  return digest();
 }
 
 digest md_algorithm::get_hmac(const uint8_t* _key, uint64_t _keyLen, const uint8_t* _data, uint64_t _dataLen)
 {
   digest md_digest;
 
-  const EVP_MD* md = EVP_get_digestbynid(m_nid);
-  if ( !md )
-    throw sid::exception(std::string("Failed to get digest for nid ") + sid::to_str(m_nid) + ". Ensure sid::hash::init() is called before using");
+  const EVP_MD* md = this->md();
 
   unsigned char out[EVP_MAX_MD_SIZE];
   unsigned int out_len = EVP_MD_size(md);
@@ -122,3 +189,124 @@ digest md_algorithm::get_hmac(const uint8_t* _key, uint64_t _keyLen, const uint8
 
   return md_digest;
 }
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of hmac_key
+//
+hmac_key::hmac_key(const md_algorithm& _algorithm, const uint8_t* _key, uint64_t _keyLen)
+  : m_template(_algorithm, _key, _keyLen)
+{
+}
+
+digest hmac_key::get_hmac(const uint8_t* _data, uint64_t _dataLen) const
+{
+  // The template is never updated, so that the threads can copy it at the same time
+  hasher hmac(m_template);
+  return hmac.update(_data? _data:uint8_t_empty, _dataLen).final();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of hasher
+//
+hasher::hasher(const md_algorithm& _algorithm)
+  : m_template(EVP_MD_CTX_create()), m_ctx(EVP_MD_CTX_create()), m_hmac(nullptr), m_length(0)
+{
+  const EVP_MD* md = _algorithm.md();
+  if ( !m_template || !m_ctx || 1 != EVP_DigestInit_ex(m_template, md, nullptr) )
+  {
+    EVP_MD_CTX_destroy(m_template);
+    EVP_MD_CTX_destroy(m_ctx);
+    throw sid::exception("Failed to create the digest context");
+  }
+  m_type = EVP_MD_name(md);
+  reset();
+}
+
+hasher::hasher(const md_algorithm& _algorithm, const uint8_t* _key, uint64_t _keyLen)
+  : m_template(nullptr), m_ctx(nullptr), m_hmac(nullptr), m_length(0)
+{
+  const EVP_MD* md = _algorithm.md();
+  EVP_MAC* mac = get_hmac_mac();
+  OSSL_PARAM params[] = {
+    OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>(EVP_MD_name(md)), 0),
+    OSSL_PARAM_construct_end()
+  };
+  // The key is hashed once here. Later messages start again with the same key (see reset()).
+  m_hmac = mac? EVP_MAC_CTX_new(mac) : nullptr;
+  if ( !m_hmac || 1 != EVP_MAC_init(m_hmac, (_key? _key:uint8_t_empty), _keyLen, params) )
+  {
+    EVP_MAC_CTX_free(m_hmac);
+    throw sid::exception("Failed to create the HMAC context");
+  }
+  m_type = std::string("HMAC-") + EVP_MD_name(md);
+}
+
+hasher::hasher(const hasher& _obj)
+  : m_template(nullptr), m_ctx(nullptr), m_hmac(nullptr), m_type(_obj.m_type), m_length(_obj.m_length)
+{
+  if ( _obj.m_hmac )
+  {
+    m_hmac = EVP_MAC_CTX_dup(_obj.m_hmac);
+    if ( !m_hmac )
+      throw sid::exception("Failed to copy the " + m_type + " context");
+    return;
+  }
+  m_template = EVP_MD_CTX_create();
+  m_ctx = EVP_MD_CTX_create();
+  if ( !m_template || !m_ctx || 1 != EVP_MD_CTX_copy_ex(m_template, _obj.m_template) || 1 != EVP_MD_CTX_copy_ex(m_ctx, _obj.m_ctx) )
+  {
+    EVP_MD_CTX_destroy(m_template);
+    EVP_MD_CTX_destroy(m_ctx);
+    throw sid::exception("Failed to copy the " + m_type + " context");
+  }
+}
+
+hasher::~hasher()
+{
+  EVP_MD_CTX_destroy(m_template);
+  EVP_MD_CTX_destroy(m_ctx);
+  EVP_MAC_CTX_free(m_hmac);
+}
+
+void hasher::reset()
+{
+  // Copying the template reuses the buffers of the context, unlike creating and initializing it again.
+  // An HMAC initialized without a key starts again with the key it already holds.
+  int status = m_hmac? EVP_MAC_init(m_hmac, nullptr, 0, nullptr) : EVP_MD_CTX_copy_ex(m_ctx, m_template);
+  if ( status != 1 )
+    throw sid::exception("Failed to reset the " + m_type + " context");
+  m_length = 0;
+}
+
+hasher& hasher::update(const void* _data, uint64_t _dataLen)
+{
+  if ( _dataLen == 0 ) return *this;
+  int status = m_hmac? EVP_MAC_update(m_hmac, static_cast<const uint8_t*>(_data), _dataLen) : EVP_DigestUpdate(m_ctx, _data, _dataLen);
+  if ( status != 1 )
+    throw sid::exception("Failed to update the " + m_type + " context");
+  m_length += _dataLen;
+  return *this;
+}
+
+digest hasher::final()
+{
+  unsigned char out[EVP_MAX_MD_SIZE];
+  int status = 0;
+  size_t out_len = 0;
+  if ( m_hmac )
+    status = EVP_MAC_final(m_hmac, out, &out_len, sizeof(out));
+  else
+  {
+    unsigned int md_len = 0;
+    status = EVP_DigestFinal_ex(m_ctx, out, &md_len);
+    out_len = md_len;
+  }
+  if ( status != 1 )
+    throw sid::exception("Failed to finalize the " + m_type + " context");
+  digest md_digest;
+  md_digest.set(out, out_len, m_type);
+  reset();
+  return md_digest;
+}
@@ -0,0 +1,540 @@
+/**
+ * @file hash_batch.cpp
+ * @brief Digests of many independent buffers on a pool of worker threads
+ */
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief List of common functions in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "common/convert.hpp"
+#include "common/hash_batch.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SID_HASH_MULTI_BUFFER
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+using namespace std;
+using namespace sid::hash;
+
+namespace {
+
+const size_t LANES = 8;        //! Messages hashed together by the multi-buffer kernels (32-bit lanes of AVX2)
+const size_t BLOCK_SIZE = 64;  //! Block size of MD5 and SHA-256
+
+const uint32_t MD5_IV[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+
+const uint32_t MD5_K[64] = {
+  0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+  0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+  0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+  0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+  0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+  0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+  0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+  0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+const int MD5_S[64] = {
+  7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+  5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+  4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+  6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+const uint32_t SHA256_IV[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+const uint32_t SHA256_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/**
+ * @struct mb_state
+ * @brief State of the messages in the lanes of a multi-buffer kernel. word[i][lane] is the i-th state word of a lane.
+ */
+struct mb_state
+{
+  uint32_t word[8][LANES];
+};
+
+using FNMultiBuffer = void (*)(mb_state& _state, const uint8_t* _blocks[LANES], size_t _count);
+
+#ifdef SID_HASH_MULTI_BUFFER
+
+bool cpu_has_avx2()
+{
+  return __builtin_cpu_supports("avx2");
+}
+
+//! SHA extensions (SHA-NI), which OpenSSL uses for SHA-256
+bool cpu_has_sha()
+{
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if ( ! __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) ) return false;
+  return ( (ebx >> 29) & 1 ) != 0;
+}
+
+#define AVX2 __attribute__((target("avx2"), always_inline)) inline
+
+AVX2 __m256i rotl(__m256i _x, int _n) { return _mm256_or_si256(_mm256_slli_epi32(_x, _n), _mm256_srli_epi32(_x, 32 - _n)); }
+AVX2 __m256i rotr(__m256i _x, int _n) { return _mm256_or_si256(_mm256_srli_epi32(_x, _n), _mm256_slli_epi32(_x, 32 - _n)); }
+AVX2 __m256i add(__m256i _x, __m256i _y) { return _mm256_add_epi32(_x, _y); }
+AVX2 __m256i xor3(__m256i _x, __m256i _y, __m256i _z) { return _mm256_xor_si256(_mm256_xor_si256(_x, _y), _z); }
+
+//! Load 8 consecutive 32-bit words of each lane and transpose them, so that _w[i] holds the i-th word of every lane
+AVX2 void load_transposed(const uint8_t* _blocks[LANES], size_t _offset, __m256i _w[8])
+{
+  __m256i r[8], t[8], u[8];
+  for ( size_t i = 0; i < LANES; i++ )
+    r[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_blocks[i] + _offset));
+  for ( size_t i = 0; i < 8; i += 2 )
+  {
+    t[i] = _mm256_unpacklo_epi32(r[i], r[i+1]);
+    t[i+1] = _mm256_unpackhi_epi32(r[i], r[i+1]);
+  }
+  for ( size_t i = 0; i < 8; i += 4 )
+  {
+    u[i] = _mm256_unpacklo_epi64(t[i], t[i+2]);
+    u[i+1] = _mm256_unpackhi_epi64(t[i], t[i+2]);
+    u[i+2] = _mm256_unpacklo_epi64(t[i+1], t[i+3]);
+    u[i+3] = _mm256_unpackhi_epi64(t[i+1], t[i+3]);
+  }
+  for ( size_t i = 0; i < 4; i++ )
+  {
+    _w[i] = _mm256_permute2x128_si256(u[i], u[i+4], 0x20);
+    _w[i+4] = _mm256_permute2x128_si256(u[i], u[i+4], 0x31);
+  }
+}
+
+__attribute__((target("avx2")))
+void md5_x8(mb_state& _state, const uint8_t* _blocks[LANES], size_t _count)
+{
+  __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_state.word[0]));
+  __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_state.word[1]));
+  __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_state.word[2]));
+  __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_state.word[3]));
+  const __m256i ones = _mm256_set1_epi32(-1);
+  const uint8_t* blocks[LANES];
+  ::memcpy(blocks, _blocks, sizeof(blocks));
+
+  for ( size_t n = 0; n < _count; n++ )
+  {
+    __m256i w[16];
+    load_transposed(blocks, 0, w);
+    load_transposed(blocks, 32, w + 8);
+    const __m256i aa = a, bb = b, cc = c, dd = d;
+
+#define MD5_STEP(f, i, g) \
+    { \
+      __m256i x = add(add(a, f), add(w[g], _mm256_set1_epi32(MD5_K[i]))); \
+      a = d; d = c; c = b; b = add(b, rotl(x, MD5_S[i])); \
+    }
+#pragma GCC unroll 16
+    for ( int i = 0; i < 16; i++ )
+      MD5_STEP(_mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d))), i, i)
+#pragma GCC unroll 16
+    for ( int i = 16; i < 32; i++ )
+      MD5_STEP(_mm256_xor_si256(c, _mm256_and_si256(d, _mm256_xor_si256(b, c))), i, (5*i + 1) % 16)
+#pragma GCC unroll 16
+    for ( int i = 32; i < 48; i++ )
+      MD5_STEP(xor3(b, c, d), i, (3*i + 5) % 16)
+#pragma GCC unroll 16
+    for ( int i = 48; i < 64; i++ )
+      MD5_STEP(_mm256_xor_si256(c, _mm256_or_si256(b, _mm256_xor_si256(d, ones))), i, (7*i) % 16)
+#undef MD5_STEP
+
+    a = add(a, aa); b = add(b, bb); c = add(c, cc); d = add(d, dd);
+    for ( size_t i = 0; i < LANES; i++ )
+      blocks[i] += BLOCK_SIZE;
+  }
+
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(_state.word[0]), a);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(_state.word[1]), b);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(_state.word[2]), c);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(_state.word[3]), d);
+}
+
+__attribute__((target("avx2")))
+void sha256_x8(mb_state& _state, const uint8_t* _blocks[LANES], size_t _count)
+{
+  __m256i s[8];
+  for ( size_t i = 0; i < 8; i++ )
+    s[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_state.word[i]));
+  // The message words are big-endian
+  const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                         3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const uint8_t* blocks[LANES];
+  ::memcpy(blocks, _blocks, sizeof(blocks));
+
+  for ( size_t n = 0; n < _count; n++ )
+  {
+    __m256i w[64];
+    load_transposed(blocks, 0, w);
+    load_transposed(blocks, 32, w + 8);
+    for ( size_t i = 0; i < 16; i++ )
+      w[i] = _mm256_shuffle_epi8(w[i], bswap);
+#pragma GCC unroll 8
+    for ( size_t i = 16; i < 64; i++ )
+    {
+      __m256i s0 = xor3(rotr(w[i-15], 7), rotr(w[i-15], 18), _mm256_srli_epi32(w[i-15], 3));
+      __m256i s1 = xor3(rotr(w[i-2], 17), rotr(w[i-2], 19), _mm256_srli_epi32(w[i-2], 10));
+      w[i] = add(add(w[i-16], s0), add(w[i-7], s1));
+    }
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+#pragma GCC unroll 8
+    for ( size_t i = 0; i < 64; i++ )
+    {
+      __m256i S1 = xor3(rotr(e, 6), rotr(e, 11), rotr(e, 25));
+      __m256i ch = _mm256_xor_si256(g, _mm256_and_si256(e, _mm256_xor_si256(f, g)));
+      __m256i t1 = add(add(h, S1), add(ch, add(w[i], _mm256_set1_epi32(SHA256_K[i]))));
+      __m256i S0 = xor3(rotr(a, 2), rotr(a, 13), rotr(a, 22));
+      __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+      h = g; g = f; f = e; e = add(d, t1);
+      d = c; c = b; b = a; a = add(t1, add(S0, maj));
+    }
+    s[0] = add(s[0], a); s[1] = add(s[1], b); s[2] = add(s[2], c); s[3] = add(s[3], d);
+    s[4] = add(s[4], e); s[5] = add(s[5], f); s[6] = add(s[6], g); s[7] = add(s[7], h);
+    for ( size_t i = 0; i < LANES; i++ )
+      blocks[i] += BLOCK_SIZE;
+  }
+
+  for ( size_t i = 0; i < 8; i++ )
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(_state.word[i]), s[i]);
+}
+
+#undef AVX2
+
+#endif // SID_HASH_MULTI_BUFFER
+
+/**
+ * @struct mb_algorithm
+ * @brief Multi-buffer kernel of an algorithm and how its messages are padded and output
+ */
+struct mb_algorithm
+{
+  FNMultiBuffer   kernel;
+  const uint32_t* iv;
+  size_t          words;      //! Number of state words (the digest is 4 bytes per word)
+  bool            bigEndian;  //! Byte order of the message length and the digest
+
+  mb_algorithm() : kernel(nullptr), iv(nullptr), words(0), bigEndian(false) {}
+};
+
+//! Multi-buffer kernel for the algorithm, if it is supported and chosen by the configuration
+mb_algorithm get_multi_buffer(int _nid, batch_kernel _kernel)
+{
+  mb_algorithm mb;
+#ifdef SID_HASH_MULTI_BUFFER
+  if ( _kernel == batch_kernel::scalar || ! cpu_has_avx2() )
+    return mb;
+  if ( _nid == NID_md5 )
+  {
+    mb.kernel = md5_x8;
+    mb.iv = MD5_IV;
+    mb.words = 4;
+    mb.bigEndian = false;
+  }
+  // OpenSSL is faster with the SHA extensions than the multi-buffer kernel
+  else if ( _nid == NID_sha256 && (_kernel == batch_kernel::multi_buffer || ! cpu_has_sha()) )
+  {
+    mb.kernel = sha256_x8;
+    mb.iv = SHA256_IV;
+    mb.words = 8;
+    mb.bigEndian = true;
+  }
+#endif
+  return mb;
+}
+
+/**
+ * @struct mb_lane
+ * @brief Message in a lane of a multi-buffer kernel. The full blocks are read from the buffer, and the padded
+ *        remainder from a copy of it.
+ */
+struct mb_lane
+{
+  bool           active;
+  size_t         index;       //! Position of the buffer in the batch
+  const uint8_t* data;
+  uint64_t       fullBlocks;  //! Number of blocks read from the buffer
+  uint64_t       totalBlocks; //! fullBlocks and 1 or 2 padded blocks
+  uint64_t       pos;         //! Next block
+  uint8_t        tail[2*BLOCK_SIZE];
+
+  mb_lane() : active(false), index(0), data(nullptr), fullBlocks(0), totalBlocks(0), pos(0) {}
+
+  void set(size_t _index, const uint8_t* _data, uint64_t _length, bool _bigEndian)
+  {
+    active = true;
+    index = _index;
+    data = _data;
+    fullBlocks = _length / BLOCK_SIZE;
+    pos = 0;
+    const size_t remaining = _length % BLOCK_SIZE;
+    const size_t tailLength = ( remaining < BLOCK_SIZE - 8 )? BLOCK_SIZE : 2*BLOCK_SIZE;
+    totalBlocks = fullBlocks + tailLength / BLOCK_SIZE;
+    ::memset(tail, 0, sizeof(tail));
+    if ( remaining > 0 )
+      ::memcpy(tail, _data + fullBlocks * BLOCK_SIZE, remaining);
+    tail[remaining] = 0x80;
+    const uint64_t bits = _length * 8;
+    for ( size_t i = 0; i < 8; i++ )
+      tail[tailLength - 8 + i] = static_cast<uint8_t>( bits >> (_bigEndian? 56 - 8*i : 8*i) );
+  }
+
+  const uint8_t* block() const { return ( pos < fullBlocks )? data + pos * BLOCK_SIZE : tail + (pos - fullBlocks) * BLOCK_SIZE; }
+};
+
+} // anonymous namespace
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of batch_digest
+//
+batch_digest::batch_digest(const md_algorithm& _algorithm, const batch_config& _config/* = batch_config()*/)
+  : m_algorithm(_algorithm), m_multiBuffer(false), m_workers(), m_lock(), m_ready(), m_finished(),
+    m_jobs(), m_digests(), m_next(0), m_done(0), m_failed(0), m_stop(false)
+{
+  // Throws if the digest is not available
+  m_algorithm.md();
+  m_multiBuffer = ( get_multi_buffer(m_algorithm.nid(), _config.kernel).kernel != nullptr );
+
+  size_t threads = _config.threads;
+  if ( threads == 0 )
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  for ( size_t i = 0; i < threads; i++ )
+    m_workers.emplace_back(&batch_digest::p_worker, this);
+}
+
+batch_digest::~batch_digest()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_stop = true;
+  }
+  m_ready.notify_all();
+  for ( std::thread& worker : m_workers )
+    worker.join();
+}
+
+size_t batch_digest::submit(const void* _data, uint64_t _dataLen)
+{
+  size_t index = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    index = m_jobs.size();
+    m_jobs.push_back(job{static_cast<const uint8_t*>(_data), _dataLen});
+    m_digests.emplace_back();
+  }
+  m_ready.notify_one();
+  return index;
+}
+
+std::vector<digest> batch_digest::wait()
+{
+  std::vector<digest> digests;
+  size_t failed = 0;
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_finished.wait(lock, [this]() { return m_done == m_jobs.size(); });
+    digests.swap(m_digests);
+    failed = m_failed;
+    m_jobs.clear();
+    m_next = m_done = m_failed = 0;
+  }
+  if ( failed > 0 )
+    throw sid::exception("Failed to hash " + sid::to_str(failed) + " of " + sid::to_str(digests.size()) + " buffers");
+  return digests;
+}
+
+std::vector<digest> batch_digest::get_hash(const std::vector<std::string>& _buffers)
+{
+  for ( const std::string& buffer : _buffers )
+    submit(buffer.data(), buffer.length());
+  return wait();
+}
+
+tree_digest batch_digest::get_tree_hash(const void* _data, uint64_t _dataLen, uint64_t _chunkSize)
+{
+  if ( _chunkSize == 0 )
+    throw sid::exception("Chunk size of a tree hash cannot be 0");
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if ( ! m_jobs.empty() )
+      throw sid::exception("A tree hash cannot be mixed with submitted buffers");
+  }
+
+  tree_digest tree;
+  tree.chunk_size = _chunkSize;
+  const uint8_t* data = static_cast<const uint8_t*>(_data);
+  uint64_t offset = 0;
+  do
+  {
+    uint64_t length = std::min(_chunkSize, _dataLen - offset);
+    submit(data + offset, length);
+    offset += length;
+  }
+  while ( offset < _dataLen );
+  tree.chunks = wait();
+
+  hasher root(m_algorithm);
+  for ( const digest& chunk : tree.chunks )
+    root.update(chunk.data());
+  tree.root = root.final();
+  return tree;
+}
+
+void batch_digest::p_worker()
+{
+  for ( ;; )
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_ready.wait(lock, [this]() { return m_stop || m_next < m_jobs.size(); });
+      if ( m_stop ) return;
+    }
+    if ( m_multiBuffer )
+      p_run_multi_buffer();
+    else
+      p_run_scalar();
+  }
+}
+
+bool batch_digest::p_next(size_t& _index, job& _job)
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  if ( m_stop || m_next >= m_jobs.size() ) return false;
+  _index = m_next++;
+  _job = m_jobs[_index];
+  return true;
+}
+
+void batch_digest::p_done(size_t _index, const digest& _digest, bool _isFailed/* = false*/)
+{
+  bool isFinished = false;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_digests[_index] = _digest;
+    if ( _isFailed ) m_failed++;
+    isFinished = ( ++m_done == m_jobs.size() );
+  }
+  if ( isFinished )
+    m_finished.notify_all();
+}
+
+void batch_digest::p_run_scalar()
+{
+  hasher md_hasher(m_algorithm);
+  size_t index = 0;
+  job next;
+  while ( p_next(index, next) )
+  {
+    try
+    {
+      p_done(index, md_hasher.update(next.data, next.length).final());
+    }
+    catch (const sid::exception&)
+    {
+      md_hasher.reset();
+      p_done(index, digest(), true);
+    }
+  }
+}
+
+void batch_digest::p_run_multi_buffer()
+{
+  const mb_algorithm mb = get_multi_buffer(m_algorithm.nid(), batch_kernel::multi_buffer);
+  const std::string type = EVP_MD_name(m_algorithm.md());
+  mb_state state = {};
+  mb_lane lanes[LANES];
+  const uint8_t* blocks[LANES];
+
+  for ( ;; )
+  {
+    // Start the next buffers in the free lanes. The lanes are not kept waiting for buffers to be submitted.
+    size_t active = 0;
+    size_t index = 0;
+    job next;
+    for ( size_t i = 0; i < LANES; i++ )
+    {
+      if ( ! lanes[i].active && p_next(index, next) )
+      {
+        lanes[i].set(index, next.data, next.length, mb.bigEndian);
+        for ( size_t w = 0; w < mb.words; w++ )
+          state.word[w][i] = mb.iv[w];
+      }
+      if ( lanes[i].active ) active++;
+    }
+    if ( active == 0 ) break;
+
+    // Run as many blocks as all the active lanes can read from their buffers, otherwise a single block
+    uint64_t count = ~0ULL;
+    const uint8_t* anyBlock = nullptr;
+    for ( const mb_lane& lane : lanes )
+    {
+      if ( ! lane.active ) continue;
+      count = std::min(count, ( lane.pos < lane.fullBlocks )? lane.fullBlocks - lane.pos : 1);
+      anyBlock = lane.block();
+    }
+    // The free lanes hash the data of another lane and their result is discarded
+    for ( size_t i = 0; i < LANES; i++ )
+      blocks[i] = lanes[i].active? lanes[i].block() : anyBlock;
+    mb.kernel(state, blocks, count);
+
+    for ( size_t i = 0; i < LANES; i++ )
+    {
+      mb_lane& lane = lanes[i];
+      if ( ! lane.active || (lane.pos += count) < lane.totalBlocks ) continue;
+      uint8_t out[32];
+      for ( size_t w = 0; w < mb.words; w++ )
+        for ( size_t b = 0; b < 4; b++ )
+          out[4*w + b] = static_cast<uint8_t>( state.word[w][i] >> (mb.bigEndian? 24 - 8*b : 8*b) );
+      digest md_digest;
+      md_digest.set(out, 4*mb.words, type);
+      lane.active = false;
+      p_done(lane.index, md_digest);
+    }
+  }
+}
@@ -0,0 +1,139 @@
+/**
+ * @file histogram.cpp
+ * @brief histogram class implementation
+ *        Distribution of values (typically latencies) with bounded relative error
+ */
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief Latency histogram with log-linear buckets
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "common/histogram.hpp"
+#include "common/convert.hpp"
+#include <cstring>
+
+using namespace sid;
+
+//! Default constructor
+histogram::histogram()
+{
+  clear();
+}
+
+void histogram::clear()
+{
+  ::memset(m_counts, 0, sizeof(m_counts));
+  m_count = m_sum = m_max = 0;
+  m_min = UINT64_MAX;
+}
+
+/*static*/
+int histogram::p_index(uint64_t _value)
+{
+  // Values below 2 * SUB_BUCKETS get a bucket each. Above that, the bucket is given by the position of the
+  // most significant bit and the SUB_BUCKET_BITS bits that follow it.
+  if ( _value < 2 * SUB_BUCKETS )
+    return static_cast<int>(_value);
+  int msb = 63 - __builtin_clzll(_value);
+  int shift = msb - SUB_BUCKET_BITS;
+  return (shift + 1) * SUB_BUCKETS + static_cast<int>((_value >> shift) - SUB_BUCKETS);
+}
+
+/*static*/
+uint64_t histogram::p_upper_bound(int _index)
+{
+  if ( _index < 2 * SUB_BUCKETS )
+    return static_cast<uint64_t>(_index);
+  int shift = _index / SUB_BUCKETS - 1;
+  uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + _index % SUB_BUCKETS) << shift;
+  return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void histogram::record(uint64_t _value)
+{
+  m_counts[p_index(_value)]++;
+  m_count++;
+  m_sum += _value;
+  if ( _value < m_min ) m_min = _value;
+  if ( _value > m_max ) m_max = _value;
+}
+
+void histogram::merge(const histogram& _other)
+{
+  if ( _other.m_count == 0 )
+    return;
+  for ( int i = 0; i < BUCKETS; i++ )
+    m_counts[i] += _other.m_counts[i];
+  m_count += _other.m_count;
+  m_sum += _other.m_sum;
+  if ( _other.m_min < m_min ) m_min = _other.m_min;
+  if ( _other.m_max > m_max ) m_max = _other.m_max;
+}
+
+uint64_t histogram::percentile(double _percent) const
+{
+  if ( m_count == 0 )
+    return 0;
+  if ( _percent <= 0 )
+    return m_min;
+  if ( _percent >= 100 )
+    return m_max;
+
+  // Rank of the value (1 based), rounded up so that p50 of two values is the first one
+  uint64_t rank = static_cast<uint64_t>(_percent / 100.0 * m_count);
+  if ( static_cast<double>(rank) < _percent / 100.0 * m_count ) rank++;
+  if ( rank == 0 ) rank = 1;
+
+  uint64_t seen = 0;
+  for ( int i = 0; i < BUCKETS; i++ )
+  {
+    seen += m_counts[i];
+    if ( seen >= rank )
+    {
+      uint64_t value = p_upper_bound(i);
+      return ( value > m_max )? m_max : ( value < m_min )? m_min : value;
+    }
+  }
+  return m_max;
+}
+
+std::string histogram::to_str(const std::string& _unit) const
+{
+  return "count=" + sid::to_str(m_count)
+    + " min=" + sid::to_str(this->min()) + _unit
+    + " mean=" + sid::to_str(static_cast<uint64_t>(this->mean() + 0.5)) + _unit
+    + " p50=" + sid::to_str(percentile(50)) + _unit
+    + " p90=" + sid::to_str(percentile(90)) + _unit
+    + " p99=" + sid::to_str(percentile(99)) + _unit
+    + " p99.9=" + sid::to_str(percentile(99.9)) + _unit
+    + " max=" + sid::to_str(m_max) + _unit;
+}
@@ -131,6 +131,8 @@ void json::parser_stats::clear()
   nulls = 0;
   keys = 0;
   time_ms = 0;
+  memory = 0;
+  allocations = 0;
 }
 
 std::string json::parser_stats::to_str() const
@@ -145,6 +147,8 @@ std::string json::parser_stats::to_str() const
       << "(keys)........: " << sid::get_sep(keys) << endl
       << "(time taken)..: " << sid::get_sep(time_ms/1000) << "." << std::setfill('0') << std::setw(3) << (time_ms % 1000) << " seconds" << endl
     ;
+  if ( allocations != 0 )
+    out << "(memory)......: " << sid::get_sep(memory) << " bytes in " << sid::get_sep(allocations) << " allocations" << endl;
   return out.str();
 }
 
@@ -343,23 +347,20 @@ bool json::value::has_index(const size_t _index) const
 
 bool json::value::has_key(const std::string& _key) const
 {
-  json::value jval;
-  return has_key(_key, jval);
+  if ( ! is_object() )
+    throw sid::exception(__func__ + std::string("() can be used only for object type"));
+  return m_data.map().find(_key) != m_data.map().end();
 }
 
 bool json::value::has_key(const std::string& _key, value& _obj) const
 {
   if ( ! is_object() )
     throw sid::exception(__func__ + std::string("() can be used only for object type"));
-  for ( const auto& entry : m_data.map() )
-  {
-    if ( entry.first == _key )
-    {
-      _obj = entry.second;
-      return true;
-    }
-  }
-  return false;
+  const auto it = m_data.map().find(_key);
+  if ( it == m_data.map().end() )
+    return false;
+  _obj = it->second;
+  return true;
 }
 
 std::vector<std::string> json::value::get_keys() const
@@ -635,8 +636,8 @@ const json::value& json::value::operator[](const std::string& _key) const
 {
   if ( ! is_object() )
     throw sid::exception(__func__ + std::string(": can be used only for object type"));
-  for ( const auto& entry : m_data.map() )
-    if ( entry.first == _key ) return entry.second;
+  const auto it = m_data.map().find(_key);
+  if ( it != m_data.map().end() ) return it->second;
   throw sid::exception(__func__ + std::string(": key(") + _key + ") not found");
 }
 
@@ -1029,8 +1030,10 @@ void json::parser::parse_object(json::value& _jobj)
     if ( *m_p == '}' ) { ++m_p; break; }
 
     parse_key(m_key);
-    // Check whether this key already exists in the object map
-    bool isDuplicateKey = _jobj.has_key(m_key);
+    // Check whether this key already exists in the object map. The position found is used to insert a new key.
+    json::value::object& jmap = _jobj.m_data.map();
+    auto it = jmap.lower_bound(m_key);
+    bool isDuplicateKey = ( it != jmap.end() && it->first == m_key );
     if ( isDuplicateKey )
     {
       // Handle duplicate key scenario
@@ -1046,13 +1049,13 @@ void json::parser::parse_object(json::value& _jobj)
     REMOVE_LEADING_SPACES(m_p);
     if ( ! isDuplicateKey )
     {
-      parse_value(_jobj[m_key]);
+      parse_value(jmap.emplace_hint(it, m_key, json::value())->second);
     }
     // Handle duplicate key based on the input mode
     else if ( m_ctrl.dupKey == parser_control::dup_key::accept )
     {
       // Accept the value and overwrite it
-      parse_value(_jobj[m_key]);
+      parse_value(it->second);
     }
     else if ( m_ctrl.dupKey == parser_control::dup_key::ignore )
     {
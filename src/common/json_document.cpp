@@ -0,0 +1,686 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@file json_document.cpp
+@brief Json handling using c++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file  json_document.cpp
+ * @brief Implementation of the arena based json document
+ */
+#include <common/json_document.hpp>
+#include <common/json_stream.hpp>
+#include <common/convert.hpp>
+#include <cstring>
+#include <cstddef>
+#include <sstream>
+#include <unordered_map>
+
+using namespace sid;
+
+//! FNV-1a hash of the key
+static inline uint32_t key_hash(const char* _key, size_t _len)
+{
+  uint32_t hash = 2166136261u;
+  for ( size_t i = 0; i < _len; i++ )
+    hash = (hash ^ static_cast<uint8_t>(_key[i])) * 16777619u;
+  return hash;
+}
+
+//! Number of slots in the index of an object (a power of 2, at most half full)
+static inline size_t index_capacity(size_t _count)
+{
+  size_t capacity = 1;
+  while ( capacity < 2 * _count )
+    capacity <<= 1;
+  return capacity;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of json::node
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t json::node::size() const
+{
+  if ( is_array() || is_object() )
+    return m_size;
+  throw sid::exception(__func__ + std::string("() can be used only for array and object types"));
+}
+
+const json::node& json::node::operator[](const size_t _index) const
+{
+  if ( ! is_array() )
+    throw sid::exception(__func__ + std::string(": can be used only for array type"));
+  if ( _index >= m_size )
+    throw sid::exception(__func__ + std::string(": index(") + sid::to_str(_index) + ") out of range(" + sid::to_str(m_size) + ")");
+  return m_arr[_index];
+}
+
+const json::node& json::node::operator[](const std::string& _key) const
+{
+  const node* jval = find(_key);
+  if ( jval == nullptr )
+    throw sid::exception(__func__ + std::string(": key(") + _key + ") not found");
+  return *jval;
+}
+
+const json::member& json::node::member(const size_t _index) const
+{
+  if ( ! is_object() )
+    throw sid::exception(__func__ + std::string(": can be used only for object type"));
+  if ( _index >= m_size )
+    throw sid::exception(__func__ + std::string(": index(") + sid::to_str(_index) + ") out of range(" + sid::to_str(m_size) + ")");
+  return m_members[_index];
+}
+
+const uint32_t* json::node::p_index() const
+{
+  // The index follows the members
+  return reinterpret_cast<const uint32_t*>(m_members + m_size);
+}
+
+const json::node* json::node::find(const char* _key, size_t _len) const
+{
+  if ( ! is_object() )
+    throw sid::exception(__func__ + std::string("() can be used only for object type"));
+  if ( m_size < index_threshold )
+  {
+    for ( uint32_t i = 0; i < m_size; i++ )
+    {
+      const json::member& entry = m_members[i];
+      if ( entry.key->length == _len && ::memcmp(entry.key->str, _key, _len) == 0 )
+        return &entry.value;
+    }
+    return nullptr;
+  }
+  const uint32_t hash = key_hash(_key, _len);
+  const uint32_t* index = p_index();
+  const size_t mask = index_capacity(m_size) - 1;
+  for ( size_t slot = hash & mask; index[slot] != 0; slot = (slot + 1) & mask )
+  {
+    const json::member& entry = m_members[index[slot] - 1];
+    if ( entry.key->hash == hash && entry.key->length == _len && ::memcmp(entry.key->str, _key, _len) == 0 )
+      return &entry.value;
+  }
+  return nullptr;
+}
+
+int64_t json::node::get_int64() const
+{
+  if ( is_signed() )
+    return m_i64;
+  if ( is_unsigned() )
+    return static_cast<int64_t>(m_u64);
+  if ( is_double() )
+    return static_cast<int64_t>(*m_dbl);
+  throw sid::exception(__func__ + std::string("() can be used only for number type"));
+}
+
+uint64_t json::node::get_uint64() const
+{
+  if ( is_unsigned() )
+    return m_u64;
+  if ( is_signed() )
+    return static_cast<uint64_t>(m_i64);
+  if ( is_double() )
+    return static_cast<uint64_t>(*m_dbl);
+  throw sid::exception(__func__ + std::string("() can be used only for number type"));
+}
+
+long double json::node::get_double() const
+{
+  if ( is_double() )
+    return *m_dbl;
+  if ( is_signed() )
+    return static_cast<long double>(m_i64);
+  if ( is_unsigned() )
+    return static_cast<long double>(m_u64);
+  throw sid::exception(__func__ + std::string("() can be used only for number type"));
+}
+
+bool json::node::get_bool() const
+{
+  if ( is_bool() )
+    return m_bval;
+  throw sid::exception(__func__ + std::string("() can be used only for boolean type"));
+}
+
+std::string json::node::get_str() const
+{
+  if ( is_string() )
+    return std::string(m_str, m_size);
+  throw sid::exception(__func__ + std::string("() can be used only for string type"));
+}
+
+const char* json::node::c_str() const
+{
+  if ( is_string() )
+    return m_str;
+  throw sid::exception(__func__ + std::string("() can be used only for string type"));
+}
+
+size_t json::node::length() const
+{
+  if ( is_string() )
+    return m_size;
+  throw sid::exception(__func__ + std::string("() can be used only for string type"));
+}
+
+std::string json::node::as_str() const
+{
+  if ( is_string() )
+    return std::string(m_str, m_size);
+  else if ( is_bool() )
+    return sid::to_str(m_bval);
+  else if ( is_signed() )
+    return sid::to_str(m_i64);
+  else if ( is_unsigned() )
+    return sid::to_str(m_u64);
+  else if ( is_double() )
+    return sid::to_str(*m_dbl);
+  throw sid::exception(__func__ + std::string("() can be used only for string, number or boolean types"));
+}
+
+int json::node::get_value(bool& _val) const
+{
+  if ( is_null() )
+    return -1;
+  _val = get_bool();
+  return 1;
+}
+
+int json::node::get_value(std::string& _val) const
+{
+  if ( is_null() )
+    return -1;
+  _val = as_str();
+  return 1;
+}
+
+json::value json::node::to_value() const
+{
+  json::value jout;
+  p_to_value(jout);
+  return jout;
+}
+
+void json::node::p_to_value(json::value& _jout) const
+{
+  switch ( m_type )
+  {
+  case json::element::null:      _jout.clear(); break;
+  case json::element::string:    _jout = std::string(m_str, m_size); break;
+  case json::element::_signed:   _jout = m_i64; break;
+  case json::element::_unsigned: _jout = m_u64; break;
+  case json::element::_double:   _jout = *m_dbl; break;
+  case json::element::boolean:   _jout = m_bval; break;
+  case json::element::array:
+    _jout = json::value(json::element::array);
+    for ( uint32_t i = 0; i < m_size; i++ )
+      m_arr[i].p_to_value(_jout.append());
+    break;
+  case json::element::object:
+    _jout = json::value(json::element::object);
+    for ( uint32_t i = 0; i < m_size; i++ )
+      m_members[i].value.p_to_value(_jout[std::string(m_members[i].key->str, m_members[i].key->length)]);
+    break;
+  }
+}
+
+std::string json::node::to_str() const
+{
+  std::ostringstream out;
+  write(out);
+  return out.str();
+}
+
+void json::node::write(std::ostream& _out) const
+{
+  if ( ! is_object() && ! is_array() )
+    throw sid::exception("Can be applied only on a object or array");
+  p_write(_out);
+}
+
+void json::node::p_write(std::ostream& _out) const
+{
+  // Same escapes as json::value
+  auto write_string = [&](const char* _str, size_t _len)
+    {
+      _out << '\"';
+      size_t start = 0;
+      for ( size_t i = 0; i < _len; i++ )
+      {
+        const char* escape = nullptr;
+        switch ( _str[i] )
+        {
+        case '\b': escape = "\\b";  break;
+        case '\f': escape = "\\f";  break;
+        case '\n': escape = "\\n";  break;
+        case '\r': escape = "\\r";  break;
+        case '\t': escape = "\\t";  break;
+        case '\\': escape = "\\\\"; break;
+        case '\"': escape = "\\\""; break;
+        default: continue;
+        }
+        _out.write(_str + start, i - start);
+        _out << escape;
+        start = i + 1;
+      }
+      _out.write(_str + start, _len - start);
+      _out << '\"';
+    };
+
+  switch ( m_type )
+  {
+  case json::element::object:
+    _out << '{';
+    for ( uint32_t i = 0; i < m_size; i++ )
+    {
+      if ( i != 0 ) _out << ',';
+      write_string(m_members[i].key->str, m_members[i].key->length);
+      _out << ':';
+      m_members[i].value.p_write(_out);
+    }
+    _out << '}';
+    break;
+  case json::element::array:
+    _out << '[';
+    for ( uint32_t i = 0; i < m_size; i++ )
+    {
+      if ( i != 0 ) _out << ',';
+      m_arr[i].p_write(_out);
+    }
+    _out << ']';
+    break;
+  case json::element::string:
+    write_string(m_str, m_size);
+    break;
+  case json::element::null:
+    _out << "null";
+    break;
+  default:
+    _out << as_str();
+    break;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of json::document::builder
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * @class builder
+ * @brief Builds the document from the events of the stream_parser. The values of the open containers are kept in
+ *        m_children, and copied into the arena as one array when the container ends.
+ */
+class json::document::builder : public json::handler
+{
+public:
+  builder(sid::arena& _arena, parser_control::dup_key _dupKey)
+    : m_arena(_arena), m_dupKey(_dupKey), m_depth(0), m_isSkipping(false), m_skipDepth(0), m_keyCount(0)
+  {
+    m_keys.resize(256, nullptr);
+  }
+
+  const json::node& root() const { return m_root; }
+
+  bool start_object() override { return p_start(true); }
+  bool start_array() override { return p_start(false); }
+  bool end_object() override;
+  bool end_array() override;
+  bool key(const std::string& _key) override;
+  bool string(const std::string& _value) override;
+  bool number_signed(int64_t _value) override { json::node n; n.m_type = json::element::_signed; n.m_i64 = _value; return p_add(n); }
+  bool number_unsigned(uint64_t _value) override { json::node n; n.m_type = json::element::_unsigned; n.m_u64 = _value; return p_add(n); }
+  bool number_double(long double _value) override;
+  bool boolean(bool _value) override { json::node n; n.m_type = json::element::boolean; n.m_bval = _value; return p_add(n); }
+  bool null() override { return p_add(json::node()); }
+
+private:
+  struct frame
+  {
+    size_t          start;    //! Position of the first value in m_children
+    bool            isObject;
+    const key_data* key;      //! Key of the value being parsed
+    size_t          dupIndex; //! Member with the same key, std::string::npos if the key is new
+    bool            hasKeys;  //! Whether keys is in use (for large objects)
+    std::unordered_map<const key_data*, size_t> keys;  //! Position of the members by key
+    std::vector<std::pair<size_t, json::node>> appended; //! Values of duplicate keys with dup_key::append
+  };
+
+  bool p_start(bool _isObject);
+  bool p_add(const json::node& _node);
+  const key_data* p_intern(const std::string& _key);
+  size_t p_find(frame& _frame, const key_data* _key);
+  void p_append_duplicates(frame& _frame);
+  uint32_t p_size(size_t _size) const;
+
+private:
+  sid::arena&                  m_arena;
+  parser_control::dup_key      m_dupKey;
+  json::node                   m_root;
+  std::vector<frame>           m_frames;     //! Open containers (reused), m_depth of them in use
+  size_t                       m_depth;
+  std::vector<json::member>    m_children;   //! Values of the open containers. key is nullptr for arrays.
+  bool                         m_isSkipping; //! Skipping the value of a duplicate key (dup_key::ignore)
+  size_t                       m_skipDepth;
+  std::vector<const key_data*> m_keys;       //! Interned keys (open addressing)
+  size_t                       m_keyCount;
+};
+
+uint32_t json::document::builder::p_size(size_t _size) const
+{
+  if ( _size > UINT32_MAX )
+    throw sid::exception("Size " + sid::to_str(_size) + " is too large for json::document");
+  return static_cast<uint32_t>(_size);
+}
+
+const json::key_data* json::document::builder::p_intern(const std::string& _key)
+{
+  const uint32_t hash = key_hash(_key.data(), _key.length());
+  if ( 2 * (m_keyCount + 1) > m_keys.size() )
+  {
+    // Double the table
+    std::vector<const key_data*> keys(2 * m_keys.size(), nullptr);
+    const size_t mask = keys.size() - 1;
+    for ( const key_data* key : m_keys )
+    {
+      if ( key == nullptr ) continue;
+      size_t slot = key->hash & mask;
+      while ( keys[slot] != nullptr )
+        slot = (slot + 1) & mask;
+      keys[slot] = key;
+    }
+    m_keys.swap(keys);
+  }
+  const size_t mask = m_keys.size() - 1;
+  size_t slot = hash & mask;
+  for ( ; m_keys[slot] != nullptr; slot = (slot + 1) & mask )
+  {
+    const key_data* key = m_keys[slot];
+    if ( key->hash == hash && key->length == _key.length() && ::memcmp(key->str, _key.data(), _key.length()) == 0 )
+      return key;
+  }
+  key_data* key = static_cast<key_data*>(m_arena.allocate(offsetof(key_data, str) + _key.length() + 1, alignof(key_data)));
+  key->hash = hash;
+  key->length = p_size(_key.length());
+  ::memcpy(key->str, _key.data(), _key.length());
+  key->str[_key.length()] = '\0';
+  m_keys[slot] = key;
+  ++m_keyCount;
+  return key;
+}
+
+size_t json::document::builder::p_find(frame& _frame, const key_data* _key)
+{
+  // Interned keys are compared by their address
+  const size_t count = m_children.size() - _frame.start;
+  if ( count < json::node::index_threshold )
+  {
+    for ( size_t i = 0; i < count; i++ )
+      if ( m_children[_frame.start + i].key == _key )
+        return i;
+    return std::string::npos;
+  }
+  if ( ! _frame.hasKeys )
+  {
+    for ( size_t i = 0; i < count; i++ )
+      _frame.keys.emplace(m_children[_frame.start + i].key, i);
+    _frame.hasKeys = true;
+  }
+  const auto it = _frame.keys.find(_key);
+  return ( it != _frame.keys.end() )? it->second : std::string::npos;
+}
+
+bool json::document::builder::p_start(bool _isObject)
+{
+  if ( m_isSkipping )
+  {
+    ++m_skipDepth;
+    return true;
+  }
+  if ( m_depth == m_frames.size() )
+    m_frames.emplace_back();
+  frame& f = m_frames[m_depth++];
+  f.start = m_children.size();
+  f.isObject = _isObject;
+  f.key = nullptr;
+  f.dupIndex = std::string::npos;
+  if ( f.hasKeys )
+  {
+    f.keys.clear();
+    f.hasKeys = false;
+  }
+  f.appended.clear();
+  return true;
+}
+
+bool json::document::builder::p_add(const json::node& _node)
+{
+  if ( m_isSkipping )
+  {
+    // The skipped value is complete
+    if ( m_skipDepth == 0 )
+      m_isSkipping = false;
+    return true;
+  }
+  if ( m_depth == 0 )
+  {
+    m_root = _node;
+    return true;
+  }
+  frame& f = m_frames[m_depth-1];
+  if ( ! f.isObject )
+    m_children.push_back(json::member{nullptr, _node});
+  else if ( f.dupIndex == std::string::npos )
+  {
+    if ( f.hasKeys )
+      f.keys.emplace(f.key, m_children.size() - f.start);
+    m_children.push_back(json::member{f.key, _node});
+  }
+  else if ( m_dupKey == parser_control::dup_key::append )
+    f.appended.emplace_back(f.dupIndex, _node);
+  else
+    m_children[f.start + f.dupIndex].value = _node;
+  return true;
+}
+
+bool json::document::builder::key(const std::string& _key)
+{
+  if ( m_isSkipping )
+    return true;
+  frame& f = m_frames[m_depth-1];
+  f.key = p_intern(_key);
+  f.dupIndex = p_find(f, f.key);
+  if ( f.dupIndex != std::string::npos )
+  {
+    if ( m_dupKey == parser_control::dup_key::reject )
+      throw sid::exception("Duplicate key \"" + _key + "\" encountered");
+    if ( m_dupKey == parser_control::dup_key::ignore )
+    {
+      // Keep the first value and skip this one
+      m_isSkipping = true;
+      m_skipDepth = 0;
+    }
+  }
+  return true;
+}
+
+void json::document::builder::p_append_duplicates(frame& _frame)
+{
+  // As in json::value::parse(), the values of a key are gathered in an array. If the first value is an array,
+  // the others are added to it.
+  std::vector<json::node> values;
+  for ( size_t i = 0; i < _frame.appended.size(); i++ )
+  {
+    const size_t index = _frame.appended[i].first;
+    if ( index == std::string::npos ) continue;
+    json::node& jval = m_children[_frame.start + index].value;
+    values.clear();
+    if ( jval.is_array() )
+      values.insert(values.end(), jval.m_arr, jval.m_arr + jval.m_size);
+    else
+      values.push_back(jval);
+    for ( size_t j = i; j < _frame.appended.size(); j++ )
+    {
+      if ( _frame.appended[j].first != index ) continue;
+      values.push_back(_frame.appended[j].second);
+      _frame.appended[j].first = std::string::npos;
+    }
+    json::node* arr = m_arena.allocate<json::node>(values.size());
+    std::copy(values.begin(), values.end(), arr);
+    jval.m_type = json::element::array;
+    jval.m_size = p_size(values.size());
+    jval.m_arr = arr;
+  }
+}
+
+bool json::document::builder::end_object()
+{
+  if ( m_isSkipping && m_skipDepth > 0 )
+  {
+    if ( --m_skipDepth == 0 )
+      m_isSkipping = false;
+    return true;
+  }
+  frame& f = m_frames[m_depth-1];
+  if ( ! f.appended.empty() )
+    p_append_duplicates(f);
+  const size_t count = m_children.size() - f.start;
+  const size_t capacity = ( count >= json::node::index_threshold )? index_capacity(count) : 0;
+  json::member* members = static_cast<json::member*>(m_arena.allocate(count * sizeof(json::member) + capacity * sizeof(uint32_t), alignof(json::member)));
+  std::copy(m_children.begin() + f.start, m_children.end(), members);
+  if ( capacity != 0 )
+  {
+    // Slots hold the position of the member + 1, and 0 when they are empty
+    uint32_t* index = reinterpret_cast<uint32_t*>(members + count);
+    ::memset(index, 0, capacity * sizeof(uint32_t));
+    const size_t mask = capacity - 1;
+    for ( size_t i = 0; i < count; i++ )
+    {
+      size_t slot = members[i].key->hash & mask;
+      while ( index[slot] != 0 )
+        slot = (slot + 1) & mask;
+      index[slot] = static_cast<uint32_t>(i + 1);
+    }
+  }
+  json::node n;
+  n.m_type = json::element::object;
+  n.m_size = p_size(count);
+  n.m_members = members;
+  m_children.resize(f.start);
+  --m_depth;
+  return p_add(n);
+}
+
+bool json::document::builder::end_array()
+{
+  if ( m_isSkipping && m_skipDepth > 0 )
+  {
+    if ( --m_skipDepth == 0 )
+      m_isSkipping = false;
+    return true;
+  }
+  frame& f = m_frames[m_depth-1];
+  const size_t count = m_children.size() - f.start;
+  json::node* arr = m_arena.allocate<json::node>(count);
+  for ( size_t i = 0; i < count; i++ )
+    arr[i] = m_children[f.start + i].value;
+  json::node n;
+  n.m_type = json::element::array;
+  n.m_size = p_size(count);
+  n.m_arr = arr;
+  m_children.resize(f.start);
+  --m_depth;
+  return p_add(n);
+}
+
+bool json::document::builder::string(const std::string& _value)
+{
+  if ( m_isSkipping )
+    return p_add(json::node());
+  json::node n;
+  n.m_type = json::element::string;
+  n.m_size = p_size(_value.length());
+  n.m_str = m_arena.copy(_value.data(), _value.length());
+  return p_add(n);
+}
+
+bool json::document::builder::number_double(long double _value)
+{
+  if ( m_isSkipping )
+    return p_add(json::node());
+  long double* dbl = m_arena.allocate<long double>(1);
+  *dbl = _value;
+  json::node n;
+  n.m_type = json::element::_double;
+  n.m_dbl = dbl;
+  return p_add(n);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of json::document
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool json::document::parse(const std::string& _value, const parser_control& _ctrl/* = parser_control()*/)
+{
+  json::parser_stats stats;
+  return parse(stats, _value, _ctrl);
+}
+
+bool json::document::parse(parser_stats& _stats, const std::string& _value, const parser_control& _ctrl/* = parser_control()*/)
+{
+  clear();
+  builder jbuilder(m_arena, _ctrl.dupKey);
+  // Duplicate keys are handled by the builder, which compares the interned keys
+  parser_control ctrl = _ctrl;
+  ctrl.dupKey = parser_control::dup_key::accept;
+  json::stream_parser jparser(jbuilder, ctrl);
+  try
+  {
+    jparser.parse(_value);
+    jparser.finish();
+  }
+  catch (...)
+  {
+    _stats = jparser.stats();
+    clear();
+    throw;
+  }
+  m_root = jbuilder.root();
+  _stats = jparser.stats();
+  _stats.memory = m_arena.reserved();
+  _stats.allocations = m_arena.blocks();
+  return true;
+}
@@ -0,0 +1,615 @@
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@file json_stream.cpp
+@brief Json handling using c++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+/**
+ * @file  json_stream.cpp
+ * @brief Implementation of the event based json parser
+ */
+#include <common/json_stream.hpp>
+#include <common/convert.hpp>
+#include <chrono>
+#include <cstring>
+
+using namespace sid;
+
+//! Append the code point as UTF-8
+static void append_utf8(std::string& _out, uint32_t _cp)
+{
+  if ( _cp < 0x80 )
+    _out += static_cast<char>(_cp);
+  else if ( _cp < 0x800 )
+  {
+    _out += static_cast<char>(0xC0 | (_cp >> 6));
+    _out += static_cast<char>(0x80 | (_cp & 0x3F));
+  }
+  else if ( _cp < 0x10000 )
+  {
+    _out += static_cast<char>(0xE0 | (_cp >> 12));
+    _out += static_cast<char>(0x80 | ((_cp >> 6) & 0x3F));
+    _out += static_cast<char>(0x80 | (_cp & 0x3F));
+  }
+  else
+  {
+    _out += static_cast<char>(0xF0 | (_cp >> 18));
+    _out += static_cast<char>(0x80 | ((_cp >> 12) & 0x3F));
+    _out += static_cast<char>(0x80 | ((_cp >> 6) & 0x3F));
+    _out += static_cast<char>(0x80 | (_cp & 0x3F));
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of json::stream_parser
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+json::stream_parser::stream_parser(json::handler& _handler, const parser_control& _ctrl/* = parser_control()*/)
+  : m_handler(_handler), m_ctrl(_ctrl)
+{
+  reset();
+}
+
+void json::stream_parser::reset()
+{
+  m_stats.clear();
+  m_state = m_returnState = state::start;
+  m_isKey = m_isNumber = m_isEscape = m_hasEscape = false;
+  m_isStopped = m_isIgnoring = false;
+  m_ignoreLevel = 0;
+  m_line = 1;
+  m_pos = 0;
+  m_commentLine = m_commentPos = 0;
+  m_timeUs = 0;
+  m_buffer.clear();
+  m_value.clear();
+  m_stack.clear();
+  m_keys.clear();
+}
+
+std::string json::stream_parser::loc_str() const
+{
+  return std::string("@line:") + sid::to_str(m_line) + ", @pos:" + sid::to_str(m_pos);
+}
+
+bool json::stream_parser::parse(const char* _data, size_t _len)
+{
+  if ( m_isStopped )
+    return false;
+
+  auto start = std::chrono::steady_clock::now();
+  auto update_time = [&]()
+    {
+      m_timeUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      m_stats.time_ms = m_timeUs / 1000;
+    };
+  try
+  {
+    const char* p = _data;
+    const char* end = _data + _len;
+    while ( p < end && ! m_isStopped )
+    {
+      if ( m_state == state::string && ! m_isEscape )
+      {
+        // Copy the characters of the string up to the next one that needs attention
+        const char* q = p;
+        while ( q < end && *q != '\"' && *q != '\\' && *q != '\n' )
+          ++q;
+        m_buffer.append(p, q - p);
+        m_pos += q - p;
+        if ( (p = q) == end ) break;
+      }
+      const char ch = *p++;
+      ++m_pos;
+      p_char(ch);
+      if ( ch == '\n' )
+      {
+        ++m_line;
+        m_pos = 0;
+      }
+    }
+  }
+  catch (...)
+  {
+    update_time();
+    throw;
+  }
+  update_time();
+  return ! m_isStopped;
+}
+
+bool json::stream_parser::finish()
+{
+  if ( m_isStopped )
+    return false;
+  const state current = ( m_state == state::line_comment )? m_returnState : m_state;
+  if ( current == state::block_comment || current == state::block_comment_end )
+    throw sid::exception("Comments starting @line:" + sid::to_str(m_commentLine) + ", @pos:" + sid::to_str(m_commentPos) + " is not closed");
+  if ( current == state::start )
+    throw sid::exception("End of data reached " + loc_str() + ". Expecting { or [");
+  if ( current == state::comment_start )
+    throw sid::exception("Invalid character [/] " + loc_str());
+  if ( current != state::done )
+    throw sid::exception("Unexpected end of data " + loc_str() + " with " + sid::to_str(m_stack.size()) + " open object(s) or array(s)");
+  return true;
+}
+
+void json::stream_parser::p_char(char _ch)
+{
+  switch ( m_state )
+  {
+  case state::string:
+    if ( m_isEscape )
+      m_isEscape = false;
+    else if ( _ch == '\\' )
+      m_isEscape = m_hasEscape = true;
+    else if ( _ch == '\"' )
+      return p_string_end();
+    m_buffer += _ch;
+    return;
+
+  case state::token:
+    if ( m_isNumber )
+    {
+      // The number ends at the first character that cannot be a part of it
+      if ( ::isdigit(_ch) || _ch == '.' || _ch == 'e' || _ch == 'E' || _ch == '+' || _ch == '-' )
+      {
+        m_buffer += _ch;
+        return;
+      }
+    }
+    else if ( m_isEscape )
+    {
+      m_isEscape = false;
+      m_buffer += _ch;
+      return;
+    }
+    else if ( _ch == '\\' )
+    {
+      m_isEscape = m_hasEscape = true;
+      m_buffer += _ch;
+      return;
+    }
+    // A key ends with a space or :, a value with a space, a , or the end of the container
+    else if ( ! ::isspace(_ch) && ( m_isKey? _ch != ':' : ( _ch != ',' && _ch != (m_stack.back() == '{'? '}' : ']') ) ) )
+    {
+      m_buffer += _ch;
+      return;
+    }
+    p_token_end();
+    // The character that ended the token is processed in the next state
+    if ( ! m_isStopped )
+      p_char(_ch);
+    return;
+
+  case state::line_comment:
+    if ( _ch == '\n' )
+      m_state = m_returnState;
+    return;
+
+  case state::block_comment:
+    if ( _ch == '*' )
+      m_state = state::block_comment_end;
+    return;
+
+  case state::block_comment_end:
+    if ( _ch == '/' )
+      m_state = m_returnState;
+    else if ( _ch != '*' )
+      m_state = state::block_comment;
+    return;
+
+  case state::comment_start:
+    if ( _ch == '/' )
+      m_state = state::line_comment;
+    else if ( _ch == '*' )
+    {
+      m_commentLine = m_line;
+      m_commentPos = m_pos - 1;
+      m_state = state::block_comment;
+    }
+    else if ( m_returnState == state::value || ( m_returnState == state::key && m_ctrl.mode.allowFlexibleKeys ) )
+    {
+      // Not a comment. It is the beginning of a value or a key that is not quoted.
+      m_isKey = ( m_returnState == state::key );
+      m_isNumber = m_isEscape = m_hasEscape = false;
+      m_buffer.assign(1, '/');
+      m_state = state::token;
+      p_char(_ch);
+    }
+    else
+      throw sid::exception("Invalid character [/] " + loc_str());
+    return;
+
+  default:
+    break;
+  }
+
+  // Spaces and comments can be between the tokens
+  if ( ::isspace(_ch) )
+    return;
+  if ( _ch == '/' )
+  {
+    m_returnState = m_state;
+    m_state = state::comment_start;
+    return;
+  }
+
+  switch ( m_state )
+  {
+  case state::start:
+    if ( _ch != '{' && _ch != '[' )
+      throw sid::exception(std::string("Invalid character [") + _ch + "] " + loc_str() + ". Expecting { or [");
+    return p_start_container(_ch);
+
+  case state::done:
+    throw sid::exception(std::string("Invalid character [") + _ch + "] " + loc_str() + " after the end of the document");
+
+  case state::value:
+    if ( _ch == '{' || _ch == '[' )
+      return p_start_container(_ch);
+    // An array can be empty or end with a ,
+    if ( _ch == ']' && m_stack.back() == '[' )
+      return p_end_container(_ch);
+    if ( _ch == ',' || _ch == '}' || _ch == ']' )
+      throw sid::exception("Expected value not found " + loc_str());
+    m_isKey = m_isEscape = m_hasEscape = false;
+    m_buffer.clear();
+    if ( _ch == '\"' )
+    {
+      m_state = state::string;
+      return;
+    }
+    // A number, true, false, null or an unquoted string
+    m_isNumber = ( _ch == '-' || ::isdigit(_ch) );
+    m_state = state::token;
+    return p_char(_ch);
+
+  case state::key:
+    // An object can be empty or end with a ,
+    if ( _ch == '}' )
+      return p_end_container(_ch);
+    m_isKey = true;
+    m_isNumber = m_isEscape = m_hasEscape = false;
+    m_buffer.clear();
+    if ( _ch == '\"' )
+    {
+      m_state = state::string;
+      return;
+    }
+    if ( ! m_ctrl.mode.allowFlexibleKeys )
+      throw sid::exception("Expected \" " + loc_str() + ", found \"" + std::string(1, _ch) + "\"");
+    m_state = state::token;
+    return p_char(_ch);
+
+  case state::colon:
+    if ( _ch != ':' )
+      throw sid::exception("Expected : " + loc_str());
+    m_state = state::value;
+    return;
+
+  case state::next:
+    if ( _ch == ',' )
+    {
+      m_state = ( m_stack.back() == '{' )? state::key : state::value;
+      return;
+    }
+    if ( _ch == (m_stack.back() == '{'? '}' : ']') )
+      return p_end_container(_ch);
+    throw sid::exception("Encountered " + std::string(1, _ch) + ". Expected , or " + std::string(1, m_stack.back() == '{'? '}' : ']') + " " + loc_str());
+
+  default:
+    break;
+  }
+}
+
+void json::stream_parser::p_start_container(char _ch)
+{
+  const bool isObject = ( _ch == '{' );
+  if ( isObject )
+    m_stats.objects++;
+  else
+    m_stats.arrays++;
+  if ( ! m_isIgnoring )
+    p_check(isObject? m_handler.start_object() : m_handler.start_array());
+  m_stack.push_back(_ch);
+  if ( isObject && ( m_ctrl.dupKey == parser_control::dup_key::reject || m_ctrl.dupKey == parser_control::dup_key::ignore ) )
+    m_keys.emplace_back();
+  m_state = isObject? state::key : state::value;
+}
+
+void json::stream_parser::p_end_container(char _ch)
+{
+  m_stack.pop_back();
+  if ( _ch == '}' && ( m_ctrl.dupKey == parser_control::dup_key::reject || m_ctrl.dupKey == parser_control::dup_key::ignore ) )
+    m_keys.pop_back();
+  if ( ! m_isIgnoring )
+    p_check(( _ch == '}' )? m_handler.end_object() : m_handler.end_array());
+  p_end_value();
+}
+
+void json::stream_parser::p_end_value()
+{
+  // The value of the duplicate key that was skipped is complete
+  if ( m_isIgnoring && m_stack.size() == m_ignoreLevel )
+    m_isIgnoring = false;
+  m_state = m_stack.empty()? state::done : state::next;
+}
+
+void json::stream_parser::p_key(const std::string& _key)
+{
+  m_stats.keys++;
+  m_state = state::colon;
+  if ( ! m_keys.empty() && ! m_keys.back().insert(_key).second )
+  {
+    if ( m_ctrl.dupKey == parser_control::dup_key::reject )
+      throw sid::exception("Duplicate key \"" + _key + "\" encountered");
+    // Skip the key and its value
+    if ( ! m_isIgnoring )
+    {
+      m_isIgnoring = true;
+      m_ignoreLevel = m_stack.size();
+    }
+    return;
+  }
+  if ( ! m_isIgnoring )
+    p_check(m_handler.key(_key));
+}
+
+void json::stream_parser::p_string_end()
+{
+  const std::string& str = p_decode(m_buffer);
+  if ( m_isKey )
+    return p_key(str);
+  m_stats.strings++;
+  if ( ! m_isIgnoring )
+    p_check(m_handler.string(str));
+  p_end_value();
+}
+
+void json::stream_parser::p_token_end()
+{
+  if ( m_isKey )
+    return p_key(p_decode(m_buffer));
+  if ( m_isNumber )
+  {
+    p_number(m_buffer);
+    return p_end_value();
+  }
+
+  // true, false and null (in any case with allowNocaseValues)
+  const std::string& token = m_buffer;
+  const bool isNocase = m_ctrl.mode.allowNocaseValues;
+  int literal = -1; // 0: false, 1: true, 2: null
+  if ( token == "null" || ( isNocase && (token == "Null" || token == "NULL") ) )
+    literal = 2;
+  else if ( token == "true" || ( isNocase && (token == "True" || token == "TRUE") ) )
+    literal = 1;
+  else if ( token == "false" || ( isNocase && (token == "False" || token == "FALSE") ) )
+    literal = 0;
+
+  if ( literal == 2 )
+  {
+    m_stats.nulls++;
+    if ( ! m_isIgnoring )
+      p_check(m_handler.null());
+  }
+  else if ( literal >= 0 )
+  {
+    m_stats.booleans++;
+    if ( ! m_isIgnoring )
+      p_check(m_handler.boolean(literal == 1));
+  }
+  else if ( m_ctrl.mode.allowFlexibleStrings )
+  {
+    const std::string& str = p_decode(m_buffer);
+    m_stats.strings++;
+    if ( ! m_isIgnoring )
+      p_check(m_handler.string(str));
+  }
+  else
+    throw sid::exception("Invalid value [" + token + "] " + loc_str() + ". Did you miss enclosing in \"\"?");
+  p_end_value();
+}
+
+void json::stream_parser::p_number(const std::string& _str)
+{
+  // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+  const size_t len = _str.length();
+  auto char_at = [&](size_t i)->std::string { return ( i < len )? _str.substr(i, 1) : std::string("end"); };
+  size_t i = 0;
+  const bool isNegative = ( _str[0] == '-' );
+  if ( isNegative )
+    ++i;
+  if ( i == len || ! ::isdigit(_str[i]) )
+    throw sid::exception("Missing integer digit " + loc_str());
+  if ( _str[i] == '0' )
+  {
+    if ( ++i < len && ::isdigit(_str[i]) )
+      throw sid::exception("Invalid digit (" + char_at(i) + ") after first 0 " + loc_str());
+  }
+  else
+    for ( ; i < len && ::isdigit(_str[i]); i++ );
+  bool isDouble = false;
+  if ( i < len && _str[i] == '.' )
+  {
+    size_t first = ++i;
+    for ( ; i < len && ::isdigit(_str[i]); i++ );
+    if ( i == first )
+      throw sid::exception("Invalid digit (" + char_at(i) + ") Expected a digit for fraction " + loc_str());
+    isDouble = true;
+  }
+  if ( i < len && (_str[i] == 'e' || _str[i] == 'E') )
+  {
+    if ( ++i < len && (_str[i] == '+' || _str[i] == '-') )
+      ++i;
+    size_t first = i;
+    for ( ; i < len && ::isdigit(_str[i]); i++ );
+    if ( i == first )
+      throw sid::exception("Invalid digit (" + char_at(i) + ") Expected a digit for exponent " + loc_str());
+    isDouble = true;
+  }
+  if ( i != len )
+    throw sid::exception("Invalid character " + char_at(i) + " in number [" + _str + "] " + loc_str());
+
+  m_stats.numbers++;
+  std::string errStr;
+  if ( isDouble )
+  {
+    long double v = 0;
+    if ( ! sid::to_num(_str, /*out*/ v, &errStr) )
+      throw sid::exception("Unable to convert (" + _str + ") to numeric " + loc_str() + ": " + errStr);
+    if ( ! m_isIgnoring )
+      p_check(m_handler.number_double(v));
+  }
+  else if ( isNegative )
+  {
+    int64_t v = 0;
+    if ( ! sid::to_num(_str, /*out*/ v, &errStr) )
+      throw sid::exception("Unable to convert (" + _str + ") to numeric " + loc_str() + ": " + errStr);
+    if ( ! m_isIgnoring )
+      p_check(m_handler.number_signed(v));
+  }
+  else
+  {
+    uint64_t v = 0;
+    if ( ! sid::to_num(_str, /*out*/ v, &errStr) )
+      throw sid::exception("Unable to convert (" + _str + ") to numeric " + loc_str() + ": " + errStr);
+    if ( ! m_isIgnoring )
+      p_check(m_handler.number_unsigned(v));
+  }
+}
+
+const std::string& json::stream_parser::p_decode(const std::string& _raw)
+{
+  // A quoted string cannot have a " that is not escaped, so this check is for the unquoted ones
+  if ( ! m_hasEscape )
+  {
+    if ( m_state == state::token && _raw.find('\"') != std::string::npos )
+      throw sid::exception("Character \" must be escaped " + loc_str());
+    return _raw;
+  }
+
+  auto hex_value = [&](size_t i)->uint32_t
+    {
+      if ( i >= _raw.length() )
+        throw sid::exception("Missing hexadecimal sequence characters at the end position " + loc_str());
+      const char ch = _raw[i];
+      if ( ! ::isxdigit(ch) )
+        throw sid::exception("Missing hexadecimal character at " + loc_str());
+      return ( ch <= '9' )? ch - '0' : ( ::tolower(ch) - 'a' + 10 );
+    };
+  auto code_point = [&](size_t i)->uint32_t
+    {
+      return (hex_value(i) << 12) | (hex_value(i+1) << 8) | (hex_value(i+2) << 4) | hex_value(i+3);
+    };
+
+  m_value.clear();
+  const size_t len = _raw.length();
+  for ( size_t i = 0; i < len; i++ )
+  {
+    // Copy the characters up to the next escape sequence as they are
+    size_t next = _raw.find('\\', i);
+    if ( next == std::string::npos )
+      next = len;
+    if ( m_state == state::token && _raw.find('\"', i) < next )
+      throw sid::exception("Character \" must be escaped " + loc_str());
+    m_value.append(_raw, i, next - i);
+    if ( (i = next) == len )
+      break;
+    if ( ++i == len )
+      throw sid::exception("Missing escape sequence characters at the end position " + loc_str());
+    const char ch = _raw[i];
+    switch ( ch )
+    {
+    case '/':  m_value += ch;   break;
+    case 'b':  m_value += '\b'; break;
+    case 'f':  m_value += '\f'; break;
+    case 'n':  m_value += '\n'; break;
+    case 'r':  m_value += '\r'; break;
+    case 't':  m_value += '\t'; break;
+    case '\\': m_value += ch;   break;
+    case '\"': m_value += ch;   break;
+    case 'u':
+    {
+      // \uXXXX is written as UTF-8. A surrogate pair (\uD8xx\uDCxx) is combined into one code point.
+      // A surrogate that is not part of a pair has no UTF-8 encoding.
+      uint32_t cp = code_point(i+1);
+      i += 4;
+      if ( cp >= 0xD800 && cp <= 0xDBFF )
+      {
+        const uint32_t low = ( i + 6 < len && _raw[i+1] == '\\' && _raw[i+2] == 'u' )? code_point(i+3) : 0;
+        if ( low < 0xDC00 || low > 0xDFFF )
+          throw sid::exception("Unpaired surrogate in the unicode escape sequence for string at " + loc_str());
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        i += 6;
+      }
+      else if ( cp >= 0xDC00 && cp <= 0xDFFF )
+        throw sid::exception("Unpaired surrogate in the unicode escape sequence for string at " + loc_str());
+      append_utf8(m_value, cp);
+    }
+    break;
+    default:
+      throw sid::exception("Invalid escape sequence (" + std::string(1, ch) + ") for string at " + loc_str());
+    }
+  }
+  return m_value;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of json::value_builder
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+json::value& json::value_builder::p_next()
+{
+  if ( m_stack.empty() )
+    return m_jroot;
+  json::value& jparent = *m_stack.back();
+  return jparent.is_array()? jparent.append() : jparent[m_key];
+}
+
+bool json::value_builder::start_object()
+{
+  json::value& jobj = p_next();
+  jobj = json::value(json::element::object);
+  m_stack.push_back(&jobj);
+  return true;
+}
+
+bool json::value_builder::start_array()
+{
+  json::value& jarr = p_next();
+  jarr = json::value(json::element::array);
+  m_stack.push_back(&jarr);
+  return true;
+}
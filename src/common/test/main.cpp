@@ -4,7 +4,12 @@
 #include <cstring>
 #include <vector>
 #include <limits>
+#include <functional>
+#include <chrono>
 #include <stdlib.h>
+#include <thread>
+#include <sstream>
+#include <malloc.h>
 #include "common/optional.hpp"
 #include "common/uuid.hpp"
 #include "common/json.hpp"
@@ -12,6 +17,12 @@
 #include "common/uuid.hpp"
 #include "common/regex.hpp"
 #include "common/simple_types.hpp"
+#include "common/hash.hpp"
+#include "common/hash_batch.hpp"
+#include "common/checksum.hpp"
+#include "common/json_stream.hpp"
+#include "common/json_document.hpp"
+#include "common/arena.hpp"
 
 using namespace std;
 using namespace sid;
@@ -221,9 +232,784 @@ void regex_test(const std::string& _infoStr)
   }
 }
 
+using FNTest = std::function<void(uint64_t)>;
+
+struct Test
+{
+  std::string name;
+  std::string description;
+  FNTest      fn;
+};
+
+//! Run the callback the given number of times and print the time taken per iteration
+static void benchmark(const std::string& _name, uint64_t _iterations, const std::function<void()>& _fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  for ( uint64_t i = 0; i < _iterations; i++ )
+    _fn();
+  auto end = std::chrono::steady_clock::now();
+  double nsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  cout << "  " << _name << ": " << sid::to_str(static_cast<uint64_t>(nsecs / _iterations)) << " ns/op" << endl;
+}
+
+void test_hash(uint64_t _iterations)
+{
+  struct algorithm
+  {
+    std::string             name;
+    sid::hash::md_algorithm md;
+    std::string             abc;   //! Hex digest of "abc"
+  };
+  const std::vector<algorithm> algorithms = {
+    { "md5", sid::hash::md5(), "900150983CD24FB0D6963F7D28E17F72" },
+    { "sha1", sid::hash::sha1(), "A9993E364706816ABA3E25717850C26C9CD0D89D" },
+    { "sha256", sid::hash::sha256(), "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD" },
+    { "sha512", sid::hash::sha512(), "DDAF35A193617ABACC417349AE20413112E6FA4E89A97EA20A9EEEE64B55D39A2192992A274FC1A836BA3C23A3FEEBBD"
+                                     "454D4423643CE80E2A9AC94FA54CA49F" },
+  };
+  std::string data(100000, '\0');
+  for ( size_t i = 0; i < data.length(); i++ )
+    data[i] = static_cast<char>(::rand());
+  const std::string key = "secret key";
+
+  // Known answers, and the same digest however the data is split
+  for ( const algorithm& algo : algorithms )
+  {
+    sid::hash::md_algorithm md = algo.md;
+    sid::hash::hasher h(md), hmac(md, key);
+    if ( h.update("a").update("bc").final().to_hex_str() != algo.abc )
+      throw sid::exception(algo.name + ": digest of \"abc\" does not match");
+    const std::string expected = md.get_hash(data).data(), expectedHmac = md.get_hmac(key, data).data();
+    for ( int round = 0; round < 20; round++ )
+    {
+      for ( size_t pos = 0, count = 0; pos < data.length(); pos += count )
+      {
+        count = std::min<size_t>(::rand() % 5000, data.length() - pos);
+        h.update(data.data() + pos, count);
+        hmac.update(data.data() + pos, count);
+      }
+      if ( h.length() != data.length() || h.final().data() != expected || hmac.final().data() != expectedHmac )
+        throw sid::exception(algo.name + ": incremental digest does not match the one-shot digest");
+    }
+    h.update("discarded");
+    h.reset();
+    if ( h.length() != 0 || h.final().data() != md.get_hash(std::string()).data() )
+      throw sid::exception(algo.name + ": reset() did not discard the data");
+  }
+  // RFC 4231 test case 2
+  sid::hash::hasher jefe(sid::hash::sha256(), "Jefe");
+  if ( jefe.update("what do ya want for nothing?").final().to_hex_str() != "5BDCC146BF60754E6A042426089575C75A003F089D2739839DEC58B964EC3843"
+       || jefe.type() != "HMAC-SHA256" || ! jefe.is_hmac() )
+    throw sid::exception("HMAC-SHA256 does not match RFC 4231");
+
+  // A copy carries on from where the original was, and hmac_key starts each HMAC from a copy of its keyed hasher
+  for ( const std::string& hmacKey : { key, std::string() } )
+  {
+    const std::string expected = sid::hash::sha256().get_hmac(hmacKey, data).data();
+    sid::hash::hasher original(sid::hash::sha256(), hmacKey);
+    original.update(data.substr(0, 1000));
+    sid::hash::hasher copy(original);
+    if ( copy.length() != 1000 || copy.update(data.substr(1000)).final().data() != expected
+         || original.update(data.substr(1000)).final().data() != expected )
+      throw sid::exception("Copy of an HMAC hasher does not match the one-shot HMAC");
+    const sid::hash::hmac_key hmacKeyed(sid::hash::sha256(), hmacKey);
+    for ( int round = 0; round < 2; round++ )
+      if ( hmacKeyed.get_hmac(data).data() != expected || copy.update(data).final().data() != expected )
+        throw sid::exception("hmac_key does not match the one-shot HMAC");
+  }
+
+  // Digest of a small payload, as done for the chunks of a streamed body
+  const std::string chunk = data.substr(0, 64);
+  std::string out;
+  cout << "hash: before (new context per digest) and after (reused contexts)" << endl;
+  benchmark("sha256 of 64 bytes before", _iterations, [&]()
+    {
+      EVP_MD_CTX* ctx = EVP_MD_CTX_create();
+      unsigned char md[EVP_MAX_MD_SIZE];
+      unsigned int mdLen = 0;
+      EVP_DigestInit_ex(ctx, EVP_get_digestbynid(NID_sha256), nullptr);
+      EVP_DigestUpdate(ctx, chunk.data(), chunk.length());
+      EVP_DigestFinal_ex(ctx, md, &mdLen);
+      EVP_MD_CTX_destroy(ctx);
+      out.assign(reinterpret_cast<const char*>(md), mdLen);
+    });
+  benchmark("sha256 of 64 bytes get_hash()", _iterations, [&]() { out = sid::hash::sha256().get_hash(chunk).data(); });
+  sid::hash::hasher h{sid::hash::sha256()};
+  benchmark("sha256 of 64 bytes hasher", _iterations, [&]() { out = h.update(chunk).final().data(); });
+  benchmark("hmac-sha256 of 64 bytes before", _iterations, [&]() { out = sid::hash::sha256().get_hmac(key, chunk).data(); });
+  sid::hash::hasher hmac(sid::hash::sha256(), key);
+  benchmark("hmac-sha256 of 64 bytes hasher", _iterations, [&]() { out = hmac.update(chunk).final().data(); });
+}
+
+void test_batch(uint64_t _iterations)
+{
+  // Lengths around the padding boundaries, and random ones
+  std::vector<std::string> buffers;
+  for ( size_t length : { 0, 1, 55, 56, 63, 64, 65, 119, 120, 127, 128, 1000, 4096 } )
+    buffers.push_back(std::string(length, static_cast<char>(length)));
+  for ( size_t i = 0; i < 200; i++ )
+  {
+    std::string buffer(::rand() % 20000, '\0');
+    for ( char& ch : buffer )
+      ch = static_cast<char>(::rand());
+    buffers.push_back(buffer);
+  }
+
+  const std::vector<sid::hash::md_algorithm> algorithms = { sid::hash::md5(), sid::hash::sha256(), sid::hash::sha1(), sid::hash::sha512() };
+  for ( sid::hash::md_algorithm md : algorithms )
+  {
+    std::vector<std::string> expected;
+    for ( const std::string& buffer : buffers )
+      expected.push_back(md.get_hash(buffer).data());
+    for ( sid::hash::batch_kernel kernel : { sid::hash::batch_kernel::scalar, sid::hash::batch_kernel::multi_buffer } )
+    {
+      for ( uint32_t threads : { 1, 3 } )
+      {
+        sid::hash::batch_config config;
+        config.threads = threads;
+        config.kernel = kernel;
+        sid::hash::batch_digest batch(md, config);
+        std::vector<sid::hash::digest> digests = batch.get_hash(buffers);
+        for ( size_t i = 0; i < buffers.size(); i++ )
+          if ( digests[i].data() != expected[i] )
+            throw sid::exception(md.name() + ": batch digest of buffer " + sid::to_str(i) + " (" + sid::to_str(buffers[i].length()) +
+                                 " bytes) does not match" + (batch.is_multi_buffer()? " with the multi-buffer kernel" : ""));
+        // The batch can be reused
+        if ( batch.get_hash({ buffers[5] })[0].data() != expected[5] )
+          throw sid::exception(md.name() + ": second batch does not match");
+      }
+    }
+  }
+
+  // Tree hash: digests of the chunks and the digest of the chunk digests
+  std::string object(1000000, '\0');
+  for ( char& ch : object )
+    ch = static_cast<char>(::rand());
+  sid::hash::batch_digest treeBatch{sid::hash::sha256()};
+  sid::hash::tree_digest tree = treeBatch.get_tree_hash(object.data(), object.length(), 64*1024);
+  std::string chunkDigests;
+  for ( size_t i = 0; i < tree.chunks.size(); i++ )
+  {
+    std::string chunk = sid::hash::sha256().get_hash(object.substr(i * tree.chunk_size, tree.chunk_size)).data();
+    if ( tree.chunks[i].data() != chunk )
+      throw sid::exception("Tree hash chunk " + sid::to_str(i) + " does not match");
+    chunkDigests += chunk;
+  }
+  if ( tree.chunks.size() != 16 || tree.root.data() != sid::hash::sha256().get_hash(chunkDigests).data() )
+    throw sid::exception("Tree hash root does not match");
+
+  // Throughput of 1 MB buffers, as read by block_client
+  const size_t bufferCount = 32;
+  std::vector<std::string> large(bufferCount, object);
+  auto throughput = [&](const std::string& _name, const std::function<void()>& _fn)
+    {
+      auto start = std::chrono::steady_clock::now();
+      for ( uint64_t i = 0; i < std::max<uint64_t>(1, _iterations / 10000); i++ )
+        _fn();
+      double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      double mb = std::max<uint64_t>(1, _iterations / 10000) * bufferCount * object.length() / 1e6;
+      cout << "  " << _name << ": " << static_cast<uint64_t>(mb / secs) << " MB/s" << endl;
+    };
+  cout << "batch: " << std::thread::hardware_concurrency() << " CPUs, 1 MB buffers" << endl;
+  for ( sid::hash::md_algorithm md : { sid::hash::md_algorithm(sid::hash::md5()), sid::hash::md_algorithm(sid::hash::sha256()) } )
+  {
+    throughput(md.name() + " get_hash() on the caller", [&]() { for ( const std::string& buffer : large ) md.get_hash(buffer); });
+    for ( sid::hash::batch_kernel kernel : { sid::hash::batch_kernel::scalar, sid::hash::batch_kernel::multi_buffer } )
+    {
+      sid::hash::batch_config config;
+      config.kernel = kernel;
+      sid::hash::batch_digest batch(md, config);
+      throughput(md.name() + " batch " + (batch.is_multi_buffer()? "multi-buffer" : "scalar"), [&]() { batch.get_hash(large); });
+    }
+  }
+}
+
+namespace legacy
+{
+//! sid::bytes_to_hex() using std::ostringstream (as it was before sid::sized_writer)
+std::string bytes_to_hex(const std::string& _input)
+{
+  std::ostringstream out;
+  std::string csHex;
+  for ( size_t i = 0; i < _input.length(); i++ )
+  {
+    csHex = sid::to_str((unsigned char) _input[i], num_base::hex);
+    if ( csHex.length() == 1 ) csHex = "0" + csHex;
+    out << csHex;
+  }
+  return out.str();
+}
+
+//! sid::hex_to_bytes() using sid::to_num() per pair (as it was before the table-driven codecs)
+std::string hex_to_bytes(const std::string& _input)
+{
+  std::ostringstream out;
+  unsigned char ch = 0;
+  for ( size_t i = 0; i + 1 < _input.length(); i += 2 )
+  {
+    if ( ! sid::to_num(_input.substr(i, 2), num_base::hex, /*out*/ ch) )
+      throw sid::exception("Invalid hex string");
+    out << static_cast<char>(ch);
+  }
+  return out.str();
+}
+
+//! sid::base64::encode() writing a character at a time into std::ostringstream (as it was before the table-driven codecs)
+std::string base64_encode(const std::string& _input)
+{
+  static const char lookup[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::ostringstream out;
+  size_t i = 0;
+  for ( ; i + 3 <= _input.length(); i += 3 )
+  {
+    uint32_t temp = (static_cast<uint8_t>(_input[i]) << 16) | (static_cast<uint8_t>(_input[i+1]) << 8) | static_cast<uint8_t>(_input[i+2]);
+    out << lookup[(temp >> 18) & 0x3F] << lookup[(temp >> 12) & 0x3F] << lookup[(temp >> 6) & 0x3F] << lookup[temp & 0x3F];
+  }
+  if ( i < _input.length() )
+  {
+    uint32_t temp = static_cast<uint8_t>(_input[i]) << 16;
+    if ( i + 1 < _input.length() ) temp |= static_cast<uint8_t>(_input[i+1]) << 8;
+    out << lookup[(temp >> 18) & 0x3F] << lookup[(temp >> 12) & 0x3F]
+        << ((i + 1 < _input.length())? lookup[(temp >> 6) & 0x3F] : '=') << '=';
+  }
+  return out.str();
+}
+
+//! sid::base64::decode() writing a byte at a time into std::ostringstream (as it was before the table-driven codecs)
+std::string base64_decode(const std::string& _input)
+{
+  static const char lookup[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char table[256] = {0};
+  for ( size_t x = 0; x < 64; x++ )
+    table[static_cast<uint8_t>(lookup[x])] = x;
+  size_t outLen = _input.length() / 4 * 3;
+  if ( outLen && _input[_input.length() - 1] == '=' ) outLen--;
+  if ( outLen && _input[_input.length() - 2] == '=' ) outLen--;
+  std::ostringstream out;
+  for ( size_t i = 0, j = 0; i < _input.length(); i += 4 )
+  {
+    uint32_t triple = 0;
+    for ( size_t k = 0; k < 4; k++ )
+      triple = (triple << 6) | ((_input[i+k] == '=')? 0 : table[static_cast<uint8_t>(_input[i+k])]);
+    for ( int shift = 16; shift >= 0 && j < outLen; shift -= 8, j++ )
+      out << static_cast<char>((triple >> shift) & 0xFF);
+  }
+  return out.str();
+}
+
+} // namespace legacy
+
+void test_codec(uint64_t _iterations)
+{
+  const std::vector<codec::simd> levels = { codec::simd::none, codec::simd::ssse3, codec::simd::avx2 };
+  const codec::simd initial = codec::active();
+  auto level_name = [](codec::simd _simd) -> std::string
+    { return (_simd == codec::simd::avx2)? "avx2" : (_simd == codec::simd::ssse3)? "ssse3" : "scalar"; };
+
+  // Every length up to 300 bytes covers the SIMD blocks and all the tails
+  for ( size_t length = 0; length <= 300; length++ )
+  {
+    std::string input(length, '\0');
+    for ( char& ch : input )
+      ch = static_cast<char>(::rand());
+    const std::string hex = legacy::bytes_to_hex(input), base64 = legacy::base64_encode(input);
+    for ( codec::simd level : levels )
+    {
+      codec::set_active(level);
+      const std::string name = level_name(codec::active()) + " with " + sid::to_str(length) + " bytes: ";
+      if ( sid::bytes_to_hex(input) != hex )
+        throw sid::exception(name + "bytes_to_hex() does not match");
+      std::string lower(2 * length, '\0');
+      sid::bytes_to_hex(input.data(), input.length(), &lower[0], true);
+      if ( lower != sid::to_lower(hex) )
+        throw sid::exception(name + "lower case bytes_to_hex() does not match");
+      if ( sid::hex_to_bytes(hex) != input || sid::hex_to_bytes(lower) != input )
+        throw sid::exception(name + "hex_to_bytes() does not match");
+      if ( sid::base64::encode(input) != base64 )
+        throw sid::exception(name + "base64::encode() does not match");
+      if ( sid::base64::decode(base64) != input )
+        throw sid::exception(name + "base64::decode() does not match");
+
+      // An invalid character at every position is rejected
+      if ( length == 0 || length > 100 ) continue;
+      std::vector<uint8_t> output(length + 16);
+      size_t outputLen = 0;
+      for ( size_t i = 0; i < hex.length(); i++ )
+      {
+        std::string bad = hex;
+        bad[i] = "g/:@G`\xff"[i % 7];
+        if ( sid::hex_to_bytes(bad.data(), bad.length(), output.data()) )
+          throw sid::exception(name + "hex_to_bytes() accepted " + bad);
+      }
+      for ( size_t i = 0; i < base64.length(); i++ )
+      {
+        std::string bad = base64;
+        bad[i] = "-_.:@[`{\x80 "[i % 10];
+        if ( sid::base64::decode(bad.data(), bad.length(), output.data(), outputLen) )
+          throw sid::exception(name + "base64::decode() accepted " + bad);
+        // Padding is only allowed in the last two characters
+        bad[i] = '=';
+        if ( i + 2 < base64.length() && sid::base64::decode(bad.data(), bad.length(), output.data(), outputLen) )
+          throw sid::exception(name + "base64::decode() accepted " + bad);
+      }
+      if ( sid::hex_to_bytes(hex.data(), hex.length() - 1, output.data()) )
+        throw sid::exception(name + "hex_to_bytes() accepted an odd length");
+      if ( sid::base64::decode(base64.data(), base64.length() - 1, output.data(), outputLen) )
+        throw sid::exception(name + "base64::decode() accepted a length that is not a multiple of 4");
+    }
+  }
+  bool isThrown = false;
+  try { sid::base64::decode("QUJD*A=="); } catch (const sid::exception&) { isThrown = true; }
+  if ( ! isThrown )
+    throw sid::exception("base64::decode() did not throw for an invalid input");
+
+  // Throughput with 1 MB inputs
+  std::string input(1000000, '\0');
+  for ( char& ch : input )
+    ch = static_cast<char>(::rand());
+  const std::string hex = sid::bytes_to_hex(input), base64 = sid::base64::encode(input);
+  std::string out;
+  auto throughput = [&](const std::string& _name, size_t _bytes, const std::function<void()>& _fn)
+    {
+      const uint64_t count = std::max<uint64_t>(1, _iterations / 1000);
+      auto start = std::chrono::steady_clock::now();
+      for ( uint64_t i = 0; i < count; i++ )
+        _fn();
+      double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      cout << "  " << _name << ": " << static_cast<uint64_t>(count * _bytes / 1e6 / secs) << " MB/s" << endl;
+    };
+  cout << "codec: 1 MB of bytes, supported " << level_name(codec::supported()) << endl;
+  throughput("bytes_to_hex() before", input.length(), [&]() { out = legacy::bytes_to_hex(input); });
+  throughput("hex_to_bytes() before", input.length(), [&]() { out = legacy::hex_to_bytes(hex); });
+  throughput("base64::encode() before", input.length(), [&]() { out = legacy::base64_encode(input); });
+  throughput("base64::decode() before", input.length(), [&]() { out = legacy::base64_decode(base64); });
+  for ( codec::simd level : levels )
+  {
+    if ( static_cast<int>(level) > static_cast<int>(codec::supported()) ) continue;
+    codec::set_active(level);
+    throughput("bytes_to_hex() " + level_name(level), input.length(), [&]() { out = sid::bytes_to_hex(input); });
+    throughput("hex_to_bytes() " + level_name(level), input.length(), [&]() { out = sid::hex_to_bytes(hex); });
+    throughput("base64::encode() " + level_name(level), input.length(), [&]() { out = sid::base64::encode(input); });
+    throughput("base64::decode() " + level_name(level), input.length(), [&]() { out = sid::base64::decode(base64); });
+  }
+  codec::set_active(initial);
+}
+
+void test_crc(uint64_t _iterations)
+{
+  using sid::checksum::type;
+  const bool hasHardware = sid::checksum::hardware_supported();
+  const bool initial = sid::checksum::use_hardware(hasHardware);
+
+  // Check values of the algorithms
+  const std::string check = "123456789";
+  if ( sid::checksum::crc32c(check.data(), check.length()) != 0xE3069283U )
+    throw sid::exception("crc32c(\"123456789\") does not match the check value");
+  if ( sid::checksum::crc64nvme(check.data(), check.length()) != 0xAE8B14860A799888ULL )
+    throw sid::exception("crc64nvme(\"123456789\") does not match the check value");
+  if ( sid::checksum::crc(type::crc32c).update(check).to_base64() != "4waSgw==" )
+    throw sid::exception("Base64 of the crc32c does not match");
+
+  // The accelerated CRCs match the tables for every length and alignment, including the 3 stream blocks
+  std::string input(200000, '\0');
+  for ( char& ch : input )
+    ch = static_cast<char>(::rand());
+  std::vector<size_t> lengths;
+  for ( size_t length = 0; length <= 1100; length++ )
+    lengths.push_back(length);
+  for ( size_t length : { 3*256 - 1, 3*8192 + 17, 3*8192*2 + 3*256 + 9, 199990 } )
+    lengths.push_back(length);
+  for ( size_t length : lengths )
+  {
+    for ( size_t offset = 0; offset < 8; offset++ )
+    {
+      const char* data = input.data() + offset;
+      sid::checksum::use_hardware(false);
+      const uint32_t crc32 = sid::checksum::crc32c(data, length, 0x1234);
+      const uint64_t crc64 = sid::checksum::crc64nvme(data, length, 0x1234);
+      sid::checksum::use_hardware(hasHardware);
+      if ( sid::checksum::crc32c(data, length, 0x1234) != crc32 || sid::checksum::crc64nvme(data, length, 0x1234) != crc64 )
+        throw sid::exception("Accelerated CRC does not match with " + sid::to_str(length) + " bytes at offset " + sid::to_str(offset));
+      if ( length > 1100 ) break;
+    }
+  }
+
+  // CRCs of the parts combine into the CRC of the whole
+  for ( size_t i = 0; i < 200; i++ )
+  {
+    const size_t length = ::rand() % input.length(), split = ::rand() % (length + 1);
+    for ( type t : { type::crc32c, type::crc64nvme } )
+    {
+      sid::checksum::crc whole(t), first(t), second(t);
+      whole.update(input.data(), length);
+      first.update(input.data(), split);
+      second.update(input.data() + split, length - split);
+      if ( first.append(second).value() != whole.value() || first.length() != length )
+        throw sid::exception(sid::checksum::to_str(t) + ": append() does not match with " + sid::to_str(length) + " bytes split at " + sid::to_str(split));
+    }
+  }
+
+  // Throughput with 1 MB inputs
+  input.resize(1000000);
+  uint64_t result = 0;
+  auto throughput = [&](const std::string& _name, const std::function<void()>& _fn)
+    {
+      const uint64_t count = std::max<uint64_t>(1, _iterations / 100);
+      auto start = std::chrono::steady_clock::now();
+      for ( uint64_t i = 0; i < count; i++ )
+        _fn();
+      double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      cout << "  " << _name << ": " << static_cast<uint64_t>(count * input.length() / 1e6 / secs) << " MB/s" << endl;
+    };
+  cout << "checksum: 1 MB of bytes, hardware " << (hasHardware? "supported" : "not supported") << endl;
+  throughput("md5", [&]() { result += sid::hash::md5().get_hash(input).data()[0]; });
+  sid::checksum::use_hardware(false);
+  throughput("crc32c tables", [&]() { result += sid::checksum::crc32c(input.data(), input.length()); });
+  throughput("crc64nvme tables", [&]() { result += sid::checksum::crc64nvme(input.data(), input.length()); });
+  if ( hasHardware )
+  {
+    sid::checksum::use_hardware(true);
+    throughput("crc32c sse4.2", [&]() { result += sid::checksum::crc32c(input.data(), input.length()); });
+    throughput("crc64nvme pclmul", [&]() { result += sid::checksum::crc64nvme(input.data(), input.length()); });
+  }
+  sid::checksum::use_hardware(initial);
+  if ( result == 0 )
+    cout << "  (no result)" << endl;
+}
+
+//! Build a random json document with comments, escapes and all the value types
+static void json_document(std::string& _out, size_t _depth, size_t _width)
+{
+  auto scalar = [&]()
+    {
+      switch ( ::rand() % 8 )
+      {
+      case 0: _out += sid::to_str(::rand()); break;
+      case 1: _out += "-" + sid::to_str(::rand() % 1000); break;
+      case 2: _out += sid::to_str(::rand() % 1000) + "." + sid::to_str(::rand() % 1000) + "e-" + sid::to_str(::rand() % 5); break;
+      case 3: _out += ( ::rand() % 2 )? "true" : "false"; break;
+      case 4: _out += "null"; break;
+      case 5: _out += "\"tab\\t quote\\\" slash\\/ back\\\\ line\\n\""; break;
+      default: _out += "\"value " + sid::to_str(::rand()) + "\""; break;
+      }
+    };
+  const bool isObject = ( ::rand() % 2 == 0 );
+  _out += isObject? "{" : "[ ";
+  const size_t count = ::rand() % (_width + 1);
+  for ( size_t i = 0; i < count; i++ )
+  {
+    if ( i > 0 ) _out += ( i % 3 == 0 )? ",\n  " : ", ";
+    if ( i % 5 == 4 ) _out += "/* comment, with } and ] */ ";
+    if ( isObject ) _out += "\"key" + sid::to_str(i) + "\" : ";
+    if ( _depth > 0 && ::rand() % 3 == 0 )
+      json_document(_out, _depth - 1, _width);
+    else
+      scalar();
+    if ( i % 7 == 6 ) _out += " // comment\n";
+  }
+  _out += isObject? "}" : "]";
+}
+
+//! Parse the document with the stream parser, passing it in chunks of the given size
+static json::value json_stream_parse(const std::string& _doc, size_t _chunk, const json::parser_control& _ctrl = json::parser_control())
+{
+  json::value jout;
+  json::value_builder builder(jout);
+  json::stream_parser parser(builder, _ctrl);
+  for ( size_t i = 0; i < _doc.length(); i += _chunk )
+    parser.parse(_doc.data() + i, std::min(_chunk, _doc.length() - i));
+  parser.finish();
+  return jout;
+}
+
+void test_json(uint64_t _iterations)
+{
+  // Documents parsed in chunks of every size match the tree built by json::value::parse()
+  for ( size_t n = 0; n < 200; n++ )
+  {
+    std::string doc;
+    json_document(doc, 3, 6);
+    json::value jdom;
+    json::value::parse(jdom, doc);
+    const std::string expected = jdom.to_str();
+    for ( size_t chunk : { (size_t) 1, (size_t) 2, (size_t) 7, (size_t) 1 + ::rand() % 64, doc.length() } )
+    {
+      if ( json_stream_parse(doc, chunk).to_str() != expected )
+        throw sid::exception("Stream parser with " + sid::to_str(chunk) + " byte chunks does not match for " + doc);
+    }
+  }
+
+  // Flexible keys, strings and values in any case, as accepted by json::value::parse()
+  const json::parser_control flexible(json::parser_control::parse_mode(SID_JSON_PARSE_MODE_ALLOW_FLEXIBLE_KEYS | SID_JSON_PARSE_MODE_ALLOW_FLEXIBLE_STRINGS | SID_JSON_PARSE_MODE_ALLOW_NOCASE_VALUES));
+  for ( const char* doc : {
+      "{name: sda, size : 100, ro:False, wwn: NULL, list: [a, b/c, TRUE, -1, 2.5],}",
+      "{ path:dev/sda, // comment\n mount:mnt/x , label: \"quoted\" }",
+      "[ one, two , [three], {four:4}, ]" } )
+  {
+    json::value jdom;
+    json::value::parse(jdom, doc, flexible);
+    for ( size_t chunk = 1; chunk <= 5; chunk++ )
+      if ( json_stream_parse(doc, chunk, flexible).to_str() != jdom.to_str() )
+        throw sid::exception("Stream parser does not match for the flexible document " + std::string(doc));
+  }
+
+  // An unquoted value can start with / (json::value::parse() does not return for it)
+  if ( json_stream_parse("{path:/dev/sda}", 1, flexible).to_str() != "{\"path\":\"/dev/sda\"}" )
+    throw sid::exception("Stream parser did not accept an unquoted value starting with /");
+
+  // \u escapes are written as UTF-8, including surrogate pairs
+  if ( json_stream_parse("[\"a\\u00e9\\u20ac\\ud83d\\ude00z\"]", 1)[0].as_str() != "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80z" )
+    throw sid::exception("Stream parser did not decode \\u escapes");
+
+  // Duplicate keys
+  const std::string dupDoc = "{\"a\":1, \"b\":{\"a\":2}, \"a\":{\"x\":[3]}, \"c\":4}";
+  if ( json_stream_parse(dupDoc, 3).to_str() != "{\"a\":{\"x\":[3]},\"b\":{\"a\":2},\"c\":4}" )
+    throw sid::exception("Stream parser did not accept the duplicate key");
+  if ( json_stream_parse(dupDoc, 3, json::parser_control::dup_key::ignore).to_str() != "{\"a\":1,\"b\":{\"a\":2},\"c\":4}" )
+    throw sid::exception("Stream parser did not ignore the duplicate key");
+
+  // Invalid documents are rejected, whatever the chunk size
+  for ( const char* bad : {
+      "", "  ", "x", "[", "{\"a\":1", "[1,,2]", "[,]", "{\"a\" 1}", "{a:1}", "[01]", "[1.]", "[1e]", "[-]", "[1.5.3]",
+      "[tru]", "[abc]", "[\"\\x\"]", "[\"\\u12g4\"]", "[1] x", "[1] /* open", "[/x]", "[1 2]", "{\"a\":1]",
+      "{\"a\":1, \"a\":2}", "[\"\\ud800\"]", "[\"\\ud800x\"]", "[\"\\udc00\"]", "[\"\\ud800\\u0041\"]", "[\"\\ude00\\ud83d\"]" } )
+  {
+    for ( size_t chunk : { (size_t) 1, (size_t) 100 } )
+    {
+      bool isThrown = false;
+      try { json_stream_parse(bad, chunk, json::parser_control::dup_key::reject); } catch (const sid::exception&) { isThrown = true; }
+      if ( ! isThrown )
+        throw sid::exception("Stream parser accepted " + std::string(bad));
+    }
+  }
+
+  // The handler stops the parser
+  struct first_handler : public json::handler
+  {
+    std::string first;
+    bool string(const std::string& _value) override { first = _value; return false; }
+  } first;
+  json::stream_parser stopped(first);
+  if ( stopped.parse("[1, \"one\", \"two\", ") || ! stopped.is_stopped() || first.first != "one" || stopped.parse("\"three\"]") || stopped.finish() )
+    throw sid::exception("Stream parser did not stop when the handler returned false");
+
+  // Counting handler for the throughput of the parser alone
+  struct count_handler : public json::handler
+  {
+    uint64_t count = 0;
+    bool key(const std::string&) override { ++count; return true; }
+    bool string(const std::string&) override { ++count; return true; }
+    bool number_unsigned(uint64_t) override { ++count; return true; }
+  } counter;
+
+  std::string doc = "[";
+  while ( doc.length() < 1000000 )
+  {
+    if ( doc.length() > 1 ) doc += ",\n";
+    json_document(doc, 3, 8);
+  }
+  doc += "]";
+  json::value jout;
+  const uint64_t count = std::max<uint64_t>(1, _iterations / 2000);
+  auto throughput = [&](const std::string& _name, const std::function<void()>& _fn)
+    {
+      auto start = std::chrono::steady_clock::now();
+      for ( uint64_t i = 0; i < count; i++ )
+        _fn();
+      double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      cout << "  " << _name << ": " << static_cast<uint64_t>(count * doc.length() / 1e6 / secs) << " MB/s" << endl;
+    };
+  cout << "json: " << doc.length() / 1000 << " KB document" << endl;
+  throughput("json::value::parse()", [&]() { json::value::parse(jout, doc); });
+  throughput("stream_parser in 64 KB chunks", [&]()
+    {
+      json::stream_parser parser(counter);
+      for ( size_t i = 0; i < doc.length(); i += 65536 )
+        parser.parse(doc.data() + i, std::min<size_t>(65536, doc.length() - i));
+      parser.finish();
+    });
+  throughput("stream_parser with value_builder", [&]()
+    {
+      json::value_builder builder(jout);
+      json::stream_parser parser(builder);
+      for ( size_t i = 0; i < doc.length(); i += 65536 )
+        parser.parse(doc.data() + i, std::min<size_t>(65536, doc.length() - i));
+      parser.finish();
+    });
+}
+
+void test_document(uint64_t _iterations)
+{
+  // Documents match the tree built by json::value::parse()
+  for ( size_t n = 0; n < 200; n++ )
+  {
+    std::string doc;
+    json_document(doc, 3, 24);
+    json::value jdom;
+    json::value::parse(jdom, doc);
+    json::document jdoc;
+    jdoc.parse(doc);
+    if ( jdoc.root().to_value().to_str() != jdom.to_str() )
+      throw sid::exception("json::document does not match json::value for " + doc);
+  }
+
+  // Members stay in the order of the document, keys are stored once, and large objects are found through the index
+  json::document jdoc;
+  jdoc.parse("[{\"b\":1, \"a\":\"x\\ty\"}, {\"b\":2.5, \"a\":null}]");
+  if ( jdoc.root().to_str() != "[{\"b\":1,\"a\":\"x\\ty\"},{\"b\":2.5,\"a\":null}]" )
+    throw sid::exception("json::document did not keep the order of the members: " + jdoc.root().to_str());
+  if ( jdoc.root()[0].member(1).key != jdoc.root()[1].member(1).key || jdoc.root()[1]["b"].get_double() != 2.5 )
+    throw sid::exception("json::document did not intern the keys");
+  for ( size_t count : { (size_t) 15, (size_t) 16, (size_t) 1000 } )
+  {
+    std::string doc = "{";
+    for ( size_t i = 0; i < count; i++ )
+      doc += ( i? ", \"key" : "\"key" ) + sid::to_str(i * 7) + "\": " + sid::to_str(i);
+    doc += "}";
+    jdoc.parse(doc);
+    for ( size_t i = 0; i < count * 7; i++ )
+    {
+      const json::node* jval = jdoc.root().find("key" + sid::to_str(i));
+      if ( ( i % 7 == 0 ) != ( jval != nullptr ) || ( jval != nullptr && jval->get_uint64() != i / 7 ) )
+        throw sid::exception("json::document lookup of key" + sid::to_str(i) + " failed with " + sid::to_str(count) + " members");
+    }
+  }
+
+  // Duplicate keys are handled as json::value::parse() does, except for the cases of accept below
+  for ( const char* doc : { "{\"a\":1, \"b\":{\"a\":2}, \"a\":{\"x\":[3]}, \"c\":4, \"a\":[5]}", "{\"a\":[1], \"a\":2, \"b\":true, \"a\":[3]}" } )
+  {
+    for ( json::parser_control::dup_key dupKey : { json::parser_control::dup_key::accept, json::parser_control::dup_key::ignore, json::parser_control::dup_key::append } )
+    {
+      json::value jdom;
+      json::value::parse(jdom, doc, dupKey);
+      jdoc.parse(doc, dupKey);
+      if ( jdoc.root().to_value().to_str() != jdom.to_str() )
+        throw sid::exception("json::document does not match json::value with duplicate keys for " + std::string(doc) + ": " + jdoc.root().to_value().to_str());
+    }
+    bool isThrown = false;
+    try { jdoc.parse(doc, json::parser_control::dup_key::reject); } catch (const sid::exception&) { isThrown = true; }
+    if ( ! isThrown || ! jdoc.empty() )
+      throw sid::exception("json::document accepted a duplicate key");
+  }
+
+  // With accept, the last value replaces the earlier one (in json::document and value_builder). json::value::parse() merges objects and arrays, and keeps a value over null.
+  const std::vector<std::vector<std::string>> accepts = {
+    { "{\"k\":{\"a\":1},\"k\":{\"b\":2}}", "{\"k\":{\"b\":2}}", "{\"k\":{\"a\":1,\"b\":2}}" },
+    { "{\"k\":[1],\"k\":[2]}", "{\"k\":[2]}", "{\"k\":[1,2]}" },
+    { "{\"k\":1,\"k\":null}", "{\"k\":null}", "{\"k\":1}" },
+  };
+  for ( const std::vector<std::string>& accept : accepts )
+  {
+    json::value jdom, jbuilt;
+    json::value::parse(jdom, accept[0], json::parser_control::dup_key::accept);
+    json::value_builder builder(jbuilt);
+    json::stream_parser parser(builder, json::parser_control::dup_key::accept);
+    parser.parse(accept[0]);
+    parser.finish();
+    jdoc.parse(accept[0], json::parser_control::dup_key::accept);
+    if ( jdoc.root().to_str() != accept[1] || jbuilt.to_str() != accept[1] || jdom.to_str() != accept[2] )
+      throw sid::exception("Duplicate keys with accept are not handled as documented for " + accept[0] + ": json::document "
+                           + jdoc.root().to_str() + ", value_builder " + jbuilt.to_str() + ", json::value " + jdom.to_str());
+  }
+
+  // Arena: small requests share blocks, large ones get their own block and the current block continues
+  sid::arena mem(4096);
+  char* p1 = static_cast<char*>(mem.allocate(100, 8));
+  mem.allocate(5000, 64);
+  char* p2 = static_cast<char*>(mem.allocate(100, 8));
+  if ( mem.blocks() != 2 || p2 != p1 + 104 || reinterpret_cast<uintptr_t>(mem.allocate(10, 256)) % 256 != 0 )
+    throw sid::exception("arena did not allocate as expected");
+  mem.clear();
+  if ( mem.blocks() != 0 || mem.reserved() != 0 )
+    throw sid::exception("arena did not free the blocks");
+
+  // Throughput and memory with a 1 MB document
+  std::string doc = "[";
+  while ( doc.length() < 1000000 )
+  {
+    if ( doc.length() > 1 ) doc += ",\n";
+    json_document(doc, 3, 8);
+  }
+  doc += "]";
+  auto heap_used = []() { return static_cast<uint64_t>(::mallinfo2().uordblks); };
+  json::parser_stats stats;
+  json::value jout;
+  uint64_t before = heap_used();
+  json::value::parse(jout, stats, doc);
+  const uint64_t valueMemory = heap_used() - before;
+  jdoc.clear();
+  before = heap_used();
+  jdoc.parse(stats, doc);
+  const uint64_t documentMemory = heap_used() - before;
+  if ( documentMemory > stats.memory + 4096 )
+    throw sid::exception("json::document holds " + sid::to_str(documentMemory) + " bytes, but reports " + sid::to_str(stats.memory));
+
+  const uint64_t count = std::max<uint64_t>(1, _iterations / 2000);
+  auto throughput = [&](const std::string& _name, const std::function<void()>& _fn)
+    {
+      auto start = std::chrono::steady_clock::now();
+      for ( uint64_t i = 0; i < count; i++ )
+        _fn();
+      double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      cout << "  " << _name << ": " << static_cast<uint64_t>(count * doc.length() / 1e6 / secs) << " MB/s" << endl;
+    };
+  cout << "document: " << doc.length() / 1000 << " KB document" << endl;
+  cout << "  json::value memory: " << valueMemory / 1000 << " KB" << endl;
+  cout << "  json::document memory: " << stats.memory / 1000 << " KB in " << stats.allocations << " allocations" << endl;
+  throughput("json::value::parse() and free", [&]() { json::value jval; json::value::parse(jval, doc); });
+  throughput("json::document::parse() and free", [&]() { json::document jval; jval.parse(doc); });
+}
+
+static const std::vector<Test> tests = {
+  { "hash", "Compare the streaming hasher with one-shot digests and HMACs, and reused contexts with new ones", test_hash },
+  { "batch", "Compare batch and tree digests on worker threads (scalar and multi-buffer) with one-shot digests", test_batch },
+  { "codec", "Compare the base64 and hex codecs (scalar, SSSE3 and AVX2) with the previous ones, and reject invalid input", test_codec },
+  { "crc", "Compare the accelerated CRC32C/CRC64-NVMe with the tables, and combine the CRCs of parts", test_crc },
+  { "json", "Compare the streaming json parser fed in chunks with json::value::parse(), and reject invalid documents", test_json },
+  { "document", "Compare the arena json::document with json::value, its key lookups and duplicate keys, and their speed and memory", test_document },
+};
+
+//! Run the tests as: common_test --test <test_name> [iterations]
+static int run_tests(int argc, char* argv[])
+{
+  try
+  {
+    if ( argc < 3 )
+    {
+      cout << "Usage: " << argv[0] << " --test <test_name> [iterations]" << endl;
+      for ( const Test& test : tests )
+        cout << "  " << test.name << " : " << test.description << endl;
+      cout << "  all : Run all the tests" << endl;
+      return 0;
+    }
+    std::string name = argv[2];
+    uint64_t iterations = 100000;
+    if ( argc > 3 && ! sid::to_num(std::string(argv[3]), /*out*/ iterations) )
+      throw sid::exception("Invalid number of iterations: " + std::string(argv[3]));
+
+    bool isFound = false;
+    for ( const Test& test : tests )
+    {
+      if ( name != "all" && name != test.name ) continue;
+      isFound = true;
+      test.fn(iterations);
+    }
+    if ( !isFound )
+      throw sid::exception("Invalid test name: " + name);
+  }
+  catch (const sid::exception& e)
+  {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
+
 int main(int argc, char* argv[])
 {
   ::srand(::time(nullptr));
+  if ( argc > 1 && std::string(argv[1]) == "--test" )
+    return run_tests(argc, argv);
   try
   {
     //if ( argc < 2 )
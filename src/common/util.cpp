@@ -83,6 +83,30 @@ command command::execute(const std::string& _cmd)
 
 /*static*/
 command command::execute(const std::string& _cmd, const std::vector<std::string>& _params)
+{
+  std::string response;
+  command cmdOut = command::execute(_cmd, _params, [&](const char* _data, size_t _len)->bool
+    {
+      response.append(_data, _len);
+      return true;
+    });
+  if ( cmdOut.response.empty() )
+    cmdOut.response = std::move(response);
+  return cmdOut;
+}
+
+/*static*/
+command command::execute(const std::string& _cmd, const FNOutput& _fnOutput)
+{
+  std::vector<std::string> params;
+  sid::split(params, _cmd, ' ', SPLIT_SKIP_EMPTY);
+  const std::string cmd = params[0];
+  params.erase(params.begin());
+  return command::execute(cmd, params, _fnOutput);
+}
+
+/*static*/
+command command::execute(const std::string& _cmd, const std::vector<std::string>& _params, const FNOutput& _fnOutput)
 {
   command cmdOut;
 
@@ -124,11 +148,23 @@ command command::execute(const std::string& _cmd, const std::vector<std::string>
     char buffer[4096] = {0};
     ::memset(buffer, 0, sizeof(buffer));
     ssize_t n = 0;
+    std::string callbackError;
+    bool isStopped = false;
     while ( 0 < (n = ::read(pipefd_stdout[0], buffer, sizeof(buffer)-1)) )
     {
-      cmdOut.response += buffer;
-      ::memset(buffer, 0, sizeof(buffer));
+      // Once the callback stops (or throws), the rest of the output is read and discarded, so that the
+      // child does not get SIGPIPE and completes with its own exit status
+      if ( isStopped )
+        continue;
+      try
+      {
+        if ( ! _fnOutput(buffer, n) )
+          isStopped = true;
+      }
+      catch (const sid::exception& _e) { callbackError = _e.message(); isStopped = true; }
+      catch (const std::exception& _e) { callbackError = _e.what(); isStopped = true; }
     }
+    ::close(pipefd_stdout[0]);
     //cout << cmdOut.response << endl;
 
     ::memset(buffer, 0, sizeof(buffer));
@@ -142,6 +178,12 @@ command command::execute(const std::string& _cmd, const std::vector<std::string>
     // wait for completion of the child
     //::waitpid(pid, &cmdOut.retVal, WEXITSTATUS);
     ::waitpid(pid, &cmdOut.retVal, 0);
+    ::close(pipefd_stderr[0]);
+    if ( ! callbackError.empty() )
+    {
+      cmdOut.retVal = -1;
+      cmdOut.error = callbackError;
+    }
   }
   catch (const sid::exception& _e)
   {
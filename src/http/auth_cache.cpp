@@ -0,0 +1,228 @@
+//////////////////////////////////////////////////////
+//
+// auth_cache.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/http.hpp"
+#include "http/auth_cache.hpp"
+#include "common/convert.hpp"
+#include <algorithm>
+
+using namespace std;
+using namespace sid;
+using namespace sid::http;
+
+//! Path of the URI without the query, for matching the protection spaces
+static std::string uri_path(const std::string& _uri)
+{
+  std::string path = _uri.substr(0, _uri.find('?'));
+  // An absolute URI (proxy requests, Digest domain) is reduced to its path
+  size_t pos = path.find("://");
+  if ( pos != std::string::npos )
+  {
+    pos = path.find('/', pos + 3);
+    path = ( pos == std::string::npos )? "/" : path.substr(pos);
+  }
+  return path;
+}
+
+//! Protection space of a challenge to the URI
+static std::vector<std::string> protection_space(const www_authenticate& _challenge, const std::string& _uri)
+{
+  std::vector<std::string> prefixes;
+  std::string domain;
+  if ( _challenge.type == "Digest" )
+  {
+    if ( _challenge.exists("domain", /*out*/ domain) )
+    {
+      std::vector<std::string> uris;
+      sid::split(uris, domain, ' ', SPLIT_TRIM_SKIP_EMPTY);
+      for ( const std::string& uri : uris )
+        prefixes.push_back(uri_path(uri));
+    }
+    if ( prefixes.empty() )
+      prefixes.push_back("/");
+  }
+  else
+  {
+    // The directory of the URI, and everything below it
+    std::string path = uri_path(_uri);
+    prefixes.push_back(path.substr(0, path.rfind('/') + 1));
+  }
+  return prefixes;
+}
+
+std::string auth_stats::to_str() const
+{
+  return "preemptive=" + sid::to_str(preemptive) + " challenges=" + sid::to_str(challenges)
+    + " next_nonces=" + sid::to_str(next_nonces) + " sessions=" + sid::to_str(sessions);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// auth_cache
+//
+auth_cache::entry* auth_cache::p_find(const std::string& _host, const http::request& _request)
+{
+  auto it = m_entries.find(_host);
+  if ( it == m_entries.end() )
+    return nullptr;
+
+  // The longest prefix wins when the protection spaces are nested
+  const std::string path = uri_path(_request.uri);
+  entry* found = nullptr;
+  size_t foundLength = 0;
+  for ( entry& e : it->second )
+  {
+    if ( e.session.userName != _request.userName || e.session.password != _request.password )
+      continue;
+    for ( const std::string& prefix : e.prefixes )
+    {
+      if ( path.compare(0, prefix.length(), prefix) == 0 && ( ! found || prefix.length() > foundLength ) )
+      {
+        found = &e;
+        foundLength = prefix.length();
+      }
+    }
+  }
+  return found;
+}
+
+bool auth_cache::apply(http::request& _request, const std::string& _host)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  entry* e = p_find(_host, _request);
+  if ( ! e )
+    return false;
+  _request.headers("Authorization", e->session.get_auth_string(_request));
+  m_stats.preemptive++;
+  return true;
+}
+
+bool auth_cache::challenge(http::request& _request, const std::string& _host, const std::string& _wwwAuth)
+{
+  www_authenticate_list authList;
+  authList.set(_wwwAuth);
+  // Schemes that cannot be answered are skipped
+  const www_authenticate* challenge = nullptr;
+  for ( const www_authenticate& item : authList )
+  {
+    if ( item.type == "Digest" || item.type == "Basic" )
+    {
+      challenge = &item;
+      break;
+    }
+  }
+  if ( ! challenge )
+    return false;
+
+  std::string realm, entryRealm;
+  challenge->exists("realm", /*out*/ realm);
+  std::vector<std::string> prefixes = protection_space(*challenge, _request.uri);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<entry>& entries = m_entries[_host];
+  entry* found = nullptr;
+  for ( entry& e : entries )
+  {
+    e.session.challenge.exists("realm", /*out*/ entryRealm);
+    if ( e.session.challenge.type == challenge->type && entryRealm == realm
+         && e.session.userName == _request.userName && e.session.password == _request.password )
+    {
+      found = &e;
+      break;
+    }
+  }
+  if ( ! found )
+  {
+    entries.emplace_back();
+    found = &entries.back();
+    m_stats.sessions++;
+  }
+
+  // A new nonce for the same realm keeps HA1
+  found->session.set(*challenge, _request.userName, _request.password);
+  for ( const std::string& prefix : prefixes )
+    if ( std::find(found->prefixes.begin(), found->prefixes.end(), prefix) == found->prefixes.end() )
+      found->prefixes.push_back(prefix);
+  _request.headers("Authorization", found->session.get_auth_string(_request));
+  m_stats.challenges++;
+  return true;
+}
+
+void auth_cache::update(const http::request& _request, const std::string& _host, const http::response& _response)
+{
+  std::string authInfo, nextNonce;
+  if ( ! _response.headers.exists("Authentication-Info", &authInfo) )
+    return;
+  // The header has the parameters of a challenge without the scheme
+  www_authenticate_list authList;
+  authList.set("Digest " + authInfo);
+  if ( authList.empty() || ! authList[0].exists("nextnonce", /*out*/ nextNonce) || nextNonce.empty() )
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  entry* e = p_find(_host, _request);
+  if ( e && e->session.challenge.type == "Digest" )
+  {
+    e->session.set_nonce(nextNonce);
+    m_stats.next_nonces++;
+  }
+}
+
+void auth_cache::remove(const std::string& _host)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_entries.find(_host);
+  if ( it == m_entries.end() )
+    return;
+  m_stats.sessions -= it->second.size();
+  m_entries.erase(it);
+}
+
+auth_stats auth_cache::stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+void auth_cache::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.clear();
+  m_stats.sessions = 0;
+}
@@ -0,0 +1,672 @@
+//////////////////////////////////////////////////////
+//
+// cache.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/http.hpp"
+#include "http/cache.hpp"
+#include "common/convert.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <strings.h>
+#include <climits>
+#include <algorithm>
+
+using namespace std;
+using namespace sid;
+using namespace sid::http;
+
+namespace sid {
+namespace http {
+
+/**
+ * @struct cache_entry
+ * @brief A stored response. This is an internal structure.
+ */
+struct cache_entry
+{
+  std::string    key;            //! URI of the request
+  std::vector<std::pair<std::string, std::string>> vary; //! Request headers named in Vary and their values
+  http::response head;           //! Status line and headers of the response (no payload)
+  std::string    body;           //! Payload, if it is in memory
+  std::string    filePath;       //! File holding the payload, if it is on disk
+  uint64_t       size;           //! Length of the payload
+  uint64_t       bytes;          //! Bytes accounted for the entry in its tier
+  time_t         requestTime;    //! Time the request was sent
+  time_t         responseTime;   //! Time the response was received
+  int64_t        lifetime;       //! Freshness lifetime in seconds
+  bool           noCache;        //! Must be revalidated before every use (no-cache in the response)
+  bool           mustRevalidate; //! Must not be served stale (must-revalidate or proxy-revalidate)
+  bool           onDisk;         //! The payload is on disk
+  std::list<std::shared_ptr<cache_entry>>::iterator it; //! Position in the LRU list of its tier
+
+  cache_entry() : size(0), bytes(0), requestTime(0), responseTime(0), lifetime(0), noCache(false), mustRevalidate(false), onDisk(false) {}
+
+  //! Current age as per RFC 9111 section 4.2.3
+  int64_t age(time_t _now) const;
+};
+
+} // namespace http
+} // namespace sid
+
+/**
+ * @struct cache_control
+ * @brief Directives of the Cache-Control header fields (RFC 9111 section 5.2)
+ */
+struct cache_control
+{
+  bool    noStore;
+  bool    noCache;
+  bool    mustRevalidate;
+  bool    isPrivate;
+  bool    isPublic;
+  bool    onlyIfCached;
+  int64_t maxAge;    //! -1 if absent
+  int64_t sMaxAge;   //! -1 if absent
+  int64_t maxStale;  //! -1 if absent, INT64_MAX if it has no value
+  int64_t minFresh;  //! -1 if absent
+
+  cache_control(const http::headers& _headers);
+};
+
+cache_control::cache_control(const http::headers& _headers)
+  : noStore(false), noCache(false), mustRevalidate(false), isPrivate(false), isPublic(false), onlyIfCached(false),
+    maxAge(-1), sMaxAge(-1), maxStale(-1), minFresh(-1)
+{
+  for ( const std::string& field : _headers.get_all("Cache-Control") )
+  {
+    std::vector<std::string> directives;
+    sid::split(directives, field, ',', SPLIT_TRIM_SKIP_EMPTY);
+    for ( const std::string& directive : directives )
+    {
+      std::string name = directive, value;
+      size_t pos = directive.find('=');
+      bool hasValue = ( pos != std::string::npos );
+      if ( hasValue )
+      {
+        name = sid::trim(directive.substr(0, pos));
+        value = sid::trim(directive.substr(pos + 1));
+        if ( value.length() >= 2 && value.front() == '"' && value.back() == '"' )
+          value = value.substr(1, value.length() - 2);
+      }
+      name = sid::to_lower(name);
+      // An invalid delta-seconds is treated as 0, which makes the response stale (RFC 9111 section 1.2.2)
+      auto seconds = [&]()->int64_t { uint64_t num = 0; return sid::to_num(value, num)? static_cast<int64_t>(std::min<uint64_t>(num, INT_MAX)) : 0; };
+      if ( name == "no-store" ) noStore = true;
+      else if ( name == "no-cache" ) noCache = true;
+      else if ( name == "must-revalidate" || name == "proxy-revalidate" ) mustRevalidate = true;
+      else if ( name == "private" ) isPrivate = true;
+      else if ( name == "public" ) isPublic = true;
+      else if ( name == "only-if-cached" ) onlyIfCached = true;
+      else if ( name == "max-age" ) maxAge = seconds();
+      else if ( name == "s-maxage" ) sMaxAge = seconds();
+      else if ( name == "max-stale" ) maxStale = hasValue? seconds() : INT64_MAX;
+      else if ( name == "min-fresh" ) minFresh = seconds();
+    }
+  }
+}
+
+//! Statuses that can be stored with a heuristic freshness (RFC 9110 section 15.1)
+static bool is_heuristically_cacheable(http::status_code _code)
+{
+  switch ( static_cast<int>(_code) )
+  {
+  case 200: case 203: case 204: case 206: case 300: case 301: case 308:
+  case 404: case 405: case 410: case 414: case 501:
+    return true;
+  default:
+    return false;
+  }
+}
+
+//! Value of the header as an HTTP-date (0 if it is missing or invalid)
+static time_t header_date(const http::headers& _headers, const std::string& _name)
+{
+  bool isFound = false;
+  std::string value = _headers.get(_name, &isFound);
+  time_t tt = 0;
+  if ( ! isFound || ! http::date_from_str(value, tt) )
+    return 0;
+  return tt;
+}
+
+//! Values of the request header as compared for Vary. Whitespace is normalized.
+static std::string vary_value(const http::headers& _headers, const std::string& _name)
+{
+  std::string value;
+  for ( const std::string& field : _headers.get_all(_name) )
+  {
+    if ( ! value.empty() ) value += ",";
+    value += field;
+  }
+  std::string normalized;
+  bool isSpace = false;
+  for ( char ch : sid::trim(value) )
+  {
+    if ( ch == ' ' || ch == '\t' )
+    {
+      isSpace = true;
+      continue;
+    }
+    if ( isSpace && ch != ',' && ! normalized.empty() && normalized.back() != ',' )
+      normalized += ' ';
+    isSpace = false;
+    normalized += ch;
+  }
+  return normalized;
+}
+
+//! Names listed in the Vary header fields, in lower case
+static std::vector<std::string> vary_names(const http::headers& _headers)
+{
+  std::vector<std::string> names;
+  for ( const std::string& field : _headers.get_all("Vary") )
+  {
+    std::vector<std::string> tokens;
+    sid::split(tokens, field, ',', SPLIT_TRIM_SKIP_EMPTY);
+    for ( const std::string& token : tokens )
+      names.push_back(sid::to_lower(token));
+  }
+  return names;
+}
+
+int64_t cache_entry::age(time_t _now) const
+{
+  time_t date = header_date(head.headers, "Date");
+  uint64_t ageValue = 0;
+  sid::to_num(head.headers.get("Age"), ageValue);
+  int64_t apparentAge = ( date != 0 && responseTime > date )? (responseTime - date) : 0;
+  int64_t correctedAge = static_cast<int64_t>(ageValue) + (responseTime - requestTime);
+  int64_t initialAge = std::max(apparentAge, correctedAge);
+  return initialAge + std::max<int64_t>(_now - responseTime, 0);
+}
+
+//! Key of the responses of the request: the target URI
+static std::string cache_key(const http::client& _client)
+{
+  const http::request& request = _client.request;
+  std::string host = request.headers.get("Host");
+  if ( host.empty() && ! _client.conn.empty() )
+    host = _client.conn->server() + ":" + sid::to_str(_client.conn->port());
+  bool isHttps = ( ! _client.conn.empty() && _client.conn->type() == connection_type::https );
+  return std::string(isHttps? "https://" : "http://") + sid::to_lower(host) + request.uri;
+}
+
+//! Status of the client as client::run() would have set it
+static bool finish(http::client& _client)
+{
+  int code = static_cast<int>(_client.response.status.code());
+  if ( code >= 200 && code < 300 )
+  {
+    _client.exception().clear();
+    return true;
+  }
+  _client.exception() = sid::exception(code, "[" + sid::to_str(code) + "] " + _client.response.status.message());
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// cache_config and cache_stats
+//
+cache_config::cache_config()
+{
+  clear();
+}
+
+void cache_config::clear()
+{
+  max_memory = 64*1024*1024;
+  max_entry_size = 8*1024*1024;
+  disk_path.clear();
+  max_disk = 1024*1024*1024;
+  shared = false;
+  heuristic_ratio = 0.1;
+}
+
+std::string cache_stats::to_str() const
+{
+  return "hits=" + sid::to_str(hits) + " misses=" + sid::to_str(misses) + " revalidations=" + sid::to_str(revalidations)
+    + " not_modified=" + sid::to_str(not_modified) + " stores=" + sid::to_str(stores) + " evictions=" + sid::to_str(evictions)
+    + " invalidations=" + sid::to_str(invalidations) + " disk_hits=" + sid::to_str(disk_hits)
+    + " memory_bytes=" + sid::to_str(memory_bytes) + " disk_bytes=" + sid::to_str(disk_bytes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// cache
+//
+cache::cache(const cache_config& _config) : m_config(_config), m_fileCount(0)
+{
+}
+
+cache::~cache()
+{
+  clear();
+}
+
+cache_stats cache::stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+void cache::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for ( const entry_ptr& entry : m_disk )
+    ::unlink(entry->filePath.c_str());
+  m_memory.clear();
+  m_disk.clear();
+  m_entries.clear();
+  m_stats.memory_bytes = m_stats.disk_bytes = 0;
+}
+
+cache::entry_ptr cache::p_lookup(const std::string& _key, const http::request& _request)
+{
+  auto it = m_entries.find(_key);
+  if ( it == m_entries.end() )
+    return nullptr;
+  for ( const entry_ptr& entry : it->second )
+  {
+    bool isMatch = true;
+    for ( const auto& field : entry->vary )
+    {
+      if ( vary_value(_request.headers, field.first) != field.second )
+      {
+        isMatch = false;
+        break;
+      }
+    }
+    if ( ! isMatch )
+      continue;
+    entry_list& tier = entry->onDisk? m_disk : m_memory;
+    tier.splice(tier.begin(), tier, entry->it);
+    return entry;
+  }
+  return nullptr;
+}
+
+void cache::p_unlink(const entry_ptr& _entry)
+{
+  if ( _entry->onDisk )
+  {
+    ::unlink(_entry->filePath.c_str());
+    m_disk.erase(_entry->it);
+    m_stats.disk_bytes -= _entry->bytes;
+  }
+  else
+  {
+    m_memory.erase(_entry->it);
+    m_stats.memory_bytes -= _entry->bytes;
+  }
+  auto it = m_entries.find(_entry->key);
+  if ( it == m_entries.end() )
+    return;
+  std::vector<entry_ptr>& variants = it->second;
+  variants.erase(std::remove(variants.begin(), variants.end(), _entry), variants.end());
+  if ( variants.empty() )
+    m_entries.erase(it);
+}
+
+void cache::p_remove(const std::string& _key)
+{
+  auto it = m_entries.find(_key);
+  if ( it == m_entries.end() )
+    return;
+  std::vector<entry_ptr> variants = it->second;
+  for ( const entry_ptr& entry : variants )
+    p_unlink(entry);
+  m_stats.invalidations += variants.size();
+}
+
+std::string cache::p_write(const std::string& _data)
+{
+  std::string filePath = m_config.disk_path + "/sid-http-cache." + sid::to_str(::getpid()) + "." + sid::to_str(++m_fileCount);
+  int fd = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if ( fd == -1 )
+    return std::string();
+  bool isSuccess = true;
+  for ( size_t pos = 0; pos < _data.length(); )
+  {
+    ssize_t written = ::write(fd, _data.data() + pos, _data.length() - pos);
+    if ( written <= 0 )
+    {
+      if ( written < 0 && errno == EINTR ) continue;
+      isSuccess = false;
+      break;
+    }
+    pos += written;
+  }
+  ::close(fd);
+  if ( ! isSuccess )
+  {
+    ::unlink(filePath.c_str());
+    return std::string();
+  }
+  return filePath;
+}
+
+void cache::p_trim()
+{
+  // Move the least recently used payloads to disk (or drop them) until memory is within the limit
+  while ( m_stats.memory_bytes > m_config.max_memory && ! m_memory.empty() )
+  {
+    entry_ptr entry = m_memory.back();
+    std::string filePath;
+    if ( ! m_config.disk_path.empty() && entry->size <= m_config.max_disk )
+      filePath = p_write(entry->body);
+    if ( filePath.empty() )
+    {
+      p_unlink(entry);
+      m_stats.evictions++;
+      continue;
+    }
+    m_memory.pop_back();
+    m_stats.memory_bytes -= entry->bytes;
+    entry->body.clear();
+    entry->body.shrink_to_fit();
+    entry->filePath = filePath;
+    entry->onDisk = true;
+    m_disk.push_front(entry);
+    entry->it = m_disk.begin();
+    m_stats.disk_bytes += entry->bytes;
+  }
+  while ( m_stats.disk_bytes > m_config.max_disk && ! m_disk.empty() )
+  {
+    p_unlink(m_disk.back());
+    m_stats.evictions++;
+  }
+}
+
+bool cache::p_load(const entry_ptr& _entry, http::response& _response)
+{
+  _response = _entry->head;
+  if ( ! _entry->onDisk )
+  {
+    _response.content.set_data(_entry->body);
+    return true;
+  }
+  if ( _entry->size == 0 )
+    return true;
+
+  // The file is mapped, so the payload is copied once from the page cache
+  int fd = ::open(_entry->filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if ( fd == -1 )
+    return false;
+  void* data = ::mmap(nullptr, _entry->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if ( data == MAP_FAILED )
+    return false;
+  ::madvise(data, _entry->size, MADV_SEQUENTIAL);
+  _response.content.append(static_cast<const char*>(data), _entry->size);
+  ::munmap(data, _entry->size);
+  m_stats.disk_hits++;
+  return true;
+}
+
+void cache::p_store(const std::string& _key, const http::request& _request, const http::response& _response,
+                    time_t _requestTime, time_t _responseTime)
+{
+  entry_ptr entry = std::make_shared<cache_entry>();
+  entry->key = _key;
+  for ( const std::string& name : vary_names(_response.headers) )
+    entry->vary.emplace_back(name, vary_value(_request.headers, name));
+  entry->head.version = _response.version;
+  entry->head.status = _response.status;
+  entry->head.headers = _response.headers;
+  entry->head.decoded = _response.decoded;
+  // Hop-by-hop fields describe the connection the response came on (RFC 9111 section 3.1)
+  for ( const char* name : { "Connection", "Keep-Alive", "Proxy-Connection", "TE", "Transfer-Encoding", "Trailer", "Upgrade" } )
+    entry->head.headers.remove_all(name);
+  entry->size = _response.content.length();
+  entry->requestTime = _requestTime;
+  entry->responseTime = _responseTime;
+  p_refresh(entry, http::response(), _requestTime, _responseTime);
+
+  // Replace the stored response of the same variant
+  auto it = m_entries.find(_key);
+  if ( it != m_entries.end() )
+  {
+    std::vector<entry_ptr> variants = it->second;
+    for ( const entry_ptr& variant : variants )
+      if ( variant->vary == entry->vary )
+        p_unlink(variant);
+  }
+
+  entry->bytes = entry->size + entry->head.headers.to_str().length() + _key.length();
+  if ( entry->size > m_config.max_entry_size )
+  {
+    // Too large to be held in memory
+    if ( m_config.disk_path.empty() || entry->bytes > m_config.max_disk )
+      return;
+    entry->filePath = p_write(_response.content.data());
+    if ( entry->filePath.empty() )
+      return;
+    entry->onDisk = true;
+    m_disk.push_front(entry);
+    entry->it = m_disk.begin();
+    m_stats.disk_bytes += entry->bytes;
+  }
+  else
+  {
+    entry->body = _response.content.data();
+    m_memory.push_front(entry);
+    entry->it = m_memory.begin();
+    m_stats.memory_bytes += entry->bytes;
+  }
+  m_entries[_key].push_back(entry);
+  m_stats.stores++;
+  p_trim();
+}
+
+void cache::p_refresh(const entry_ptr& _entry, const http::response& _notModified, time_t _requestTime, time_t _responseTime)
+{
+  // The fields of a 304 replace the stored ones, except those describing the payload (RFC 9111 section 4.3.4)
+  for ( const http::header& field : _notModified.headers )
+  {
+    if ( ::strcasecmp(field.key.c_str(), "Content-Length") == 0 || ::strcasecmp(field.key.c_str(), "Content-Encoding") == 0
+         || ::strcasecmp(field.key.c_str(), "Transfer-Encoding") == 0 || ::strcasecmp(field.key.c_str(), "Connection") == 0
+         || ::strcasecmp(field.key.c_str(), "Keep-Alive") == 0 )
+      continue;
+    _entry->head.headers(field.key, field.value);
+  }
+  _entry->requestTime = _requestTime;
+  _entry->responseTime = _responseTime;
+
+  // Freshness lifetime (RFC 9111 section 4.2.1)
+  const http::headers& headers = _entry->head.headers;
+  cache_control cc(headers);
+  _entry->noCache = cc.noCache;
+  _entry->mustRevalidate = cc.mustRevalidate;
+  time_t date = header_date(headers, "Date");
+  if ( date == 0 ) date = _responseTime;
+  if ( m_config.shared && cc.sMaxAge >= 0 )
+    _entry->lifetime = cc.sMaxAge;
+  else if ( cc.maxAge >= 0 )
+    _entry->lifetime = cc.maxAge;
+  else if ( headers.exists("Expires") )
+  {
+    // An invalid Expires means that the response is already stale
+    time_t expires = header_date(headers, "Expires");
+    _entry->lifetime = ( expires > date )? (expires - date) : 0;
+  }
+  else
+  {
+    // Heuristic freshness: a share of the time since the last modification (RFC 9111 section 4.2.2)
+    time_t lastModified = header_date(headers, "Last-Modified");
+    _entry->lifetime = ( lastModified != 0 && lastModified < date && is_heuristically_cacheable(_entry->head.status.code()) )?
+      static_cast<int64_t>((date - lastModified) * m_config.heuristic_ratio) : 0;
+  }
+}
+
+bool cache::exchange(http::client& _client, const std::function<bool()>& _fnExchange)
+{
+  http::request& request = _client.request;
+  http::response& response = _client.response;
+  const std::string key = cache_key(_client);
+
+  if ( ! request.method.is_safe() )
+  {
+    // A successful unsafe request invalidates the stored responses of its URI (RFC 9111 section 4.4)
+    bool isSuccess = _fnExchange();
+    int code = static_cast<int>(response.status.code());
+    if ( (isSuccess || _client.exception().code() >= 100) && code >= 200 && code < 400 )
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      p_remove(key);
+    }
+    return isSuccess;
+  }
+  // Partial and conditional requests of the application are passed through. So are the responses that go
+  // to a sink, as their payload is not kept in the content and a stored payload would not reach the sink.
+  if ( (request.method != method_type::get && request.method != method_type::head) || response.sink
+       || request.headers.exists("Range") || request.headers.exists("If-Range")
+       || request.headers.exists("If-None-Match") || request.headers.exists("If-Modified-Since")
+       || request.headers.exists("If-Match") || request.headers.exists("If-Unmodified-Since") )
+    return _fnExchange();
+
+  const cache_control reqCC(request.headers);
+  const bool isHead = ( request.method == method_type::head );
+  std::string etag, lastModified;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    entry_ptr entry = p_lookup(key, request);
+    if ( entry )
+    {
+      time_t now = ::time(nullptr);
+      int64_t age = entry->age(now);
+      bool canUse = ! reqCC.noCache && ! entry->noCache
+        && ( reqCC.maxAge < 0 || age <= reqCC.maxAge )
+        && ( reqCC.minFresh < 0 || entry->lifetime - age >= reqCC.minFresh )
+        && ( age < entry->lifetime
+             || (reqCC.maxStale >= 0 && ! entry->mustRevalidate && age - entry->lifetime <= reqCC.maxStale) );
+      if ( canUse && p_load(entry, response) )
+      {
+        if ( isHead )
+          response.content.clear();
+        response.headers("Age", sid::to_str(age));
+        m_stats.hits++;
+        return finish(_client);
+      }
+      if ( ! isHead )
+      {
+        etag = entry->head.headers.get("ETag");
+        lastModified = entry->head.headers.get("Last-Modified");
+      }
+    }
+    if ( reqCC.onlyIfCached )
+    {
+      // Nothing usable in the cache and the server must not be contacted (RFC 9111 section 5.2.1.7)
+      m_stats.misses++;
+      response.clear();
+      response.version = request.version;
+      response.status = http::status_code::GatewayTimeout;
+      response.headers("Content-Length", "0");
+      return finish(_client);
+    }
+  }
+
+  // Validate the stored response with the server
+  bool isConditional = ! etag.empty() || ! lastModified.empty();
+  if ( ! etag.empty() )
+    request.headers("If-None-Match", etag);
+  if ( ! lastModified.empty() )
+    request.headers("If-Modified-Since", lastModified);
+
+  time_t requestTime = ::time(nullptr);
+  bool isSuccess = _fnExchange();
+  time_t responseTime = ::time(nullptr);
+  if ( isConditional )
+  {
+    request.headers.remove_all("If-None-Match");
+    request.headers.remove_all("If-Modified-Since");
+  }
+  bool hasResponse = ( isSuccess || _client.exception().code() >= 100 );
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if ( isConditional )
+    m_stats.revalidations++;
+  else
+    m_stats.misses++;
+  if ( ! hasResponse )
+    return isSuccess;
+
+  if ( isConditional && response.status.code() == http::status_code::NotModified )
+  {
+    entry_ptr entry = p_lookup(key, request);
+    http::response notModified = response;
+    if ( entry )
+    {
+      p_refresh(entry, notModified, requestTime, responseTime);
+      if ( p_load(entry, response) )
+      {
+        m_stats.not_modified++;
+        return finish(_client);
+      }
+      p_unlink(entry);
+    }
+    // The stored response went away meanwhile. The 304 is returned as it is.
+    response = notModified;
+    return isSuccess;
+  }
+
+  // Store the response if it is allowed (RFC 9111 section 3)
+  const cache_control respCC(response.headers);
+  const std::vector<std::string> varyNames = vary_names(response.headers);
+  const int code = static_cast<int>(response.status.code());
+  bool isStorable = ! isHead && code >= 200 && code != 206 && code != 304
+    && ! reqCC.noStore && ! respCC.noStore
+    && ! (m_config.shared && respCC.isPrivate)
+    && ! (m_config.shared && request.headers.exists("Authorization") && ! respCC.isPublic && respCC.sMaxAge < 0 && ! respCC.mustRevalidate)
+    && ! response.content.is_file()
+    && std::find(varyNames.begin(), varyNames.end(), "*") == varyNames.end()
+    && ( respCC.maxAge >= 0 || (m_config.shared && respCC.sMaxAge >= 0) || response.headers.exists("Expires")
+         || respCC.isPublic || is_heuristically_cacheable(response.status.code()) );
+  if ( isStorable )
+    p_store(key, request, response, requestTime, responseTime);
+  else if ( ! isHead )
+  {
+    // The response replaces whatever was stored for the request
+    entry_ptr entry = p_lookup(key, request);
+    if ( entry )
+      p_unlink(entry);
+  }
+  return isSuccess;
+}
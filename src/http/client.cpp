@@ -38,8 +38,10 @@ LICENSE: END
 */
 
 #include "http/http.hpp"
+#include "http/compression.hpp"
 #include "common/convert.hpp"
 #include <strings.h>
+#include <poll.h>
 
 using namespace std;
 using namespace sid;
@@ -53,6 +55,8 @@ client::client()
 
 void client::clear()
 {
+  decode_content = true;
+  continue_timeout_ms = 1000;
 }
 
 bool client::run(bool _followRedirects)
@@ -67,21 +71,48 @@ bool client::run(bool _followRedirects)
 }
 
 bool client::run(FNRedirectCallback& _redirect_callback, bool _followRedirects)
+{
+  // Advertise the content-codings we can decode, unless the application has chosen its own.
+  // This is done before the cache is looked up, as a stored response may vary on it.
+  if ( this->decode_content )
+    this->request.headers("Accept-Encoding", http::content_decoder::accept_encoding(), http::header_action::skip);
+  this->timing.clear();
+
+  if ( ! this->cache )
+    return p_run(_redirect_callback, _followRedirects);
+
+  return this->cache->exchange(*this, [&]() { return p_run(_redirect_callback, _followRedirects); });
+}
+
+bool client::p_run(FNRedirectCallback& _redirect_callback, bool _followRedirects)
 {
   bool isSuccess = false;
   bool loop = _followRedirects;
+  bool isReopen = false;
+  std::string reopenServer;
+  unsigned short reopenPort = 0;
+  bool isResend = false;  //! Send the request again (authentication, expectation failed)
   http::connection_ptr currentConn;  //! HTTP connection pointer used for request/response
 
+  bool isAuthPreemptive = false;  //! Authorization was added by the authentication cache before any challenge
+  std::string authHost;  //! Server and port the request is authorized for
+
   try
   {
     // The first connection object is the same as the current connection object.
     // It will change if there is a redirect
     currentConn = this->conn;
 
+    // An Authorization added by the authentication cache in the previous run is not reused, as Digest needs the next nonce count
+    if ( ! m_authorization.empty() && this->request.headers.get("Authorization") == m_authorization )
+      this->request.headers.remove_all("Authorization");
+    m_authorization.clear();
+
     do
     {
       bool expecting100Continue = false;
       isSuccess = false;
+      isResend = false;
       this->response.clear();
 
       if ( this->request.method == method_type::post || this->request.method == method_type::put )
@@ -90,33 +121,56 @@ bool client::run(FNRedirectCallback& _redirect_callback, bool _followRedirects)
         std::string hval = this->request.headers.get("Expect", &isFound);
         expecting100Continue = ( isFound && ::strcasecmp(hval.c_str(), "100-continue") == 0 );
       }
-      std::string data = this->request.to_str(!expecting100Continue);
-
-      if ( http::is_verbose() )
+      // The connection was closed as the server answered before the payload was sent
+      if ( isReopen && ! currentConn->open(reopenServer, reopenPort) )
+        throw sid::exception(currentConn->error());
+      isReopen = false;
+      // A streamed payload has to be sent again from its start (authentication, redirects)
+      if ( ! this->request.body.rewind() )
+        throw sid::exception("The payload cannot be sent again as its source cannot be rewound");
+      authHost = currentConn->server() + ":" + sid::to_str(currentConn->port());
+      if ( this->auth && ! this->request.userName.empty() && ! this->request.headers.exists("Authorization")
+           && this->auth->apply(this->request, authHost) )
       {
-        cerr << "=================================" << endl;
-        cerr << data << endl;
+        m_authorization = this->request.headers.get("Authorization");
+        isAuthPreemptive = true;
       }
+      if ( request_timing* timing = currentConn->timing() )
+        p_start_timing(*timing);
 
-      if ( ! this->request.send(currentConn, data) )
-        throw sid::exception(this->request.error);
-
-      if ( ! this->response.recv(currentConn, this->request.method) )
-        throw sid::exception(this->response.error);
+      if ( ! p_exchange_http2(currentConn) )
+      {
+        // The server details are cleared when the connection is closed
+        reopenServer = currentConn->server();
+        reopenPort = currentConn->port();
+        p_exchange_http1(currentConn, expecting100Continue);
+        isReopen = ! currentConn->is_open();
+      }
 
       if ( http::is_verbose() )
       {
         cerr << "=================================" << endl;
         http::content_encoding encoding = this->response.headers.content_encoding();
-        cerr << this->response.to_str( (encoding == http::content_encoding::identity) ) << endl;
+        cerr << this->response.to_str( (this->response.decoded || encoding == http::content_encoding::identity) ) << endl;
       }
 
       if ( this->response.status.code() == http::status_code::Unauthorized )
       {
         std::string wwwAuth;
+        // A preemptive Authorization can be refused for a stale nonce, so the new challenge is answered once
         if ( this->response.headers.exists("WWW-Authenticate", &wwwAuth)
-             && !this->request.headers.exists("Authorization") )
+             && ( !this->request.headers.exists("Authorization") || isAuthPreemptive ) )
         {
+          isAuthPreemptive = false;
+          if ( this->auth )
+          {
+            if ( ! this->auth->challenge(this->request, authHost, wwwAuth) )
+              throw sid::exception("Failed to perform authentication");
+            m_authorization = this->request.headers.get("Authorization");
+            isResend = true;
+            continue;
+          }
+
           www_authenticate_list authList;
           authList.set(wwwAuth);
           if ( authList.empty() )
@@ -124,45 +178,21 @@ bool client::run(FNRedirectCallback& _redirect_callback, bool _followRedirects)
 
           std::string authStr = authList[0].get_auth_string(this->request);
           this->request.headers("Authorization", authStr);
+          isResend = true;
           continue;
         }
       }
-      else if ( this->response.status.code() == http::status_code::Continue )
+      else if ( this->response.status.code() == http::status_code::ExpectationFailed && expecting100Continue )
       {
-        this->response.clear();
-
-        data = this->request.content().to_str();
-        cerr << "=================================" << endl;
-        cerr << "Sending actual data of size " << data.length() << endl;
-        /*
-        size_t totalLen = data.length();
-        const char* buffer = data.data();
-        const size_t BUF_SIZE = 4095;
-        do
-        {
-          size_t bufferLen = (totalLen <= BUF_SIZE)? totalLen : BUF_SIZE;
-          cerr << "     Sending chunk of size " << bufferLen << endl;
-          if ( ! this->request.send(currentConn, buffer, bufferLen) )
-            throw sid::exception(this->request.error);
-          totalLen -= bufferLen;
-          buffer += bufferLen;
-        } while ( totalLen != 0 );
-        */
-
-        if ( ! this->request.send(currentConn, data) )
-          throw sid::exception(this->request.error);
-
-        if ( ! this->response.recv(currentConn, this->request.method) )
-          throw sid::exception(this->response.error);
-
-        if ( http::is_verbose() )
-        {
-          cerr << "=================================" << endl;
-          cerr << this->response.to_str() << endl;
-        }
+        // The server does not support the expectation. Send the payload without waiting.
+        this->request.headers.remove_all("Expect");
+        isResend = true;
+        continue;
       }
 
       isSuccess = (static_cast<int>(this->response.status.code()) >= 200 && static_cast<int>(this->response.status.code()) < 300 );
+      if ( this->auth && ! m_authorization.empty() )
+        this->auth->update(this->request, authHost, this->response);
 
       if ( _followRedirects )
       {
@@ -179,11 +209,18 @@ bool client::run(FNRedirectCallback& _redirect_callback, bool _followRedirects)
 
           // create new connection pointer object
           currentConn = http::connection::create(url.type);
+          currentConn->set_timing(this->conn->timing() != nullptr);
           if ( !currentConn->open(url.server, url.port) )
             throw sid::exception(currentConn->error());
+          isReopen = false;
 
           this->request.headers.remove_all("Cookie");
           this->request.headers.remove_all("Host");
+          // The authentication cache authorizes the request for the new location, if it has a session there
+          if ( ! m_authorization.empty() && this->request.headers.get("Authorization") == m_authorization )
+            this->request.headers.remove_all("Authorization");
+          m_authorization.clear();
+          isAuthPreemptive = false;
           http::cookies s_cookies = http::cookies::get_session_cookies(url.server);
 
           this->request.uri = url.resource;
@@ -202,7 +239,7 @@ bool client::run(FNRedirectCallback& _redirect_callback, bool _followRedirects)
           loop = false;
       }
     }
-    while ( loop );
+    while ( loop || isResend );
 
     // If the status failed, set the status message
     if ( !isSuccess )
@@ -219,5 +256,134 @@ bool client::run(FNRedirectCallback& _redirect_callback, bool _followRedirects)
     isSuccess = false;
   }
 
+  if ( ! currentConn.empty() && currentConn->timing() )
+  {
+    // The connect phases belong to this request only. The next request on the connection reuses it.
+    request_timing* timing = currentConn->timing();
+    this->timing = *timing;
+    timing->clear();
+  }
+
   return isSuccess;
 }
+
+void client::p_start_timing(request_timing& _timing)
+{
+  // Keep the connect phases if the connection was opened for this request
+  _timing.request_start = request_timing::clock::now();
+  _timing.sent = _timing.first_byte = _timing.done = request_timing::clock::time_point();
+  _timing.io[static_cast<int>(timing_phase::send)].clear();
+  _timing.io[static_cast<int>(timing_phase::receive)].clear();
+  _timing.phase = timing_phase::send;
+}
+
+void client::p_exchange_http1(http::connection_ptr _conn, bool _expect100Continue)
+{
+  // A payload held in memory goes out along with the headers, unless it waits for "100 Continue".
+  // A streamed payload always follows the headers.
+  const bool isWithHeaders = ( this->request.body.empty() && ! _expect100Continue );
+  std::string data = this->request.to_str(isWithHeaders);
+
+  if ( http::is_verbose() )
+  {
+    cerr << "=================================" << endl;
+    cerr << data << endl;
+  }
+
+  if ( ! this->request.send(_conn, data) )
+    throw sid::exception(this->request.error);
+
+  if ( ! isWithHeaders )
+  {
+    bool isSendPayload = true;
+    if ( _expect100Continue )
+    {
+      // Wait for a while for the server to accept or reject the request. Servers that do not know
+      // the expectation never answer, so the payload is sent once the wait is over.
+      pollfd poll_fd = {_conn->descriptor(), POLLIN, 0};
+      int ret = ::poll(&poll_fd, 1, static_cast<int>(this->continue_timeout_ms));
+      if ( ret == -1 && errno != EINTR )
+        throw sid::exception(sid::to_errno_str("poll failed"));
+      if ( ret > 0 )
+      {
+        if ( ! this->response.recv(_conn, this->request.method, this->decode_content) )
+          throw sid::exception(this->response.error);
+        isSendPayload = ( this->response.status.code() == http::status_code::Continue );
+      }
+    }
+    if ( ! isSendPayload )
+    {
+      // The final response arrived instead of "100 Continue". The server still expects the payload
+      // that was not sent, so the connection cannot be used again.
+      _conn->close();
+      return;
+    }
+
+    if ( http::is_verbose() )
+    {
+      cerr << "=================================" << endl;
+      if ( this->request.body.empty() )
+        cerr << "Sending payload of size " << this->request.content().length() << endl;
+      else
+        cerr << "Sending streamed payload" << (this->request.body.has_length()? " of size " + sid::to_str(this->request.body.length()) : std::string()) << endl;
+    }
+    if ( ! this->request.send_body(_conn) )
+      throw sid::exception(this->request.error);
+  }
+  if ( request_timing* timing = _conn->timing() )
+  {
+    timing->sent = request_timing::clock::now();
+    timing->phase = timing_phase::receive;
+  }
+
+  // An interim "100 Continue" can still arrive after the payload if the server was slow to send it
+  do
+  {
+    this->response.clear();
+    if ( ! this->response.recv(_conn, this->request.method, this->decode_content) )
+      throw sid::exception(this->response.error);
+  }
+  while ( this->response.status.code() == http::status_code::Continue );
+}
+
+bool client::p_exchange_http2(http::connection_ptr _conn)
+{
+  bool isHttp2 = ( _conn->alpn_protocol() == HTTP2_ALPN_PROTOCOL )
+                 || ( _conn->type() == connection_type::http && this->request.version == http::version_id::v20 );
+  if ( ! isHttp2 )
+  {
+    // HTTP/2 was asked for, but the server did not agree to it
+    if ( this->request.version == http::version_id::v20 )
+      this->request.version = http::version_id::v11;
+    return false;
+  }
+
+  if ( ! m_http2 || m_http2Conn != _conn.ptr() || ! m_http2->is_usable() )
+  {
+    m_http2 = std::make_shared<http2_session>(_conn);
+    m_http2Conn = _conn;
+  }
+  m_http2->set_decode_content(this->decode_content);
+  this->request.version = http::version_id::v20;
+
+  if ( http::is_verbose() )
+  {
+    cerr << "=================================" << endl;
+    cerr << this->request.to_str() << endl;
+  }
+
+  // The session hands over a new response. Over HTTP/2 the sink gets the payload once it is complete.
+  http::FNResponseSink sink = this->response.sink;
+  if ( ! m_http2->exchange(this->request, this->response) )
+    throw sid::exception(m_http2->error());
+  this->response.sink = sink;
+  const int code = static_cast<int>(this->response.status.code());
+  if ( sink && code >= 200 && code < 300 && ! this->response.content.empty() )
+  {
+    const std::string& data = this->response.content.data();
+    if ( ! sink(this->response, data.data(), data.length()) )
+      throw sid::exception("Application was force stopped");
+    this->response.content.clear();
+  }
+  return true;
+}
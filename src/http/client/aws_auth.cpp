@@ -10,6 +10,10 @@
 #include <fstream>
 #include <cstdlib>
 #include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <common/convert.hpp>
 #include <common/hash.hpp>
 
@@ -30,6 +34,8 @@ void SignatureOutput::clear()
   stringToSign.clear();
   signature.clear();
   authStr.clear();
+  timeStamp.clear();
+  key.reset();
 }
 
 std::string SignatureOutput::toString() const
@@ -65,6 +71,7 @@ SignatureInput::SignatureInput()
 {
   data = NULL;
   dataLen = 0;
+  payload = PayloadSigning::signedPayload;
 }
 
 void SignatureInput::getSignature(SignatureOutput& out, const int awsApiVersion)
@@ -265,6 +272,7 @@ void SignatureInput::getSignature_v4(SignatureOutput& out)
   CanonicalData canonicalData;
   std::string objectKey;
   std::string hostOnly;
+  std::shared_ptr<const SigningKey> key;
   std::map<std::string, std::string>::const_iterator it;
 
   try
@@ -274,7 +282,28 @@ void SignatureInput::getSignature_v4(SignatureOutput& out)
     aws_region = AWS::getRegion(hostOnly);
 
     // Get has value of payload
-    hashedPayload = sid::to_lower(sha256.get_hash(data, dataLen).to_hex_str());
+    switch ( payload )
+    {
+    case PayloadSigning::unsignedPayload:
+      hashedPayload = "UNSIGNED-PAYLOAD";
+      break;
+    case PayloadSigning::streaming:
+      // The payload is sent aws-chunked. Its decoded length is signed as the chunks are signed separately.
+      hashedPayload = "STREAMING-" + p_awsHmacKey + "-PAYLOAD";
+      headers("Content-Encoding", "aws-chunked");
+      headers("x-amz-decoded-content-length", sid::to_str(dataLen));
+      break;
+    case PayloadSigning::unsignedTrailer:
+      // The aws-chunked headers are set by request::set_checksum() along with the checksum trailer
+      hashedPayload = "STREAMING-UNSIGNED-PAYLOAD-TRAILER";
+      break;
+    default:
+      if ( ! payloadHash.empty() )
+        hashedPayload = sid::to_lower(payloadHash);
+      else
+        hashedPayload = sha256.get_hash(data, dataLen).to_hex_str(true);
+      break;
+    }
 
     headers("x-amz-content-sha256", hashedPayload);
 
@@ -319,27 +348,20 @@ void SignatureInput::getSignature_v4(SignatureOutput& out)
     stringToSign = p_awsHmacKey + "\n" +
                    timeStamp + "\n" +
                    scope + "\n" +
-                   sid::to_lower(sha256.get_hash(canonicalRequest).to_hex_str());
+                   sha256.get_hash(canonicalRequest).to_hex_str(true);
 
     ///////////////////////////////////////////////////
-    // Generate the signing key
+    // Get the signing key (derived once per day, region and service)
     // variables: signingKey
-    digest = sha256.get_hmac("AWS4"+this->secret, dateStr);
-    if ( digest.empty() ) throw sid::exception("Failed to create the date key");
-    digest = sha256.get_hmac(digest.data(), aws_region);
-    if ( digest.empty() ) throw sid::exception("Failed to create the date region key");
-    digest = sha256.get_hmac(digest.data(), aws_service);
-    if ( digest.empty() ) throw sid::exception("Failed to create the date region service key");
-    digest = sha256.get_hmac(digest.data(), aws_request);
-    if ( digest.empty() ) throw sid::exception("Failed to create the signing key");
-    signingKey = digest.data();
+    key = SigningKeyCache::instance().get(accessKeyId, this->secret, dateStr, aws_region, aws_service);
+    signingKey = key->key;
 
     ///////////////////////////////////////////////////
     // Generate the signature
     // variables: signature
-    digest = sha256.get_hmac(signingKey, stringToSign);
+    digest = key->hmac.get_hmac(stringToSign);
     if ( digest.empty() ) throw sid::exception("Failed to create the signature");
-    signature = sid::to_lower(digest.to_hex_str());
+    signature = digest.to_hex_str(true);
 
     ///////////////////////////////////////////////////
     // Generate the "Authorization" header
@@ -368,6 +390,8 @@ void SignatureInput::getSignature_v4(SignatureOutput& out)
   out.stringToSign = stringToSign;
   out.signature = signature;
   out.authStr = authStr;
+  out.timeStamp = timeStamp;
+  out.key = key;
 }
 
 
@@ -476,6 +500,7 @@ bool SignatureInput::getCanonicalData(int awsVersion, CanonicalData& out)
     }
 
     // get all the query string values in a sorted fashion
+    std::string encoded;  // Buffer of the keys and values that need to be encoded
     std::map< std::string, std::vector<std::string> >::const_iterator it;
     for ( it = qsmap.begin(); it != qsmap.end(); it++ )
     {
@@ -486,10 +511,10 @@ bool SignatureInput::getCanonicalData(int awsVersion, CanonicalData& out)
       {
         const std::string& value = *itv;
         if ( ! out.queryString.empty() ) out.queryString += "&";
-        out.queryString += local::uriEncode(key, true);
+        out.queryString += http::url_encode(key, http::url_encoding::aws, encoded);
         out.queryString += "=";
         if ( ! value.empty() )
-          out.queryString += local::uriEncode(value, true);
+          out.queryString += http::url_encode(value, http::url_encoding::aws, encoded);
       }
     }
   }
@@ -546,6 +571,238 @@ bool SignatureInput::getCanonicalData(int awsVersion, CanonicalData& out)
   return true;
 }
 
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of SigningKeyCache
+//
+SigningKeyCache& SigningKeyCache::instance()
+{
+  static SigningKeyCache cache;
+  return cache;
+}
+
+std::shared_ptr<const SigningKey> SigningKeyCache::get(const std::string& _accessKeyId, const std::string& _secret,
+                                                       const std::string& _date, const std::string& _region, const std::string& _service)
+{
+  const std::string cacheKey = _accessKeyId + "/" + _date + "/" + _region + "/" + _service;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_keys.find(cacheKey);
+    // The secret of an access key can be rotated
+    if ( it != m_keys.end() && it->second->secret == _secret )
+      return it->second;
+  }
+
+  // Derive the key outside the lock
+  sid::hash::sha256 sha256;
+  sid::hash::digest digest = sha256.get_hmac("AWS4" + _secret, _date);
+  if ( digest.empty() ) throw sid::exception("Failed to create the date key");
+  digest = sha256.get_hmac(digest.data(), _region);
+  if ( digest.empty() ) throw sid::exception("Failed to create the date region key");
+  digest = sha256.get_hmac(digest.data(), _service);
+  if ( digest.empty() ) throw sid::exception("Failed to create the date region service key");
+  digest = sha256.get_hmac(digest.data(), "aws4_request");
+  if ( digest.empty() ) throw sid::exception("Failed to create the signing key");
+  std::shared_ptr<const SigningKey> key = std::make_shared<SigningKey>(_secret, digest.data());
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  if ( _date > m_date )
+  {
+    // A new day (UTC). The keys of the previous days are not needed anymore.
+    m_keys.clear();
+    m_date = _date;
+  }
+  m_keys[cacheKey] = key;
+  return key;
+}
+
+size_t SigningKeyCache::size()
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  return m_keys.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of StreamingPayload
+//
+namespace {
+
+//! Lowercase hex of the SHA-256 of an empty string
+const std::string EMPTY_SHA256 = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+
+//! Length of the chunk header without the hex size: ";chunk-signature=" + 64 hex digits + "\r\n"
+const size_t CHUNK_META_LENGTH = 17 + 64 + 2;
+
+/**
+ * @struct ChunkSigner
+ * @brief State of an aws-chunked payload, shared by the copies of its body source
+ */
+struct ChunkSigner
+{
+  http::body_source                 source;
+  std::shared_ptr<const SigningKey> key;
+  std::string                       prefix;         //! "AWS4-HMAC-SHA256-PAYLOAD\n<TimeStamp>\n<Scope>\n"
+  std::string                       prevSignature;  //! Signature of the previous chunk (the seed for the first one)
+  size_t                            chunkSize;
+  std::string                       data;           //! Data of the chunk being encoded
+  std::string                       encoded;        //! Encoded chunk that is not returned yet
+  size_t                            pos;            //! Position in encoded
+  bool                              isLast;         //! The final (empty) chunk has been encoded
+  sid::hash::hasher                 sha256;         //! Hashes the data of each chunk
+
+  ChunkSigner() : chunkSize(0), pos(0), isLast(false), sha256(sid::hash::sha256()) {}
+
+  size_t read(void* _buffer, size_t _count);
+  void   p_nextChunk();
+};
+
+void ChunkSigner::p_nextChunk()
+{
+  // Fill a complete chunk, as the source can return fewer bytes than requested
+  data.resize(chunkSize);
+  size_t dataLen = 0;
+  for ( size_t nread = 0; dataLen < chunkSize; dataLen += nread )
+  {
+    nread = source.read(&data[dataLen], chunkSize - dataLen);
+    if ( nread == 0 ) break;
+  }
+  data.resize(dataLen);
+  isLast = ( dataLen == 0 );
+
+  const std::string stringToSign = prefix + prevSignature + "\n" + EMPTY_SHA256 + "\n" +
+                                   sha256.update(data).final().to_hex_str(true);
+  sid::hash::digest digest = key->hmac.get_hmac(stringToSign);
+  if ( digest.empty() ) throw sid::exception("Failed to create the chunk signature");
+  prevSignature = digest.to_hex_str(true);
+
+  encoded = sid::to_lower(sid::to_str(dataLen, num_base::hex)) + ";chunk-signature=" + prevSignature + "\r\n";
+  encoded.append(data);
+  encoded.append("\r\n");
+  pos = 0;
+}
+
+size_t ChunkSigner::read(void* _buffer, size_t _count)
+{
+  if ( pos == encoded.length() )
+  {
+    if ( isLast ) return 0;
+    p_nextChunk();
+  }
+  size_t count = std::min(_count, encoded.length() - pos);
+  ::memcpy(_buffer, encoded.data() + pos, count);
+  pos += count;
+  return count;
+}
+
+} // anonymous namespace
+
+uint64_t StreamingPayload::encodedLength(uint64_t _decodedLength, size_t _chunkSize/* = defaultChunkSize*/)
+{
+  auto chunkLength = [](uint64_t _size)->uint64_t
+    {
+      return sid::to_str(_size, num_base::hex).length() + CHUNK_META_LENGTH + _size + 2;
+    };
+  const uint64_t fullChunks = _decodedLength / _chunkSize;
+  const uint64_t lastChunk = _decodedLength % _chunkSize;
+  return fullChunks * chunkLength(_chunkSize) + (lastChunk > 0? chunkLength(lastChunk) : 0) + chunkLength(0);
+}
+
+http::body_source StreamingPayload::create(const http::body_source& _source, const SignatureOutput& _seed, size_t _chunkSize/* = defaultChunkSize*/)
+{
+  if ( _seed.awsVersion != 4 || ! _seed.success || ! _seed.key )
+    throw sid::exception("A streaming payload needs a successful AWS version 4 signature");
+  if ( ! _source.has_length() )
+    throw sid::exception("A streaming payload needs a source of known length");
+  if ( _chunkSize == 0 )
+    throw sid::exception("Chunk size of a streaming payload cannot be 0");
+
+  std::shared_ptr<ChunkSigner> signer = std::make_shared<ChunkSigner>();
+  signer->source = _source;
+  signer->key = _seed.key;
+  signer->prefix = "AWS4-HMAC-SHA256-PAYLOAD\n" + _seed.timeStamp + "\n" + _seed.scope + "\n";
+  signer->prevSignature = _seed.signature;
+  signer->chunkSize = _chunkSize;
+  return http::body_source::from_reader([signer](void* _buffer, size_t _count) { return signer->read(_buffer, _count); },
+                                        encodedLength(_source.length(), _chunkSize));
+}
+
+std::string AWS::hashFile(const std::string& _filePath, uint64_t _offset/* = 0*/, uint64_t _length/* = http::body_source::unknown_length*/)
+{
+  // Files are mapped a window at a time to bound the address space used for very large files
+  const uint64_t mapWindow = 64*1024*1024;
+  const size_t readSize = 1024*1024;
+
+  int fd = ::open(_filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if ( fd == -1 )
+    throw sid::exception(sid::to_errno_str("Unable to open " + _filePath));
+  sid::hash::hasher sha256{sid::hash::sha256()};
+  try
+  {
+    struct stat st;
+    if ( ::fstat(fd, &st) != 0 )
+      throw sid::exception(sid::to_errno_str("Unable to stat " + _filePath));
+    if ( _length == http::body_source::unknown_length )
+    {
+      if ( ! S_ISREG(st.st_mode) || static_cast<uint64_t>(st.st_size) < _offset )
+        throw sid::exception("Unable to get the length of " + _filePath);
+      _length = st.st_size - _offset;
+    }
+
+    uint64_t done = 0;
+    if ( S_ISREG(st.st_mode) )
+    {
+      // Windows start at a page boundary
+      const uint64_t pageSize = ::sysconf(_SC_PAGESIZE);
+      while ( done < _length )
+      {
+        const uint64_t start = _offset + done;
+        const uint64_t mapOffset = start - (start % pageSize);
+        const uint64_t count = std::min(mapWindow, _length - done);
+        const size_t mapLength = (start - mapOffset) + count;
+        void* addr = ::mmap(nullptr, mapLength, PROT_READ, MAP_PRIVATE, fd, mapOffset);
+        if ( addr == MAP_FAILED ) break;  // Read the rest of the file
+        ::madvise(addr, mapLength, MADV_SEQUENTIAL);
+        try
+        {
+          sha256.update(static_cast<const uint8_t*>(addr) + (start - mapOffset), count);
+        }
+        catch (...)
+        {
+          ::munmap(addr, mapLength);
+          throw;
+        }
+        ::munmap(addr, mapLength);
+        done += count;
+      }
+    }
+    if ( done < _length )
+    {
+      ::posix_fadvise(fd, _offset + done, _length - done, POSIX_FADV_SEQUENTIAL);
+      std::unique_ptr<uint8_t[]> buffer(new uint8_t[readSize]);
+      while ( done < _length )
+      {
+        ssize_t nread = ::pread(fd, buffer.get(), std::min<uint64_t>(readSize, _length - done), _offset + done);
+        if ( nread < 0 && errno == EINTR ) continue;
+        if ( nread < 0 )
+          throw sid::exception(sid::to_errno_str("Unable to read " + _filePath));
+        if ( nread == 0 )
+          throw sid::exception(_filePath + " ended after " + sid::to_str(done) + " of " + sid::to_str(_length) + " bytes");
+        sha256.update(buffer.get(), nread);
+        done += nread;
+      }
+    }
+  }
+  catch (...)
+  {
+    ::close(fd);
+    throw;
+  }
+  ::close(fd);
+
+  return sha256.final().to_hex_str(true);
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 //
 // Implementation of local functions
@@ -671,25 +928,5 @@ std::string AWS::getApiVersion()
 
 std::string local::uriEncode(const std::string& uri, bool encodeSlash)
 {
-  std::string encodedUri;
-
-  for ( size_t i = 0; i < uri.length(); i++ )
-  {
-    const char ch = uri[i];
-    if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z')
-        || (ch >= '0' && ch <= '9')
-        || ch == '_' || ch == '-' || ch == '~' || ch == '.'
-        || (ch == '/' && !encodeSlash) )
-    {
-      encodedUri.push_back(ch);
-    }
-    else
-    {
-      std::string csHex = sid::to_str((unsigned char) ch, num_base::hex);
-      if ( csHex.length() == 1 ) csHex = "0" + csHex;
-      encodedUri.append("%"+csHex);
-    }
-  }
-
-  return encodedUri;
+  return http::url_encode(uri, encodeSlash? http::url_encoding::aws : http::url_encoding::aws_path);
 }
@@ -10,7 +10,10 @@
 
 #include <string>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <http/http.hpp>
+#include <common/hash.hpp>
 
 typedef std::map<std::string, std::string> StringMap;
 
@@ -38,6 +41,69 @@ namespace AWS
   std::string getRegion(const std::string& host);
   std::string getApiVersion();
 
+  /**
+   * @fn std::string hashFile(const std::string& _filePath, uint64_t _offset = 0, uint64_t _length = http::body_source::unknown_length);
+   * @brief Lowercase hex SHA-256 of a range of the file (the default range is from _offset till the end of the file).
+   *        The file is mapped a window at a time, or read in large sequential pieces if it cannot be mapped,
+   *        so that the payload hash of an upload is computed in a pre-pass without holding the file in memory.
+   *        Throws sid::exception on failure.
+   */
+  std::string hashFile(const std::string& _filePath, uint64_t _offset = 0, uint64_t _length = http::body_source::unknown_length);
+
+  /**
+   * @enum PayloadSigning
+   * @brief How the payload is covered by a SigV4 signature (x-amz-content-sha256)
+   */
+  enum class PayloadSigning
+  {
+    signedPayload,    //! SHA-256 of the whole payload is signed
+    unsignedPayload,  //! UNSIGNED-PAYLOAD. The payload is not covered by the signature.
+    streaming,        //! STREAMING-AWS4-HMAC-SHA256-PAYLOAD. The payload is sent aws-chunked, each chunk signed.
+    unsignedTrailer   //! STREAMING-UNSIGNED-PAYLOAD-TRAILER. The payload is sent aws-chunked with a checksum trailer
+                      //! by http::request (see http::checksum_location::aws_chunked), the chunks are not signed.
+  };
+
+  /**
+   * @struct SigningKey
+   * @brief SigV4 signing key of a scope, with an HMAC context keyed with it for the signatures
+   */
+  struct SigningKey
+  {
+    std::string             secret;  //! Secret the key was derived from
+    std::string             key;     //! HMAC(HMAC(HMAC(HMAC("AWS4"+secret, date), region), service), "aws4_request")
+    sid::hash::hmac_key     hmac;    //! HMAC-SHA256 keyed with the signing key
+
+    SigningKey(const std::string& _secret, const std::string& _key) : secret(_secret), key(_key), hmac(sid::hash::sha256(), _key) {}
+  };
+
+  /**
+   * @class SigningKeyCache
+   * @brief Thread-safe cache of SigV4 signing keys keyed by (access key, date, region, service).
+   *        Deriving a key takes four HMACs, while every request of the day to the same region and service
+   *        uses the same key. Keys of the other dates are dropped when a new date is seen, so the cache
+   *        refreshes itself at UTC midnight.
+   */
+  class SigningKeyCache
+  {
+  public:
+    static SigningKeyCache& instance();
+
+    //! Get the signing key, deriving it if it is not cached. Throws sid::exception on failure.
+    std::shared_ptr<const SigningKey> get(const std::string& _accessKeyId, const std::string& _secret,
+                                          const std::string& _date, const std::string& _region, const std::string& _service);
+
+    //! Number of keys in the cache
+    size_t size();
+
+  private:
+    SigningKeyCache() = default;
+
+  private:
+    std::mutex  m_lock;
+    std::string m_date;  //! Date (YYYYMMDD) of the keys in the cache
+    std::map<std::string, std::shared_ptr<const SigningKey>> m_keys;
+  };
+
   struct SignatureOutput
   {
     int         awsVersion;
@@ -48,6 +114,8 @@ namespace AWS
     std::string stringToSign;
     std::string signature;
     std::string authStr;
+    std::string timeStamp;                     //! x-amz-date of the request (SigV4)
+    std::shared_ptr<const SigningKey> key;     //! Signing key of the scope (SigV4), used to sign the payload chunks
 
   public:
     SignatureOutput() { clear(); }
@@ -65,7 +133,9 @@ namespace AWS
     std::string  accessKeyId;
     std::string  secret;
     const uint8_t* data;
-    uint64_t       dataLen;
+    uint64_t       dataLen;      //! Length of the payload. data can be NULL when the payload is not in memory.
+    PayloadSigning payload;      //! How the payload is signed (SigV4)
+    std::string    payloadHash;  //! Hex SHA-256 of the payload computed beforehand (eg: hashFile). Used instead of data.
 
     struct CanonicalData
     {
@@ -86,6 +156,36 @@ namespace AWS
   private:
     std::string private_fixAndGetHost(std::string* hostOnly = nullptr);
   };
+
+  /**
+   * @class StreamingPayload
+   * @brief Encodes a payload as aws-chunked for STREAMING-AWS4-HMAC-SHA256-PAYLOAD uploads.
+   *        Each chunk is signed as it is read from the source, chaining from the seed signature of the request:
+   *
+   *        <hex(size)>;chunk-signature=<signature>\r\n<data>\r\n ... 0;chunk-signature=<signature>\r\n\r\n
+   *
+   *        signature = HMAC-SHA256(<Signing_Key>, "AWS4-HMAC-SHA256-PAYLOAD" + "\n" + <TimeStamp> + "\n" + <Scope> + "\n" +
+   *                                <Previous_Signature> + "\n" + HEX(SHA256Hash("")) + "\n" + HEX(SHA256Hash(<data>)))
+   */
+  class StreamingPayload
+  {
+  public:
+    static const size_t defaultChunkSize = 64*1024;  //! Minimum accepted by S3 is 8 KB (other than the last chunk)
+
+    /**
+     * @fn uint64_t encodedLength(uint64_t _decodedLength, size_t _chunkSize = defaultChunkSize);
+     * @brief Length of the aws-chunked payload (Content-Length of the request)
+     */
+    static uint64_t encodedLength(uint64_t _decodedLength, size_t _chunkSize = defaultChunkSize);
+
+    /**
+     * @fn http::body_source create(const http::body_source& _source, const SignatureOutput& _seed, size_t _chunkSize = defaultChunkSize);
+     * @brief Create a source that reads _source (its length must be known) and returns it aws-chunked, signed using
+     *        the signature of the request headers (_seed). The source cannot be rewound, as the request is signed
+     *        again when it is resent. Throws sid::exception if the seed is not a SigV4 streaming signature.
+     */
+    static http::body_source create(const http::body_source& _source, const SignatureOutput& _seed, size_t _chunkSize = defaultChunkSize);
+  };
 }
 
 #endif // _AWS_AUTH_H_
@@ -0,0 +1,182 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// @file load_generator.cpp
+// @brief Implementation of the load generator
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+#include "load_generator.h"
+
+#include <thread>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+#include <common/convert.hpp>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of LoadConfig and LoadReport
+//
+LoadConfig::LoadConfig()
+{
+  concurrency = 1;
+  requests = 0;
+  duration = 10;
+  rate = 0;
+  keepAlive = true;
+  family = http::connection_family::none;
+}
+
+void LoadReport::clear()
+{
+  requests = succeeded = 0;
+  bytesSent = bytesRecv = 0;
+  elapsedUs = 0;
+  latency.clear();
+  errors.clear();
+}
+
+void LoadReport::merge(const LoadReport& _other)
+{
+  requests += _other.requests;
+  succeeded += _other.succeeded;
+  bytesSent += _other.bytesSent;
+  bytesRecv += _other.bytesRecv;
+  latency.merge(_other.latency);
+  for ( const auto& error : _other.errors )
+    errors[error.first] += error.second;
+}
+
+std::string LoadReport::toString() const
+{
+  std::ostringstream out;
+  double secs = elapsedUs / 1000000.0;
+  out << std::fixed << std::setprecision(2);
+  out << "Requests   : " << requests << " in " << secs << " s, " << succeeded << " succeeded, " << (requests - succeeded) << " failed" << endl;
+  if ( secs > 0 )
+  {
+    out << "Rate       : " << requests / secs << " requests/s" << endl;
+    out << "Throughput : " << bytesRecv / secs / (1024*1024) << " MB/s received, " << bytesSent / secs / (1024*1024) << " MB/s sent" << endl;
+  }
+  out << "Latency    : " << latency.to_str("us") << endl;
+  for ( const auto& error : errors )
+    out << "Error      : " << error.second << " x " << error.first << endl;
+  return out.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of LoadGenerator
+//
+bool LoadGenerator::run(const std::string& _url, const http::request& _request)
+{
+  m_error.clear();
+  m_report.clear();
+  try
+  {
+    if ( ! m_url.set(_url) )
+      throw sid::exception(m_url.error);
+    if ( config.concurrency == 0 )
+      throw sid::exception("Concurrency must be greater than 0");
+    if ( config.requests == 0 && config.duration == 0 )
+      throw sid::exception("Either the number of requests or the duration must be set");
+
+    http::request request = _request;
+    request.uri = m_url.resource;
+    request.headers("Host", m_url.server);
+    if ( ! config.keepAlive )
+      request.headers("Connection", "close");
+    if ( ! config.infile.empty() && request.body.empty() )
+      request.set_content(http::body_source::from_file(config.infile));
+    else if ( config.infile.empty() && ! request.body.empty() )
+      throw sid::exception("A streamed payload cannot be shared by the connections. Set it in config.infile.");
+    m_auth = request.userName.empty()? nullptr : std::make_shared<http::auth_cache>();
+
+    std::vector<LoadReport> reports(config.concurrency);
+    std::vector<std::thread> workers;
+    m_next = 0;
+    m_start = clock::now();
+    m_end = m_start + std::chrono::seconds(config.duration);
+    for ( uint32_t i = 0; i < config.concurrency; i++ )
+      workers.emplace_back([&, i]() { p_worker(request, reports[i]); });
+    for ( std::thread& worker : workers )
+      worker.join();
+    for ( const LoadReport& report : reports )
+      m_report.merge(report);
+    m_report.elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - m_start).count();
+  }
+  catch (const sid::exception& e)
+  {
+    m_error = e.what();
+  }
+  return m_error.empty();
+}
+
+void LoadGenerator::p_worker(const http::request& _request, LoadReport& _report)
+{
+  http::client client;
+  client.request = _request;
+  client.auth = m_auth;
+  // The headers of the payload are those of the request, but the file is read from a source of this worker
+  if ( ! config.infile.empty() )
+    client.request.body = http::body_source::from_file(config.infile);
+  const std::chrono::nanoseconds period( (config.rate > 0)? static_cast<int64_t>(1e9 / config.rate) : 0 );
+
+  while ( true )
+  {
+    const uint64_t index = m_next++;
+    if ( config.requests != 0 && index >= config.requests )
+      break;
+
+    // In open-loop mode the request is due at its slot in the schedule, whether or not the previous one is done
+    clock::time_point scheduled = clock::now();
+    if ( config.rate > 0 )
+    {
+      scheduled = m_start + period * index;
+      if ( config.duration != 0 && scheduled >= m_end )
+        break;
+      std::this_thread::sleep_until(scheduled);
+    }
+    else if ( config.duration != 0 && scheduled >= m_end )
+      break;
+
+    std::string error;
+    try
+    {
+      if ( client.conn.empty() || ! client.conn->is_open() )
+      {
+        client.conn = http::connection::create(m_url.type, config.family);
+        if ( ! client.conn->open(m_url.server, m_url.port) )
+          throw sid::exception(client.conn->error());
+      }
+      client.response.clear();
+      if ( ! client.run() && client.exception().code() < 100 )
+        throw client.exception();
+      int code = static_cast<int>(client.response.status.code());
+      if ( code >= 400 )
+        error = "HTTP " + client.response.status.to_str();
+      if ( ! config.keepAlive || ! http::response_parser::keep_alive(client.response) )
+        client.conn->close();
+      _report.bytesSent += client.request.to_str(false).length()
+                           + (client.request.body.empty()? client.request.content().length() :
+                              client.request.body.has_length()? client.request.body.length() : 0);
+      _report.bytesRecv += client.response.content.length();
+    }
+    catch (const sid::exception& e)
+    {
+      // The connection is in an unknown state after a failure
+      error = e.what();
+      if ( ! client.conn.empty() )
+        client.conn->close();
+    }
+
+    _report.latency.record(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - scheduled).count());
+    _report.requests++;
+    if ( error.empty() )
+      _report.succeeded++;
+    else
+      _report.errors[error]++;
+  }
+}
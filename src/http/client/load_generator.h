@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// @file load_generator.h
+// @brief Load generator used to benchmark an HTTP server
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _LOAD_GENERATOR_H_
+#define _LOAD_GENERATOR_H_
+
+#include <string>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <http/http.hpp>
+#include <common/histogram.hpp>
+
+using namespace sid;
+
+/**
+ * @struct LoadConfig
+ * @brief Parameters of a load run.
+ *        The run stops when the number of requests is sent or the duration elapses, whichever is first.
+ */
+struct LoadConfig
+{
+  uint32_t concurrency;  //! Number of connections, each driven by its own thread
+  uint64_t requests;     //! Number of requests to send (0 for no limit)
+  uint32_t duration;     //! Length of the run in seconds (0 for no limit)
+  double   rate;         //! Requests per second across all connections. 0 runs closed-loop (as fast as the server answers).
+  bool     keepAlive;    //! Reuse connections. Otherwise every request is sent on a new connection.
+  std::string infile;    //! File streamed as the payload. Every connection reads it from its own source.
+  http::connection_family family;
+
+  LoadConfig();
+};
+
+/**
+ * @struct LoadReport
+ * @brief Results of a load run.
+ */
+struct LoadReport
+{
+  uint64_t          requests;     //! Requests completed (successful or not)
+  uint64_t          succeeded;    //! Requests that received a 2xx or 3xx response
+  uint64_t          bytesSent;    //! Bytes of the requests sent (headers and payloads)
+  uint64_t          bytesRecv;    //! Bytes of the payloads received
+  uint64_t          elapsedUs;    //! Length of the run
+  sid::histogram    latency;      //! Latency of the requests in microseconds
+  std::map<std::string, uint64_t> errors; //! Failed requests by HTTP status or error message
+
+  LoadReport() { clear(); }
+  void clear();
+  void merge(const LoadReport& _other);
+  std::string toString() const;
+};
+
+/**
+ * @class LoadGenerator
+ * @brief Sends the same request to a server from many connections and measures the latency.
+ *
+ * In closed-loop mode (rate = 0) each connection sends its next request as soon as the previous one is answered.
+ * In open-loop mode the requests are scheduled at a constant rate, and the latency of each request is measured
+ * from the time it was scheduled rather than the time it was sent. So a stalled server is charged for the
+ * requests it held back as well (correcting coordinated omission), provided the concurrency is high enough to
+ * sustain the rate.
+ */
+class LoadGenerator
+{
+public:
+  LoadConfig config;
+
+public:
+  LoadGenerator() : m_next(0) {}
+
+  /**
+   * @fn bool run(const std::string& _url, const http::request& _request);
+   * @brief Send the request to the server in the url. The uri and Host of the request are taken from the url.
+   *        A streamed payload must be given in config.infile rather than in the body of the request, as the
+   *        copies of a body_source share their read position.
+   *
+   * @return true if the run completed. error() has the reason for failure otherwise.
+   */
+  bool run(const std::string& _url, const http::request& _request);
+
+  const std::string& error() const { return m_error; }
+  const LoadReport& report() const { return m_report; }
+
+private:
+  void p_worker(const http::request& _request, LoadReport& _report);
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  http::url             m_url;
+  std::string           m_error;
+  LoadReport            m_report;
+  clock::time_point     m_start;   //! Start of the run
+  clock::time_point     m_end;     //! End of the run (if there is a duration)
+  std::atomic<uint64_t> m_next;    //! Index of the next request to send
+  std::shared_ptr<http::auth_cache> m_auth; //! Challenges answered by any worker, so that the others authorize up front
+};
+
+#endif // _LOAD_GENERATOR_H_
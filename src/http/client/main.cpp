@@ -6,9 +6,12 @@
 #include <fstream>
 #include <common/convert.hpp>
 #include <common/hash.hpp>
+#include <common/checksum.hpp>
 
 #include "main.h"
 #include "aws_auth.h"
+#include "s3_multipart.h"
+#include "load_generator.h"
 #include <cstring>
 #include <cstdlib>
 
@@ -19,7 +22,7 @@ using namespace std;
 
 struct CommonParams
 {
-  CommonParams() : method(http::method_type::get) { ip.v4 = ip.v6 = 0; }
+  CommonParams() : method(http::method_type::get), checksum(sid::checksum::type::none) { ip.v4 = ip.v6 = 0; }
   std::string      url;
   http::method     method;
   http::version    version;
@@ -29,6 +32,7 @@ struct CommonParams
   std::string      outfile;
   std::string      userName;
   std::string      password;
+  sid::checksum::type checksum;  //! Checksum sent with the payload, or requested and verified for GET
   struct
   {
     uint8_t v4 : 1;
@@ -52,7 +56,12 @@ struct AWSParams
   std::string bucket;
   std::string id;
   std::string key;
-  AWSParams() { version = 2; }
+  uint64_t    partSize;     //! Upload --infile using multipart upload with parts of this size (0 disables it)
+  uint32_t    concurrency;  //! Number of parts uploaded in parallel
+  AWS::PayloadSigning payload;  //! How the payload is covered by a version 4 signature
+  std::string payloadHash;  //! SHA-256 of --infile, computed once for a signed payload
+  AWSParams() { version = 2; partSize = 0; concurrency = 4; payload = AWS::PayloadSigning::signedPayload; }
+  bool isMultipart() const { return partSize > 0; }
 };
 
 struct AzureParams
@@ -62,6 +71,13 @@ struct AzureParams
   std::string key;
 };
 
+struct BenchParams
+{
+  bool        enabled;      //! Run as a load generator instead of sending a single request
+  LoadConfig  config;
+  BenchParams() { enabled = false; }
+};
+
 struct Global
 {
   std::string scriptName;
@@ -74,6 +90,7 @@ struct Global
   CommonParams http;
   AWSParams    aws;
   AzureParams  azure;
+  BenchParams  bench;
 
   Global()
     {
@@ -99,14 +116,24 @@ enum ParamType {
   PT_outfile,
   PT_blocking,
   PT_timeout,
-  PT_verbose
+  PT_verbose,
+  PT_bench,
+  PT_concurrency,
+  PT_requests,
+  PT_duration,
+  PT_rate,
+  PT_keep_alive,
+  PT_checksum
 };
 
 enum AWSPType {
   PT_aws_version,
   PT_aws_bucket,
   PT_aws_id,
-  PT_aws_key
+  PT_aws_key,
+  PT_aws_part_size,
+  PT_aws_concurrency,
+  PT_aws_payload
 };
 
 enum AzurePType {
@@ -152,6 +179,13 @@ ValidParams global_valid_params[] =
   {"--blocking", "-b", PT_blocking, OPTIONAL_SINGLE_NON_EMPTY},
   {"--timeout",  "-t", PT_timeout,  OPTIONAL_SINGLE_NON_EMPTY},
   {"--verbose",  "-v", PT_verbose,  OPTIONAL_SINGLE_NO_DATA},
+  {"--bench",       NULL, PT_bench,       OPTIONAL_SINGLE_NO_DATA},
+  {"--concurrency", NULL, PT_concurrency, OPTIONAL_SINGLE_NON_EMPTY},
+  {"--requests",    NULL, PT_requests,    OPTIONAL_SINGLE_NON_EMPTY},
+  {"--duration",    NULL, PT_duration,    OPTIONAL_SINGLE_NON_EMPTY},
+  {"--rate",        NULL, PT_rate,        OPTIONAL_SINGLE_NON_EMPTY},
+  {"--keep-alive",  NULL, PT_keep_alive,  OPTIONAL_SINGLE_NON_EMPTY},
+  {"--checksum",    NULL, PT_checksum,    OPTIONAL_SINGLE_NON_EMPTY},
   {NULL,         NULL, PT_none,     0}
 };
 
@@ -162,6 +196,9 @@ ValidParams global_aws_params[] =
   {P_aws_bucket,  NULL, PT_aws_bucket,  REQUIRED_SINGLE_NON_EMPTY},
   {P_aws_id,      NULL, PT_aws_id,      REQUIRED_SINGLE_NON_EMPTY},
   {P_aws_key,     NULL, PT_aws_key,     REQUIRED_SINGLE_NON_EMPTY},
+  {P_aws_part_size,   NULL, PT_aws_part_size,   OPTIONAL_SINGLE_NON_EMPTY},
+  {P_aws_concurrency, NULL, PT_aws_concurrency, OPTIONAL_SINGLE_NON_EMPTY},
+  {P_aws_payload,     NULL, PT_aws_payload,     OPTIONAL_SINGLE_NON_EMPTY},
   {NULL,          NULL, -1,        0}
 };
 
@@ -197,7 +234,7 @@ void showUsage(const std::string& csErr = "")
   cout << "    --verbose" << endl;
   cout << "    -l --url=(http|https)://<url>" << endl;
   cout << "    -m --method=GET|POST|PUT|DELETE|HEAD (Optional: Defaults to GET)" << endl;
-  cout << "    -v --version=1.1|1.0 (Optional: Defaults to 1.1)" << endl;
+  cout << "    -v --version=2|1.1|1.0 (Optional: Defaults to 1.1. For https, 2 is negotiated and falls back to 1.1)" << endl;
   cout << "    -4 --ipv4 (default)" << endl;
   cout << "    -6 --ipv6" << endl;
   cout << "    -h --header=name:value" << endl;
@@ -209,11 +246,26 @@ void showUsage(const std::string& csErr = "")
   cout << "       --blocking=true|false (Optional: Defaults to true)" << endl;
   cout << "       --timeout=SECONDS (Optional: Defaults to " << DEFAULT_IO_TIMEOUT_SECS << ")" << endl;
   cout << "           Note: --timeout is applicable only for non-blocking mode, when --blocking=false" << endl;
+  cout << "       --checksum=crc32c|crc64nvme (Optional: Send the checksum of the payload in x-amz-checksum-<type>." << endl;
+  cout << "           For GET, it is requested with x-amz-checksum-mode and the response is verified against it)" << endl;
+  cout << "  [Benchmark options]" << endl;
+  cout << "       --bench (Send the request repeatedly and report the rate and the latency percentiles)" << endl;
+  cout << "       --concurrency=N (Optional: Connections used in parallel. Defaults to 1)" << endl;
+  cout << "       --requests=N (Optional: Stop after N requests)" << endl;
+  cout << "       --duration=SECONDS (Optional: Stop after the duration. Defaults to 10 if --requests is not given)" << endl;
+  cout << "       --rate=N (Optional: Send N requests/s on a fixed schedule (open-loop). Defaults to closed-loop)" << endl;
+  cout << "       --keep-alive=true|false (Optional: Reuse connections. Defaults to true)" << endl;
+  cout << "           Note: The request payload is taken from --data or --infile" << endl;
   cout << "  [AWS options]" << endl;
   cout << "       --aws-bucket=<AmazonS3 Bucket Name>" << endl;
   cout << "       --aws-id=<AmazonS3 Access ID>" << endl;
   cout << "       --aws-key=<AmazonS3 Secret Key>" << endl;
   cout << "       --aws-version=(2|4) (Optional: Defaults to 2)" << endl;
+  cout << "       --aws-part-size=<bytes> (Optional: PUT --infile as a multipart upload with parts of this size, minimum 5 MB)" << endl;
+  cout << "       --aws-concurrency=N (Optional: Parts uploaded in parallel in a multipart upload. Defaults to 4)" << endl;
+  cout << "       --aws-payload=(signed|unsigned|streaming|trailer) (Optional: How version 4 signs the payload. Defaults to signed)" << endl;
+  cout << "           Note: --infile is hashed in a pre-pass when signed, and sent aws-chunked with signed chunks when streaming" << endl;
+  cout << "                 trailer sends the payload aws-chunked, unsigned, with the --checksum in a trailer" << endl;
   cout << "  [Azure options]" << endl;
   cout << "       --azure-container=<Azure Container Name>" << endl;
   cout << "       --azure-account=<Azure Account Name>" << endl;
@@ -319,6 +371,30 @@ void validateAwsParams()
       case PT_aws_bucket: global.aws.bucket = param.value; break;
       case PT_aws_id:     global.aws.id = param.value; break;
       case PT_aws_key:    global.aws.key = param.value; break;
+      case PT_aws_part_size:
+        if ( ! sid::to_num(param.value, global.aws.partSize, &csError) )
+          throw sid::exception(param.key + ": " + csError);
+        if ( global.aws.partSize == 0 )
+          throw sid::exception(param.key + ": Part size must be greater than 0");
+        break;
+      case PT_aws_concurrency:
+        if ( ! sid::to_num(param.value, global.aws.concurrency, &csError) )
+          throw sid::exception(param.key + ": " + csError);
+        if ( global.aws.concurrency == 0 )
+          throw sid::exception(param.key + ": Concurrency must be greater than 0");
+        break;
+      case PT_aws_payload:
+        if ( param.value == "signed" )
+          global.aws.payload = AWS::PayloadSigning::signedPayload;
+        else if ( param.value == "unsigned" )
+          global.aws.payload = AWS::PayloadSigning::unsignedPayload;
+        else if ( param.value == "streaming" )
+          global.aws.payload = AWS::PayloadSigning::streaming;
+        else if ( param.value == "trailer" )
+          global.aws.payload = AWS::PayloadSigning::unsignedTrailer;
+        else
+          throw sid::exception(param.key + ": Invalid value specified");
+        break;
       }
     }
   }
@@ -329,6 +405,8 @@ void validateAwsParams()
     throw sid::exception("Missing --aws-id");
   if ( ! params_count.exists(PT_aws_key) )
     throw sid::exception("Missing --aws-key");
+  if ( global.aws.payload != AWS::PayloadSigning::signedPayload && global.aws.version != 4 )
+    throw sid::exception(P_aws_payload " requires " P_aws_version "=4");
 }
 
 void validateAtmosParams()
@@ -408,6 +486,7 @@ void parseCommandLine(std::vector<std::string>& args, std::string& location, htt
   
   bool timeoutSet = false;
   std::string timeoutValue;
+  std::string csError;
 
   for ( size_t i = 0; i < args.size(); i++ )
   {
@@ -448,6 +527,36 @@ void parseCommandLine(std::vector<std::string>& args, std::string& location, htt
       case PT_blocking: global.blocking = sid::to_bool(param.value); break;
       case PT_timeout:  timeoutSet = true; timeoutValue = param.value; break;
       case PT_verbose:  global.verbose = true; http::set_verbose(global.verbose); break;
+      case PT_bench:    global.bench.enabled = true; break;
+      case PT_concurrency:
+        if ( ! sid::to_num(param.value, global.bench.config.concurrency, &csError) )
+          throw sid::exception(param.key + ": " + csError);
+        if ( global.bench.config.concurrency == 0 )
+          throw sid::exception(param.key + ": Concurrency must be greater than 0");
+        break;
+      case PT_requests:
+        if ( ! sid::to_num(param.value, global.bench.config.requests, &csError) )
+          throw sid::exception(param.key + ": " + csError);
+        break;
+      case PT_duration:
+        if ( ! sid::to_num(param.value, global.bench.config.duration, &csError) )
+          throw sid::exception(param.key + ": " + csError);
+        break;
+      case PT_rate:
+      {
+        long double rate = 0;
+        if ( ! sid::to_num(param.value, rate, &csError) )
+          throw sid::exception(param.key + ": " + csError);
+        if ( rate <= 0 )
+          throw sid::exception(param.key + ": Rate must be greater than 0");
+        global.bench.config.rate = static_cast<double>(rate);
+        break;
+      }
+      case PT_keep_alive: global.bench.config.keepAlive = sid::to_bool(param.value); break;
+      case PT_checksum:
+        if ( ! sid::checksum::from_str(param.value, global.http.checksum) || global.http.checksum == sid::checksum::type::none )
+          throw sid::exception(param.key + ": Invalid value specified");
+        break;
       }
     }
   }
@@ -473,40 +582,71 @@ void parseCommandLine(std::vector<std::string>& args, std::string& location, htt
     throw sid::exception("Missing --url");
   if ( params_count.exists(PT_data) && params_count.exists(PT_infile) )
     throw sid::exception("--data(-d) and --infile(-i) cannot be specified together");
+  if ( ! global.bench.enabled && (params_count.exists(PT_concurrency) || params_count.exists(PT_requests)
+                                  || params_count.exists(PT_duration) || params_count.exists(PT_rate) || params_count.exists(PT_keep_alive)) )
+    throw sid::exception("Benchmark options can be used only with --bench");
+  // A run is bounded by the number of requests when it is given, otherwise by the default duration
+  if ( global.bench.enabled && params_count.exists(PT_requests) && ! params_count.exists(PT_duration) )
+    global.bench.config.duration = 0;
+  if ( global.bench.enabled && global.bench.config.requests == 0 && global.bench.config.duration == 0 )
+    throw sid::exception("--requests or --duration must be greater than 0");
 
   // validate class-specific parameters
   validateClassKeyValues(global.ctype);
 
-  if ( ! global.http.infile.empty() )
+  // A multipart upload reads the parts from the file as they are sent
+  if ( global.ctype == Class::aws && global.aws.isMultipart() )
   {
-    std::ifstream ifs(global.http.infile.c_str(), std::ifstream::in | std::ifstream::binary);
-    if ( ! ifs.is_open() )
-      throw sid::exception("Unable to open input file");
-    std::ostringstream out;
-    out << ifs.rdbuf();
-    // read the file contents and put it in content
-    global.http.data = out.str();
-    ifs.close();
+    if ( global.http.method != http::method_type::put || global.http.infile.empty() )
+      throw sid::exception(P_aws_part_size " requires --method=PUT and --infile");
   }
 }
 
-void attach_aws_signature(http::headers& headers, const http::method& method, const std::string& resource)
+//! Source that streams the payload of --data
+static http::body_source data_source()
+{
+  std::shared_ptr<size_t> pos = std::make_shared<size_t>(0);
+  return http::body_source::from_reader([pos](void* _buffer, size_t _count)
+    {
+      size_t count = std::min(_count, global.http.data.length() - *pos);
+      ::memcpy(_buffer, global.http.data.data() + *pos, count);
+      *pos += count;
+      return count;
+    }, global.http.data.length());
+}
+
+void attach_aws_signature(http::request& request, const std::string& resource)
 {
   AWS::SignatureInput input;
   AWS::SignatureOutput output;
+  const bool hasPayload = ( (request.method == http::method_type::put || request.method == http::method_type::post)
+                            && (! global.http.data.empty() || ! global.http.infile.empty()) );
 
   // Remove "Authorization" header if it exists
-  headers.remove_all("Authorization");
+  request.headers.remove_all("Authorization");
 
   // Fill the input object
-  input.headers = headers;
-  input.method = method;
+  input.headers = request.headers;
+  input.method = request.method;
   input.resource = resource;
   input.bucketName = global.aws.bucket;
   input.accessKeyId = global.aws.id;
   input.secret = global.aws.key;
   input.data = reinterpret_cast<const uint8_t*>(global.http.data.c_str());
   input.dataLen = global.http.data.length();
+  input.payload = hasPayload? global.aws.payload : AWS::PayloadSigning::signedPayload;
+  if ( hasPayload && global.http.data.empty() )
+  {
+    // The file is streamed. A signed payload is hashed in a pre-pass over the file, only once for redirects.
+    input.data = NULL;
+    input.dataLen = request.body.length();
+    if ( global.aws.version == 4 && input.payload == AWS::PayloadSigning::signedPayload )
+    {
+      if ( global.aws.payloadHash.empty() )
+        global.aws.payloadHash = AWS::hashFile(global.http.infile);
+      input.payloadHash = global.aws.payloadHash;
+    }
+  }
 
   // Generate the signature
   input.getSignature(output, global.aws.version);
@@ -515,15 +655,72 @@ void attach_aws_signature(http::headers& headers, const http::method& method, co
   //  cerr << "Signature calculation" << endl << output.toString() << endl;
 
   // Replace all the headers from input
-  headers.add(input.headers, http::header_action::replace);
+  request.headers.add(input.headers, http::header_action::replace);
   // Attach the signature
-  headers("Authorization", output.authStr);
+  request.headers("Authorization", output.authStr);
+
+  // The chunks are signed starting from the signature of the headers, so the payload is set again when they are signed
+  if ( input.payload == AWS::PayloadSigning::streaming && output.success )
+  {
+    http::body_source source = global.http.data.empty()? http::body_source::from_file(global.http.infile) : data_source();
+    request.set_content(AWS::StreamingPayload::create(source, output));
+  }
 }
 
 void attach_azure_signature(http::headers& headers, const http::method& method, const std::string& resource)
 {
 }
 
+int makeMultipartUpload()
+{
+  AWS::MultipartUpload upload;
+
+  upload.config.partSize = global.aws.partSize;
+  upload.config.concurrency = global.aws.concurrency;
+  upload.config.awsVersion = global.aws.version;
+  upload.bucketName = global.aws.bucket;
+  upload.accessKeyId = global.aws.id;
+  upload.secret = global.aws.key;
+  upload.headers.add("Content-Type", "application/octet-stream");
+  upload.headers.add("x-amz-meta-fma-attr", "TEST");
+  upload.headers.add(global.http.headers, http::header_action::replace);
+  if ( global.http.ip.v6 && ! global.http.ip.v4 )
+    upload.family = http::connection_family::ip_v6;
+  else if ( global.http.ip.v4 && ! global.http.ip.v6 )
+    upload.family = http::connection_family::ip_v4;
+
+  if ( ! upload.upload(global.http.url, global.http.infile) )
+  {
+    cerr << "Error: " << upload.error() << endl;
+    return -1;
+  }
+  cout << "ETag: " << upload.etag() << endl;
+  cout << upload.stats().toString() << endl;
+  return 0;
+}
+
+int makeBenchmark(const http::request& request)
+{
+  LoadGenerator generator;
+
+  generator.config = global.bench.config;
+  // Every connection streams the file from its own source
+  if ( ! request.body.empty() && global.http.data.empty() )
+    generator.config.infile = global.http.infile;
+  if ( global.http.ip.v6 && ! global.http.ip.v4 )
+    generator.config.family = http::connection_family::ip_v6;
+  else if ( global.http.ip.v4 && ! global.http.ip.v6 )
+    generator.config.family = http::connection_family::ip_v4;
+
+  if ( ! generator.run(global.http.url, request) )
+  {
+    cerr << "Error: " << generator.error() << endl;
+    return -1;
+  }
+  cout << generator.report().toString();
+  return 0;
+}
+
 int makeHttpCall(const std::vector<std::string>& args)
 {
   int status = -1;
@@ -540,19 +737,45 @@ int makeHttpCall(const std::vector<std::string>& args)
     parseCommandLine(newArgs, location, cmd.request, cmd.response);
 
     location = global.http.url;
+    if ( global.ctype == Class::aws && global.aws.isMultipart() )
+      return makeMultipartUpload();
+
     cmd.request.method = global.http.method;
     cmd.request.version = global.http.version;
     cmd.request.headers.add("Accept: */*");
-    cmd.request.headers.add("Accept-Encoding: identity");
     cmd.request.headers.add(global.http.headers, http::header_action::replace);
     if ( global.ctype == Class::none )
     {
       cmd.request.userName = global.http.userName;
       cmd.request.password = global.http.password;
     }
-    if ( (cmd.request.method == http::method_type::post || cmd.request.method == http::method_type::put ) &&
-         ! global.http.data.empty() )
-      cmd.request.set_content(global.http.data);
+    if ( (cmd.request.method == http::method_type::post || cmd.request.method == http::method_type::put ) )
+    {
+      if ( ! global.http.data.empty() )
+        cmd.request.set_content(global.http.data);
+      else if ( ! global.http.infile.empty() )
+        cmd.request.set_content(http::body_source::from_file(global.http.infile));
+      // The checksum is computed before the request is signed if it is a header, or while it is sent in a trailer
+      const bool isTrailer = ( global.ctype == Class::aws && global.aws.payload == AWS::PayloadSigning::unsignedTrailer );
+      if ( isTrailer && global.http.checksum == sid::checksum::type::none )
+        throw sid::exception("--aws-payload=trailer requires --checksum");
+      if ( isTrailer )
+      {
+        if ( ! global.http.data.empty() )
+          cmd.request.set_content(data_source());
+        cmd.request.set_checksum(global.http.checksum, http::checksum_location::aws_chunked);
+      }
+      else if ( global.http.checksum != sid::checksum::type::none )
+        cmd.request.set_checksum(global.http.checksum);
+    }
+    else if ( cmd.request.method == http::method_type::get && global.http.checksum != sid::checksum::type::none )
+      cmd.request.headers("x-amz-checksum-mode", "ENABLED");
+    if ( global.bench.enabled )
+    {
+      if ( global.ctype != Class::none )
+        throw sid::exception("--bench cannot be used with --class");
+      return makeBenchmark(cmd.request);
+    }
 
     if ( !global.http.outfile.empty() )
     {
@@ -583,6 +806,11 @@ int makeHttpCall(const std::vector<std::string>& args)
     else if ( global.http.ip.v4 )
       family = http::connection_family::ip_v4;
     cmd.conn = http::connection::create(url.type, family);
+    // HTTP/2 over TLS is negotiated through ALPN. Over plain HTTP it is used with prior knowledge.
+    if ( url.type == http::connection_type::https && global.http.version == http::version_id::v20 )
+      cmd.conn->set_alpn({HTTP2_ALPN_PROTOCOL, "http/1.1"});
+    // The timing breakdown of the request is shown in verbose mode
+    cmd.conn->set_timing(global.verbose);
     if ( ! cmd.conn->open(url.server, url.port) )
       throw sid::exception(cmd.conn->error());
 
@@ -604,7 +832,7 @@ int makeHttpCall(const std::vector<std::string>& args)
         switch ( global.ctype )
         {
         case Class::aws:
-          attach_aws_signature(request.headers, request.method, request.uri);
+          attach_aws_signature(request, request.uri);
           break;
         case Class::azure:
           attach_azure_signature(request.headers, request.method, request.uri);
@@ -621,7 +849,7 @@ int makeHttpCall(const std::vector<std::string>& args)
         cmd.request.headers.add("Content-Type", "application/octet-stream");
         cmd.request.headers.add("x-amz-meta-fma-attr", "TEST");
       }
-      attach_aws_signature(cmd.request.headers, cmd.request.method, url.resource);
+      attach_aws_signature(cmd.request, url.resource);
       break;
     case Class::azure:
       attach_azure_signature(cmd.request.headers, cmd.request.method, url.resource);
@@ -635,8 +863,14 @@ int makeHttpCall(const std::vector<std::string>& args)
     if ( ! cmd.run(signature_calc, true) )
       throw cmd.exception();
 
+    // The checksum in the reply of a PUT is the one of the object that was stored, not of the reply
+    std::string checksumError;
+    if ( cmd.request.method == http::method_type::get && ! cmd.response.verify_checksum(&checksumError) )
+      throw sid::exception("Checksum mismatch: " + checksumError);
+
     if ( global.verbose )
     {
+      cerr << "Timing: " << cmd.timing.to_str() << endl;
       http::cookies s_cookies = http::cookies::get_session_cookies(url.server);
       if ( ! s_cookies.empty() )
       {
@@ -646,7 +880,8 @@ int makeHttpCall(const std::vector<std::string>& args)
       }
     }
 
-    bool bShowContent = (cmd.response.headers.content_encoding() == http::content_encoding::identity);
+    // Compressed content is decoded by the client as it arrives, unless the encoding is not supported
+    bool bShowContent = ( cmd.response.decoded || cmd.response.headers.content_encoding() == http::content_encoding::identity );
     if ( ! global.verbose )
     {
       if ( (int) cmd.response.status.code() >= 400 )
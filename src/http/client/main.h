@@ -20,6 +20,9 @@ enum class Class { none, aws, atmos, azure };
 #define P_aws_bucket  P_PREFIX_AWS"bucket"
 #define P_aws_id      P_PREFIX_AWS"id"
 #define P_aws_key     P_PREFIX_AWS"key"
+#define P_aws_part_size   P_PREFIX_AWS"part-size"
+#define P_aws_concurrency P_PREFIX_AWS"concurrency"
+#define P_aws_payload     P_PREFIX_AWS"payload"
 
 #define P_azure_container  P_PREFIX_AZURE"container"
 #define P_azure_account    P_PREFIX_AZURE"account"
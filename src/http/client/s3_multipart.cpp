@@ -0,0 +1,329 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// @file s3_multipart.cpp
+// @brief Implementation of the parallel S3 multipart upload
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+#include "s3_multipart.h"
+#include "aws_auth.h"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <common/convert.hpp>
+
+using namespace std;
+using namespace AWS;
+
+namespace {
+
+const uint64_t S3_MIN_PART_SIZE = 5*1024*1024;
+const uint64_t S3_MAX_PART_SIZE = 5ULL*1024*1024*1024;
+const uint32_t S3_MAX_PARTS = 10000;
+
+//! Returns the text between <_tag> and </_tag>, or an empty string if the tag is not found
+std::string xml_value(const std::string& _xml, const std::string& _tag)
+{
+  const std::string openTag = "<" + _tag + ">", closeTag = "</" + _tag + ">";
+  size_t start = _xml.find(openTag);
+  if ( start == std::string::npos ) return std::string();
+  start += openTag.length();
+  size_t end = _xml.find(closeTag, start);
+  return ( end == std::string::npos )? std::string() : _xml.substr(start, end - start);
+}
+
+//! Throws an exception describing the S3 error if the response is not a success
+void check_response(const http::response& _response, const std::string& _operation)
+{
+  const std::string& body = _response.content.data();
+  // CompleteMultipartUpload can fail after sending a 200 status, in which case the body has an Error element
+  if ( (int) _response.status.code() < 300 && body.find("<Error>") == std::string::npos )
+    return;
+  std::string errStr = _operation + " failed: " + _response.status.to_str();
+  const std::string code = xml_value(body, "Code"), message = xml_value(body, "Message");
+  if ( ! code.empty() )
+    errStr += " (" + code + (message.empty()? "" : ": " + message) + ")";
+  throw sid::exception(errStr);
+}
+
+} // anonymous namespace
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of MultipartConfig and MultipartStats
+//
+MultipartConfig::MultipartConfig()
+{
+  partSize = 8*1024*1024;
+  concurrency = 4;
+  maxRetries = 3;
+  awsVersion = 4;
+}
+
+std::string MultipartStats::toString() const
+{
+  std::ostringstream out;
+  out << "Uploaded " << bytes << " bytes in " << parts << " part(s) in " << elapsedMs << " ms";
+  if ( elapsedMs > 0 )
+    out << " (" << (bytes * 1000 / elapsedMs) / (1024*1024) << " MB/s)";
+  if ( retries > 0 )
+    out << ", " << retries << " part(s) retried";
+  return out.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of MultipartUpload
+//
+MultipartUpload::MultipartUpload()
+{
+  family = http::connection_family::none;
+  m_fileSize = 0;
+}
+
+http::connection_ptr MultipartUpload::p_connect() const
+{
+  http::connection_ptr conn = http::connection::create(m_url.type, family);
+  if ( ! conn->open(m_url.server, m_url.port) )
+    throw sid::exception(conn->error());
+  conn->set_blocking(true);
+  return conn;
+}
+
+void MultipartUpload::p_sign(http::request& _request, const void* _data, uint64_t _dataLen) const
+{
+  SignatureInput input;
+  SignatureOutput output;
+
+  input.headers = _request.headers;
+  input.method = _request.method;
+  input.resource = _request.uri;
+  input.bucketName = bucketName;
+  input.accessKeyId = accessKeyId;
+  input.secret = secret;
+  input.data = reinterpret_cast<const uint8_t*>(_data);
+  input.dataLen = _dataLen;
+  if ( config.awsVersion == 2 )
+    input.getSignature_v2(output);
+  else
+    input.getSignature_v4(output);
+  if ( ! output.success )
+    throw sid::exception("Failed to calculate the signature for " + _request.uri);
+
+  _request.headers.add(input.headers, http::header_action::replace);
+  _request.headers("Authorization", output.authStr);
+}
+
+void MultipartUpload::p_exchange(http::client& _client, const http::method& _method, const std::string& _uri, const std::string& _data)
+{
+  if ( _client.conn.empty() || ! _client.conn->is_open() )
+    _client.conn = p_connect();
+
+  http::request& request = _client.request;
+  request.clear();
+  request.method = _method;
+  request.version = http::version_id::v11;
+  request.uri = _uri;
+  request.headers("Host", m_url.server);
+  if ( _method == http::method_type::post || _method == http::method_type::put )
+    request.set_content(_data);
+  p_sign(request, _data.data(), _data.length());
+
+  _client.response.clear();
+  if ( ! _client.run() )
+  {
+    _client.conn->close();
+    throw _client.exception();
+  }
+  if ( ! http::response_parser::keep_alive(_client.response) )
+    _client.conn->close();
+}
+
+std::string MultipartUpload::p_create()
+{
+  http::client client;
+  http::request& request = client.request;
+
+  client.conn = p_connect();
+  request.method = http::method_type::post;
+  request.version = http::version_id::v11;
+  request.uri = m_url.resource + "?uploads";
+  request.headers("Host", m_url.server);
+  request.headers.add(headers, http::header_action::replace);
+  p_sign(request, nullptr, 0);
+  if ( ! client.run() )
+    throw client.exception();
+  check_response(client.response, "CreateMultipartUpload");
+
+  std::string uploadId = xml_value(client.response.content.data(), "UploadId");
+  if ( uploadId.empty() )
+    throw sid::exception("CreateMultipartUpload did not return an UploadId");
+  return uploadId;
+}
+
+std::string MultipartUpload::p_uploadPart(http::client& _client, int _fd, uint32_t _partNumber, std::string& _buffer)
+{
+  const uint64_t offset = (_partNumber - 1) * config.partSize;
+  const uint64_t length = std::min(config.partSize, m_fileSize - offset);
+
+  // Read the part from the file into the buffer of this worker
+  _buffer.resize(length);
+  for ( uint64_t pos = 0; pos < length; )
+  {
+    ssize_t nread = ::pread(_fd, &_buffer[pos], length - pos, offset + pos);
+    if ( nread <= 0 )
+      throw sid::exception(sid::to_errno_str("Failed to read part " + sid::to_str(_partNumber)));
+    pos += nread;
+  }
+
+  p_exchange(_client, http::method_type::put, m_url.resource + "?partNumber=" + sid::to_str(_partNumber) + "&uploadId=" + local::uriEncode(m_uploadId, true), _buffer);
+  check_response(_client.response, "UploadPart " + sid::to_str(_partNumber));
+
+  std::string etag = _client.response.headers.get("ETag");
+  if ( etag.empty() )
+    throw sid::exception("UploadPart " + sid::to_str(_partNumber) + " did not return an ETag");
+  return etag;
+}
+
+void MultipartUpload::p_complete(const std::vector<std::string>& _etags)
+{
+  std::string xml = "<CompleteMultipartUpload>";
+  for ( size_t i = 0; i < _etags.size(); i++ )
+    xml += "<Part><PartNumber>" + sid::to_str(i+1) + "</PartNumber><ETag>" + _etags[i] + "</ETag></Part>";
+  xml += "</CompleteMultipartUpload>";
+
+  http::client client;
+  p_exchange(client, http::method_type::post, m_url.resource + "?uploadId=" + local::uriEncode(m_uploadId, true), xml);
+  check_response(client.response, "CompleteMultipartUpload");
+  m_etag = xml_value(client.response.content.data(), "ETag");
+  // ETag in the XML document can have its quotes escaped
+  size_t pos;
+  while ( (pos = m_etag.find("&quot;")) != std::string::npos )
+    m_etag.replace(pos, 6, "\"");
+}
+
+void MultipartUpload::p_abort()
+{
+  // Parts that have already been uploaded are discarded by the server. Failures here are not reported
+  // as the error that caused the abort is more relevant.
+  try
+  {
+    http::client client;
+    p_exchange(client, http::method_type::delete_, m_url.resource + "?uploadId=" + local::uriEncode(m_uploadId, true), std::string());
+  }
+  catch (...) {}
+}
+
+bool MultipartUpload::upload(const std::string& _url, const std::string& _filePath)
+{
+  bool isSuccess = false;
+  int fd = -1;
+
+  m_uploadId.clear();
+  m_etag.clear();
+  m_error.clear();
+  m_stats.clear();
+  auto startTime = std::chrono::steady_clock::now();
+
+  try
+  {
+    if ( ! m_url.set(_url) )
+      throw sid::exception(m_url.error);
+    if ( config.concurrency == 0 )
+      throw sid::exception("Concurrency must be greater than 0");
+
+    fd = ::open(_filePath.c_str(), O_RDONLY);
+    if ( fd == -1 )
+      throw sid::exception(sid::to_errno_str("Unable to open " + _filePath));
+    struct stat st;
+    if ( ::fstat(fd, &st) != 0 )
+      throw sid::exception(sid::to_errno_str("Unable to stat " + _filePath));
+    m_fileSize = st.st_size;
+
+    // S3 allows at most 10000 parts, each of 5 MB to 5 GB except for the last one
+    if ( config.partSize < S3_MIN_PART_SIZE )
+      config.partSize = S3_MIN_PART_SIZE;
+    if ( m_fileSize > config.partSize * S3_MAX_PARTS )
+      config.partSize = (m_fileSize + S3_MAX_PARTS - 1) / S3_MAX_PARTS;
+    if ( config.partSize > S3_MAX_PART_SIZE )
+      throw sid::exception("File is too large for a multipart upload");
+    const uint32_t partCount = ( m_fileSize == 0 )? 1 : (m_fileSize + config.partSize - 1) / config.partSize;
+
+    m_uploadId = p_create();
+
+    std::vector<std::string> etags(partCount);
+    std::atomic<uint32_t> nextPart(1);
+    std::atomic<bool> isFailed(false);
+    std::mutex lock;
+
+    // Each worker picks the next part, reads it into its own buffer and uploads it on its own connection
+    auto worker = [&]()
+      {
+        http::client client;
+        std::string buffer;
+        for ( uint32_t partNumber; ! isFailed && (partNumber = nextPart++) <= partCount; )
+        {
+          for ( uint32_t attempt = 0; ! isFailed; attempt++ )
+          {
+            try
+            {
+              etags[partNumber-1] = p_uploadPart(client, fd, partNumber, buffer);
+              break;
+            }
+            catch (const sid::exception& e)
+            {
+              if ( ! client.conn.empty() )
+                client.conn->close();
+              std::lock_guard<std::mutex> guard(lock);
+              if ( attempt >= config.maxRetries )
+              {
+                if ( ! isFailed )
+                  m_error = e.what();
+                isFailed = true;
+              }
+              else
+                m_stats.retries++;
+            }
+          }
+        }
+        if ( ! client.conn.empty() )
+          client.conn->close();
+      };
+
+    std::vector<std::thread> workers;
+    for ( uint32_t i = 0; i < std::min(config.concurrency, partCount); i++ )
+      workers.emplace_back(worker);
+    for ( std::thread& t : workers )
+      t.join();
+    if ( isFailed )
+      throw sid::exception(m_error);
+
+    p_complete(etags);
+
+    m_stats.bytes = m_fileSize;
+    m_stats.parts = partCount;
+    isSuccess = true;
+  }
+  catch (const sid::exception& e)
+  {
+    m_error = e.what();
+  }
+  catch (...)
+  {
+    m_error = "Unhandled exception in MultipartUpload::upload";
+  }
+
+  if ( ! isSuccess && ! m_uploadId.empty() )
+    p_abort();
+  if ( fd != -1 )
+    ::close(fd);
+  m_stats.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+  return isSuccess;
+}
@@ -0,0 +1,101 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// @file s3_multipart.h
+// @brief Parallel S3 multipart upload of a file
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _S3_MULTIPART_H_
+#define _S3_MULTIPART_H_
+
+#include <string>
+#include <vector>
+#include <http/http.hpp>
+
+using namespace sid;
+
+namespace AWS
+{
+  /**
+   * @struct MultipartConfig
+   * @brief Tuning parameters of a multipart upload.
+   *        Each worker holds one part read from the file and the request payload built from it,
+   *        so memory used by the upload is bounded by 2 x concurrency x partSize.
+   */
+  struct MultipartConfig
+  {
+    uint64_t partSize;     //! Size of each part (the last part can be smaller). Minimum is 5 MB.
+    uint32_t concurrency;  //! Number of parts uploaded in parallel, each on its own connection
+    uint32_t maxRetries;   //! Number of times a failed part is retried on a new connection
+    int      awsVersion;   //! Signature version (2 or 4) used for every request
+
+    MultipartConfig();
+  };
+
+  /**
+   * @struct MultipartStats
+   * @brief Statistics of the last multipart upload.
+   */
+  struct MultipartStats
+  {
+    uint64_t bytes;        //! Number of bytes uploaded
+    uint32_t parts;        //! Number of parts
+    uint32_t retries;      //! Number of part uploads that were retried
+    uint64_t elapsedMs;    //! Time taken from create to complete
+
+    MultipartStats() { clear(); }
+    void clear() { bytes = 0; parts = 0; retries = 0; elapsedMs = 0; }
+    std::string toString() const;
+  };
+
+  /**
+   * @class MultipartUpload
+   * @brief Uploads a file to S3 using CreateMultipartUpload, parallel UploadPart requests and
+   *        CompleteMultipartUpload. Each part is read from the file and signed separately, so the
+   *        file is never held in memory as a whole. The upload is aborted if any part fails.
+   */
+  class MultipartUpload
+  {
+  public:
+    MultipartConfig            config;
+    std::string                bucketName;
+    std::string                accessKeyId;
+    std::string                secret;
+    http::headers              headers;     //! Additional headers for CreateMultipartUpload (Content-Type, x-amz-meta-*)
+    http::connection_family    family;
+
+  public:
+    MultipartUpload();
+
+    /**
+     * @fn bool upload(const std::string& _url, const std::string& _filePath);
+     * @brief Upload the file to the object identified by the url.
+     *
+     * @return true on success. error() has the reason for failure otherwise.
+     */
+    bool upload(const std::string& _url, const std::string& _filePath);
+
+    const std::string& error() const { return m_error; }
+    const std::string& etag() const { return m_etag; }
+    const MultipartStats& stats() const { return m_stats; }
+
+  private:
+    http::connection_ptr p_connect() const;
+    void p_sign(http::request& _request, const void* _data, uint64_t _dataLen) const;
+    void p_exchange(http::client& _client, const http::method& _method, const std::string& _uri, const std::string& _data);
+    std::string p_create();
+    std::string p_uploadPart(http::client& _client, int _fd, uint32_t _partNumber, std::string& _buffer);
+    void p_complete(const std::vector<std::string>& _etags);
+    void p_abort();
+
+  private:
+    http::url      m_url;
+    std::string    m_uploadId;
+    uint64_t       m_fileSize;
+    std::string    m_etag;
+    std::string    m_error;
+    MultipartStats m_stats;
+  };
+}
+
+#endif // _S3_MULTIPART_H_
@@ -40,8 +40,6 @@ LICENSE: END
 #include "http/common.hpp"
 #include "common/convert.hpp"
 #include <string.h>
-#include <sstream>
-#include <iomanip>
 
 //OpenSSL includes
 #include <openssl/rsa.h>
@@ -70,7 +68,10 @@ bool http::library_init()
   ::SSL_library_init();
 
   ::SSL_load_error_strings();
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+  // The error strings are loaded automatically since OpenSSL 3.0
   ::ERR_load_BIO_strings();
+#endif
   ::SSLeay_add_ssl_algorithms();
     
   // Set up OpenSSL to enable all algorithms, ciphers and digests
@@ -121,6 +122,11 @@ bool http::get_line(const std::string& _input, size_t& _pos1, std::string& _outp
   return true;
 }
 
+std::string http::checksum_header(sid::checksum::type _type)
+{
+  return "x-amz-checksum-" + sid::checksum::to_str(_type);
+}
+
 std::string http::date_to_str(const struct tm& _tm)
 {
   char szDate[256] = {0};
@@ -138,7 +144,7 @@ std::string http::date_to_str(const time_t& _tt)
 
 bool http::date_from_str(const std::string& _input, struct tm& _tm)
 {
-  return ( ! ::strptime(_input.c_str(), HTTP_DATE_FORMAT, &_tm) );
+  return ( ::strptime(_input.c_str(), HTTP_DATE_FORMAT, &_tm) != nullptr );
 }
 
 bool http::date_from_str(const std::string& _input, time_t& _tt)
@@ -146,68 +152,142 @@ bool http::date_from_str(const std::string& _input, time_t& _tt)
   struct tm tm = {0};
   if ( ! date_from_str(_input, /*out*/ tm) )
     return false;
-  _tt = ::mktime(&tm);
+  // HTTP dates are always in GMT
+  _tt = ::timegm(&tm);
   return true;
 }
 
-std::string http::url_encode(const std::string& _input)
+/**
+ * @struct url_tables
+ * @brief Lookup tables of url_encode() and url_decode(), built once.
+ */
+struct url_tables
 {
-  // define a string stream for the output
-  std::ostringstream out;
+  uint8_t encode[256];  //! Bit (1 << url_encoding) is set if the character is encoded with that encoding
+  int8_t  hex[256];     //! Value of a hex digit, -1 for other characters
 
-  for ( size_t i = 0; i < _input.length(); i++ )
-  {
-    char ch = _input[i];
-    // check whether the character is one of the reserved characters
-    if ( urlReservedChars.find(ch) != std::string::npos )
+  url_tables()
     {
-      // if it is a reserverd character, write "%<hex>"
-      // where <hex> is the hexadecimal value of the character
-      out << '%' << std::setbase(16) << std::setw(2) << std::setfill('0') << ((int) ch);
+      const std::string pathChars = "-._~!$&'()*+,;=:@/";
+      for ( int ch = 0; ch < 256; ch++ )
+      {
+        const bool isUnreserved = ::isalnum(ch) || ch == '-' || ch == '_' || ch == '.' || ch == '~';
+        const bool isPathChar = ::isalnum(ch) || ( ch != 0 && pathChars.find(static_cast<char>(ch)) != std::string::npos );
+        encode[ch] = 0;
+        if ( ch != 0 && urlReservedChars.find(static_cast<char>(ch)) != std::string::npos )
+          encode[ch] |= 1 << static_cast<int>(http::url_encoding::reserved);
+        if ( ! isPathChar || ch >= 0x80 )
+          encode[ch] |= 1 << static_cast<int>(http::url_encoding::rfc3986_path);
+        if ( ! isUnreserved || ch >= 0x80 )
+          encode[ch] |= 1 << static_cast<int>(http::url_encoding::aws);
+        if ( ( ! isUnreserved && ch != '/' ) || ch >= 0x80 )
+          encode[ch] |= 1 << static_cast<int>(http::url_encoding::aws_path);
+        hex[ch] = ( ch >= '0' && ch <= '9' )? ch - '0' : ( ch >= 'a' && ch <= 'f' )? ch - 'a' + 10 : ( ch >= 'A' && ch <= 'F' )? ch - 'A' + 10 : -1;
+      }
     }
-    else
-    {
-      // if it is not a reserved character, just write it to the stream
-      out << ch;
-    }
-  }
-  // return the encoded string
-  return out.str();
+};
+
+static const url_tables& get_url_tables()
+{
+  static const url_tables tables;
+  return tables;
 }
 
-std::string http::url_decode(const std::string& _input)
+size_t http::url_encoded_length(const char* _input, size_t _inputLen, url_encoding _encoding) noexcept
 {
-  // define a string stream for the output
-  std::ostringstream out;
-  char ia[4] = {0};
+  const uint8_t* encode = get_url_tables().encode;
+  const uint8_t mask = 1 << static_cast<int>(_encoding);
+  const uint8_t* input = reinterpret_cast<const uint8_t*>(_input);
+  size_t length = _inputLen;
+  for ( size_t i = 0; i < _inputLen; i++ )
+    length += ( encode[input[i]] & mask )? 2 : 0;
+  return length;
+}
 
-  for ( size_t i=0; i < _input.length(); i++ )
+size_t http::url_encode(const char* _input, size_t _inputLen, char* _output, url_encoding _encoding) noexcept
+{
+  const uint8_t* encode = get_url_tables().encode;
+  const uint8_t mask = 1 << static_cast<int>(_encoding);
+  const char* digits = ( _encoding == url_encoding::reserved )? "0123456789abcdef" : "0123456789ABCDEF";
+  const uint8_t* input = reinterpret_cast<const uint8_t*>(_input);
+  char* out = _output;
+  for ( size_t i = 0; i < _inputLen; i++ )
   {
-    char ch = _input[i];
-    // if the character is a %, then we've encountered an encoded value
-    if ( ch == '%' ) // the next 2 characters are hexadecimal
+    const uint8_t ch = input[i];
+    if ( encode[ch] & mask )
     {
-      // make sure there are atleast 2 characters after %
-      //   otherwise throw an exception
-      if ( i+2 > _input.length() )
-        throw sid::exception("Invalid input to urlDecode: " + _input);
-      // get the next 2 characters (after %)
-      ia[0] = _input[++i];
-      ia[1] = _input[++i];
-      // make sure the 2 characters are hexdecimal characters,
-      //   otherwise throw an exception
-      if ( !::isxdigit(ia[0]) || !::isxdigit(ia[1]) )
-        throw sid::exception("Invalid hex input to urlDecode: " + _input);
-      // convert the hexadecimal string to long and
-      //   write it to the buffer as a character
-      out << (char) ::strtol(ia, NULL, 16);
+      out[0] = '%';
+      out[1] = digits[ch >> 4];
+      out[2] = digits[ch & 0x0F];
+      out += 3;
     }
     else
-    {
-      // write any non-% character directly to the output stream
-      out << ch;
-    }
+      *out++ = static_cast<char>(ch);
   }
-  // return the decoded string
-  return out.str();
+  return out - _output;
+}
+
+const std::string& http::url_encode(const std::string& _input, url_encoding _encoding, std::string& _buffer)
+{
+  const size_t length = url_encoded_length(_input.data(), _input.length(), _encoding);
+  if ( length == _input.length() )
+    return _input;
+  _buffer.resize(length);
+  url_encode(_input.data(), _input.length(), &_buffer[0], _encoding);
+  return _buffer;
+}
+
+std::string http::url_encode(const std::string& _input, url_encoding _encoding/* = url_encoding::reserved*/)
+{
+  std::string output;
+  if ( &url_encode(_input, _encoding, output) == &_input )
+    return _input;
+  return output;
+}
+
+bool http::url_decode(const char* _input, size_t _inputLen, char* _output, size_t& _outputLen) noexcept
+{
+  const int8_t* hex = get_url_tables().hex;
+  const char* input = _input;
+  const char* end = _input + _inputLen;
+  char* out = _output;
+  while ( input < end )
+  {
+    // copy the characters up to the next '%' as they are
+    const char* percent = static_cast<const char*>(::memchr(input, '%', end - input));
+    const size_t count = ( percent? percent : end ) - input;
+    ::memcpy(out, input, count);
+    out += count;
+    if ( ! percent ) break;
+    // the next 2 characters must be hexadecimal
+    if ( end - percent < 3 )
+      return false;
+    const int hi = hex[static_cast<uint8_t>(percent[1])], lo = hex[static_cast<uint8_t>(percent[2])];
+    if ( (hi | lo) < 0 )
+      return false;
+    *out++ = static_cast<char>((hi << 4) | lo);
+    input = percent + 3;
+  }
+  _outputLen = out - _output;
+  return true;
+}
+
+const std::string& http::url_decode(const std::string& _input, std::string& _buffer)
+{
+  if ( _input.find('%') == std::string::npos )
+    return _input;
+  size_t length = 0;
+  _buffer.resize(_input.length());
+  if ( ! url_decode(_input.data(), _input.length(), &_buffer[0], length) )
+    throw sid::exception("Invalid input to url_decode: " + _input);
+  _buffer.resize(length);
+  return _buffer;
+}
+
+std::string http::url_decode(const std::string& _input)
+{
+  std::string output;
+  if ( &url_decode(_input, output) == &_input )
+    return _input;
+  return output;
 }
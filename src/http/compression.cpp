@@ -0,0 +1,895 @@
+//////////////////////////////////////////////////////
+//
+// compression.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/compression.hpp"
+#include "common/convert.hpp"
+#include "common/hash.hpp"
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <strings.h>
+#include <time.h>
+#include <zlib.h>
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#ifdef SID_HTTP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace sid;
+using namespace sid::http;
+
+//! Size of the scratch buffer used by the codecs to produce output
+#define CODEC_BUFFER_SIZE (16*1024)
+
+/**
+ * @struct content_decoder::codec
+ * @brief Interface that is implemented by each of the supported content-codings.
+ */
+struct content_decoder::codec
+{
+  virtual ~codec() {}
+  //! Decode the data and append the output to _out
+  virtual void decode(const char* _data, size_t _len, std::string& _out) = 0;
+  //! Checks whether the end of the encoded stream has been reached
+  virtual bool is_complete() const = 0;
+  //! Name of the content-coding
+  virtual const char* name() const = 0;
+};
+
+namespace local
+{
+/**
+ * @class zlib_decoder
+ * @brief Decoder for "gzip" and "deflate" content-codings.
+ *
+ * Some servers send "deflate" as a raw deflate stream instead of the zlib format (RFC 1950).
+ * The first two bytes are checked for a zlib header to decide which one it is.
+ */
+class zlib_decoder : public content_decoder::codec
+{
+public:
+  zlib_decoder(bool _isGzip) : m_isGzip(_isGzip), m_init(false), m_end(false), m_members(0)
+  {
+    ::memset(&m_zs, 0, sizeof(m_zs));
+    if ( m_isGzip ) init(15 + 16);
+  }
+  ~zlib_decoder()
+  {
+    if ( m_init ) ::inflateEnd(&m_zs);
+  }
+
+  void decode(const char* _data, size_t _len, std::string& _out) override
+  {
+    if ( !m_init )
+    {
+      // deflate: wait for the first two bytes to check for the zlib header
+      m_head.append(_data, _len);
+      if ( m_head.length() < 2 )
+        return;
+      uint8_t cmf = static_cast<uint8_t>(m_head[0]), flg = static_cast<uint8_t>(m_head[1]);
+      bool isZlib = ( (cmf & 0x0F) == Z_DEFLATED && ((cmf << 8) | flg) % 31 == 0 );
+      init(isZlib? 15 : -15);
+      std::string head;
+      head.swap(m_head);
+      inflate(head.data(), head.length(), _out);
+      return;
+    }
+    inflate(_data, _len, _out);
+  }
+
+  bool is_complete() const override { return m_end; }
+  const char* name() const override { return m_isGzip? "gzip" : "deflate"; }
+
+private:
+  void init(int _windowBits)
+  {
+    if ( ::inflateInit2(&m_zs, _windowBits) != Z_OK )
+      throw sid::exception(std::string("Failed to initialize ") + name() + " decoder");
+    m_init = true;
+  }
+
+  void inflate(const char* _data, size_t _len, std::string& _out)
+  {
+    char buffer[CODEC_BUFFER_SIZE];
+
+    m_zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(_data));
+    m_zs.avail_in = static_cast<uInt>(_len);
+    while ( true )
+    {
+      if ( m_end )
+      {
+        if ( m_zs.avail_in == 0 ) break;
+        // A gzip payload can have multiple members, one after the other
+        if ( !m_isGzip ) { m_zs.avail_in = 0; break; }
+        ::inflateReset(&m_zs);
+        m_end = false;
+      }
+      m_zs.next_out = reinterpret_cast<Bytef*>(buffer);
+      m_zs.avail_out = sizeof(buffer);
+      int rc = ::inflate(&m_zs, Z_NO_FLUSH);
+      if ( rc == Z_DATA_ERROR && m_members > 0 && m_zs.total_out == 0 )
+      {
+        // Trailing garbage after a complete gzip member. Ignore it.
+        m_end = true; m_zs.avail_in = 0;
+        break;
+      }
+      if ( rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR )
+        throw sid::exception(std::string("Failed to decode ") + name() + " content: "
+                             + (m_zs.msg? m_zs.msg : sid::to_str(rc)));
+      _out.append(buffer, sizeof(buffer) - m_zs.avail_out);
+      if ( rc == Z_STREAM_END )
+      {
+        m_end = true; m_members++;
+        continue;
+      }
+      if ( rc == Z_BUF_ERROR || (m_zs.avail_in == 0 && m_zs.avail_out != 0) )
+        break;
+    }
+  }
+
+private:
+  z_stream    m_zs;
+  bool        m_isGzip;
+  bool        m_init;
+  bool        m_end;
+  size_t      m_members;
+  std::string m_head;
+};
+
+/**
+ * @class brotli_decoder
+ * @brief Decoder for "br" content-coding.
+ */
+class brotli_decoder : public content_decoder::codec
+{
+public:
+  brotli_decoder() : m_end(false)
+  {
+    m_state = ::BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+    if ( !m_state )
+      throw sid::exception("Failed to initialize br decoder");
+  }
+  ~brotli_decoder()
+  {
+    ::BrotliDecoderDestroyInstance(m_state);
+  }
+
+  void decode(const char* _data, size_t _len, std::string& _out) override
+  {
+    uint8_t buffer[CODEC_BUFFER_SIZE];
+    const uint8_t* nextIn = reinterpret_cast<const uint8_t*>(_data);
+    size_t availIn = _len;
+
+    while ( !m_end )
+    {
+      uint8_t* nextOut = buffer;
+      size_t availOut = sizeof(buffer);
+      BrotliDecoderResult res = ::BrotliDecoderDecompressStream(m_state, &availIn, &nextIn, &availOut, &nextOut, nullptr);
+      if ( res == BROTLI_DECODER_RESULT_ERROR )
+        throw sid::exception(std::string("Failed to decode br content: ")
+                             + ::BrotliDecoderErrorString(::BrotliDecoderGetErrorCode(m_state)));
+      _out.append(reinterpret_cast<const char*>(buffer), sizeof(buffer) - availOut);
+      if ( res == BROTLI_DECODER_RESULT_SUCCESS )
+        m_end = true;
+      else if ( res == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT )
+        break;
+    }
+  }
+
+  bool is_complete() const override { return m_end; }
+  const char* name() const override { return "br"; }
+
+private:
+  BrotliDecoderState* m_state;
+  bool                m_end;
+};
+
+#ifdef SID_HTTP_HAVE_ZSTD
+/**
+ * @class zstd_decoder
+ * @brief Decoder for "zstd" content-coding (RFC 8878).
+ */
+class zstd_decoder : public content_decoder::codec
+{
+public:
+  zstd_decoder() : m_end(false)
+  {
+    m_stream = ::ZSTD_createDStream();
+    if ( !m_stream )
+      throw sid::exception("Failed to initialize zstd decoder");
+  }
+  ~zstd_decoder()
+  {
+    ::ZSTD_freeDStream(m_stream);
+  }
+
+  void decode(const char* _data, size_t _len, std::string& _out) override
+  {
+    char buffer[CODEC_BUFFER_SIZE];
+    ZSTD_inBuffer in = { _data, _len, 0 };
+
+    while ( true )
+    {
+      ZSTD_outBuffer out = { buffer, sizeof(buffer), 0 };
+      size_t rc = ::ZSTD_decompressStream(m_stream, &out, &in);
+      if ( ::ZSTD_isError(rc) )
+        throw sid::exception(std::string("Failed to decode zstd content: ") + ::ZSTD_getErrorName(rc));
+      _out.append(buffer, out.pos);
+      // rc is 0 when a frame is completely decoded and flushed
+      m_end = ( rc == 0 );
+      if ( in.pos == in.size && out.pos < out.size )
+        break;
+    }
+  }
+
+  bool is_complete() const override { return m_end; }
+  const char* name() const override { return "zstd"; }
+
+private:
+  ZSTD_DStream* m_stream;
+  bool          m_end;
+};
+#endif // SID_HTTP_HAVE_ZSTD
+
+//! Create the codec for the given content-coding. Returns nullptr if it is not supported.
+content_decoder::codec* create_decoder(const http::content_encoding& _encoding)
+{
+  switch ( _encoding )
+  {
+  case http::content_encoding::gzip:    return new zlib_decoder(true);
+  case http::content_encoding::deflate: return new zlib_decoder(false);
+  case http::content_encoding::br:      return new brotli_decoder();
+#ifdef SID_HTTP_HAVE_ZSTD
+  case http::content_encoding::zstd:    return new zstd_decoder();
+#endif
+  default: break;
+  }
+  return nullptr;
+}
+} // namespace local
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of content_decoder class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+content_decoder::content_decoder() : m_bytesIn(0), m_bytesOut(0)
+{
+}
+
+content_decoder::~content_decoder()
+{
+}
+
+void content_decoder::clear()
+{
+  m_codecs.clear();
+  m_stage.clear();
+  m_bytesIn = m_bytesOut = 0;
+}
+
+/*static*/
+bool content_decoder::is_supported(const http::content_encoding& _encoding)
+{
+  switch ( _encoding )
+  {
+  case http::content_encoding::identity:
+  case http::content_encoding::gzip:
+  case http::content_encoding::deflate:
+  case http::content_encoding::br:
+#ifdef SID_HTTP_HAVE_ZSTD
+  case http::content_encoding::zstd:
+#endif
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+/*static*/
+const std::string& content_decoder::accept_encoding()
+{
+#ifdef SID_HTTP_HAVE_ZSTD
+  static const std::string value = "gzip, deflate, br, zstd";
+#else
+  static const std::string value = "gzip, deflate, br";
+#endif
+  return value;
+}
+
+bool content_decoder::set(const std::string& _contentEncoding)
+{
+  std::vector<std::string> tokens;
+  std::vector< std::unique_ptr<codec> > codecs;
+
+  this->clear();
+
+  sid::split(/*out*/ tokens, _contentEncoding, ',', SPLIT_TRIM_SKIP_EMPTY);
+  // Encodings are listed in the order they were applied, so they are decoded in the reverse order
+  for ( auto it = tokens.rbegin(); it != tokens.rend(); it++ )
+  {
+    http::content_encoding encoding;
+    if ( ! http::get_content_encoding(*it, /*out*/ encoding) || ! is_supported(encoding) )
+      return false;
+    if ( encoding == http::content_encoding::identity )
+      continue;
+    codecs.emplace_back(local::create_decoder(encoding));
+  }
+
+  m_codecs.swap(codecs);
+  if ( m_codecs.size() > 1 )
+    m_stage.resize(m_codecs.size() - 1);
+  return true;
+}
+
+void content_decoder::decode(const char* _data, size_t _len, std::string& _out)
+{
+  if ( _len == 0 ) return;
+  if ( m_codecs.empty() )
+  {
+    _out.append(_data, _len);
+    return;
+  }
+  m_bytesIn += _len;
+
+  size_t outLen = _out.length();
+  const char* data = _data;
+  size_t len = _len;
+  size_t last = m_codecs.size() - 1;
+  for ( size_t i = 0; i < last; i++ )
+  {
+    m_stage[i].clear();
+    m_codecs[i]->decode(data, len, m_stage[i]);
+    data = m_stage[i].data();
+    len = m_stage[i].length();
+  }
+  m_codecs[last]->decode(data, len, _out);
+  m_bytesOut += ( _out.length() - outLen );
+}
+
+void content_decoder::finish()
+{
+  for ( const auto& codec : m_codecs )
+  {
+    if ( ! codec->is_complete() )
+      throw sid::exception(std::string("Incomplete ") + codec->name() + " encoded content");
+  }
+}
+
+void content_decoder::update_headers(http::headers& _headers) const
+{
+  _headers.remove_all("Content-Encoding");
+  if ( _headers.exists("Content-Length") )
+    _headers("Content-Length", sid::to_str(m_bytesOut));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of content_encoder class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @struct content_encoder::codec
+ * @brief Interface that is implemented by each of the supported content-codings.
+ */
+struct content_encoder::codec
+{
+  virtual ~codec() {}
+  //! Encode the data and append the output to _out
+  virtual void encode(const char* _data, size_t _len, std::string& _out) = 0;
+  //! Flush the remaining data to _out
+  virtual void finish(std::string& _out) = 0;
+};
+
+namespace local
+{
+/**
+ * @class zlib_encoder
+ * @brief Encoder for "gzip" and "deflate" content-codings.
+ */
+class zlib_encoder : public content_encoder::codec
+{
+public:
+  zlib_encoder(bool _isGzip, int _level)
+  {
+    ::memset(&m_zs, 0, sizeof(m_zs));
+    int level = ( _level < 0 )? Z_DEFAULT_COMPRESSION : ( _level > 9 )? 9 : _level;
+    if ( ::deflateInit2(&m_zs, level, Z_DEFLATED, _isGzip? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+      throw sid::exception("Failed to initialize zlib encoder");
+  }
+  ~zlib_encoder()
+  {
+    ::deflateEnd(&m_zs);
+  }
+
+  void encode(const char* _data, size_t _len, std::string& _out) override { deflate(_data, _len, Z_NO_FLUSH, _out); }
+  void finish(std::string& _out) override { deflate(nullptr, 0, Z_FINISH, _out); }
+
+private:
+  void deflate(const char* _data, size_t _len, int _flush, std::string& _out)
+  {
+    char buffer[CODEC_BUFFER_SIZE];
+
+    m_zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(_data));
+    m_zs.avail_in = static_cast<uInt>(_len);
+    do
+    {
+      m_zs.next_out = reinterpret_cast<Bytef*>(buffer);
+      m_zs.avail_out = sizeof(buffer);
+      int rc = ::deflate(&m_zs, _flush);
+      if ( rc == Z_STREAM_ERROR )
+        throw sid::exception("Failed to encode zlib content");
+      _out.append(buffer, sizeof(buffer) - m_zs.avail_out);
+      if ( rc == Z_STREAM_END ) break;
+    }
+    while ( m_zs.avail_out == 0 || m_zs.avail_in != 0 );
+  }
+
+private:
+  z_stream m_zs;
+};
+
+/**
+ * @class brotli_encoder
+ * @brief Encoder for "br" content-coding.
+ */
+class brotli_encoder : public content_encoder::codec
+{
+public:
+  brotli_encoder(int _level)
+  {
+    m_state = ::BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+    if ( !m_state )
+      throw sid::exception("Failed to initialize br encoder");
+    // Quality 11 (the library default) is too slow for on-the-fly compression
+    uint32_t quality = ( _level < 0 )? 5 : ( _level > BROTLI_MAX_QUALITY )? BROTLI_MAX_QUALITY : _level;
+    ::BrotliEncoderSetParameter(m_state, BROTLI_PARAM_QUALITY, quality);
+  }
+  ~brotli_encoder()
+  {
+    ::BrotliEncoderDestroyInstance(m_state);
+  }
+
+  void encode(const char* _data, size_t _len, std::string& _out) override { compress(_data, _len, BROTLI_OPERATION_PROCESS, _out); }
+  void finish(std::string& _out) override { compress(nullptr, 0, BROTLI_OPERATION_FINISH, _out); }
+
+private:
+  void compress(const char* _data, size_t _len, BrotliEncoderOperation _op, std::string& _out)
+  {
+    uint8_t buffer[CODEC_BUFFER_SIZE];
+    const uint8_t* nextIn = reinterpret_cast<const uint8_t*>(_data);
+    size_t availIn = _len;
+
+    do
+    {
+      uint8_t* nextOut = buffer;
+      size_t availOut = sizeof(buffer);
+      if ( ! ::BrotliEncoderCompressStream(m_state, _op, &availIn, &nextIn, &availOut, &nextOut, nullptr) )
+        throw sid::exception("Failed to encode br content");
+      _out.append(reinterpret_cast<const char*>(buffer), sizeof(buffer) - availOut);
+    }
+    while ( availIn != 0 || ::BrotliEncoderHasMoreOutput(m_state)
+            || (_op == BROTLI_OPERATION_FINISH && ! ::BrotliEncoderIsFinished(m_state)) );
+  }
+
+private:
+  BrotliEncoderState* m_state;
+};
+
+#ifdef SID_HTTP_HAVE_ZSTD
+/**
+ * @class zstd_encoder
+ * @brief Encoder for "zstd" content-coding (RFC 8878).
+ */
+class zstd_encoder : public content_encoder::codec
+{
+public:
+  zstd_encoder(int _level)
+  {
+    m_stream = ::ZSTD_createCStream();
+    if ( !m_stream )
+      throw sid::exception("Failed to initialize zstd encoder");
+    int level = ( _level <= 0 )? 3 : ( _level > ::ZSTD_maxCLevel() )? ::ZSTD_maxCLevel() : _level;
+    ::ZSTD_initCStream(m_stream, level);
+  }
+  ~zstd_encoder()
+  {
+    ::ZSTD_freeCStream(m_stream);
+  }
+
+  void encode(const char* _data, size_t _len, std::string& _out) override
+  {
+    char buffer[CODEC_BUFFER_SIZE];
+    ZSTD_inBuffer in = { _data, _len, 0 };
+    while ( in.pos < in.size )
+    {
+      ZSTD_outBuffer out = { buffer, sizeof(buffer), 0 };
+      size_t rc = ::ZSTD_compressStream(m_stream, &out, &in);
+      if ( ::ZSTD_isError(rc) )
+        throw sid::exception(std::string("Failed to encode zstd content: ") + ::ZSTD_getErrorName(rc));
+      _out.append(buffer, out.pos);
+    }
+  }
+
+  void finish(std::string& _out) override
+  {
+    char buffer[CODEC_BUFFER_SIZE];
+    size_t remaining = 0;
+    do
+    {
+      ZSTD_outBuffer out = { buffer, sizeof(buffer), 0 };
+      remaining = ::ZSTD_endStream(m_stream, &out);
+      if ( ::ZSTD_isError(remaining) )
+        throw sid::exception(std::string("Failed to encode zstd content: ") + ::ZSTD_getErrorName(remaining));
+      _out.append(buffer, out.pos);
+    }
+    while ( remaining != 0 );
+  }
+
+private:
+  ZSTD_CStream* m_stream;
+};
+#endif // SID_HTTP_HAVE_ZSTD
+} // namespace local
+
+content_encoder::content_encoder()
+{
+}
+
+content_encoder::~content_encoder()
+{
+}
+
+void content_encoder::clear()
+{
+  m_codec.reset();
+}
+
+/*static*/
+bool content_encoder::is_supported(const http::content_encoding& _encoding)
+{
+  switch ( _encoding )
+  {
+  case http::content_encoding::gzip:
+  case http::content_encoding::deflate:
+  case http::content_encoding::br:
+#ifdef SID_HTTP_HAVE_ZSTD
+  case http::content_encoding::zstd:
+#endif
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+void content_encoder::set(const http::content_encoding& _encoding, int _level/* = -1*/)
+{
+  switch ( _encoding )
+  {
+  case http::content_encoding::gzip:    m_codec.reset(new local::zlib_encoder(true, _level)); break;
+  case http::content_encoding::deflate: m_codec.reset(new local::zlib_encoder(false, _level)); break;
+  case http::content_encoding::br:      m_codec.reset(new local::brotli_encoder(_level)); break;
+#ifdef SID_HTTP_HAVE_ZSTD
+  case http::content_encoding::zstd:    m_codec.reset(new local::zstd_encoder(_level)); break;
+#endif
+  default:
+    throw sid::exception("Content-Encoding " + http::content_encoding_to_str(_encoding) + " is not supported for encoding");
+  }
+}
+
+void content_encoder::encode(const char* _data, size_t _len, std::string& _out)
+{
+  if ( !m_codec )
+    throw sid::exception("Encoder is not set");
+  if ( _len > 0 )
+    m_codec->encode(_data, _len, _out);
+}
+
+void content_encoder::finish(std::string& _out)
+{
+  if ( !m_codec )
+    throw sid::exception("Encoder is not set");
+  m_codec->finish(_out);
+}
+
+/*static*/
+std::string content_encoder::encode(const http::content_encoding& _encoding, int _level, const std::string& _data)
+{
+  std::string out;
+  content_encoder encoder;
+  encoder.set(_encoding, _level);
+  encoder.encode(_data.data(), _data.length(), out);
+  encoder.finish(out);
+  return out;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of response_compressor and related classes
+//
+//////////////////////////////////////////////////////////////////////////////////////
+compression_config::compression_config()
+{
+#ifdef SID_HTTP_HAVE_ZSTD
+  encodings = { http::content_encoding::zstd, http::content_encoding::gzip };
+#else
+  encodings = { http::content_encoding::gzip };
+#endif
+  level = -1;
+  min_size = 1024;
+  mime_types = { "text/*", "application/json", "application/xml", "application/javascript",
+                 "application/x-www-form-urlencoded", "image/svg+xml" };
+  cache_size = 16 * 1024 * 1024;
+}
+
+bool compression_config::is_compressible(const std::string& _contentType) const
+{
+  // Ignore the parameters (charset etc.)
+  std::string mime = sid::trim(_contentType.substr(0, _contentType.find(';')));
+  for ( const std::string& type : mime_types )
+  {
+    size_t len = type.length();
+    if ( len > 2 && type.compare(len-2, 2, "/*") == 0 )
+    {
+      // Match the prefix including the '/'
+      if ( mime.length() > len-1 && ::strncasecmp(mime.c_str(), type.c_str(), len-1) == 0 )
+        return true;
+    }
+    else if ( ::strcasecmp(mime.c_str(), type.c_str()) == 0 )
+      return true;
+  }
+  // Structured syntax suffixes (RFC 6839) like application/vnd.api+json
+  size_t pos = mime.rfind('+');
+  if ( pos != std::string::npos )
+  {
+    std::string suffix = mime.substr(pos+1);
+    if ( ::strcasecmp(suffix.c_str(), "json") == 0 || ::strcasecmp(suffix.c_str(), "xml") == 0 )
+      return true;
+  }
+  return false;
+}
+
+std::string compression_stats::to_str() const
+{
+  std::ostringstream out;
+  out << "Responses: " << responses
+      << ", Compressed: " << compressed
+      << ", Cache hits: " << cache_hits
+      << ", Cache misses: " << cache_misses
+      << ", Bytes in: " << bytes_in
+      << ", Bytes out: " << bytes_out
+      << ", Ratio: " << std::fixed << std::setprecision(2) << ratio()
+      << ", CPU time: " << std::setprecision(3) << (cpu_usecs / 1000.0) << " ms";
+  return out.str();
+}
+
+response_compressor::response_compressor(const compression_config& _config/* = compression_config()*/)
+  : m_config(_config), m_cacheBytes(0)
+{
+  for ( const http::content_encoding& encoding : m_config.encodings )
+  {
+    if ( ! content_encoder::is_supported(encoding) )
+      throw sid::exception("Content-Encoding " + http::content_encoding_to_str(encoding) + " is not supported for encoding");
+  }
+}
+
+http::content_encoding response_compressor::select(const std::string& _acceptEncoding) const
+{
+  struct accepted { std::string token; double q; };
+  std::vector<std::string> items;
+  std::vector<accepted> accepts;
+
+  // Accept-Encoding: gzip;q=0.8, br, *;q=0.1
+  sid::split(/*out*/ items, _acceptEncoding, ',', SPLIT_TRIM_SKIP_EMPTY);
+  for ( const std::string& item : items )
+  {
+    accepted entry;
+    entry.q = 1.0;
+    size_t pos = item.find(';');
+    entry.token = sid::trim(item.substr(0, pos));
+    if ( pos != std::string::npos )
+    {
+      std::string param = sid::trim(item.substr(pos+1));
+      if ( param.length() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=' )
+        entry.q = ::strtod(param.c_str()+2, nullptr);
+    }
+    accepts.push_back(entry);
+  }
+
+  auto get_q = [&](const http::content_encoding& _encoding)->double
+    {
+      double wildcard = -1.0;
+      for ( const accepted& entry : accepts )
+      {
+        http::content_encoding encoding;
+        if ( entry.token == "*" )
+          wildcard = entry.q;
+        else if ( http::get_content_encoding(entry.token, /*out*/ encoding) && encoding == _encoding )
+          return entry.q;
+      }
+      return ( wildcard < 0.0 )? 0.0 : wildcard;
+    };
+
+  // Pick the highest q-value. For equal values the server preference wins.
+  http::content_encoding selected = http::content_encoding::identity;
+  double selectedQ = 0.0;
+  for ( const http::content_encoding& encoding : m_config.encodings )
+  {
+    double q = get_q(encoding);
+    if ( q > selectedQ )
+    {
+      selected = encoding;
+      selectedQ = q;
+    }
+  }
+  return selected;
+}
+
+bool response_compressor::compress(const http::request& _request, /*in/out*/ http::response& _response)
+{
+  std::string acceptEncoding, contentType;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.responses++;
+  }
+
+  if ( _response.headers.exists("Content-Encoding")
+       || ! _response.content.is_string()
+       || _response.content.length() < m_config.min_size )
+    return false;
+
+  int code = static_cast<int>(_response.status.code());
+  if ( code < 200 || code == 204 || code == 206 || code == 304 )
+    return false;
+
+  if ( ! _response.headers.exists("Content-Type", &contentType) || ! m_config.is_compressible(contentType) )
+    return false;
+
+  // The representation depends on Accept-Encoding, so let the caches know about it
+  std::string vary;
+  if ( ! _response.headers.exists("Vary", &vary) )
+    _response.headers("Vary", "Accept-Encoding");
+  else if ( ::strcasestr(vary.c_str(), "Accept-Encoding") == nullptr && vary != "*" )
+    _response.headers("Vary", vary + ", Accept-Encoding");
+
+  if ( ! _request.headers.exists("Accept-Encoding", &acceptEncoding) )
+    return false;
+
+  http::content_encoding encoding = select(acceptEncoding);
+  if ( encoding == http::content_encoding::identity )
+    return false;
+
+  const std::string data = _response.content.to_str();
+  std::string encoded;
+  bool isFound = false;
+
+  // The cache is keyed by the hash of the payload and the encoding
+  std::string key;
+  if ( m_config.cache_size > 0 )
+  {
+    key = sid::hash::sha1().get_hash(data).data();
+    key += static_cast<char>(encoding);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_cacheMap.find(key);
+    if ( it != m_cacheMap.end() )
+    {
+      // Move it to the front as the most recently used entry
+      m_cache.splice(m_cache.begin(), m_cache, it->second);
+      encoded = it->second->data;
+      isFound = true;
+    }
+  }
+
+  uint64_t cpuUsecs = 0;
+  if ( ! isFound )
+  {
+    struct timespec ts1, ts2;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts1);
+    encoded = content_encoder::encode(encoding, m_config.level, data);
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts2);
+    cpuUsecs = (ts2.tv_sec - ts1.tv_sec) * 1000000 + (ts2.tv_nsec - ts1.tv_nsec) / 1000;
+  }
+
+  // Not worth it if the payload did not shrink
+  bool useEncoded = ( encoded.length() < data.length() );
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if ( isFound )
+      m_stats.cache_hits++;
+    else
+    {
+      m_stats.cache_misses++;
+      m_stats.cpu_usecs += cpuUsecs;
+      if ( m_config.cache_size > 0 && encoded.length() <= m_config.cache_size && m_cacheMap.find(key) == m_cacheMap.end() )
+      {
+        m_cache.push_front(cache_entry{key, encoded});
+        m_cacheMap[key] = m_cache.begin();
+        m_cacheBytes += encoded.length();
+        // Evict the least recently used entries
+        while ( m_cacheBytes > m_config.cache_size && ! m_cache.empty() )
+        {
+          m_cacheBytes -= m_cache.back().data.length();
+          m_cacheMap.erase(m_cache.back().key);
+          m_cache.pop_back();
+        }
+      }
+    }
+    if ( useEncoded )
+    {
+      m_stats.compressed++;
+      m_stats.bytes_in += data.length();
+      m_stats.bytes_out += encoded.length();
+    }
+  }
+
+  if ( ! useEncoded )
+    return false;
+
+  const std::string encodingStr = http::content_encoding_to_str(encoding);
+  _response.content.set_data(encoded);
+  _response.headers("Content-Encoding", encodingStr);
+  _response.headers("Content-Length", sid::to_str(_response.content.length()));
+  // A strong ETag identifies the bytes of a representation, so the compressed one gets its own ("v1" becomes "v1-gzip").
+  // A weak ETag already allows for a different encoding of the same content.
+  std::string etag;
+  if ( _response.headers.exists("ETag", &etag) && etag.length() >= 2 && etag.back() == '"' && etag.compare(0, 2, "W/") != 0 )
+    _response.headers("ETag", etag.substr(0, etag.length()-1) + "-" + encodingStr + "\"");
+  return true;
+}
+
+compression_stats response_compressor::stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+void response_compressor::clear_cache()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cache.clear();
+  m_cacheMap.clear();
+  m_cacheBytes = 0;
+}
@@ -54,6 +54,7 @@ LICENSE: END
 #include <poll.h>
 #include <sys/select.h>
 #include <arpa/inet.h>
+#include <deque>
 
 //OpenSSL includes
 #include <openssl/rsa.h>
@@ -86,6 +87,16 @@ struct io_exec_output
 };
 using IOLoopCallback = std::function<int(bool&)> ;
 
+//! Resolved address of the server, kept to try the next one when a non-blocking connect fails
+struct resolved_address
+{
+  struct sockaddr_storage addr;
+  socklen_t addrLen;
+  int family;
+  int socktype;
+  int protocol;
+};
+
 /**
  * @class http_connection
  * @brief Class definition for a HTTP connection.
@@ -106,17 +117,28 @@ public:
   bool is_open() const override { return m_socket > 0; }
   bool close() override;
   ssize_t write(const void* _buffer, size_t _count) override;
+  ssize_t writev(const struct iovec* _iov, int _iovcnt) override;
   ssize_t read(void* _buffer, size_t _count) override;
   connection_description description() const override;
+  int descriptor() const override { return m_socket; }
+  io_status open_async(const std::string& _server, const unsigned short& _port = 0) override;
+  io_status open_continue() override;
+  io_status read_some(void* _buffer, size_t _count, size_t& _nread) override;
+  io_status write_some(const void* _buffer, size_t _count, size_t& _nwritten) override;
   ////////////////////////////////////////////////////////////////////////////
 
 protected:
   bool do_set_non_blocking(int fd);
+  void set_keep_alive();
+  void set_no_delay();
   io_exec_output io_exec(IOLoopCallback& fnIOCallback, int ioType, int default_retVal = 0);
   bool isReadyForIO(int ioType, bool* pOperationTimedOut = nullptr) const;
+  bool connect_next(int& _errNo);
   
 protected:
-  int m_socket; //! Socket to the server
+  int  m_socket;       //! Socket to the server
+  bool m_isConnecting; //! Non-blocking connect is in progress (see open_async())
+  std::deque<resolved_address> m_addresses; //! Addresses not tried yet by open_async() and open_continue()
 };
 
 /**
@@ -139,14 +161,23 @@ public:
   bool is_open() const override { return super::is_open(); }
   bool close() override;
   ssize_t write(const void* _buffer, size_t _count) override;
+  ssize_t writev(const struct iovec* _iov, int _iovcnt) override;
   ssize_t read(void* _buffer, size_t _count) override;
   connection_description description() const override;
   //! Accept - SSL-specific
   void accept() override;
+  io_status open_async(const std::string& _server, const unsigned short& _port = 0) override;
+  io_status open_continue() override;
+  io_status read_some(void* _buffer, size_t _count, size_t& _nread) override;
+  io_status write_some(const void* _buffer, size_t _count, size_t& _nwritten) override;
   ////////////////////////////////////////////////////////////////////////////
 
 private:
   void attach_ssl();
+  void create_ssl();
+  void set_alpn_protocol();
+  io_status ssl_connect_step();
+  io_status ssl_status(int _retVal, const std::string& _operation);
 
 private:
   SSL_CTX* m_sslctx;
@@ -174,6 +205,26 @@ connection::~connection()
   // Nothing to destroy here. Cleanup done in derived class.
 }
 
+ssize_t connection::writev(const struct iovec* _iov, int _iovcnt)
+{
+  std::string buffer;
+  for ( int i = 0; i < _iovcnt; i++ )
+    buffer.append(static_cast<const char*>(_iov[i].iov_base), _iov[i].iov_len);
+  return this->write(buffer.data(), buffer.length());
+}
+
+void connection::write_fully(const void* _buffer, size_t _count)
+{
+  // A single write can be partial for large payloads on the non-blocking socket
+  for ( size_t pos = 0; pos < _count; )
+  {
+    ssize_t written = this->write(static_cast<const char*>(_buffer) + pos, _count - pos);
+    if ( written <= 0 )
+      throw sid::exception("Failed to write data");
+    pos += written;
+  }
+}
+
 /**
  * @fn connection_ptr create(const connection_type& _type);
  * @brief Creates a connection object based on the connection type specified. In case of error it throws a sid::exception.
@@ -256,7 +307,7 @@ connection_ptr connection::p_create(const connection_type& _type, const ssl::cer
 // Implementation of http_connection class
 //
 //////////////////////////////////////////////////////////////////////////////////////
-http_connection::http_connection() : super(), m_socket(-1)
+http_connection::http_connection() : super(), m_socket(-1), m_isConnecting(false)
 {
 }
 
@@ -273,10 +324,34 @@ bool http_connection::do_set_non_blocking(int fd)
   return (::fcntl(fd, F_SETFL, flags) == 0);
 }
 
+void http_connection::set_keep_alive()
+{
+#ifdef SO_KEEPALIVE
+    //#pragma message "Building with SO_KEEPALIVE flag"
+#define __setsockopt(_level, _optname, _optvalue) ::setsockopt(m_socket, _level, _optname, &_optvalue, sizeof(_optvalue));
+    int flags = 0;
+    flags = 10; __setsockopt(SOL_TCP, TCP_KEEPIDLE, flags);
+    flags = 5; __setsockopt(SOL_TCP, TCP_KEEPCNT, flags);
+    flags = 5; __setsockopt(SOL_TCP, TCP_KEEPINTVL, flags);
+    flags = 1; __setsockopt(SOL_TCP, SO_KEEPALIVE, flags);
+#undef __setsocketopt
+#endif
+}
+
+void http_connection::set_no_delay()
+{
+  // Messages are written whole, so coalescing small writes only delays them. Pipelined responses written
+  // back-to-back would otherwise wait for the (delayed) acknowledgement of the previous one.
+  int flag = 1;
+  ::setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
 io_exec_output http_connection::io_exec(IOLoopCallback& fnIOCallback, int ioType, int default_retVal/* = 0*/)
 {
   io_exec_output out(default_retVal);
 
+  // Failures of the I/O (timeout, reset or close by the peer) are transient as far as the request is concerned
+  m_retryable = true;
   for ( bool bContinue = true; bContinue; )
   {
     bContinue = false;
@@ -300,6 +375,7 @@ io_exec_output http_connection::io_exec(IOLoopCallback& fnIOCallback, int ioType
   if ( out.timedOut )
     throw sid::exception("The operation timedout after " + sid::to_str(this->get_timeout()) + " seconds");
 
+  m_retryable = false;
   return out;
 }
 
@@ -412,8 +488,11 @@ bool http_connection::close()
     //::shutdown(m_socket, SHUT_RDWR);
     ::close(m_socket);
     m_socket = -1;
+    m_isConnecting = false;
+    m_addresses.clear();
     m_server.clear();
     m_port = 0;
+    m_unread.clear();
     return true;
   }
   return false;
@@ -430,6 +509,7 @@ bool http_connection::open(const std::string& _server, const unsigned short& _po
   try
   {
     m_error.clear();
+    m_retryable = false;
 
     if ( this->is_open() )
       throw sid::exception("Connection is already established. Close the connection before opening it.");
@@ -437,6 +517,12 @@ bool http_connection::open(const std::string& _server, const unsigned short& _po
     if ( _server.empty() )
       throw sid::exception("Server name cannot be empty");
 
+    if ( m_timing )
+    {
+      m_timing->clear();
+      m_timing->open_start = request_timing::clock::now();
+    }
+
     ::memset(&hints, 0, sizeof(struct addrinfo));
     hints.ai_family = (m_family == connection_family::ip_v4)? AF_INET :
                       (m_family == connection_family::ip_v6)? AF_INET6 : AF_UNSPEC;
@@ -448,6 +534,8 @@ bool http_connection::open(const std::string& _server, const unsigned short& _po
     int s = ::getaddrinfo(_server.c_str(), csPort.c_str(), &hints, &result);
     if ( s != 0 )
       throw sid::exception(std::string("getaddrinfo() failed with gai_error(") + sid::to_str(s) + ") " + gai_strerror(s));
+    if ( m_timing )
+      m_timing->resolved = request_timing::clock::now();
 
     /* getaddrinfo() returns a list of address structures.
        Try each address until we successfully connect(2).
@@ -515,18 +603,17 @@ bool http_connection::open(const std::string& _server, const unsigned short& _po
     ::freeaddrinfo(result);
 
     if ( ! found )
+    {
+      // The server could not be reached. Trying again later can succeed.
+      m_retryable = true;
       throw sid::exception(std::string("Could not connect to server ") + _server + " at port " + csPort + " over " + szName + ". " + sid::to_errno_str(iErrNo));
+    }
 
-#ifdef SO_KEEPALIVE
-    //#pragma message "Building with SO_KEEPALIVE flag"
-#define __setsockopt(_level, _optname, _optvalue) ::setsockopt(m_socket, _level, _optname, &_optvalue, sizeof(_optvalue));
-    int flags = 0;
-    flags = 10; __setsockopt(SOL_TCP, TCP_KEEPIDLE, flags);
-    flags = 5; __setsockopt(SOL_TCP, TCP_KEEPCNT, flags);
-    flags = 5; __setsockopt(SOL_TCP, TCP_KEEPINTVL, flags);
-    flags = 1; __setsockopt(SOL_TCP, SO_KEEPALIVE, flags);
-#undef __setsocketopt
-#endif
+    if ( m_timing )
+      m_timing->connected = request_timing::clock::now();
+
+    set_keep_alive();
+    set_no_delay();
 
     // set the port member
     m_port = httpPort;
@@ -602,6 +689,7 @@ bool http_connection::open(int _sockfd)
     }
     // set the socket to non-blocking mode internally
     do_set_non_blocking(m_socket);
+    set_no_delay();
     // set the return status to true
     isSuccess = true;
   }
@@ -636,6 +724,32 @@ ssize_t http_connection::write(const void* _buffer, size_t _count)
     };
 
   io_exec_output out = io_exec(write_callback, IO_WRITE, 0);
+  if ( m_timing ) m_timing->on_write(out.retVal);
+  return out.retVal;
+}
+
+ssize_t http_connection::writev(const struct iovec* _iov, int _iovcnt)
+{
+  IOLoopCallback writev_callback = [&](bool& bContinue)->int
+    {
+      struct msghdr msg;
+      ::memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = const_cast<struct iovec*>(_iov);
+      msg.msg_iovlen = _iovcnt;
+      // The peer can close a pipelined connection at any time. Report it as an error instead of SIGPIPE.
+      int retVal = ::sendmsg(m_socket, &msg, MSG_NOSIGNAL);
+      if ( retVal < 0 )
+      {
+        if ( errno == EAGAIN || errno == EWOULDBLOCK )
+          bContinue = true;
+        else if ( errno != 0 )
+          throw sid::exception("Write failed with error: " + sid::to_errno_str());
+      }
+      return retVal;
+    };
+
+  io_exec_output out = io_exec(writev_callback, IO_WRITE, 0);
+  if ( m_timing ) m_timing->on_write(out.retVal);
   return out.retVal;
 }
 
@@ -659,9 +773,165 @@ ssize_t http_connection::read(void* _buffer, size_t _count)
     };
 
   io_exec_output out = io_exec(read_callback, IO_READ, 0);
+  if ( m_timing ) m_timing->on_read(out.retVal);
   return out.retVal;
 }
 
+io_status http_connection::open_async(const std::string& _server, const unsigned short& _port)
+{
+  struct addrinfo hints;
+  struct addrinfo *result, *rp;
+  unsigned short httpPort = ( _port )? _port : DEFAULT_PORT_HTTP;
+
+  m_error.clear();
+  m_retryable = false;
+
+  if ( this->is_open() )
+    throw sid::exception("Connection is already established. Close the connection before opening it.");
+
+  if ( _server.empty() )
+    throw sid::exception("Server name cannot be empty");
+
+  ::memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_family = (m_family == connection_family::ip_v4)? AF_INET :
+                    (m_family == connection_family::ip_v6)? AF_INET6 : AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM; // Stream socket
+
+  std::string csPort = sid::to_str(httpPort);
+  int s = ::getaddrinfo(_server.c_str(), csPort.c_str(), &hints, &result);
+  if ( s != 0 )
+    throw sid::exception(std::string("getaddrinfo() failed with gai_error(") + sid::to_str(s) + ") " + gai_strerror(s));
+
+  m_addresses.clear();
+  for ( rp = result; rp; rp = rp->ai_next )
+  {
+    if ( rp->ai_family != AF_INET && rp->ai_family != AF_INET6 )
+      continue;
+    resolved_address address;
+    ::memcpy(&address.addr, rp->ai_addr, rp->ai_addrlen);
+    address.addrLen = rp->ai_addrlen;
+    address.family = rp->ai_family;
+    address.socktype = rp->ai_socktype;
+    address.protocol = rp->ai_protocol;
+    m_addresses.push_back(address);
+  }
+  ::freeaddrinfo(result);
+
+  int iErrNo = 0;
+  if ( ! connect_next(iErrNo) )
+  {
+    m_retryable = true;
+    throw sid::exception(std::string("Could not connect to server ") + _server + " at port " + csPort + ". " + sid::to_errno_str(iErrNo));
+  }
+
+  m_port = httpPort;
+
+  return m_isConnecting? io_status::want_write : io_status::done;
+}
+
+io_status http_connection::open_continue()
+{
+  if ( m_isConnecting )
+  {
+    int errCode = 0;
+    socklen_t len = sizeof(errCode);
+    if ( ::getsockopt(m_socket, SOL_SOCKET, SO_ERROR, &errCode, &len) == -1 )
+      errCode = errno;
+    if ( errCode == EINPROGRESS || errCode == EALREADY )
+      return io_status::want_write;
+    if ( errCode != 0 )
+    {
+      // Move on to the next address of the server. The connect starts afresh on a new socket.
+      std::string server = m_server;
+      ::close(m_socket);
+      m_socket = -1;
+      m_isConnecting = false;
+      int iErrNo = 0;
+      if ( ! connect_next(iErrNo) )
+      {
+        m_retryable = true;
+        throw sid::exception("Could not connect to server " + server + " at port " + sid::to_str(m_port) + ". " + sid::to_errno_str(errCode));
+      }
+      if ( m_isConnecting )
+        return io_status::want_write;
+    }
+    m_isConnecting = false;
+    m_addresses.clear();
+  }
+  return io_status::done;
+}
+
+bool http_connection::connect_next(int& _errNo)
+{
+  // Use the first address for which the connect is either complete or in progress
+  while ( ! m_addresses.empty() )
+  {
+    resolved_address address = m_addresses.front();
+    m_addresses.pop_front();
+    int sfd = ::socket(address.family, address.socktype | SOCK_NONBLOCK, address.protocol);
+    if ( sfd == -1 ) { _errNo = errno; continue; }
+
+    bool inProgress = false;
+    if ( ::connect(sfd, (const struct sockaddr*) &address.addr, address.addrLen) == -1 )
+    {
+      if ( errno != EINPROGRESS ) { _errNo = errno; ::close(sfd); continue; }
+      inProgress = true;
+    }
+    char szName[INET6_ADDRSTRLEN+1] = {0};
+    if ( address.family == AF_INET )
+      ::inet_ntop(AF_INET, &(((struct sockaddr_in*) &address.addr)->sin_addr), szName, sizeof(szName));
+    else
+      ::inet_ntop(AF_INET6, &(((struct sockaddr_in6*) &address.addr)->sin6_addr), szName, sizeof(szName));
+    m_server = szName;
+    m_socket = sfd;
+    m_family = (address.family == AF_INET)? connection_family::ip_v4 : connection_family::ip_v6;
+    m_isConnecting = inProgress;
+    set_keep_alive();
+    set_no_delay();
+    if ( ! inProgress )
+      m_addresses.clear();
+    return true;
+  }
+  return false;
+}
+
+io_status http_connection::read_some(void* _buffer, size_t _count, size_t& _nread)
+{
+  _nread = 0;
+  ssize_t retVal = ::read(m_socket, _buffer, _count);
+  if ( retVal > 0 )
+  {
+    _nread = static_cast<size_t>(retVal);
+    if ( m_timing ) m_timing->on_read(retVal);
+    return io_status::done;
+  }
+  if ( retVal == 0 )
+    return io_status::closed;
+  if ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR )
+    return io_status::want_read;
+  if ( errno == ECONNRESET )
+    return io_status::closed;
+  throw sid::exception("Read failed with error: " + sid::to_errno_str());
+}
+
+io_status http_connection::write_some(const void* _buffer, size_t _count, size_t& _nwritten)
+{
+  _nwritten = 0;
+  // MSG_NOSIGNAL so that a peer reset does not raise SIGPIPE in the event loop
+  ssize_t retVal = ::send(m_socket, _buffer, _count, MSG_NOSIGNAL);
+  if ( retVal >= 0 )
+  {
+    _nwritten = static_cast<size_t>(retVal);
+    if ( m_timing ) m_timing->on_write(retVal);
+    return io_status::done;
+  }
+  if ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR )
+    return io_status::want_write;
+  if ( errno == EPIPE || errno == ECONNRESET )
+    return io_status::closed;
+  throw sid::exception("Write failed with error: " + sid::to_errno_str());
+}
+
 std::string to_str(const connection_family& family)
 {
   return (family == connection_family::ip_v4)? "ip_v4" : (family == connection_family::ip_v6? "ip_v6" : "ip_any");
@@ -714,7 +984,7 @@ static std::string s_ssl_error_string()
   return std::string(szError);
 }
 
-void https_connection::attach_ssl()
+void https_connection::create_ssl()
 {
   try
   {
@@ -789,6 +1059,38 @@ void https_connection::attach_ssl()
     if ( 0 == ::SSL_set_fd(m_ssl, m_socket) )
       throw sid::exception("Unable to set socket on SSL");
 
+    // Offer the application protocols in the ALPN wire format (length prefixed names)
+    m_alpnProtocol.clear();
+    if ( ! m_alpn.empty() )
+    {
+      std::string protos;
+      for ( const std::string& proto : m_alpn )
+      {
+        if ( proto.empty() || proto.length() > 255 )
+          throw sid::exception("Invalid ALPN protocol name: " + proto);
+        protos += static_cast<char>(proto.length());
+        protos += proto;
+      }
+      if ( 0 != ::SSL_set_alpn_protos(m_ssl, reinterpret_cast<const unsigned char*>(protos.data()), protos.length()) )
+        throw sid::exception("Unable to set ALPN protocols: " + s_ssl_error_string());
+    }
+  }
+  catch (...)
+  {
+    // clear the context
+    __SSL_free(m_ssl);
+    __SSL_CTX_free(m_sslctx);
+    // rethrow the exception
+    throw;
+  }
+}
+
+void https_connection::attach_ssl()
+{
+  try
+  {
+    create_ssl();
+
     IOLoopCallback ssl_connect_callback = [&](bool& bContinue)->int
       {
 	int retVal = ::SSL_connect(m_ssl);
@@ -808,6 +1110,15 @@ void https_connection::attach_ssl()
       };
 
     io_exec(ssl_connect_callback, IO_READ|IO_WRITE);
+    set_alpn_protocol();
+    if ( m_timing )
+    {
+      // The handshake is done by OpenSSL on the socket, so only its BIO knows the bytes exchanged
+      m_timing->handshaken = request_timing::clock::now();
+      io_counter& c = m_timing->io[static_cast<int>(timing_phase::handshake)];
+      c.bytes_read = ::BIO_number_read(::SSL_get_rbio(m_ssl));
+      c.bytes_written = ::BIO_number_written(::SSL_get_wbio(m_ssl));
+    }
   }
   catch (...)
   {
@@ -819,6 +1130,17 @@ void https_connection::attach_ssl()
   }
 }
 
+void https_connection::set_alpn_protocol()
+{
+  const unsigned char* proto = nullptr;
+  unsigned int len = 0;
+  ::SSL_get0_alpn_selected(m_ssl, &proto, &len);
+  if ( proto )
+    m_alpnProtocol.assign(reinterpret_cast<const char*>(proto), len);
+  else
+    m_alpnProtocol.clear();
+}
+
 bool https_connection::open(const std::string& _server, const unsigned short& _port)
 {
   bool isSuccess = false;
@@ -895,9 +1217,16 @@ ssize_t https_connection::write(const void* _buffer, size_t _count)
     };
 
   io_exec_output out = io_exec(ssl_write_callback, IO_WRITE, 0);
+  if ( m_timing ) m_timing->on_write(out.retVal);
   return out.retVal;
 }
 
+ssize_t https_connection::writev(const struct iovec* _iov, int _iovcnt)
+{
+  // SSL records are written from a single buffer
+  return connection::writev(_iov, _iovcnt);
+}
+
 ssize_t https_connection::read(void* _buffer, size_t _count)
 {
   IOLoopCallback ssl_read_callback = [&](bool& bContinue)->int
@@ -918,9 +1247,110 @@ ssize_t https_connection::read(void* _buffer, size_t _count)
     };
 
   io_exec_output out = io_exec(ssl_read_callback, IO_READ, 0);
+  if ( m_timing ) m_timing->on_read(out.retVal);
   return out.retVal;
 }
 
+io_status https_connection::ssl_status(int _retVal, const std::string& _operation)
+{
+  int sslErr = ::SSL_get_error(m_ssl, _retVal);
+  switch ( sslErr )
+  {
+  case SSL_ERROR_WANT_READ:   return io_status::want_read;
+  case SSL_ERROR_WANT_WRITE:  return io_status::want_write;
+  case SSL_ERROR_ZERO_RETURN: return io_status::closed;
+  case SSL_ERROR_SYSCALL:
+    // An unexpected EOF from the peer is reported as a closed connection
+    if ( errno == 0 || errno == ECONNRESET || errno == EPIPE ) return io_status::closed;
+    break;
+  }
+  throw sid::exception(_operation + " failed. retVal=" + sid::to_str(_retVal) + ", sslErr=" + sid::to_str(sslErr) + ", errno=" + sid::to_errno_str());
+}
+
+io_status https_connection::ssl_connect_step()
+{
+  ERR_clear_error();
+  errno = 0;
+  int retVal = ::SSL_connect(m_ssl);
+  if ( retVal == 1 )
+  {
+    set_alpn_protocol();
+    return io_status::done;
+  }
+  io_status status = ssl_status(retVal, "SSL handshake");
+  if ( status == io_status::closed )
+    throw sid::exception("SSL handshake was unsuccessful as the peer closed the connection");
+  return status;
+}
+
+io_status https_connection::open_async(const std::string& _server, const unsigned short& _port)
+{
+  unsigned short httpsPort = ( _port )? _port : DEFAULT_PORT_HTTPS;
+
+  try
+  {
+    if ( super::open_async(_server, httpsPort) != io_status::done )
+      return io_status::want_write;
+    return open_continue();
+  }
+  catch (...)
+  {
+    close();
+    throw;
+  }
+}
+
+io_status https_connection::open_continue()
+{
+  try
+  {
+    if ( ! m_ssl )
+    {
+      // Wait for the TCP connect to complete before starting the SSL handshake
+      io_status status = super::open_continue();
+      if ( status != io_status::done )
+        return status;
+      create_ssl();
+    }
+    return ssl_connect_step();
+  }
+  catch (...)
+  {
+    close();
+    throw;
+  }
+}
+
+io_status https_connection::read_some(void* _buffer, size_t _count, size_t& _nread)
+{
+  _nread = 0;
+  ERR_clear_error();
+  errno = 0;
+  int retVal = ::SSL_read(m_ssl, _buffer, _count);
+  if ( retVal > 0 )
+  {
+    _nread = static_cast<size_t>(retVal);
+    if ( m_timing ) m_timing->on_read(retVal);
+    return io_status::done;
+  }
+  return ssl_status(retVal, "Read");
+}
+
+io_status https_connection::write_some(const void* _buffer, size_t _count, size_t& _nwritten)
+{
+  _nwritten = 0;
+  ERR_clear_error();
+  errno = 0;
+  int retVal = ::SSL_write(m_ssl, _buffer, _count);
+  if ( retVal > 0 )
+  {
+    _nwritten = static_cast<size_t>(retVal);
+    if ( m_timing ) m_timing->on_write(retVal);
+    return io_status::done;
+  }
+  return ssl_status(retVal, "Write");
+}
+
 connection_description https_connection::description() const
 {
   connection_description desc = super::description();
@@ -38,11 +38,15 @@ LICENSE: END
 */
 
 #include "http/content.hpp"
+#include "http/headers.hpp"
+#include "http/common.hpp"
 #include "common/convert.hpp"
 #include <sstream>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <cerrno>
 
 using namespace sid;
 using namespace sid::http;
@@ -176,6 +180,16 @@ std::string content::to_str() const
   return std::string();
 }
 
+/**
+ * @fn const std::string& data() const;
+ * @brief Return a reference to the content if it is a string, without making a copy.
+ */
+const std::string& content::data() const
+{
+  static const std::string empty;
+  return this->is_string()? m_data : empty;
+}
+
 /**
  * @fn void append(const std::string& _data, size_t _pos = 0, size_t _len = std::string::npos);
  * @brief Appends data to the end.
@@ -203,3 +217,169 @@ void content::append(const std::string& _data, size_t _pos/* = 0*/, size_t _len/
     m_length += _len;
   }
 }
+
+void content::append(const char* _data, size_t _len)
+{
+  if ( this->is_string() )
+  {
+    m_data.append(_data, _len);
+    m_length = m_data.length();
+    return;
+  }
+  m_file.seekp(0, std::ios_base::end);
+  m_file.write(_data, _len);
+  m_length += _len;
+}
+
+sid::checksum::crc content::checksum(sid::checksum::type _type) const
+{
+  sid::checksum::crc crc(_type);
+  if ( this->is_string() )
+    return crc.update(m_data);
+
+  if ( m_file.is_open() )
+    m_file.flush();
+  std::ifstream file(m_data, std::ios_base::binary);
+  if ( ! file )
+    throw sid::exception(sid::to_errno_str("Unable to open " + m_data));
+  std::vector<char> buffer(1024*1024);
+  while ( file.read(buffer.data(), buffer.size()) || file.gcount() > 0 )
+    crc.update(buffer.data(), static_cast<size_t>(file.gcount()));
+  return crc;
+}
+
+bool http::verify_checksum(const http::headers& _headers, const http::content& _content, std::string* _pError/* = nullptr*/)
+{
+  for ( sid::checksum::type type : { sid::checksum::type::crc32c, sid::checksum::type::crc64nvme } )
+  {
+    std::string expected;
+    if ( ! _headers.exists(http::checksum_header(type), &expected) )
+      continue;
+    const std::string actual = _content.checksum(type).to_base64();
+    if ( actual != expected )
+    {
+      if ( _pError )
+        *_pError = http::checksum_header(type) + " of the payload is " + actual + ", expected " + expected;
+      return false;
+    }
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of body_source class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+const uint64_t body_source::unknown_length;
+
+namespace {
+
+//! Range of a file descriptor read by a body_source
+struct fd_range
+{
+  int      fd;
+  bool     ownsFd;
+  uint64_t offset;
+  uint64_t length;
+  uint64_t pos;
+
+  fd_range(int _fd, bool _ownsFd, uint64_t _offset, uint64_t _length)
+    : fd(_fd), ownsFd(_ownsFd), offset(_offset), length(_length), pos(0) {}
+  ~fd_range() { if ( ownsFd && fd != -1 ) ::close(fd); }
+
+  size_t read(void* _buffer, size_t _count)
+  {
+    if ( _count > length - pos ) _count = length - pos;
+    while ( _count > 0 )
+    {
+      ssize_t nread = ::pread(fd, _buffer, _count, offset + pos);
+      if ( nread > 0 )
+      {
+        pos += nread;
+        return nread;
+      }
+      if ( nread == 0 )
+        throw sid::exception("Unexpected end of file after " + sid::to_str(pos) + " of " + sid::to_str(length) + " bytes");
+      if ( errno != EINTR )
+        throw sid::exception(sid::to_errno_str("Failed to read the payload"));
+    }
+    return 0;
+  }
+};
+
+body_source from_fd_range(const std::shared_ptr<fd_range>& _range)
+{
+  body_source source = body_source::from_reader([_range](void* _buffer, size_t _count) { return _range->read(_buffer, _count); }, _range->length);
+  return source;
+}
+
+} // anonymous namespace
+
+//! Default constructor (empty source)
+body_source::body_source() : m_reader(), m_rewind(), m_length(unknown_length), m_read(std::make_shared<uint64_t>(0))
+{
+}
+
+body_source body_source::from_reader(const FNBodyReader& _reader, uint64_t _length/* = unknown_length*/)
+{
+  body_source source;
+  source.m_reader = _reader;
+  source.m_length = _length;
+  return source;
+}
+
+body_source body_source::from_fd(int _fd, uint64_t _offset, uint64_t _length)
+{
+  std::shared_ptr<fd_range> range = std::make_shared<fd_range>(_fd, false, _offset, _length);
+  body_source source = from_fd_range(range);
+  source.m_rewind = [range]() { range->pos = 0; return true; };
+  return source;
+}
+
+body_source body_source::from_file(const std::string& _filePath, uint64_t _offset/* = 0*/, uint64_t _length/* = unknown_length*/)
+{
+  int fd = ::open(_filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if ( fd == -1 )
+    throw sid::exception(sid::to_errno_str("Unable to open " + _filePath));
+  struct stat st;
+  if ( ::fstat(fd, &st) != 0 )
+  {
+    ::close(fd);
+    throw sid::exception(sid::to_errno_str("Unable to stat " + _filePath));
+  }
+  const uint64_t fileSize = st.st_size;
+  if ( _offset > fileSize ) _offset = fileSize;
+  if ( _length == unknown_length || _length > fileSize - _offset )
+    _length = fileSize - _offset;
+
+  std::shared_ptr<fd_range> range = std::make_shared<fd_range>(fd, true, _offset, _length);
+  body_source source = from_fd_range(range);
+  source.m_rewind = [range]() { range->pos = 0; return true; };
+  return source;
+}
+
+size_t body_source::read(void* _buffer, size_t _count)
+{
+  if ( ! m_reader || _count == 0 ) return 0;
+  size_t nread = m_reader(_buffer, _count);
+  if ( nread > _count )
+    throw sid::exception("Payload reader returned more bytes than requested");
+  *m_read += nread;
+  if ( has_length() )
+  {
+    if ( *m_read > m_length )
+      throw sid::exception("Payload is larger than its length of " + sid::to_str(m_length) + " bytes");
+    if ( nread == 0 && *m_read < m_length )
+      throw sid::exception("Payload ended after " + sid::to_str(*m_read) + " of " + sid::to_str(m_length) + " bytes");
+  }
+  return nread;
+}
+
+bool body_source::rewind()
+{
+  if ( *m_read == 0 ) return true;
+  if ( ! m_rewind || ! m_rewind() ) return false;
+  *m_read = 0;
+  return true;
+}
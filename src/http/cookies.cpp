@@ -123,34 +123,46 @@ bool cookie::set(const std::string& _value)
 
 std::string cookie::to_str(bool _forRequest) const
 {
-  std::ostringstream out;
+  // The date is formatted only once for both the passes
+  const std::string expires = ( !_forRequest && expiration.type == cookie_expiration::expire )?
+    date_to_str(this->expiration.time) : std::string();
+  return sid::serialize([&](sid::sized_writer& _out) { this->p_write(_out, _forRequest, expires); });
+}
+
+void cookie::write(sid::sized_writer& _out, bool _forRequest) const
+{
+  const std::string expires = ( !_forRequest && expiration.type == cookie_expiration::expire )?
+    date_to_str(this->expiration.time) : std::string();
+  this->p_write(_out, _forRequest, expires);
+}
 
-  out << this->entry.to_str();
+void cookie::p_write(sid::sized_writer& _out, bool _forRequest, const std::string& _expires) const
+{
+  this->entry.write(_out);
 
   if ( ! _forRequest )
   {
     switch ( expiration.type )
     {
     case cookie_expiration::expire:
-      out << "; Expires=" << date_to_str(this->expiration.time);
+      _out << "; Expires=" << _expires;
       break;
     case cookie_expiration::max_age:
-      out << "; Max-Age=" << this->expiration.max_age;
+      _out << "; Max-Age=";
+      _out.write_num(static_cast<uint64_t>(this->expiration.max_age));
       break;
     case cookie_expiration::none:
       break;
     }
     if ( ! this->domain.empty() )
-      out << "; Domain=" << this->domain;
+      _out << "; Domain=" << this->domain;
     if ( ! this->path.empty() )
-      out << "; Path=" << this->path;
+      _out << "; Path=" << this->path;
     if ( this->is_secure )
-      out << "; Secure";
+      _out << "; Secure";
     if ( this->is_http_only )
-      out << "; HttpOnly";
+      _out << "; HttpOnly";
   }
-
-  return out.str();
 }
 
 bool cookie::is_expired() const
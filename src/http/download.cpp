@@ -0,0 +1,606 @@
+//////////////////////////////////////////////////////
+//
+// download.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/http.hpp"
+#include "http/download.hpp"
+#include "common/convert.hpp"
+#include "common/hash.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace sid;
+using namespace sid::http;
+
+namespace sid {
+namespace http {
+
+/**
+ * @struct download_range
+ * @brief A byte range of the object
+ */
+struct download_range
+{
+  uint64_t offset;   //! Offset of the first byte
+  uint64_t length;   //! Number of bytes
+  uint32_t attempts; //! Number of failed attempts
+
+  download_range(uint64_t _offset = 0, uint64_t _length = 0) : offset(_offset), length(_length), attempts(0) {}
+  std::string to_str() const { return "bytes=" + sid::to_str(offset) + "-" + sid::to_str(offset + length - 1); }
+};
+
+/**
+ * @class download_job
+ * @brief State of a download that is shared by the connections. This is an internal class.
+ */
+class download_job
+{
+public:
+  download_job() : fd(-1), buffer(nullptr), size(0), nextOffset(0), completed(0), inFlight(0), parts(0), retried(0) {}
+  ~download_job() { if ( fd != -1 ) ::close(fd); }
+
+  //! Write the data at the given offset of the file or the buffer
+  void write(uint64_t _offset, const char* _data, size_t _len);
+
+public:
+  int                          fd;         //! Output file descriptor (-1 for buffer)
+  std::string*                 buffer;     //! Output buffer (nullptr for file)
+  http::url                    url;        //! Object being downloaded
+  uint64_t                     size;       //! Size of the object
+  std::string                  etag;       //! ETag of the object
+  uint64_t                     nextOffset; //! Offset from which the next new range starts
+  uint64_t                     completed;  //! Bytes written so far
+  uint32_t                     inFlight;   //! Ranges being fetched
+  uint32_t                     parts;      //! Ranges completed
+  uint32_t                     retried;    //! Ranges that failed and were queued again
+  std::deque<download_range>   retries;    //! Failed ranges to be fetched again
+  std::string                  error;      //! Set on a failure that stops the download
+  std::mutex                   lock;       //! Protects the members above
+  std::condition_variable      cv;         //! Signalled when a range completes or fails
+};
+
+} // namespace http
+} // namespace sid
+
+void download_job::write(uint64_t _offset, const char* _data, size_t _len)
+{
+  if ( buffer )
+  {
+    // Ranges do not overlap. So, the connections can write in parallel.
+    ::memcpy(&(*buffer)[_offset], _data, _len);
+    return;
+  }
+  while ( _len > 0 )
+  {
+    ssize_t written = ::pwrite(fd, _data, _len, static_cast<off_t>(_offset));
+    if ( written < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      throw sid::exception(sid::to_errno_str("pwrite() failed"));
+    }
+    _data += written;
+    _len -= written;
+    _offset += written;
+  }
+}
+
+//! Weak ETags cannot be used with If-Match (RFC 9110 section 13.1.1)
+static bool is_strong_etag(const std::string& _etag)
+{
+  return ! _etag.empty() && _etag.compare(0, 2, "W/") != 0;
+}
+
+//! MD5 of the content in hexadecimal
+static std::string md5_hex(int _fd, const std::string* _buffer, uint64_t _size)
+{
+  if ( _buffer )
+    return sid::bytes_to_hex(sid::hash::md5().get_hash(*_buffer).data());
+
+  sid::hash::hasher md5{sid::hash::md5()};
+  std::string chunk(1024*1024, '\0');
+  for ( uint64_t offset = 0; offset < _size; )
+  {
+    ssize_t nread = ::pread(_fd, &chunk[0], chunk.length(), static_cast<off_t>(offset));
+    if ( nread <= 0 )
+    {
+      if ( nread < 0 && errno == EINTR ) continue;
+      throw sid::exception(sid::to_errno_str("pread() failed"));
+    }
+    md5.update(chunk.data(), nread);
+    offset += nread;
+  }
+  return sid::bytes_to_hex(md5.final().data());
+}
+
+/**
+ * @class range_fetcher
+ * @brief Fetches ranges over one connection
+ */
+class range_fetcher
+{
+public:
+  range_fetcher(const download_config& _config, const http::request& _request, download_job& _job) :
+    m_config(_config), m_request(_request), m_job(_job), m_bytesPerSec(0) {}
+
+  //! Fetch the range and write it. Returns false (with the reason in _error) on failure.
+  bool fetch(const download_range& _range, std::string& _error);
+
+  //! Fetch the first range and learn the size and ETag of the object
+  void probe(const download_range& _range);
+
+  //! Size of the next range as per the throughput of this connection
+  uint64_t next_part_size(uint64_t _remaining, uint32_t _connections) const;
+
+  //! Keep taking ranges until the object is complete
+  void run();
+
+  http::client& client() { return m_client; }
+
+private:
+  void p_prepare(const download_range& _range);
+  void p_connect();
+  //! Learn the size and ETag of the object from the response to the probe, and size the output accordingly
+  void p_probe_size(const http::response& _response, const download_range& _range);
+  //! Throws sid::exception if the response is not the requested range of the same object
+  void p_check_range(const http::response& _response, const download_range& _range) const;
+
+private:
+  const download_config& m_config;
+  const http::request&   m_request;
+  download_job&          m_job;
+  http::client           m_client;      //! Client used for the ranges of this connection
+  double                 m_bytesPerSec; //! Smoothed throughput of this connection (0 until the first range)
+};
+
+void range_fetcher::p_connect()
+{
+  if ( ! m_client.conn.empty() && m_client.conn->is_open() )
+    return;
+  const http::url& url = m_job.url;
+  m_client.conn = ( url.type == connection_type::https )?
+    http::connection::create(m_config.certificate, m_config.family) :
+    http::connection::create(url.type, m_config.family);
+  if ( ! m_client.conn->open(url.server, url.port) )
+    throw sid::exception(m_client.conn->error());
+  m_client.conn->set_blocking(true, m_config.timeout);
+}
+
+void range_fetcher::p_prepare(const download_range& _range)
+{
+  m_client.request = m_request;
+  m_client.request.method = http::method_type::get;
+  m_client.request.version = http::version_id::v11;
+  m_client.request.uri = m_job.url.resource;
+  m_client.request.headers("Host", m_job.url.server, http::header_action::skip);
+  m_client.request.headers("Range", _range.to_str());
+  // Content-codings apply to the whole representation. Ranges are taken from the identity.
+  m_client.request.headers("Accept-Encoding", "identity");
+  m_client.decode_content = false;
+  if ( is_strong_etag(m_job.etag) )
+    m_client.request.headers("If-Match", m_job.etag);
+}
+
+void range_fetcher::p_check_range(const http::response& _response, const download_range& _range) const
+{
+  if ( _response.status.code() != http::status_code::PartialContent )
+    throw sid::exception("Expected 206 for range " + _range.to_str() + ", but received " + _response.status.to_str());
+  if ( ! m_job.etag.empty() && _response.headers.get("ETag") != m_job.etag )
+    throw sid::exception("The object changed during the download (ETag " + _response.headers.get("ETag") + ")");
+  bool isFound = false;
+  http::content_range range = _response.headers.content_range(&isFound);
+  if ( ! isFound || ! range.range.start.exists() || range.range.start() != _range.offset )
+    throw sid::exception("Unexpected Content-Range for range " + _range.to_str() + ": " + _response.headers.get("Content-Range"));
+}
+
+void range_fetcher::p_probe_size(const http::response& _response, const download_range& _range)
+{
+  m_job.etag = _response.headers.get("ETag");
+  if ( _response.status.code() == http::status_code::OK )
+  {
+    // Ranges are not supported. The whole object comes with the probe, and its size is known only if Content-Length is sent.
+    bool isFound = false;
+    uint64_t length = _response.headers.content_length(&isFound);
+    m_job.size = isFound? length : 0;
+  }
+  else
+  {
+    bool isFound = false;
+    http::content_range range = _response.headers.content_range(&isFound);
+    if ( ! isFound || ! range.length.exists() )
+      throw sid::exception("Size of the object is not known from the Content-Range of the probe");
+    m_job.size = range.length();
+    if ( _response.status.code() == http::status_code::RequestedRangeNotSatisfiable )
+    {
+      if ( m_job.size != 0 )
+        throw sid::exception("Range " + _range.to_str() + " was not satisfiable for an object of size " + sid::to_str(m_job.size));
+    }
+    else if ( _response.status.code() != http::status_code::PartialContent || ! range.range.start.exists() || range.range.start() != 0 )
+      throw sid::exception("Unexpected response to the probe: " + _response.status.to_str() + " " + _response.headers.get("Content-Range"));
+  }
+
+  if ( m_job.buffer )
+    m_job.buffer->assign(m_job.size, '\0');
+  else if ( ::ftruncate(m_job.fd, static_cast<off_t>(m_job.size)) != 0 )
+    throw sid::exception(sid::to_errno_str("ftruncate() failed"));
+}
+
+void range_fetcher::probe(const download_range& _range)
+{
+  p_connect();
+  p_prepare(_range);
+  // Write the payload to the output as it arrives, the same way as the ranges, as a server that ignores Range sends the whole object
+  uint64_t received = 0;
+  bool isSized = false;
+  std::string sinkError;
+  m_client.response.sink = [&](const http::response& _response, const char* _data, size_t _len)->bool
+  {
+    try
+    {
+      if ( ! isSized )
+      {
+        p_probe_size(_response, _range);
+        isSized = true;
+      }
+      if ( _response.status.code() == http::status_code::OK )
+      {
+        // The size may not be known in advance
+        if ( m_job.buffer && received + _len > m_job.buffer->length() )
+          m_job.buffer->resize(received + _len);
+      }
+      else if ( _len > m_job.size - received )
+        throw sid::exception("Received more than " + sid::to_str(m_job.size) + " bytes in the probe");
+      m_job.write(received, _data, _len);
+      received += _len;
+    }
+    catch ( const sid::exception& e )
+    {
+      sinkError = e.what();
+      return false;
+    }
+    return true;
+  };
+  bool isSuccess = m_client.run();
+  m_client.response.sink = nullptr;
+  if ( ! sinkError.empty() )
+    throw sid::exception(sinkError);
+  http::response& response = m_client.response;
+  if ( ! isSuccess && response.status.code() != http::status_code::RequestedRangeNotSatisfiable )
+    throw m_client.exception();
+
+  // An empty payload (or 416) never reaches the sink
+  if ( ! isSized )
+    p_probe_size(response, _range);
+  if ( response.status.code() == http::status_code::OK && received != m_job.size )
+  {
+    m_job.size = received;
+    if ( m_job.buffer )
+      m_job.buffer->resize(m_job.size);
+    else if ( ::ftruncate(m_job.fd, static_cast<off_t>(m_job.size)) != 0 )
+      throw sid::exception(sid::to_errno_str("ftruncate() failed"));
+  }
+  m_job.nextOffset = ( response.status.code() == http::status_code::OK )? m_job.size : received;
+  m_job.completed = received;
+  if ( ! response_parser::keep_alive(response) )
+    m_client.conn->close();
+}
+
+bool range_fetcher::fetch(const download_range& _range, std::string& _error)
+{
+  auto start = std::chrono::steady_clock::now();
+  try
+  {
+    p_connect();
+    p_prepare(_range);
+    // Write each piece of the payload to its offset as it arrives instead of holding the whole range
+    uint64_t received = 0;
+    std::string sinkError;
+    m_client.response.sink = [&](const http::response& _response, const char* _data, size_t _len)->bool
+    {
+      try
+      {
+        if ( received == 0 )
+          p_check_range(_response, _range);
+        if ( _len > _range.length - received )
+          throw sid::exception("Received more than " + sid::to_str(_range.length) + " bytes for range " + _range.to_str());
+        m_job.write(_range.offset + received, _data, _len);
+        received += _len;
+      }
+      catch ( const sid::exception& e )
+      {
+        sinkError = e.what();
+        return false;
+      }
+      return true;
+    };
+    bool isSuccess = m_client.run();
+    m_client.response.sink = nullptr;
+    if ( ! sinkError.empty() )
+      throw sid::exception(sinkError);
+    if ( ! isSuccess )
+      throw m_client.exception();
+
+    http::response& response = m_client.response;
+    if ( received == 0 )
+      p_check_range(response, _range);
+    if ( received != _range.length )
+      throw sid::exception("Unexpected response for range " + _range.to_str() + ": " + response.headers.get("Content-Range")
+                           + " with " + sid::to_str(received) + " bytes");
+    if ( ! response_parser::keep_alive(response) )
+      m_client.conn->close();
+  }
+  catch ( const sid::exception& e )
+  {
+    m_client.response.sink = nullptr;
+    _error = e.what();
+    // Start afresh on a new connection
+    if ( ! m_client.conn.empty() )
+      m_client.conn->close();
+    return false;
+  }
+
+  // Exponential moving average of the throughput, so that a single slow range does not swing the size
+  double secs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1e6;
+  if ( secs > 0 )
+  {
+    double rate = _range.length / secs;
+    m_bytesPerSec = ( m_bytesPerSec == 0 )? rate : (0.7 * m_bytesPerSec + 0.3 * rate);
+  }
+  return true;
+}
+
+uint64_t range_fetcher::next_part_size(uint64_t _remaining, uint32_t _connections) const
+{
+  uint64_t size = m_config.part_size;
+  if ( m_bytesPerSec > 0 )
+    size = static_cast<uint64_t>(m_bytesPerSec * m_config.part_time_ms / 1000);
+  size = std::max(m_config.min_part_size, std::min(m_config.max_part_size, size));
+  // Near the end, split what is left among the connections so that no connection is left with a long tail
+  uint64_t share = (_remaining + _connections - 1) / _connections;
+  if ( share < size )
+    size = std::max(m_config.min_part_size, share);
+  return std::min(size, _remaining);
+}
+
+void range_fetcher::run()
+{
+  while ( true )
+  {
+    download_range range;
+    {
+      std::unique_lock<std::mutex> lock(m_job.lock);
+      while ( true )
+      {
+        if ( ! m_job.error.empty() )
+          return;
+        if ( ! m_job.retries.empty() )
+        {
+          range = m_job.retries.front();
+          m_job.retries.pop_front();
+          break;
+        }
+        if ( m_job.nextOffset < m_job.size )
+        {
+          uint64_t length = next_part_size(m_job.size - m_job.nextOffset, m_config.connections);
+          range = download_range(m_job.nextOffset, length);
+          m_job.nextOffset += length;
+          break;
+        }
+        // Wait for the ranges in flight, as they may fail and need to be retried
+        if ( m_job.inFlight == 0 )
+          return;
+        m_job.cv.wait(lock);
+      }
+      m_job.inFlight++;
+    }
+
+    std::string error;
+    bool isSuccess = fetch(range, error);
+
+    std::unique_lock<std::mutex> lock(m_job.lock);
+    m_job.inFlight--;
+    if ( isSuccess )
+    {
+      m_job.completed += range.length;
+      m_job.parts++;
+    }
+    else if ( ++range.attempts > m_config.max_retries )
+      m_job.error = "Range " + range.to_str() + " failed after " + sid::to_str(range.attempts) + " attempt(s): " + error;
+    else
+    {
+      m_job.retries.push_back(range);
+      m_job.retried++;
+    }
+    m_job.cv.notify_all();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of download_config and download_stats structures
+//
+//////////////////////////////////////////////////////////////////////////////////////
+download_config::download_config()
+{
+  clear();
+}
+
+void download_config::clear()
+{
+  connections = 8;
+  part_size = 8*1024*1024;
+  min_part_size = 1024*1024;
+  max_part_size = 64*1024*1024;
+  part_time_ms = 1000;
+  max_retries = 3;
+  timeout = DEFAULT_IO_TIMEOUT_SECS;
+  verify_md5 = false;
+  family = connection_family::none;
+  certificate.clear();
+}
+
+std::string download_stats::to_str() const
+{
+  double secs = elapsed_us / 1e6;
+  double mbps = ( secs > 0 )? (size / secs / (1024*1024)) : 0;
+  return "size=" + sid::to_str(size) + " parts=" + sid::to_str(parts) + " retries=" + sid::to_str(retries)
+    + " connections=" + sid::to_str(connections) + " elapsed_ms=" + sid::to_str(elapsed_us / 1000)
+    + " MBps=" + sid::to_str(static_cast<uint64_t>(mbps));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of downloader class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+downloader::downloader() : config(), request(), m_stats(), m_exception()
+{
+}
+
+bool downloader::download(const std::string& _url, const std::string& _filePath)
+{
+  download_job job;
+  job.fd = ::open(_filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if ( job.fd == -1 )
+  {
+    m_exception = sid::exception(sid::to_errno_str("Failed to open " + _filePath));
+    return false;
+  }
+  // The MD5 verification reads the file back
+  if ( config.verify_md5 )
+  {
+    ::close(job.fd);
+    job.fd = ::open(_filePath.c_str(), O_RDWR);
+  }
+  return p_download(_url, job);
+}
+
+bool downloader::download_to_buffer(const std::string& _url, std::string& _buffer)
+{
+  download_job job;
+  job.buffer = &_buffer;
+  return p_download(_url, job);
+}
+
+bool downloader::p_download(const std::string& _url, download_job& _job)
+{
+  bool isSuccess = false;
+  auto start = std::chrono::steady_clock::now();
+
+  try
+  {
+    m_stats.clear();
+    if ( _job.fd == -1 && ! _job.buffer )
+      throw sid::exception(sid::to_errno_str("Failed to open the output file"));
+    if ( ! _job.url.set(_url) )
+      throw sid::exception(_job.url.error);
+    if ( config.connections == 0 || config.min_part_size == 0 || config.min_part_size > config.max_part_size )
+      throw sid::exception("Invalid download configuration");
+
+    // The first range tells the size and the ETag of the object
+    std::vector<std::unique_ptr<range_fetcher>> fetchers;
+    fetchers.emplace_back(new range_fetcher(config, request, _job));
+    fetchers[0]->probe(download_range(0, std::max<uint64_t>(config.part_size, 1)));
+
+    // Fetch the rest over parallel connections. The connection of the probe is reused by the first one.
+    uint64_t remaining = _job.size - _job.nextOffset;
+    uint32_t connections = static_cast<uint32_t>(std::min<uint64_t>(config.connections, (remaining + config.min_part_size - 1) / config.min_part_size));
+    std::vector<std::thread> threads;
+    for ( uint32_t i = 0; i < connections; i++ )
+    {
+      if ( i > 0 )
+        fetchers.emplace_back(new range_fetcher(config, request, _job));
+      range_fetcher* fetcher = fetchers[i].get();
+      threads.emplace_back([fetcher]() { fetcher->run(); });
+    }
+    for ( std::thread& thread : threads )
+      thread.join();
+    m_stats.connections = std::max<uint32_t>(connections, 1);
+    m_stats.parts = 1 + _job.parts;
+    m_stats.retries = _job.retried;
+
+    if ( ! _job.error.empty() )
+      throw sid::exception(_job.error);
+
+    // Verify what was written
+    if ( _job.completed != _job.size )
+      throw sid::exception("Downloaded " + sid::to_str(_job.completed) + " bytes of " + sid::to_str(_job.size));
+    if ( _job.fd != -1 )
+    {
+      struct stat st;
+      if ( ::fstat(_job.fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != _job.size )
+        throw sid::exception("Size of the file does not match the object size " + sid::to_str(_job.size));
+    }
+    if ( config.verify_md5 )
+    {
+      // A plain (non multipart) S3 ETag is the MD5 of the content in quotes
+      std::string etag = _job.etag;
+      if ( etag.length() == 34 && etag.front() == '"' && etag.back() == '"' )
+        etag = etag.substr(1, 32);
+      if ( etag.length() == 32 && etag.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos )
+      {
+        std::string md5 = md5_hex(_job.fd, _job.buffer, _job.size);
+        if ( ::strcasecmp(md5.c_str(), etag.c_str()) != 0 )
+          throw sid::exception("MD5 of the content " + md5 + " does not match the ETag " + _job.etag);
+      }
+    }
+    m_stats.size = _job.size;
+    m_stats.etag = _job.etag;
+    isSuccess = true;
+  }
+  catch ( const sid::exception& e )
+  {
+    m_exception = e;
+  }
+  catch (...)
+  {
+    m_exception = sid::exception("An unhandled exception occurred while downloading " + _url);
+  }
+
+  m_stats.elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  return isSuccess;
+}
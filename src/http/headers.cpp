@@ -64,7 +64,7 @@ header::header(const std::string& _key, const std::string& _value)
 
 std::string header::to_str() const
 {
-  return this->key + ": " + this->value;
+  return sid::serialize([&](sid::sized_writer& _out) { this->write(_out); });
 }
 
 /*static*/
@@ -196,13 +196,16 @@ size_t headers::remove_all(const std::string& _key)
 
 std::string headers::to_str() const
 {
-  std::ostringstream out;
-  for ( size_t i = 0; i < this->size(); i++ )
+  return sid::serialize([&](sid::sized_writer& _out) { this->write(_out); });
+}
+
+void headers::write(sid::sized_writer& _out) const
+{
+  for ( const http::header& header : *this )
   {
-    const http::header& header = (*this)[i];
-    out << header.to_str() << CRLF;
+    header.write(_out);
+    _out.write(CRLF, 2);
   }
-  return out.str();
 }
 
 headers::iterator headers::find(const std::string& _key)
@@ -236,6 +239,40 @@ uint64_t headers::content_length(bool* _pisFound/* = nullptr*/) const
   return contentLength;
 }
 
+bool http::get_content_encoding(const std::string& _token, /*out*/ http::content_encoding& _encoding)
+{
+  const char* enc = _token.c_str();
+  if ( ::strcasecmp(enc, "gzip") == 0 || ::strcasecmp(enc, "x-gzip") == 0 ) // x-gzip as per http/1.1 recommendation
+    _encoding = http::content_encoding::gzip;
+  else if ( ::strcasecmp(enc, "compress") == 0 || ::strcasecmp(enc, "x-compress") == 0 )
+    _encoding = http::content_encoding::compress;
+  else if ( ::strcasecmp(enc, "deflate") == 0 )
+    _encoding = http::content_encoding::deflate;
+  else if ( ::strcasecmp(enc, "identity") == 0 )
+    _encoding = http::content_encoding::identity;
+  else if ( ::strcasecmp(enc, "br") == 0 )
+    _encoding = http::content_encoding::br;
+  else if ( ::strcasecmp(enc, "zstd") == 0 )
+    _encoding = http::content_encoding::zstd;
+  else
+    return false;
+  return true;
+}
+
+std::string http::content_encoding_to_str(const http::content_encoding& _encoding)
+{
+  switch ( _encoding )
+  {
+  case http::content_encoding::identity: return "identity";
+  case http::content_encoding::gzip:     return "gzip";
+  case http::content_encoding::compress: return "compress";
+  case http::content_encoding::deflate:  return "deflate";
+  case http::content_encoding::br:       return "br";
+  case http::content_encoding::zstd:     return "zstd";
+  }
+  return std::string();
+}
+
 http::content_encoding headers::content_encoding(bool* _pisFound/* = nullptr*/) const
 {
   http::content_encoding encoding = http::content_encoding::identity;
@@ -247,17 +284,7 @@ http::content_encoding headers::content_encoding(bool* _pisFound/* = nullptr*/)
     std::vector<std::string> encodingVec;
     if ( 0 < sid::split(/*out*/ encodingVec, value, ',', SPLIT_TRIM_SKIP_EMPTY) )
     {
-      std::string enc = encodingVec[0];
-      if ( enc == "gzip" || enc == "x-gzip" ) // x-gzip as per http/1.1 recommendation
-        encoding = http::content_encoding::gzip;
-      else if ( enc == "compress" )
-        encoding = http::content_encoding::compress;
-      else if ( enc == "deflate" )
-        encoding = http::content_encoding::deflate;
-      else if ( enc == "identity" )
-        encoding = http::content_encoding::identity;
-      else if ( enc == "br" )
-        encoding = http::content_encoding::br;
+      http::get_content_encoding(encodingVec[0], /*out*/ encoding);
     }
   }
   return encoding;
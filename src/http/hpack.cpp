@@ -0,0 +1,611 @@
+//////////////////////////////////////////////////////
+//
+// hpack.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/hpack.hpp"
+#include "common/convert.hpp"
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+using namespace sid;
+using namespace sid::http;
+
+struct StaticEntry { const char* name; const char* value; };
+
+//! Static table as per RFC 7541 Appendix A
+static const StaticEntry gStaticTable[] =
+  {
+    /* 1*/ {":authority", ""},
+    /* 2*/ {":method", "GET"},
+    /* 3*/ {":method", "POST"},
+    /* 4*/ {":path", "/"},
+    /* 5*/ {":path", "/index.html"},
+    /* 6*/ {":scheme", "http"},
+    /* 7*/ {":scheme", "https"},
+    /* 8*/ {":status", "200"},
+    /* 9*/ {":status", "204"},
+    /*10*/ {":status", "206"},
+    /*11*/ {":status", "304"},
+    /*12*/ {":status", "400"},
+    /*13*/ {":status", "404"},
+    /*14*/ {":status", "500"},
+    /*15*/ {"accept-charset", ""},
+    /*16*/ {"accept-encoding", "gzip, deflate"},
+    /*17*/ {"accept-language", ""},
+    /*18*/ {"accept-ranges", ""},
+    /*19*/ {"accept", ""},
+    /*20*/ {"access-control-allow-origin", ""},
+    /*21*/ {"age", ""},
+    /*22*/ {"allow", ""},
+    /*23*/ {"authorization", ""},
+    /*24*/ {"cache-control", ""},
+    /*25*/ {"content-disposition", ""},
+    /*26*/ {"content-encoding", ""},
+    /*27*/ {"content-language", ""},
+    /*28*/ {"content-length", ""},
+    /*29*/ {"content-location", ""},
+    /*30*/ {"content-range", ""},
+    /*31*/ {"content-type", ""},
+    /*32*/ {"cookie", ""},
+    /*33*/ {"date", ""},
+    /*34*/ {"etag", ""},
+    /*35*/ {"expect", ""},
+    /*36*/ {"expires", ""},
+    /*37*/ {"from", ""},
+    /*38*/ {"host", ""},
+    /*39*/ {"if-match", ""},
+    /*40*/ {"if-modified-since", ""},
+    /*41*/ {"if-none-match", ""},
+    /*42*/ {"if-range", ""},
+    /*43*/ {"if-unmodified-since", ""},
+    /*44*/ {"last-modified", ""},
+    /*45*/ {"link", ""},
+    /*46*/ {"location", ""},
+    /*47*/ {"max-forwards", ""},
+    /*48*/ {"proxy-authenticate", ""},
+    /*49*/ {"proxy-authorization", ""},
+    /*50*/ {"range", ""},
+    /*51*/ {"referer", ""},
+    /*52*/ {"refresh", ""},
+    /*53*/ {"retry-after", ""},
+    /*54*/ {"server", ""},
+    /*55*/ {"set-cookie", ""},
+    /*56*/ {"strict-transport-security", ""},
+    /*57*/ {"transfer-encoding", ""},
+    /*58*/ {"user-agent", ""},
+    /*59*/ {"vary", ""},
+    /*60*/ {"via", ""},
+    /*61*/ {"www-authenticate", ""},
+  };
+static const size_t gStaticCount = sizeof(gStaticTable)/sizeof(gStaticTable[0]);
+
+struct HuffmanCode { uint32_t code; uint8_t bits; };
+
+//! Huffman codes as per RFC 7541 Appendix B (the last entry is EOS)
+static const HuffmanCode gHuffmanCodes[257] =
+  {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+    {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+    {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+    {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+    {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+    {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+    {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+    {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+    {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+    {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+    {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+    {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+    {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+    {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+    {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+    {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+    {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+    {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+    {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+    {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+    {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+    {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+    {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+    {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+    {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+    {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+    {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+    {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+    {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+    {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+    {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+    {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+    {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+    {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+    {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+    {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+    {0x3fffffff, 30},
+  };
+#define HUFFMAN_EOS 256
+
+//! Entry size overhead as per RFC 7541 section 4.1
+#define HPACK_ENTRY_OVERHEAD 32
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Lookup structures that are built once
+//
+//////////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+//! The static table entries as header objects along with lookup maps
+struct static_lookup
+{
+  std::vector<http::header>               entries;   //! Index 0 is unused
+  std::unordered_map<std::string, size_t> byName;    //! First index of the name
+  std::unordered_map<std::string, size_t> byField;   //! Index of name + '\0' + value
+
+  static_lookup()
+    {
+      entries.resize(gStaticCount + 1);
+      for ( size_t i = 0; i < gStaticCount; i++ )
+      {
+        const StaticEntry& entry = gStaticTable[i];
+        entries[i+1] = http::header(entry.name, entry.value);
+        byName.insert(std::make_pair(std::string(entry.name), i+1));
+        byField.insert(std::make_pair(std::string(entry.name) + '\0' + entry.value, i+1));
+      }
+    }
+  static const static_lookup& get() { static const static_lookup lookup; return lookup; }
+};
+
+//! Binary tree used for decoding the Huffman codes
+struct huffman_tree
+{
+  struct node
+  {
+    int16_t child[2]; //! Index of the child nodes (0 if there is none)
+    int16_t symbol;   //! Decoded symbol for a leaf node (-1 otherwise)
+  };
+  std::vector<node> nodes; //! Node 0 is the root
+
+  huffman_tree()
+    {
+      nodes.push_back(node{{0, 0}, -1});
+      for ( int symbol = 0; symbol <= HUFFMAN_EOS; symbol++ )
+      {
+        const HuffmanCode& hc = gHuffmanCodes[symbol];
+        size_t current = 0;
+        for ( int bit = hc.bits - 1; bit >= 0; bit-- )
+        {
+          int b = (hc.code >> bit) & 1;
+          if ( nodes[current].child[b] == 0 )
+          {
+            nodes[current].child[b] = static_cast<int16_t>(nodes.size());
+            nodes.push_back(node{{0, 0}, -1});
+          }
+          current = nodes[current].child[b];
+        }
+        nodes[current].symbol = static_cast<int16_t>(symbol);
+      }
+    }
+  static const huffman_tree& get() { static const huffman_tree tree; return tree; }
+};
+
+//! Decode an integer with the given prefix bits (RFC 7541 section 5.1)
+uint64_t decode_integer(const uint8_t*& _p, const uint8_t* _end, uint8_t _prefixBits)
+{
+  if ( _p >= _end )
+    throw sid::exception("HPACK: Truncated integer");
+  const uint64_t maxPrefix = (1u << _prefixBits) - 1;
+  uint64_t value = (*_p++) & maxPrefix;
+  if ( value < maxPrefix )
+    return value;
+  for ( unsigned shift = 0; ; shift += 7 )
+  {
+    if ( _p >= _end )
+      throw sid::exception("HPACK: Truncated integer");
+    if ( shift > 28 )
+      throw sid::exception("HPACK: Integer overflow");
+    uint8_t b = *_p++;
+    value += static_cast<uint64_t>(b & 0x7f) << shift;
+    if ( (b & 0x80) == 0 ) break;
+  }
+  return value;
+}
+
+//! Decode a string literal (RFC 7541 section 5.2)
+void decode_string(const uint8_t*& _p, const uint8_t* _end, /*out*/ std::string& _out)
+{
+  if ( _p >= _end )
+    throw sid::exception("HPACK: Truncated string");
+  bool isHuffman = ( (*_p & 0x80) != 0 );
+  uint64_t len = decode_integer(_p, _end, 7);
+  if ( len > static_cast<uint64_t>(_end - _p) )
+    throw sid::exception("HPACK: String length exceeds the header block");
+  _out.clear();
+  if ( isHuffman )
+    hpack::huffman_decode(reinterpret_cast<const char*>(_p), len, _out);
+  else
+    _out.assign(reinterpret_cast<const char*>(_p), len);
+  _p += len;
+}
+
+//! Encode a string literal using Huffman encoding if it is shorter
+void encode_string(const std::string& _input, /*out*/ std::string& _out)
+{
+  size_t huffmanLen = hpack::huffman_length(_input);
+  if ( huffmanLen < _input.length() )
+  {
+    hpack::encode_integer(huffmanLen, 7, 0x80, _out);
+    hpack::huffman_encode(_input, _out);
+  }
+  else
+  {
+    hpack::encode_integer(_input.length(), 7, 0x00, _out);
+    _out.append(_input);
+  }
+}
+
+} // anonymous namespace
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Huffman and integer coding
+//
+//////////////////////////////////////////////////////////////////////////////////////
+void hpack::encode_integer(uint64_t _value, uint8_t _prefixBits, uint8_t _flags, /*out*/ std::string& _out)
+{
+  const uint64_t maxPrefix = (1u << _prefixBits) - 1;
+  if ( _value < maxPrefix )
+  {
+    _out.push_back(static_cast<char>(_flags | _value));
+    return;
+  }
+  _out.push_back(static_cast<char>(_flags | maxPrefix));
+  _value -= maxPrefix;
+  while ( _value >= 0x80 )
+  {
+    _out.push_back(static_cast<char>((_value & 0x7f) | 0x80));
+    _value >>= 7;
+  }
+  _out.push_back(static_cast<char>(_value));
+}
+
+size_t hpack::huffman_length(const std::string& _input)
+{
+  uint64_t bits = 0;
+  for ( unsigned char ch : _input )
+    bits += gHuffmanCodes[ch].bits;
+  return static_cast<size_t>((bits + 7) / 8);
+}
+
+void hpack::huffman_encode(const std::string& _input, /*out*/ std::string& _out)
+{
+  uint64_t current = 0; // Pending bits
+  unsigned count = 0;   // Number of pending bits
+  for ( unsigned char ch : _input )
+  {
+    const HuffmanCode& hc = gHuffmanCodes[ch];
+    current = (current << hc.bits) | hc.code;
+    count += hc.bits;
+    while ( count >= 8 )
+    {
+      count -= 8;
+      _out.push_back(static_cast<char>(current >> count));
+    }
+  }
+  // Pad with the most significant bits of EOS (all 1s)
+  if ( count > 0 )
+    _out.push_back(static_cast<char>((current << (8 - count)) | (0xff >> count)));
+}
+
+void hpack::huffman_decode(const char* _data, size_t _len, /*out*/ std::string& _out)
+{
+  const huffman_tree& tree = huffman_tree::get();
+  size_t current = 0;      // Current node
+  unsigned depth = 0;      // Bits consumed since the last symbol
+  bool allOnes = true;     // Are all the bits since the last symbol 1s?
+
+  for ( size_t i = 0; i < _len; i++ )
+  {
+    uint8_t byte = static_cast<uint8_t>(_data[i]);
+    for ( int bit = 7; bit >= 0; bit-- )
+    {
+      int b = (byte >> bit) & 1;
+      current = tree.nodes[current].child[b];
+      if ( current == 0 )
+        throw sid::exception("HPACK: Invalid Huffman code");
+      depth++;
+      allOnes = allOnes && (b == 1);
+      int16_t symbol = tree.nodes[current].symbol;
+      if ( symbol >= 0 )
+      {
+        if ( symbol == HUFFMAN_EOS )
+          throw sid::exception("HPACK: EOS found in Huffman encoded string");
+        _out.push_back(static_cast<char>(symbol));
+        current = 0;
+        depth = 0;
+        allOnes = true;
+      }
+    }
+  }
+  // The padding must be shorter than 8 bits and must be the prefix of EOS
+  if ( depth > 7 || ! allOnes )
+    throw sid::exception("HPACK: Invalid Huffman padding");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of hpack_table class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+hpack_table::hpack_table(uint32_t _maxSize) : m_entries(), m_size(0), m_maxSize(_maxSize)
+{
+}
+
+/*static*/
+size_t hpack_table::static_count()
+{
+  return gStaticCount;
+}
+
+const http::header& hpack_table::get(size_t _index) const
+{
+  if ( _index == 0 )
+    throw sid::exception("HPACK: Invalid index 0");
+  if ( _index <= gStaticCount )
+    return static_lookup::get().entries[_index];
+  size_t pos = _index - gStaticCount - 1;
+  if ( pos >= m_entries.size() )
+    throw sid::exception("HPACK: Invalid index " + sid::to_str(_index));
+  return m_entries[pos];
+}
+
+void hpack_table::evict(uint32_t _maxSize)
+{
+  while ( m_size > _maxSize && ! m_entries.empty() )
+  {
+    const http::header& oldest = m_entries.back();
+    m_size -= static_cast<uint32_t>(oldest.key.length() + oldest.value.length() + HPACK_ENTRY_OVERHEAD);
+    m_entries.pop_back();
+  }
+}
+
+void hpack_table::add(const std::string& _name, const std::string& _value)
+{
+  uint64_t entrySize = _name.length() + _value.length() + HPACK_ENTRY_OVERHEAD;
+  if ( entrySize > m_maxSize )
+  {
+    // An entry larger than the table empties the table (RFC 7541 section 4.4)
+    m_entries.clear();
+    m_size = 0;
+    return;
+  }
+  evict(m_maxSize - static_cast<uint32_t>(entrySize));
+  m_entries.emplace_front(_name, _value);
+  m_size += static_cast<uint32_t>(entrySize);
+}
+
+void hpack_table::set_max_size(uint32_t _maxSize)
+{
+  m_maxSize = _maxSize;
+  evict(m_maxSize);
+}
+
+size_t hpack_table::find(const std::string& _name, const std::string& _value, bool& _isValueMatched) const
+{
+  const static_lookup& lookup = static_lookup::get();
+  _isValueMatched = false;
+
+  auto it = lookup.byField.find(_name + '\0' + _value);
+  if ( it != lookup.byField.end() )
+  {
+    _isValueMatched = true;
+    return it->second;
+  }
+
+  size_t nameIndex = 0;
+  for ( size_t i = 0; i < m_entries.size(); i++ )
+  {
+    const http::header& entry = m_entries[i];
+    if ( entry.key != _name ) continue;
+    if ( entry.value == _value )
+    {
+      _isValueMatched = true;
+      return gStaticCount + 1 + i;
+    }
+    if ( nameIndex == 0 ) nameIndex = gStaticCount + 1 + i;
+  }
+
+  auto itName = lookup.byName.find(_name);
+  if ( itName != lookup.byName.end() )
+    return itName->second;
+  return nameIndex;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of hpack_encoder class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+hpack_encoder::hpack_encoder(uint32_t _maxTableSize) : m_table(_maxTableSize), m_pendingSize(UINT32_MAX)
+{
+}
+
+void hpack_encoder::set_max_table_size(uint32_t _maxSize)
+{
+  // Never use more than the default, even if the peer allows it
+  if ( _maxSize > HPACK_DEFAULT_TABLE_SIZE ) _maxSize = HPACK_DEFAULT_TABLE_SIZE;
+  if ( _maxSize == m_table.max_size() ) return;
+  m_table.set_max_size(_maxSize);
+  m_pendingSize = _maxSize;
+}
+
+void hpack_encoder::p_begin_block(std::string& _out)
+{
+  if ( m_pendingSize != UINT32_MAX )
+  {
+    hpack::encode_integer(m_pendingSize, 5, 0x20, _out);
+    m_pendingSize = UINT32_MAX;
+  }
+}
+
+void hpack_encoder::encode(const std::string& _name, const std::string& _value, /*out*/ std::string& _out)
+{
+  p_begin_block(_out);
+
+  bool isValueMatched = false;
+  size_t index = m_table.find(_name, _value, isValueMatched);
+  if ( index != 0 && isValueMatched )
+  {
+    // Indexed header field
+    hpack::encode_integer(index, 7, 0x80, _out);
+    return;
+  }
+
+  // Credentials are never indexed so that they cannot be probed through the compression state
+  bool isSensitive = ( _name == "authorization" || _name == "proxy-authorization"
+                       || (_name == "cookie" && _value.length() < 20) );
+  bool isIndexed = ! isSensitive && (_name.length() + _value.length() + HPACK_ENTRY_OVERHEAD) <= (m_table.max_size() * 3 / 4);
+
+  if ( isIndexed )
+    hpack::encode_integer(index, 6, 0x40, _out);   // Literal with incremental indexing
+  else if ( isSensitive )
+    hpack::encode_integer(index, 4, 0x10, _out);   // Literal never indexed
+  else
+    hpack::encode_integer(index, 4, 0x00, _out);   // Literal without indexing
+  if ( index == 0 )
+    encode_string(_name, _out);
+  encode_string(_value, _out);
+
+  if ( isIndexed )
+    m_table.add(_name, _value);
+}
+
+void hpack_encoder::encode(const http::headers& _headers, /*out*/ std::string& _out)
+{
+  std::string name;
+  for ( const http::header& header : _headers )
+  {
+    name = header.key;
+    for ( char& ch : name )
+      ch = static_cast<char>(::tolower(static_cast<unsigned char>(ch)));
+    encode(name, header.value, _out);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of hpack_decoder class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+hpack_decoder::hpack_decoder(uint32_t _maxTableSize) : m_table(_maxTableSize), m_maxTableSize(_maxTableSize)
+{
+}
+
+void hpack_decoder::decode(const char* _data, size_t _len, /*out*/ http::headers& _headers)
+{
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(_data);
+  const uint8_t* end = p + _len;
+  std::string name, value;
+  bool isFieldSeen = false;
+
+  while ( p < end )
+  {
+    uint8_t b = *p;
+    if ( b & 0x80 )
+    {
+      // Indexed header field
+      uint64_t index = decode_integer(p, end, 7);
+      const http::header& entry = m_table.get(index);
+      _headers.add(entry.key, entry.value);
+      isFieldSeen = true;
+    }
+    else if ( (b & 0xe0) == 0x20 )
+    {
+      // Dynamic table size update. It is allowed only at the start of the block.
+      if ( isFieldSeen )
+        throw sid::exception("HPACK: Table size update after a header field");
+      uint64_t size = decode_integer(p, end, 5);
+      if ( size > m_maxTableSize )
+        throw sid::exception("HPACK: Table size update exceeds the limit");
+      m_table.set_max_size(static_cast<uint32_t>(size));
+    }
+    else
+    {
+      // Literal header field (with incremental indexing, without indexing or never indexed)
+      bool isIndexed = ( (b & 0xc0) == 0x40 );
+      uint64_t index = decode_integer(p, end, isIndexed? 6 : 4);
+      if ( index == 0 )
+        decode_string(p, end, name);
+      else
+        name = m_table.get(index).key;
+      decode_string(p, end, value);
+      if ( isIndexed )
+        m_table.add(name, value);
+      _headers.add(name, value);
+      isFieldSeen = true;
+    }
+  }
+}
@@ -0,0 +1,1216 @@
+//////////////////////////////////////////////////////
+//
+// http2.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/http.hpp"
+#include "http/http2.hpp"
+#include "http/hpack.hpp"
+#include "http/compression.hpp"
+#include "common/convert.hpp"
+
+#include <poll.h>
+#include <cstring>
+#include <map>
+#include <deque>
+#include <vector>
+
+using namespace std;
+using namespace sid;
+using namespace sid::http;
+
+//! Client connection preface (RFC 9113 section 3.4)
+static const char HTTP2_PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+#define HTTP2_PREFACE_LEN (sizeof(HTTP2_PREFACE) - 1)
+
+#define HTTP2_FRAME_HEADER_LEN   9
+#define HTTP2_DEFAULT_WINDOW     65535
+#define HTTP2_DEFAULT_FRAME_SIZE 16384
+#define HTTP2_MAX_WINDOW         0x7fffffff
+#define HTTP2_LOCAL_STREAM_WINDOW     (1024*1024)      // Advertised window of each stream
+#define HTTP2_LOCAL_CONNECTION_WINDOW (16*1024*1024)   // Window of the connection after the initial update
+#define HTTP2_LOCAL_MAX_STREAMS       128              // Concurrent streams allowed by the server side
+#define HTTP2_CLIENT_MAX_STREAMS      256              // Cap on the concurrent streams opened by the client
+#define HTTP2_INITIAL_MAX_STREAMS     100              // Streams opened before the SETTINGS of the server arrive (RFC 9113 section 6.5.2)
+#define HTTP2_READ_BUFFER_SIZE        (64*1024)
+#define HTTP2_BODY_PIECE_SIZE         (64*1024)        // Size of the pieces read from a streamed request payload
+
+//! Frame types (RFC 9113 section 6)
+enum class frame_type : uint8_t
+{
+  data = 0x0, headers = 0x1, priority = 0x2, rst_stream = 0x3, settings = 0x4,
+  push_promise = 0x5, ping = 0x6, goaway = 0x7, window_update = 0x8, continuation = 0x9
+};
+
+//! Frame flags
+#define FLAG_END_STREAM  0x01
+#define FLAG_ACK         0x01
+#define FLAG_END_HEADERS 0x04
+#define FLAG_PADDED      0x08
+#define FLAG_PRIORITY    0x20
+
+//! Settings identifiers
+#define SETTINGS_HEADER_TABLE_SIZE      0x1
+#define SETTINGS_ENABLE_PUSH            0x2
+#define SETTINGS_MAX_CONCURRENT_STREAMS 0x3
+#define SETTINGS_INITIAL_WINDOW_SIZE    0x4
+#define SETTINGS_MAX_FRAME_SIZE         0x5
+#define SETTINGS_MAX_HEADER_LIST_SIZE   0x6
+
+namespace sid {
+namespace http {
+
+/**
+ * @struct http2_stream
+ * @brief State of a single stream
+ */
+struct http2_stream
+{
+  uint32_t                               id;           //! Stream identifier
+  bool                                   headersSent;  //! HEADERS sent. DATA can follow.
+  bool                                   localClosed;  //! END_STREAM sent
+  bool                                   remoteClosed; //! END_STREAM received
+  bool                                   hasHeaders;   //! Final (non 1xx) headers received
+  int64_t                                sendWindow;   //! Flow control window for sending
+  uint64_t                               recvConsumed; //! Bytes received since the last WINDOW_UPDATE
+  std::string                            sendData;     //! Content to be sent
+  size_t                                 sendPos;      //! Bytes of sendData already sent
+  bool                                   bodyDone;     //! Streamed payload of the request has been read completely
+  http::request                          request;      //! Request sent (client) or received (server)
+  multi_result                           result;       //! Result (client) or the response to be sent (server)
+  FNMultiCallback                        callback;     //! Completion callback (client)
+  std::unique_ptr<http::content_decoder> decoder;      //! Content decoder (client)
+
+  http2_stream() : id(0), headersSent(false), localClosed(false), remoteClosed(false), hasHeaders(false),
+                   sendWindow(HTTP2_DEFAULT_WINDOW), recvConsumed(0), sendPos(0), bodyDone(false) {}
+};
+
+/**
+ * @class http2_engine
+ * @brief HTTP/2 framing, HPACK and flow control behind http2_session. This is an internal class.
+ */
+class http2_engine
+{
+public:
+  http2_engine(connection_ptr _conn, http2_session::role _role);
+
+  uint32_t submit(const http::request& _request, const FNMultiCallback& _fnCallback);
+  bool run();
+  bool serve(const FNHttp2Handler& _fnHandler);
+
+  bool is_usable() const { return m_error.empty() && ! m_goaway && ! m_conn.empty() && m_conn->is_open(); }
+
+public:
+  bool           m_decodeContent; //! Decode the content as per Content-Encoding header (client)
+  http2_settings m_peer;          //! Settings received from the peer
+  std::string    m_error;         //! Reason for the last failure
+
+private:
+  // I/O
+  void start();
+  void pump(int _timeoutMs);
+  void write_frame(frame_type _type, uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len);
+  void write_header_block(uint32_t _streamId, const std::string& _block, bool _endStream);
+  void write_rst_stream(uint32_t _streamId, http2_error _error);
+  void write_window_update(uint32_t _streamId, uint32_t _increment);
+  void write_goaway(http2_error _error);
+  void write_data();
+
+  // Input processing
+  void process_input();
+  void handle_frame(frame_type _type, uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len);
+  void handle_data(uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len);
+  void handle_headers(uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len);
+  void handle_header_block(uint32_t _streamId, bool _endStream);
+  void handle_settings(uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len);
+  void handle_window_update(uint32_t _streamId, const char* _payload, size_t _len);
+  void handle_goaway(const char* _payload, size_t _len);
+  void handle_remote_end(http2_stream* _stream);
+
+  // Streams
+  void start_streams();
+  void open_stream(std::unique_ptr<http2_stream> _stream);
+  void finish_stream(uint32_t _streamId, const std::string& _error);
+  void retry_stream(uint32_t _streamId);
+  void fail_all(const std::string& _error);
+  void call_callbacks();
+  http2_stream* find(uint32_t _streamId);
+
+  [[noreturn]] void connection_error(http2_error _error, const std::string& _message);
+
+private:
+  connection_ptr                                     m_conn;          //! Underlying connection
+  http2_session::role                                m_role;          //! Client or server
+  hpack_encoder                                      m_encoder;       //! Header compression
+  hpack_decoder                                      m_decoder;       //! Header decompression
+  std::map<uint32_t, std::unique_ptr<http2_stream>>  m_streams;       //! Open streams
+  std::deque<std::unique_ptr<http2_stream>>          m_queued;        //! Client requests waiting for a stream slot
+  std::vector<std::unique_ptr<http2_stream>>         m_completed;     //! Client streams whose callbacks are due
+  std::string                                        m_in;            //! Received data that is not processed yet
+  size_t                                             m_inPos;         //! Position of the unprocessed data in m_in
+  std::string                                        m_out;           //! Data to be written
+  bool                                               m_started;       //! Preface and settings were sent
+  bool                                               m_prefaceSeen;   //! Client preface received (server)
+  bool                                               m_goaway;        //! GOAWAY was received
+  bool                                               m_eof;           //! Peer closed the connection
+  bool                                               m_peerSettings;  //! SETTINGS of the peer were received
+  uint32_t                                           m_nextStreamId;  //! Next client stream identifier
+  uint32_t                                           m_lastStreamId;  //! Last stream identifier opened by the peer (server)
+  uint32_t                                           m_nextRequestId; //! Next request identifier for submit()
+  int64_t                                            m_sendWindow;    //! Connection flow control window for sending
+  uint64_t                                           m_recvConsumed;  //! Bytes received since the last connection WINDOW_UPDATE
+  uint32_t                                           m_continuationId; //! Stream expecting CONTINUATION frames (0 if none)
+  bool                                               m_continuationEnd; //! END_STREAM flag of the HEADERS being continued
+  std::string                                        m_headerBlock;   //! Header block being assembled
+  const FNHttp2Handler*                              m_handler;       //! Request handler (server)
+  std::vector<uint32_t>                              m_ready;         //! Server streams whose requests are complete
+};
+
+} // namespace http
+} // namespace sid
+
+//! Read a big-endian 32-bit value
+static inline uint32_t get_u32(const char* _p)
+{
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(_p);
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+//! Append a big-endian 32-bit value
+static inline void put_u32(std::string& _out, uint32_t _value)
+{
+  _out.push_back(static_cast<char>(_value >> 24));
+  _out.push_back(static_cast<char>(_value >> 16));
+  _out.push_back(static_cast<char>(_value >> 8));
+  _out.push_back(static_cast<char>(_value));
+}
+
+//! Headers that are specific to HTTP/1.x connections and must not be sent over HTTP/2 (RFC 9113 section 8.2.2)
+static bool is_connection_header(const std::string& _name)
+{
+  static const char* names[] = { "host", "connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade" };
+  for ( const char* name : names )
+    if ( ::strcasecmp(_name.c_str(), name) == 0 ) return true;
+  return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of http2_settings structure
+//
+//////////////////////////////////////////////////////////////////////////////////////
+http2_settings::http2_settings()
+{
+  clear();
+}
+
+void http2_settings::clear()
+{
+  header_table_size = HPACK_DEFAULT_TABLE_SIZE;
+  enable_push = 1;
+  max_concurrent_streams = UINT32_MAX; // Unlimited until the peer says otherwise
+  initial_window_size = HTTP2_DEFAULT_WINDOW;
+  max_frame_size = HTTP2_DEFAULT_FRAME_SIZE;
+  max_header_list_size = UINT32_MAX;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of http2_session class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+http2_session::http2_session(connection_ptr _conn, role _role/* = role::client*/) : m_engine(new http2_engine(_conn, _role))
+{
+}
+
+http2_session::~http2_session()
+{
+}
+
+void http2_session::set_decode_content(bool _decodeContent)
+{
+  m_engine->m_decodeContent = _decodeContent;
+}
+
+uint32_t http2_session::submit(const http::request& _request, const FNMultiCallback& _fnCallback)
+{
+  return m_engine->submit(_request, _fnCallback);
+}
+
+bool http2_session::run()
+{
+  return m_engine->run();
+}
+
+bool http2_session::exchange(const http::request& _request, http::response& _response)
+{
+  std::string error;
+  bool isReceived = false;
+  m_engine->submit(_request, [&](multi_result& _result)
+    {
+      isReceived = _result.success;
+      error = _result.error;
+      _response = std::move(_result.response);
+    });
+  bool isUsable = m_engine->run();
+  if ( ! isReceived )
+  {
+    if ( m_engine->m_error.empty() || isUsable )
+      m_engine->m_error = error;
+    return false;
+  }
+  return true;
+}
+
+bool http2_session::serve(const FNHttp2Handler& _fnHandler)
+{
+  return m_engine->serve(_fnHandler);
+}
+
+bool http2_session::is_usable() const
+{
+  return m_engine->is_usable();
+}
+
+const http2_settings& http2_session::peer_settings() const
+{
+  return m_engine->m_peer;
+}
+
+const std::string& http2_session::error() const
+{
+  return m_engine->m_error;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of http2_engine class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+http2_engine::http2_engine(connection_ptr _conn, http2_session::role _role) :
+  m_decodeContent(true), m_peer(), m_error(),
+  m_conn(_conn), m_role(_role), m_encoder(), m_decoder(),
+  m_inPos(0), m_started(false), m_prefaceSeen(false), m_goaway(false), m_eof(false), m_peerSettings(false),
+  m_nextStreamId(1), m_lastStreamId(0), m_nextRequestId(0),
+  m_sendWindow(HTTP2_DEFAULT_WINDOW), m_recvConsumed(0),
+  m_continuationId(0), m_continuationEnd(false), m_handler(nullptr)
+{
+  if ( m_conn.empty() || ! m_conn->is_open() )
+    throw sid::exception("HTTP/2 session requires an open connection");
+}
+
+void http2_engine::start()
+{
+  if ( m_started ) return;
+  m_started = true;
+
+  // The client starts with the connection preface. Both sides then send their SETTINGS.
+  if ( m_role == http2_session::role::client )
+    m_out.append(HTTP2_PREFACE, HTTP2_PREFACE_LEN);
+
+  std::string payload;
+  auto add_setting = [&](uint16_t _id, uint32_t _value)
+    {
+      payload.push_back(static_cast<char>(_id >> 8));
+      payload.push_back(static_cast<char>(_id));
+      put_u32(payload, _value);
+    };
+  if ( m_role == http2_session::role::client )
+    add_setting(SETTINGS_ENABLE_PUSH, 0);
+  else
+    add_setting(SETTINGS_MAX_CONCURRENT_STREAMS, HTTP2_LOCAL_MAX_STREAMS);
+  add_setting(SETTINGS_INITIAL_WINDOW_SIZE, HTTP2_LOCAL_STREAM_WINDOW);
+  write_frame(frame_type::settings, 0, 0, payload.data(), payload.length());
+
+  // Raise the connection window, which can only be changed through WINDOW_UPDATE
+  write_window_update(0, HTTP2_LOCAL_CONNECTION_WINDOW - HTTP2_DEFAULT_WINDOW);
+}
+
+void http2_engine::write_frame(frame_type _type, uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len)
+{
+  m_out.push_back(static_cast<char>(_len >> 16));
+  m_out.push_back(static_cast<char>(_len >> 8));
+  m_out.push_back(static_cast<char>(_len));
+  m_out.push_back(static_cast<char>(_type));
+  m_out.push_back(static_cast<char>(_flags));
+  put_u32(m_out, _streamId & HTTP2_MAX_WINDOW);
+  if ( _len > 0 )
+    m_out.append(_payload, _len);
+}
+
+void http2_engine::write_header_block(uint32_t _streamId, const std::string& _block, bool _endStream)
+{
+  // Split the block into HEADERS and CONTINUATION frames as per the frame size of the peer
+  size_t maxLen = m_peer.max_frame_size;
+  size_t pos = 0;
+  bool isFirst = true;
+  do
+  {
+    size_t len = std::min(maxLen, _block.length() - pos);
+    bool isLast = ( pos + len == _block.length() );
+    uint8_t flags = isLast? FLAG_END_HEADERS : 0;
+    if ( isFirst && _endStream ) flags |= FLAG_END_STREAM;
+    write_frame(isFirst? frame_type::headers : frame_type::continuation, flags, _streamId, _block.data() + pos, len);
+    pos += len;
+    isFirst = false;
+  }
+  while ( pos < _block.length() );
+}
+
+void http2_engine::write_rst_stream(uint32_t _streamId, http2_error _error)
+{
+  std::string payload;
+  put_u32(payload, static_cast<uint32_t>(_error));
+  write_frame(frame_type::rst_stream, 0, _streamId, payload.data(), payload.length());
+}
+
+void http2_engine::write_window_update(uint32_t _streamId, uint32_t _increment)
+{
+  std::string payload;
+  put_u32(payload, _increment);
+  write_frame(frame_type::window_update, 0, _streamId, payload.data(), payload.length());
+}
+
+void http2_engine::write_goaway(http2_error _error)
+{
+  std::string payload;
+  put_u32(payload, m_lastStreamId);
+  put_u32(payload, static_cast<uint32_t>(_error));
+  write_frame(frame_type::goaway, 0, 0, payload.data(), payload.length());
+}
+
+void http2_engine::write_data()
+{
+  // Send DATA frames for all the streams in turn, within the connection and stream windows
+  bool isProgress = true;
+  while ( isProgress && m_sendWindow > 0 )
+  {
+    isProgress = false;
+    for ( auto& entry : m_streams )
+    {
+      http2_stream* stream = entry.second.get();
+      if ( ! stream->headersSent || stream->localClosed || m_sendWindow <= 0 ) continue;
+      size_t remaining = stream->sendData.length() - stream->sendPos;
+      if ( remaining == 0 && ! stream->request.body.empty() && ! stream->bodyDone )
+      {
+        // Pull the next piece of a streamed payload only when the window allows sending it
+        if ( stream->sendWindow <= 0 ) continue;
+        stream->sendData.resize(HTTP2_BODY_PIECE_SIZE);
+        remaining = stream->request.body.read(&stream->sendData[0], stream->sendData.size());
+        stream->sendData.resize(remaining);
+        stream->sendPos = 0;
+        stream->bodyDone = ( remaining == 0 );
+      }
+      if ( remaining == 0 )
+      {
+        // Nothing (more) to send. An empty DATA frame ends the stream.
+        write_frame(frame_type::data, FLAG_END_STREAM, stream->id, nullptr, 0);
+        stream->localClosed = true;
+        continue;
+      }
+      if ( stream->sendWindow <= 0 ) continue;
+      size_t len = std::min<size_t>(remaining, m_peer.max_frame_size);
+      len = std::min<size_t>(len, static_cast<size_t>(std::min(stream->sendWindow, m_sendWindow)));
+      bool isLast = ( len == remaining ) && stream->request.body.empty();
+      write_frame(frame_type::data, isLast? FLAG_END_STREAM : 0, stream->id, stream->sendData.data() + stream->sendPos, len);
+      stream->sendPos += len;
+      stream->sendWindow -= len;
+      m_sendWindow -= len;
+      if ( isLast )
+      {
+        stream->localClosed = true;
+        std::string().swap(stream->sendData);
+      }
+      isProgress = true;
+    }
+  }
+}
+
+void http2_engine::pump(int _timeoutMs)
+{
+  // Write whatever is pending and read whatever is available, waiting at most _timeoutMs for either
+  while ( ! m_out.empty() )
+  {
+    size_t written = 0;
+    io_status status = m_conn->write_some(m_out.data(), m_out.length(), /*out*/ written);
+    if ( status == io_status::closed )
+    {
+      m_eof = true;
+      m_out.clear();
+      return;
+    }
+    if ( status != io_status::done ) break;
+    m_out.erase(0, written);
+  }
+
+  pollfd pfd = { m_conn->descriptor(), POLLIN, 0 };
+  if ( ! m_out.empty() )
+    pfd.events |= POLLOUT;
+  int ret = ::poll(&pfd, 1, _timeoutMs);
+  if ( ret == -1 && errno != EINTR )
+    throw sid::exception(sid::to_errno_str("poll() failed"));
+  if ( ret == 0 )
+    throw sid::exception("The operation timedout after " + sid::to_str(m_conn->get_timeout()) + " seconds");
+
+  // Read until the connection has nothing more. A short read does not mean that: SSL_read returns one record
+  // at a time and may hold more that poll does not see. The flow control windows bound what can arrive.
+  char buffer[HTTP2_READ_BUFFER_SIZE];
+  while ( true )
+  {
+    size_t nread = 0;
+    io_status status = m_conn->read_some(buffer, sizeof(buffer), /*out*/ nread);
+    if ( status == io_status::closed ) { m_eof = true; break; }
+    if ( status != io_status::done ) break;
+    if ( m_inPos > 0 && m_inPos == m_in.length() ) { m_in.clear(); m_inPos = 0; }
+    m_in.append(buffer, nread);
+  }
+}
+
+void http2_engine::process_input()
+{
+  if ( m_role == http2_session::role::server && ! m_prefaceSeen )
+  {
+    if ( m_in.length() - m_inPos < HTTP2_PREFACE_LEN )
+      return;
+    if ( ::memcmp(m_in.data() + m_inPos, HTTP2_PREFACE, HTTP2_PREFACE_LEN) != 0 )
+      connection_error(http2_error::protocol_error, "Invalid HTTP/2 connection preface");
+    m_inPos += HTTP2_PREFACE_LEN;
+    m_prefaceSeen = true;
+  }
+
+  while ( m_in.length() - m_inPos >= HTTP2_FRAME_HEADER_LEN )
+  {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(m_in.data() + m_inPos);
+    size_t len = (static_cast<size_t>(p[0]) << 16) | (static_cast<size_t>(p[1]) << 8) | p[2];
+    if ( len > HTTP2_DEFAULT_FRAME_SIZE )
+      connection_error(http2_error::frame_size_error, "Frame of " + sid::to_str(len) + " bytes exceeds the maximum frame size");
+    if ( m_in.length() - m_inPos < HTTP2_FRAME_HEADER_LEN + len )
+      break;
+    frame_type type = static_cast<frame_type>(p[3]);
+    uint8_t flags = p[4];
+    uint32_t streamId = get_u32(m_in.data() + m_inPos + 5) & HTTP2_MAX_WINDOW;
+    const char* payload = m_in.data() + m_inPos + HTTP2_FRAME_HEADER_LEN;
+    m_inPos += HTTP2_FRAME_HEADER_LEN + len;
+    handle_frame(type, flags, streamId, payload, len);
+  }
+
+  // Compact the input buffer
+  if ( m_inPos > 0 )
+  {
+    m_in.erase(0, m_inPos);
+    m_inPos = 0;
+  }
+}
+
+void http2_engine::handle_frame(frame_type _type, uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len)
+{
+  // Header blocks must be contiguous (RFC 9113 section 6.10)
+  if ( m_continuationId != 0 && (_type != frame_type::continuation || _streamId != m_continuationId) )
+    connection_error(http2_error::protocol_error, "Expected CONTINUATION frame");
+
+  switch ( _type )
+  {
+  case frame_type::data:
+    handle_data(_flags, _streamId, _payload, _len);
+    break;
+  case frame_type::headers:
+    handle_headers(_flags, _streamId, _payload, _len);
+    break;
+  case frame_type::continuation:
+    if ( m_continuationId == 0 )
+      connection_error(http2_error::protocol_error, "Unexpected CONTINUATION frame");
+    m_headerBlock.append(_payload, _len);
+    if ( _flags & FLAG_END_HEADERS )
+    {
+      m_continuationId = 0;
+      handle_header_block(_streamId, m_continuationEnd);
+    }
+    break;
+  case frame_type::priority:
+    if ( _len != 5 )
+      connection_error(http2_error::frame_size_error, "Invalid PRIORITY frame");
+    break;
+  case frame_type::rst_stream:
+    if ( _len != 4 || _streamId == 0 )
+      connection_error(http2_error::protocol_error, "Invalid RST_STREAM frame");
+    if ( get_u32(_payload) == static_cast<uint32_t>(http2_error::refused_stream) && m_role == http2_session::role::client )
+      retry_stream(_streamId);
+    else
+      finish_stream(_streamId, "Stream reset by the peer with error code " + sid::to_str(get_u32(_payload)));
+    break;
+  case frame_type::settings:
+    handle_settings(_flags, _streamId, _payload, _len);
+    break;
+  case frame_type::push_promise:
+    // Server push is disabled in the settings sent by the client
+    connection_error(http2_error::protocol_error, "Unexpected PUSH_PROMISE frame");
+  case frame_type::ping:
+    if ( _len != 8 || _streamId != 0 )
+      connection_error(http2_error::protocol_error, "Invalid PING frame");
+    if ( ! (_flags & FLAG_ACK) )
+      write_frame(frame_type::ping, FLAG_ACK, 0, _payload, _len);
+    break;
+  case frame_type::goaway:
+    handle_goaway(_payload, _len);
+    break;
+  case frame_type::window_update:
+    handle_window_update(_streamId, _payload, _len);
+    break;
+  default:
+    // Unknown frame types are ignored (RFC 9113 section 4.1)
+    break;
+  }
+}
+
+void http2_engine::handle_data(uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len)
+{
+  if ( _streamId == 0 )
+    connection_error(http2_error::protocol_error, "DATA frame on stream 0");
+
+  // The whole frame (including padding) counts towards flow control
+  m_recvConsumed += _len;
+  if ( m_recvConsumed >= HTTP2_LOCAL_CONNECTION_WINDOW / 2 )
+  {
+    write_window_update(0, static_cast<uint32_t>(m_recvConsumed));
+    m_recvConsumed = 0;
+  }
+
+  size_t padLen = 0;
+  if ( _flags & FLAG_PADDED )
+  {
+    if ( _len < 1 || static_cast<uint8_t>(_payload[0]) >= _len )
+      connection_error(http2_error::protocol_error, "Invalid padding in DATA frame");
+    padLen = static_cast<uint8_t>(_payload[0]);
+    _payload++;
+    _len -= 1 + padLen;
+  }
+
+  http2_stream* stream = find(_streamId);
+  if ( ! stream )
+    return; // The stream was reset or completed. Ignore the data.
+  if ( stream->remoteClosed )
+  {
+    write_rst_stream(_streamId, http2_error::stream_closed);
+    finish_stream(_streamId, "DATA received on a closed stream");
+    return;
+  }
+
+  stream->recvConsumed += _len + padLen + ((_flags & FLAG_PADDED)? 1 : 0);
+  if ( ! (_flags & FLAG_END_STREAM) && stream->recvConsumed >= HTTP2_LOCAL_STREAM_WINDOW / 2 )
+  {
+    write_window_update(_streamId, static_cast<uint32_t>(stream->recvConsumed));
+    stream->recvConsumed = 0;
+  }
+
+  if ( m_role == http2_session::role::client )
+  {
+    http::response& response = stream->result.response;
+    if ( stream->decoder )
+    {
+      std::string decoded;
+      stream->decoder->decode(_payload, _len, /*out*/ decoded);
+      response.content.append(decoded);
+    }
+    else
+      response.content.append(std::string(_payload, _len));
+  }
+  else
+    stream->request.content().append(std::string(_payload, _len));
+
+  if ( _flags & FLAG_END_STREAM )
+    handle_remote_end(stream);
+}
+
+void http2_engine::handle_headers(uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len)
+{
+  if ( _streamId == 0 )
+    connection_error(http2_error::protocol_error, "HEADERS frame on stream 0");
+
+  size_t padLen = 0;
+  if ( _flags & FLAG_PADDED )
+  {
+    if ( _len < 1 )
+      connection_error(http2_error::protocol_error, "Invalid padding in HEADERS frame");
+    padLen = static_cast<uint8_t>(_payload[0]);
+    _payload++;
+    _len--;
+  }
+  if ( _flags & FLAG_PRIORITY )
+  {
+    if ( _len < 5 )
+      connection_error(http2_error::protocol_error, "Invalid priority in HEADERS frame");
+    _payload += 5;
+    _len -= 5;
+  }
+  if ( padLen > _len )
+    connection_error(http2_error::protocol_error, "Invalid padding in HEADERS frame");
+  _len -= padLen;
+
+  m_headerBlock.assign(_payload, _len);
+  if ( _flags & FLAG_END_HEADERS )
+    handle_header_block(_streamId, (_flags & FLAG_END_STREAM) != 0);
+  else
+  {
+    m_continuationId = _streamId;
+    m_continuationEnd = (_flags & FLAG_END_STREAM) != 0;
+  }
+}
+
+void http2_engine::handle_header_block(uint32_t _streamId, bool _endStream)
+{
+  // The block must always be decoded to keep the HPACK state in sync, even if the stream is gone
+  http::headers fields;
+  try
+  {
+    m_decoder.decode(m_headerBlock.data(), m_headerBlock.length(), /*out*/ fields);
+  }
+  catch ( const sid::exception& e )
+  {
+    connection_error(http2_error::compression_error, e.what());
+  }
+  m_headerBlock.clear();
+
+  http2_stream* stream = find(_streamId);
+
+  if ( m_role == http2_session::role::server && ! stream )
+  {
+    // A new request from the client
+    if ( (_streamId % 2) == 0 || _streamId <= m_lastStreamId )
+      connection_error(http2_error::protocol_error, "Invalid stream identifier " + sid::to_str(_streamId));
+    m_lastStreamId = _streamId;
+    if ( m_goaway ) return;
+    if ( m_streams.size() >= HTTP2_LOCAL_MAX_STREAMS )
+    {
+      write_rst_stream(_streamId, http2_error::refused_stream);
+      return;
+    }
+    std::unique_ptr<http2_stream> newStream(new http2_stream());
+    newStream->id = _streamId;
+    newStream->sendWindow = m_peer.initial_window_size;
+    http::request& request = newStream->request;
+    request.version = http::version_id::v20;
+    request.method.clear();
+    for ( const http::header& field : fields )
+    {
+      if ( field.key.empty() || field.key[0] != ':' )
+        request.headers.add(field.key, field.value);
+      else if ( field.key == ":method" )
+        request.method = http::method::get(field.value);
+      else if ( field.key == ":path" )
+        request.uri = field.value;
+      else if ( field.key == ":authority" )
+        request.headers("Host", field.value, http::header_action::skip);
+    }
+    stream = newStream.get();
+    m_streams[_streamId] = std::move(newStream);
+    if ( stream->request.uri.empty() || stream->request.method.to_str().empty() )
+    {
+      write_rst_stream(_streamId, http2_error::protocol_error);
+      m_streams.erase(_streamId);
+      return;
+    }
+    if ( _endStream )
+      handle_remote_end(stream);
+    return;
+  }
+
+  if ( ! stream )
+    return; // Headers for a stream that was reset or completed
+
+  if ( m_role == http2_session::role::server )
+  {
+    // Trailers of the request
+    for ( const http::header& field : fields )
+      stream->request.headers.add(field.key, field.value);
+    if ( _endStream )
+      handle_remote_end(stream);
+    return;
+  }
+
+  // Response headers (or trailers) on the client
+  http::response& response = stream->result.response;
+  if ( ! stream->hasHeaders )
+  {
+    std::string statusStr;
+    for ( const http::header& field : fields )
+      if ( field.key == ":status" ) statusStr = field.value;
+    if ( statusStr.length() != 3 )
+    {
+      write_rst_stream(_streamId, http2_error::protocol_error);
+      finish_stream(_streamId, "Response without a valid :status");
+      return;
+    }
+    // Informational responses (1xx) are skipped
+    if ( statusStr[0] == '1' )
+      return;
+    response.version = http::version_id::v20;
+    response.status = http::status::get(statusStr);
+    for ( const http::header& field : fields )
+      if ( field.key.empty() || field.key[0] != ':' )
+        response.headers.add(field.key, field.value);
+    stream->hasHeaders = true;
+
+    std::string contentEncoding;
+    if ( m_decodeContent && response.headers.exists("Content-Encoding", &contentEncoding) )
+    {
+      std::unique_ptr<http::content_decoder> decoder(new http::content_decoder());
+      if ( decoder->set(contentEncoding) && ! decoder->empty() )
+      {
+        stream->decoder = std::move(decoder);
+        response.decoded = true;
+      }
+    }
+  }
+  else
+  {
+    for ( const http::header& field : fields )
+      response.headers.add(field.key, field.value);
+  }
+
+  if ( _endStream )
+    handle_remote_end(stream);
+}
+
+void http2_engine::handle_remote_end(http2_stream* _stream)
+{
+  _stream->remoteClosed = true;
+  if ( m_role == http2_session::role::server )
+  {
+    m_ready.push_back(_stream->id);
+    return;
+  }
+
+  if ( ! _stream->hasHeaders )
+  {
+    finish_stream(_stream->id, "Stream ended without a response");
+    return;
+  }
+  if ( _stream->decoder )
+  {
+    _stream->decoder->finish();
+    _stream->decoder->update_headers(_stream->result.response.headers);
+  }
+  // The request may still have unsent data if the server responded early
+  if ( ! _stream->localClosed )
+    write_rst_stream(_stream->id, http2_error::no_error);
+  finish_stream(_stream->id, std::string());
+}
+
+void http2_engine::handle_settings(uint8_t _flags, uint32_t _streamId, const char* _payload, size_t _len)
+{
+  if ( _streamId != 0 )
+    connection_error(http2_error::protocol_error, "SETTINGS frame on a stream");
+  if ( _flags & FLAG_ACK )
+  {
+    if ( _len != 0 )
+      connection_error(http2_error::frame_size_error, "SETTINGS acknowledgement with payload");
+    return;
+  }
+  if ( (_len % 6) != 0 )
+    connection_error(http2_error::frame_size_error, "Invalid SETTINGS frame length");
+  m_peerSettings = true;
+
+  for ( size_t pos = 0; pos < _len; pos += 6 )
+  {
+    uint16_t id = (static_cast<uint16_t>(static_cast<uint8_t>(_payload[pos])) << 8) | static_cast<uint8_t>(_payload[pos+1]);
+    uint32_t value = get_u32(_payload + pos + 2);
+    switch ( id )
+    {
+    case SETTINGS_HEADER_TABLE_SIZE:
+      m_peer.header_table_size = value;
+      m_encoder.set_max_table_size(value);
+      break;
+    case SETTINGS_ENABLE_PUSH:
+      if ( value > 1 )
+        connection_error(http2_error::protocol_error, "Invalid SETTINGS_ENABLE_PUSH");
+      m_peer.enable_push = value;
+      break;
+    case SETTINGS_MAX_CONCURRENT_STREAMS:
+      m_peer.max_concurrent_streams = value;
+      break;
+    case SETTINGS_INITIAL_WINDOW_SIZE:
+      {
+        if ( value > HTTP2_MAX_WINDOW )
+          connection_error(http2_error::flow_control_error, "Invalid SETTINGS_INITIAL_WINDOW_SIZE");
+        // The change applies to all the open streams (RFC 9113 section 6.9.2)
+        int64_t delta = static_cast<int64_t>(value) - m_peer.initial_window_size;
+        for ( auto& entry : m_streams )
+          entry.second->sendWindow += delta;
+        m_peer.initial_window_size = value;
+      }
+      break;
+    case SETTINGS_MAX_FRAME_SIZE:
+      if ( value < HTTP2_DEFAULT_FRAME_SIZE || value > 0xffffff )
+        connection_error(http2_error::protocol_error, "Invalid SETTINGS_MAX_FRAME_SIZE");
+      m_peer.max_frame_size = value;
+      break;
+    case SETTINGS_MAX_HEADER_LIST_SIZE:
+      m_peer.max_header_list_size = value;
+      break;
+    default:
+      break; // Unknown settings are ignored
+    }
+  }
+  write_frame(frame_type::settings, FLAG_ACK, 0, nullptr, 0);
+}
+
+void http2_engine::handle_window_update(uint32_t _streamId, const char* _payload, size_t _len)
+{
+  if ( _len != 4 )
+    connection_error(http2_error::frame_size_error, "Invalid WINDOW_UPDATE frame");
+  uint32_t increment = get_u32(_payload) & HTTP2_MAX_WINDOW;
+  if ( _streamId == 0 )
+  {
+    if ( increment == 0 )
+      connection_error(http2_error::protocol_error, "WINDOW_UPDATE with 0 increment");
+    m_sendWindow += increment;
+    if ( m_sendWindow > HTTP2_MAX_WINDOW )
+      connection_error(http2_error::flow_control_error, "Connection window overflow");
+    return;
+  }
+  http2_stream* stream = find(_streamId);
+  if ( ! stream ) return;
+  if ( increment == 0 )
+  {
+    write_rst_stream(_streamId, http2_error::protocol_error);
+    finish_stream(_streamId, "WINDOW_UPDATE with 0 increment");
+    return;
+  }
+  stream->sendWindow += increment;
+  if ( stream->sendWindow > HTTP2_MAX_WINDOW )
+  {
+    write_rst_stream(_streamId, http2_error::flow_control_error);
+    finish_stream(_streamId, "Stream window overflow");
+  }
+}
+
+void http2_engine::handle_goaway(const char* _payload, size_t _len)
+{
+  if ( _len < 8 )
+    connection_error(http2_error::frame_size_error, "Invalid GOAWAY frame");
+  uint32_t lastStreamId = get_u32(_payload) & HTTP2_MAX_WINDOW;
+  uint32_t errorCode = get_u32(_payload + 4);
+  m_goaway = true;
+
+  // Streams above the last stream identifier were not processed and can be retried on a new connection
+  std::vector<uint32_t> refused;
+  for ( const auto& entry : m_streams )
+    if ( entry.first > lastStreamId && m_role == http2_session::role::client )
+      refused.push_back(entry.first);
+  for ( uint32_t id : refused )
+    finish_stream(id, "Stream refused by GOAWAY (error code " + sid::to_str(errorCode) + ")");
+}
+
+http2_stream* http2_engine::find(uint32_t _streamId)
+{
+  auto it = m_streams.find(_streamId);
+  return ( it == m_streams.end() )? nullptr : it->second.get();
+}
+
+uint32_t http2_engine::submit(const http::request& _request, const FNMultiCallback& _fnCallback)
+{
+  if ( m_role != http2_session::role::client )
+    throw sid::exception("HTTP/2 requests can be submitted only on the client side");
+
+  std::unique_ptr<http2_stream> stream(new http2_stream());
+  stream->request = _request;
+  stream->callback = _fnCallback;
+  stream->result.id = ++m_nextRequestId;
+  if ( stream->request.method.to_str().empty() )
+    stream->request.method = http::method_type::get;
+  if ( m_decodeContent )
+    stream->request.headers("Accept-Encoding", http::content_decoder::accept_encoding(), http::header_action::skip);
+  uint32_t id = static_cast<uint32_t>(stream->result.id);
+  m_queued.push_back(std::move(stream));
+  return id;
+}
+
+void http2_engine::open_stream(std::unique_ptr<http2_stream> _stream)
+{
+  http2_stream* stream = _stream.get();
+  stream->id = m_nextStreamId;
+  m_nextStreamId += 2;
+  stream->sendWindow = m_peer.initial_window_size;
+
+  const http::request& request = stream->request;
+  std::string authority = request.headers.get("Host");
+  if ( authority.empty() ) authority = m_conn->server();
+
+  std::string block;
+  m_encoder.encode(":method", request.method.to_str(), block);
+  m_encoder.encode(":scheme", (m_conn->type() == connection_type::https)? "https" : "http", block);
+  m_encoder.encode(":authority", authority, block);
+  m_encoder.encode(":path", request.uri.empty()? "/" : request.uri, block);
+  for ( const http::header& header : request.headers )
+  {
+    if ( is_connection_header(header.key) ) continue;
+    m_encoder.encode(sid::to_lower(header.key), header.value, block);
+  }
+
+  stream->sendData = request.content().to_str();
+  bool isEndStream = stream->sendData.empty() && request.body.empty();
+  write_header_block(stream->id, block, isEndStream);
+  stream->headersSent = true;
+  stream->localClosed = isEndStream;
+  m_streams[stream->id] = std::move(_stream);
+}
+
+void http2_engine::start_streams()
+{
+  uint32_t maxStreams = std::min<uint32_t>(m_peer.max_concurrent_streams, m_peerSettings? HTTP2_CLIENT_MAX_STREAMS : HTTP2_INITIAL_MAX_STREAMS);
+  while ( ! m_queued.empty() && ! m_goaway && m_streams.size() < maxStreams )
+  {
+    // Stream identifiers cannot be reused. Once exhausted, a new connection is needed.
+    if ( m_nextStreamId > HTTP2_MAX_WINDOW )
+    {
+      m_goaway = true;
+      break;
+    }
+    std::unique_ptr<http2_stream> stream = std::move(m_queued.front());
+    m_queued.pop_front();
+    open_stream(std::move(stream));
+  }
+  if ( m_goaway )
+  {
+    while ( ! m_queued.empty() )
+    {
+      std::unique_ptr<http2_stream> stream = std::move(m_queued.front());
+      m_queued.pop_front();
+      stream->result.error = "The HTTP/2 connection is going away";
+      m_completed.push_back(std::move(stream));
+    }
+  }
+}
+
+void http2_engine::finish_stream(uint32_t _streamId, const std::string& _error)
+{
+  auto it = m_streams.find(_streamId);
+  if ( it == m_streams.end() ) return;
+  std::unique_ptr<http2_stream> stream = std::move(it->second);
+  m_streams.erase(it);
+  if ( m_role == http2_session::role::server ) return;
+  stream->result.success = _error.empty();
+  stream->result.error = _error;
+  m_completed.push_back(std::move(stream));
+}
+
+void http2_engine::retry_stream(uint32_t _streamId)
+{
+  // The server did not process the stream. It is sent again on a new stream once there is room.
+  auto it = m_streams.find(_streamId);
+  if ( it == m_streams.end() ) return;
+  std::unique_ptr<http2_stream> stream(new http2_stream());
+  stream->request = std::move(it->second->request);
+  stream->callback = std::move(it->second->callback);
+  stream->result.id = it->second->result.id;
+  m_streams.erase(it);
+  m_queued.push_front(std::move(stream));
+}
+
+void http2_engine::fail_all(const std::string& _error)
+{
+  std::vector<uint32_t> ids;
+  for ( const auto& entry : m_streams )
+    ids.push_back(entry.first);
+  for ( uint32_t id : ids )
+    finish_stream(id, _error);
+  while ( ! m_queued.empty() )
+  {
+    std::unique_ptr<http2_stream> stream = std::move(m_queued.front());
+    m_queued.pop_front();
+    stream->result.error = _error;
+    m_completed.push_back(std::move(stream));
+  }
+}
+
+void http2_engine::call_callbacks()
+{
+  std::vector<std::unique_ptr<http2_stream>> completed;
+  completed.swap(m_completed);
+  for ( std::unique_ptr<http2_stream>& stream : completed )
+  {
+    if ( ! stream->callback ) continue;
+    try { stream->callback(stream->result); }
+    catch (...) { /* The exceptions from the callback are not propagated */ }
+  }
+}
+
+void http2_engine::connection_error(http2_error _error, const std::string& _message)
+{
+  // Tell the peer why the connection is being closed (best effort)
+  write_goaway(_error);
+  size_t written = 0;
+  m_conn->write_some(m_out.data(), m_out.length(), /*out*/ written);
+  m_out.clear();
+  m_goaway = true;
+  throw sid::exception("HTTP/2 connection error: " + _message);
+}
+
+bool http2_engine::run()
+{
+  bool isSuccess = false;
+  const int timeoutMs = static_cast<int>(m_conn->get_timeout()) * 1000;
+
+  try
+  {
+    m_error.clear();
+    if ( ! m_conn->is_open() )
+      throw sid::exception("Connection is not established");
+    start();
+    start_streams();
+    call_callbacks();
+    while ( ! m_streams.empty() || ! m_queued.empty() )
+    {
+      write_data();
+      pump(timeoutMs);
+      process_input();
+      if ( m_eof )
+        throw sid::exception("The connection was closed by the peer");
+      start_streams();
+      call_callbacks();
+    }
+    // Send the pending acknowledgements and window updates
+    write_data();
+    if ( ! m_out.empty() )
+    {
+      size_t written = 0;
+      if ( m_conn->write_some(m_out.data(), m_out.length(), /*out*/ written) == io_status::done )
+        m_out.erase(0, written);
+    }
+    isSuccess = true;
+  }
+  catch ( const sid::exception& e )
+  {
+    m_error = e.what();
+  }
+  catch (...)
+  {
+    m_error = "An unhandled exception occurred in the HTTP/2 session";
+  }
+
+  if ( ! isSuccess )
+  {
+    fail_all(m_error);
+    call_callbacks();
+    m_conn->close();
+  }
+  return isSuccess;
+}
+
+bool http2_engine::serve(const FNHttp2Handler& _fnHandler)
+{
+  bool isSuccess = false;
+  const int timeoutMs = static_cast<int>(m_conn->get_timeout()) * 1000;
+
+  if ( m_role != http2_session::role::server )
+  {
+    m_error = "HTTP/2 serve() can be called only on the server side";
+    return false;
+  }
+
+  try
+  {
+    m_error.clear();
+    m_handler = &_fnHandler;
+    start();
+    while ( true )
+    {
+      // Respond to the requests that are complete
+      std::vector<uint32_t> ready;
+      ready.swap(m_ready);
+      for ( uint32_t id : ready )
+      {
+        http2_stream* stream = find(id);
+        if ( ! stream ) continue;
+        http::response& response = stream->result.response;
+        response.clear();
+        response.status = http::status_code::OK;
+        try
+        {
+          (*m_handler)(stream->request, response);
+        }
+        catch ( const sid::exception& e )
+        {
+          response.clear();
+          response.status = http::status_code::InternalServerError;
+          response.content.set_data(e.what());
+        }
+        std::string block;
+        m_encoder.encode(":status", sid::to_str(static_cast<int>(response.status.code())), block);
+        for ( const http::header& header : response.headers )
+        {
+          if ( is_connection_header(header.key) ) continue;
+          m_encoder.encode(sid::to_lower(header.key), header.value, block);
+        }
+        stream->sendData = response.content.to_str();
+        bool isEndStream = stream->sendData.empty() || stream->request.method == http::method_type::head;
+        write_header_block(id, block, isEndStream);
+        stream->headersSent = true;
+        stream->localClosed = isEndStream;
+      }
+      write_data();
+
+      // Streams are done once both sides have ended them
+      for ( auto it = m_streams.begin(); it != m_streams.end(); )
+      {
+        if ( it->second->localClosed && it->second->remoteClosed )
+          it = m_streams.erase(it);
+        else
+          ++it;
+      }
+
+      if ( m_eof || (m_goaway && m_streams.empty() && m_out.empty()) )
+        break;
+      pump(timeoutMs);
+      process_input();
+    }
+    isSuccess = m_streams.empty();
+    if ( ! isSuccess )
+      m_error = "The connection was closed with " + sid::to_str(m_streams.size()) + " open stream(s)";
+  }
+  catch ( const sid::exception& e )
+  {
+    m_error = e.what();
+  }
+  catch (...)
+  {
+    m_error = "An unhandled exception occurred in the HTTP/2 session";
+  }
+
+  m_handler = nullptr;
+  return isSuccess;
+}
@@ -39,26 +39,27 @@ LICENSE: END
 
 #include "http/method.hpp"
 #include <strings.h>
+#include <cstring>
 
 using namespace sid;
 using namespace sid::http;
 
-struct MapMethod { method_type type; std::string name; };
-
-//! HTTP methods map
-static MapMethod gMapMethod[] =
+//! HTTP method names indexed by method_type
+static const std::string gMethodNames[] =
   {
-    { method_type::options, "OPTIONS" },
-    { method_type::get,     "GET" },
-    { method_type::post,    "POST" },
-    { method_type::put,     "PUT" },
-    { method_type::head,    "HEAD" },
-    { method_type::delete_, "DELETE" },
-    { method_type::patch,   "PATCH" },
-    { method_type::trace,   "TRACE" },
-    { method_type::connect, "CONNECT" },
-    { method_type::custom,  "" }
+    /*options*/ "OPTIONS",
+    /*get*/     "GET",
+    /*head*/    "HEAD",
+    /*post*/    "POST",
+    /*put*/     "PUT",
+    /*delete_*/ "DELETE",
+    /*patch*/   "PATCH",
+    /*trace*/   "TRACE",
+    /*connect*/ "CONNECT",
+    /*custom*/  ""
   };
+static_assert(sizeof(gMethodNames)/sizeof(gMethodNames[0]) == static_cast<size_t>(method_type::custom) + 1,
+              "gMethodNames must have an entry for every method_type");
 
 
 //! Default constructor
@@ -108,27 +109,64 @@ bool method::operator==(const method_type& _type) const
 }
 ////////////////////////////////////////////////
 
+bool method::is_safe() const
+{
+  return ( m_type == method_type::get || m_type == method_type::head
+           || m_type == method_type::options || m_type == method_type::trace );
+}
+
+bool method::is_idempotent() const
+{
+  return ( is_safe() || m_type == method_type::put || m_type == method_type::delete_ );
+}
+
 //! Get the string name of the method
-std::string method::to_str() const
+const std::string& method::to_str() const
 {
   if ( m_type == method_type::custom ) return m_customName;
-
-  size_t cnt = sizeof(gMapMethod)/sizeof(gMapMethod[0]);
-  for ( size_t i = 0; i < cnt; i++ )
-    if ( m_type == gMapMethod[i].type ) return gMapMethod[i].name;
-  throw sid::exception("Invalid Method Type");
+  if ( m_type > method_type::custom ) throw sid::exception("Invalid Method Type");
+  return gMethodNames[static_cast<size_t>(m_type)];
 }
 
 //! Get the method object using the given method name.
 http::method method::get(const std::string& _name, const sid::match_case& _matchCase /* = sid::match_case::exact */)
 {
-  http::method method(method_type::custom);
+  return method::get(_name.data(), _name.length(), _matchCase);
+}
 
-  size_t cnt = sizeof(gMapMethod)/sizeof(gMapMethod[0]);
-  for ( size_t i = 0; i < cnt; i++ )
-    if ( sid::equals(gMapMethod[i].name, _name, _matchCase) ) { method = gMapMethod[i].type; break; }
-  if ( method == method_type::custom )
-    method.m_customName = _name;
+//! Get the method object using the given method name of _len bytes.
+http::method method::get(const char* _name, size_t _len, const sid::match_case& _matchCase /* = sid::match_case::exact */)
+{
+  // Pick the only possible candidate using the length and the first character (in uppercase)
+  method_type type = method_type::custom;
+  const char ch = ( _len > 0 )? static_cast<char>(_name[0] & ~0x20) : '\0';
+  switch ( _len )
+  {
+  case 3: type = ( ch == 'G' )? method_type::get : ( ch == 'P' )? method_type::put : method_type::custom; break;
+  case 4: type = ( ch == 'P' )? method_type::post : ( ch == 'H' )? method_type::head : method_type::custom; break;
+  case 5: type = ( ch == 'P' )? method_type::patch : ( ch == 'T' )? method_type::trace : method_type::custom; break;
+  case 6: type = ( ch == 'D' )? method_type::delete_ : method_type::custom; break;
+  case 7: type = ( ch == 'O' )? method_type::options : ( ch == 'C' )? method_type::connect : method_type::custom; break;
+  default: break;
+  }
+
+  // Confirm the candidate
+  if ( type != method_type::custom )
+  {
+    const std::string& name = gMethodNames[static_cast<size_t>(type)];
+    bool isMatch = false;
+    if ( _matchCase == sid::match_case::exact )
+      isMatch = ( ::memcmp(name.data(), _name, _len) == 0 );
+    else if ( _matchCase == sid::match_case::any )
+      isMatch = ( ::strncasecmp(name.data(), _name, _len) == 0 );
+    else
+      isMatch = sid::equals(name, std::string(_name, _len), _matchCase);
+    if ( ! isMatch )
+      type = method_type::custom;
+  }
+
+  http::method method(type);
+  if ( type == method_type::custom )
+    method.m_customName.assign(_name, _len);
   return method;
 }
-
@@ -0,0 +1,661 @@
+//////////////////////////////////////////////////////
+//
+// multi_client.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/http.hpp"
+#include "http/multi_client.hpp"
+#include "http/compression.hpp"
+#include "common/convert.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+using namespace sid;
+using namespace sid::http;
+
+using steady_clock = std::chrono::steady_clock;
+
+#define MULTI_MAX_EVENTS       256
+#define MULTI_READ_BUFFER_SIZE (64*1024)
+#define MULTI_TIMER_MSECS      250 // How often the inactivity timeouts are checked
+
+namespace sid {
+namespace http {
+
+//! State of a single request in the engine
+enum class transfer_state : uint8_t { queued, connecting, sending, receiving, done };
+
+/**
+ * @struct transfer
+ * @brief A request along with the connection it is using
+ */
+struct transfer
+{
+  multi_result                     result;      //! Result passed to the callback
+  FNMultiCallback                  callback;    //! Completion callback
+  std::string                      hostKey;     //! Key of the host in multi_engine::m_hosts
+  connection_type                  type;        //! Connection type
+  std::string                      server;      //! Server name or address
+  unsigned short                   port;        //! Port at the server
+  http::request                    request;     //! Request to be sent
+  std::string                      data;        //! Serialized request
+  size_t                           written;     //! Bytes of data written
+  uint64_t                         received;    //! Bytes received on the connection
+  transfer_state                   state;       //! Current state
+  connection_ptr                   conn;        //! Connection in use
+  bool                             reused;      //! Set if the connection was taken from the idle pool
+  uint32_t                         events;      //! Events registered with epoll (0 if not registered)
+  steady_clock::time_point         lastActive;  //! Time of the last I/O progress
+  std::unique_ptr<response_parser> parser;      //! Response parser
+
+  transfer() : type(connection_type::http), port(0), written(0), received(0),
+               state(transfer_state::queued), reused(false), events(0) {}
+};
+
+/**
+ * @struct host_state
+ * @brief Requests and connections of a single host (connection type, server and port)
+ */
+struct host_state
+{
+  uint32_t                    active;  //! Connections in use
+  std::deque<transfer*>       waiting; //! Requests waiting for a connection
+  std::vector<connection_ptr> idle;    //! Idle keep-alive connections
+
+  host_state() : active(0) {}
+};
+
+/**
+ * @class multi_engine
+ * @brief The epoll loop behind multi_client. This is an internal class.
+ */
+class multi_engine
+{
+public:
+  multi_engine();
+  ~multi_engine();
+
+  uint64_t add(const std::string& _url, const http::request& _request, const FNMultiCallback& _fnCallback, const multi_config& _config);
+  size_t poll(int _timeoutMs, const multi_config& _config);
+  void stop() { m_stop = true; wakeup(); }
+  bool is_stopped() const { return m_stop; }
+  void reset_stop() { m_stop = false; }
+  size_t pending() const { return m_pending; }
+  size_t in_flight() const { return m_inFlight; }
+
+private:
+  void wakeup();
+  void accept_incoming();
+  void dispatch(const multi_config& _config);
+  void start(transfer* _t, host_state& _host, const multi_config& _config);
+  void drive(transfer* _t, const multi_config& _config);
+  void wait_for(transfer* _t, io_status _status);
+  void unregister(transfer* _t);
+  void complete(transfer* _t, bool _reuseConnection);
+  void fail(transfer* _t, const std::string& _error);
+  void release(transfer* _t, bool _reuseConnection);
+  bool retry_stale(transfer* _t, const multi_config& _config);
+  void check_timeouts(const multi_config& _config);
+  static bool is_alive(const connection_ptr& _conn);
+
+private:
+  int                                                     m_epoll;     //! epoll descriptor
+  int                                                     m_event;     //! eventfd used to wake up the loop
+  std::mutex                                              m_mutex;     //! Protects m_incoming and m_nextId
+  std::vector<std::unique_ptr<transfer>>                  m_incoming;  //! Requests added since the last poll
+  uint64_t                                                m_nextId;    //! Identifier of the next request
+  std::unordered_map<transfer*, std::unique_ptr<transfer>> m_transfers; //! All the requests owned by the engine
+  std::unordered_map<std::string, host_state>             m_hosts;     //! State per host
+  std::vector<transfer*>                                  m_completed; //! Requests whose callbacks are due
+  std::atomic<size_t>                                     m_pending;   //! Requests that are not complete yet
+  size_t                                                  m_inFlight;  //! Requests that are using a connection
+  size_t                                                  m_waiting;   //! Requests waiting for a connection
+  steady_clock::time_point                                m_nextTimer; //! Next time to check for timeouts
+  std::atomic<bool>                                       m_stop;      //! Set by stop()
+  char                                                    m_buffer[MULTI_READ_BUFFER_SIZE]; //! Read buffer
+};
+
+} // namespace http
+} // namespace sid
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of multi_config structure
+//
+//////////////////////////////////////////////////////////////////////////////////////
+multi_config::multi_config()
+{
+  clear();
+}
+
+void multi_config::clear()
+{
+  max_in_flight = 1024;
+  max_per_host = 64;
+  timeout = DEFAULT_IO_TIMEOUT_SECS;
+  decode_content = true;
+  family = connection_family::none;
+  certificate.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of multi_client class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+multi_client::multi_client() : config(), m_engine(new multi_engine()), m_exception()
+{
+}
+
+multi_client::~multi_client()
+{
+}
+
+uint64_t multi_client::add(const std::string& _url, const http::request& _request, const FNMultiCallback& _fnCallback)
+{
+  return m_engine->add(_url, _request, _fnCallback, this->config);
+}
+
+std::future<multi_result> multi_client::add(const std::string& _url, const http::request& _request)
+{
+  auto promise = std::make_shared<std::promise<multi_result>>();
+  std::future<multi_result> future = promise->get_future();
+  m_engine->add(_url, _request, [promise](multi_result& _result) { promise->set_value(std::move(_result)); }, this->config);
+  return future;
+}
+
+bool multi_client::run()
+{
+  bool isSuccess = false;
+
+  try
+  {
+    m_engine->reset_stop();
+    while ( m_engine->pending() > 0 && ! m_engine->is_stopped() )
+      m_engine->poll(1000, this->config);
+    isSuccess = true;
+  }
+  catch ( const sid::exception& e )
+  {
+    m_exception = e;
+  }
+  catch (...)
+  {
+    m_exception = sid::exception("An unhandled exception occurred in the multi client event loop");
+  }
+
+  return isSuccess;
+}
+
+size_t multi_client::poll(int _timeoutMs)
+{
+  return m_engine->poll(_timeoutMs, this->config);
+}
+
+void multi_client::stop()
+{
+  m_engine->stop();
+}
+
+size_t multi_client::pending() const
+{
+  return m_engine->pending();
+}
+
+size_t multi_client::in_flight() const
+{
+  return m_engine->in_flight();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of multi_engine class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+multi_engine::multi_engine() :
+  m_epoll(-1), m_event(-1), m_nextId(0), m_pending(0), m_inFlight(0), m_waiting(0),
+  m_nextTimer(steady_clock::now()), m_stop(false)
+{
+  http::library_init();
+
+  m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+  if ( m_epoll == -1 )
+    throw sid::exception(sid::to_errno_str("epoll_create1() failed"));
+
+  m_event = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if ( m_event == -1 )
+  {
+    ::close(m_epoll);
+    throw sid::exception(sid::to_errno_str("eventfd() failed"));
+  }
+
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr; // nullptr identifies the wake up event
+  ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_event, &ev);
+}
+
+multi_engine::~multi_engine()
+{
+  // The connections are closed by the destructors of the transfer and host objects
+  m_transfers.clear();
+  m_hosts.clear();
+  ::close(m_event);
+  ::close(m_epoll);
+}
+
+void multi_engine::wakeup()
+{
+  uint64_t one = 1;
+  ssize_t ret = ::write(m_event, &one, sizeof(one));
+  (void) ret;
+}
+
+uint64_t multi_engine::add(const std::string& _url, const http::request& _request, const FNMultiCallback& _fnCallback, const multi_config& _config)
+{
+  http::url url;
+  if ( ! url.set(_url) )
+    throw sid::exception(url.error);
+
+  std::unique_ptr<transfer> t(new transfer());
+  t->callback = _fnCallback;
+  t->type = url.type;
+  t->server = url.server;
+  t->port = static_cast<unsigned short>(url.port);
+  t->hostKey = std::string(url.type == connection_type::https? "https://" : "http://") + url.server + ":" + sid::to_str(url.port);
+  if ( ! _request.body.empty() )
+    throw sid::exception("Streamed payloads are not supported by multi_client. Set the content of the request instead.");
+  t->request = _request;
+  if ( t->request.method.to_str().empty() )
+    t->request.method = http::method_type::get;
+  // The uri defaults to "*", which is meaningful only for OPTIONS
+  if ( t->request.uri.empty() || (t->request.uri == "*" && t->request.method != http::method_type::options) )
+    t->request.uri = url.resource.empty()? "/" : url.resource;
+  t->request.headers("Host", url.server, http::header_action::skip);
+  if ( _config.decode_content )
+    t->request.headers("Accept-Encoding", http::content_decoder::accept_encoding(), http::header_action::skip);
+  t->data = t->request.to_str(true);
+
+  uint64_t id = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    id = ++m_nextId;
+    t->result.id = id;
+    m_incoming.push_back(std::move(t));
+  }
+  ++m_pending;
+  wakeup();
+  return id;
+}
+
+void multi_engine::accept_incoming()
+{
+  std::vector<std::unique_ptr<transfer>> incoming;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    incoming.swap(m_incoming);
+  }
+  for ( std::unique_ptr<transfer>& t : incoming )
+  {
+    transfer* ptr = t.get();
+    m_hosts[ptr->hostKey].waiting.push_back(ptr);
+    m_transfers[ptr] = std::move(t);
+    m_waiting++;
+  }
+}
+
+size_t multi_engine::poll(int _timeoutMs, const multi_config& _config)
+{
+  struct epoll_event events[MULTI_MAX_EVENTS];
+
+  accept_incoming();
+  dispatch(_config);
+
+  // Do not sleep beyond the next timeout check if there are requests in flight
+  int timeoutMs = _timeoutMs;
+  if ( m_inFlight > 0 )
+  {
+    int64_t timerMs = std::chrono::duration_cast<std::chrono::milliseconds>(m_nextTimer - steady_clock::now()).count();
+    if ( timerMs < 0 ) timerMs = 0;
+    if ( timeoutMs < 0 || timerMs < timeoutMs ) timeoutMs = static_cast<int>(timerMs);
+  }
+  if ( ! m_completed.empty() ) timeoutMs = 0;
+
+  int count = ::epoll_wait(m_epoll, events, MULTI_MAX_EVENTS, timeoutMs);
+  if ( count == -1 && errno != EINTR )
+    throw sid::exception(sid::to_errno_str("epoll_wait() failed"));
+
+  for ( int i = 0; i < count; i++ )
+  {
+    transfer* t = static_cast<transfer*>(events[i].data.ptr);
+    if ( t == nullptr )
+    {
+      uint64_t value = 0;
+      ssize_t ret = ::read(m_event, &value, sizeof(value));
+      (void) ret;
+      continue;
+    }
+    // The transfer could have been completed by an earlier event in this batch
+    if ( t->state != transfer_state::done )
+      drive(t, _config);
+  }
+
+  if ( steady_clock::now() >= m_nextTimer )
+  {
+    check_timeouts(_config);
+    m_nextTimer = steady_clock::now() + std::chrono::milliseconds(MULTI_TIMER_MSECS);
+  }
+
+  // Start the waiting requests on the connections that were freed up
+  accept_incoming();
+  dispatch(_config);
+
+  // Call the callbacks at the end, so that they are free to add new requests
+  std::vector<transfer*> completed;
+  completed.swap(m_completed);
+  for ( transfer* t : completed )
+  {
+    std::unique_ptr<transfer> owner = std::move(m_transfers[t]);
+    m_transfers.erase(t);
+    if ( owner->callback )
+    {
+      try { owner->callback(owner->result); }
+      catch (...) { /* The exceptions from the callback are not propagated */ }
+    }
+    --m_pending;
+  }
+
+  return m_pending;
+}
+
+void multi_engine::dispatch(const multi_config& _config)
+{
+  if ( m_waiting == 0 ) return;
+
+  uint32_t maxPerHost = (_config.max_per_host > 0)? _config.max_per_host : 1;
+  for ( auto& entry : m_hosts )
+  {
+    host_state& host = entry.second;
+    while ( ! host.waiting.empty() && host.active < maxPerHost
+            && (_config.max_in_flight == 0 || m_inFlight < _config.max_in_flight) )
+    {
+      transfer* t = host.waiting.front();
+      host.waiting.pop_front();
+      m_waiting--;
+      start(t, host, _config);
+    }
+    if ( _config.max_in_flight != 0 && m_inFlight >= _config.max_in_flight )
+      break;
+  }
+}
+
+/*static*/
+bool multi_engine::is_alive(const connection_ptr& _conn)
+{
+  // An idle connection must not have anything to read. If it does, the server has closed it (or misbehaved).
+  char ch;
+  ssize_t ret = ::recv(_conn->descriptor(), &ch, 1, MSG_PEEK | MSG_DONTWAIT);
+  return ( ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) );
+}
+
+void multi_engine::start(transfer* _t, host_state& _host, const multi_config& _config)
+{
+  _host.active++;
+  m_inFlight++;
+  _t->lastActive = steady_clock::now();
+  _t->written = 0;
+  _t->received = 0;
+  _t->reused = false;
+  _t->parser.reset();
+  _t->result.response.clear();
+
+  try
+  {
+    // Reuse an idle connection to the same host if there is one
+    while ( ! _host.idle.empty() )
+    {
+      connection_ptr conn = _host.idle.back();
+      _host.idle.pop_back();
+      if ( is_alive(conn) )
+      {
+        _t->conn = conn;
+        _t->reused = true;
+        break;
+      }
+      conn->close();
+    }
+
+    if ( _t->conn.empty() )
+    {
+      _t->conn = ( _t->type == connection_type::https )?
+        http::connection::create(_config.certificate, _config.family) :
+        http::connection::create(_t->type, _config.family);
+      _t->conn->set_timeout(_config.timeout);
+      io_status status = _t->conn->open_async(_t->server, _t->port);
+      _t->state = transfer_state::connecting;
+      if ( status != io_status::done )
+      {
+        wait_for(_t, status);
+        return;
+      }
+    }
+    _t->state = transfer_state::sending;
+  }
+  catch ( const sid::exception& e )
+  {
+    fail(_t, e.what());
+    return;
+  }
+  drive(_t, _config);
+}
+
+void multi_engine::drive(transfer* _t, const multi_config& _config)
+{
+  try
+  {
+    io_status status = io_status::done;
+    size_t count = 0;
+
+    if ( _t->state == transfer_state::connecting )
+    {
+      // A failed connect moves on to the next address of the server over a new socket, which epoll does not know of
+      unregister(_t);
+      status = _t->conn->open_continue();
+      if ( status != io_status::done )
+      {
+        wait_for(_t, status);
+        return;
+      }
+      _t->lastActive = steady_clock::now();
+      _t->state = transfer_state::sending;
+    }
+
+    if ( _t->state == transfer_state::sending )
+    {
+      while ( _t->written < _t->data.length() )
+      {
+        status = _t->conn->write_some(_t->data.data() + _t->written, _t->data.length() - _t->written, /*out*/ count);
+        if ( status == io_status::closed )
+        {
+          if ( retry_stale(_t, _config) )
+            return;
+          throw sid::exception("The connection was closed by the peer while sending the request");
+        }
+        if ( status != io_status::done )
+        {
+          wait_for(_t, status);
+          return;
+        }
+        _t->written += count;
+        _t->lastActive = steady_clock::now();
+      }
+      _t->state = transfer_state::receiving;
+      _t->parser.reset(new response_parser(_t->conn, _t->request.method, _config.decode_content));
+    }
+
+    if ( _t->state == transfer_state::receiving )
+    {
+      // Read until the socket is drained, as SSL may hold data that epoll does not know about
+      while ( true )
+      {
+        status = _t->conn->read_some(m_buffer, sizeof(m_buffer), /*out*/ count);
+        if ( status == io_status::done )
+        {
+          _t->received += count;
+          _t->lastActive = steady_clock::now();
+          if ( ! _t->parser->parse(m_buffer, count, /*in/out*/ _t->result.response) )
+          {
+            complete(_t, response_parser::keep_alive(_t->result.response));
+            return;
+          }
+        }
+        else if ( status == io_status::closed )
+        {
+          if ( retry_stale(_t, _config) )
+            return;
+          _t->parser->end_of_input(/*in/out*/ _t->result.response);
+          complete(_t, false);
+          return;
+        }
+        else
+        {
+          wait_for(_t, status);
+          return;
+        }
+      }
+    }
+  }
+  catch ( const sid::exception& e )
+  {
+    fail(_t, e.what());
+  }
+}
+
+void multi_engine::wait_for(transfer* _t, io_status _status)
+{
+  uint32_t events = ( _status == io_status::want_write )? EPOLLOUT : EPOLLIN;
+  events |= EPOLLRDHUP;
+  if ( _t->events == events )
+    return;
+
+  struct epoll_event ev = {};
+  ev.events = events;
+  ev.data.ptr = _t;
+  int op = ( _t->events == 0 )? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  if ( ::epoll_ctl(m_epoll, op, _t->conn->descriptor(), &ev) == -1 )
+    throw sid::exception(sid::to_errno_str("epoll_ctl() failed"));
+  _t->events = events;
+}
+
+void multi_engine::unregister(transfer* _t)
+{
+  if ( _t->events != 0 && ! _t->conn.empty() && _t->conn->descriptor() != -1 )
+    ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, _t->conn->descriptor(), nullptr);
+  _t->events = 0;
+}
+
+void multi_engine::release(transfer* _t, bool _reuseConnection)
+{
+  host_state& host = m_hosts[_t->hostKey];
+  unregister(_t);
+  if ( ! _t->conn.empty() )
+  {
+    if ( _reuseConnection && _t->conn->is_open() )
+      host.idle.push_back(_t->conn);
+    else
+      _t->conn->close();
+    _t->conn.clear();
+  }
+  _t->parser.reset();
+  host.active--;
+  m_inFlight--;
+  _t->state = transfer_state::queued;
+}
+
+bool multi_engine::retry_stale(transfer* _t, const multi_config& _config)
+{
+  // If the server closed an idle connection before it saw the request, retry on another connection.
+  // The server may have acted on a request it did not respond to. So, only idempotent requests are sent again.
+  if ( ! _t->reused || _t->received != 0 || ! _t->request.method.is_idempotent() )
+    return false;
+  host_state& host = m_hosts[_t->hostKey];
+  release(_t, false);
+  start(_t, host, _config);
+  return true;
+}
+
+void multi_engine::complete(transfer* _t, bool _reuseConnection)
+{
+  release(_t, _reuseConnection);
+  _t->result.success = true;
+  _t->state = transfer_state::done;
+  m_completed.push_back(_t);
+}
+
+void multi_engine::fail(transfer* _t, const std::string& _error)
+{
+  release(_t, false);
+  _t->result.success = false;
+  _t->result.error = _error;
+  _t->state = transfer_state::done;
+  m_completed.push_back(_t);
+}
+
+void multi_engine::check_timeouts(const multi_config& _config)
+{
+  steady_clock::time_point expiry = steady_clock::now() - std::chrono::seconds(_config.timeout > 0? _config.timeout : DEFAULT_IO_TIMEOUT_SECS);
+  std::vector<transfer*> expired;
+  for ( const auto& entry : m_transfers )
+  {
+    transfer* t = entry.first;
+    if ( t->state != transfer_state::queued && t->state != transfer_state::done && t->lastActive < expiry )
+      expired.push_back(t);
+  }
+  for ( transfer* t : expired )
+    fail(t, "The operation timedout after " + sid::to_str(_config.timeout) + " seconds");
+}
@@ -0,0 +1,217 @@
+//////////////////////////////////////////////////////
+//
+// pipeline.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/http.hpp"
+#include "http/pipeline.hpp"
+#include "common/convert.hpp"
+
+#include <climits>
+#include <sys/uio.h>
+
+using namespace std;
+using namespace sid;
+using namespace sid::http;
+
+pipeline::pipeline()
+{
+  decode_content = true;
+  max_depth = 16;
+  max_replays = 3;
+  clear();
+}
+
+void pipeline::clear()
+{
+  m_requests.clear();
+  m_wire.clear();
+  m_responses.clear();
+  m_completed = m_sent = m_replayed = 0;
+  m_exception.clear();
+}
+
+void pipeline::add(const http::request& _request)
+{
+  if ( ! _request.method.is_idempotent() )
+    throw sid::exception("Only idempotent requests can be pipelined. " + _request.method.to_str() + " is not.");
+  if ( ! _request.body.empty() )
+    throw sid::exception("A request with a streamed payload cannot be pipelined");
+  m_requests.push_back(_request);
+  http::request& request = m_requests.back();
+  request.version = http::version_id::v11;
+  if ( decode_content )
+    request.headers("Accept-Encoding", http::content_decoder::accept_encoding(), http::header_action::skip);
+  m_wire.push_back(request.to_str(true));
+}
+
+void pipeline::p_send()
+{
+  size_t last = std::min(m_requests.size(), m_completed + std::max<uint32_t>(max_depth, 1));
+  if ( m_sent >= last )
+    return;
+
+  std::vector<struct iovec> iov;
+  for ( size_t i = m_sent; i < last && iov.size() < IOV_MAX; i++ )
+    iov.push_back({ const_cast<char*>(m_wire[i].data()), m_wire[i].length() });
+  m_sent += iov.size();
+
+  // Write them all, continuing after partial writes
+  for ( size_t index = 0; index < iov.size(); )
+  {
+    ssize_t written = conn->writev(&iov[index], static_cast<int>(std::min<size_t>(iov.size() - index, IOV_MAX)));
+    if ( written <= 0 )
+      throw sid::exception("Failed to write the pipelined requests");
+    while ( written > 0 && index < iov.size() )
+    {
+      size_t len = std::min<size_t>(written, iov[index].iov_len);
+      iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + len;
+      iov[index].iov_len -= len;
+      written -= len;
+      if ( iov[index].iov_len == 0 )
+        index++;
+    }
+  }
+}
+
+bool pipeline::p_recv()
+{
+  http::response& response = m_responses[m_completed];
+  response.clear();
+  response_parser parser(conn, m_requests[m_completed].method, decode_content);
+
+  // The previous read can have brought in (a part of) this response
+  std::string unread = conn->take_unread();
+  bool isMore = parser.parse(unread.data(), unread.length(), response);
+  char buffer[32*1024];
+  while ( isMore )
+  {
+    ssize_t nread = conn->read(buffer, sizeof(buffer));
+    if ( nread <= 0 )
+    {
+      try
+      {
+        // The response ends here if its length is given by the end of the connection
+        parser.end_of_input(response);
+      }
+      catch ( const sid::exception& )
+      {
+        // The response is incomplete. The request is idempotent, so it can be replayed.
+        return false;
+      }
+      break;
+    }
+    isMore = parser.parse(buffer, nread, response);
+  }
+  conn->unread(parser.take_unparsed());
+  return true;
+}
+
+void pipeline::p_reopen()
+{
+  conn->close();
+  if ( ! conn->open(m_server, m_port) )
+    throw sid::exception(conn->error());
+  // Requests written on the old connection that were not answered are sent again
+  m_replayed += m_sent - m_completed;
+  m_sent = m_completed;
+}
+
+bool pipeline::run()
+{
+  bool isSuccess = false;
+  try
+  {
+    m_exception.clear();
+    if ( conn.empty() || ! conn->is_open() )
+      throw sid::exception("Connection is not established");
+    // The server details are cleared when the connection is closed
+    m_server = conn->server();
+    m_port = static_cast<unsigned short>(conn->port());
+    m_responses.resize(m_requests.size());
+
+    uint32_t attempts = 0;  //! Connections in a row that did not answer any request
+    while ( m_completed < m_requests.size() )
+    {
+      bool isClosed = ! conn->is_open();
+      if ( ! isClosed )
+      {
+        try
+        {
+          // Top up the pipeline once half of it has been answered, so that the requests go out in batches
+          if ( m_sent == m_completed || m_sent - m_completed <= max_depth / 2 )
+            p_send();
+          isClosed = ! p_recv();
+        }
+        catch ( const sid::exception& )
+        {
+          // The connection broke in the middle of the pipeline
+          if ( ! conn->is_retryable() )
+            throw;
+          isClosed = true;
+        }
+      }
+      if ( isClosed )
+      {
+        if ( ++attempts > max_replays )
+          throw sid::exception("The server closed " + sid::to_str(attempts) + " connections in a row without answering");
+        p_reopen();
+        continue;
+      }
+
+      attempts = 0;
+      if ( ! response_parser::keep_alive(m_responses[m_completed++]) )
+      {
+        // The server does not take any more requests on this connection
+        if ( m_completed < m_requests.size() )
+          p_reopen();
+        else
+          conn->close();
+      }
+    }
+    isSuccess = true;
+  }
+  catch ( const sid::exception& e )
+  {
+    m_exception = e;
+  }
+  catch (...)
+  {
+    m_exception = sid::exception("An unhandled exception occurred while pipelining the requests");
+  }
+  return isSuccess;
+}
@@ -40,6 +40,11 @@ LICENSE: END
 #include "http/http.hpp"
 #include "common/convert.hpp"
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <strings.h>
 
 using namespace sid;
 using namespace sid::http;
@@ -68,8 +73,30 @@ void request::clear()
   this->content_is_file_path = false;
   this->error.clear();
   this->m_content.clear();
+  this->body = http::body_source();
+  this->m_trailerChecksum = sid::checksum::type::none;
+  this->m_isAwsChunked = false;
 }
 
+namespace {
+
+//! Size of the pieces in which a streamed payload is read and written
+const size_t BODY_PIECE_SIZE = 64*1024;
+
+//! Length of the aws-chunked encoding of a payload in pieces of BODY_PIECE_SIZE, ending with the checksum trailer
+uint64_t aws_chunked_length(uint64_t _length, sid::checksum::type _type)
+{
+  auto chunkLength = [](uint64_t _size)->uint64_t
+    {
+      return sid::to_str(_size, num_base::hex).length() + 2 + _size + 2;
+    };
+  const uint64_t trailerLength = http::checksum_header(_type).length() + 1 + sid::checksum::crc(_type).to_base64().length() + 2;
+  return (_length / BODY_PIECE_SIZE) * chunkLength(BODY_PIECE_SIZE) + ((_length % BODY_PIECE_SIZE) > 0? chunkLength(_length % BODY_PIECE_SIZE) : 0)
+         + 3 + trailerLength + 2;
+}
+
+} // anonymous namespace
+
 /**
  * @fn void set_content(const std::string& _data, size_t _len);
  * @brief Sets the payload of the request
@@ -82,10 +109,89 @@ void request::clear()
 void request::set_content(const std::string& _data, size_t _len)
 {
   this->m_content.set_data(_data, _len);
+  this->body = http::body_source();
   _len = this->m_content.length();
   this->headers("Content-Length", sid::to_str(_len));
 }
 
+/**
+ * @fn void set_content(const http::body_source& _source);
+ * @brief Sets a payload that is streamed from the source when the request is sent.
+ */
+void request::set_content(const http::body_source& _source)
+{
+  this->m_content.clear();
+  this->body = _source;
+  if ( _source.has_length() )
+  {
+    this->headers.remove_all("Transfer-Encoding");
+    this->headers("Content-Length", sid::to_str(_source.length()));
+  }
+  else
+  {
+    this->headers.remove_all("Content-Length");
+    this->headers("Transfer-Encoding", "chunked");
+  }
+}
+
+void request::set_checksum(sid::checksum::type _type, checksum_location _location/* = checksum_location::header*/)
+{
+  const std::string name = http::checksum_header(_type);
+  this->m_trailerChecksum = sid::checksum::type::none;
+  this->m_isAwsChunked = false;
+  this->headers.remove_all(name);
+  if ( _type == sid::checksum::type::none )
+    return;
+
+  if ( _location != checksum_location::header && this->body.empty() )
+    throw sid::exception("A checksum trailer needs a streamed payload");
+  if ( _location == checksum_location::trailer )
+  {
+    this->m_trailerChecksum = _type;
+    this->headers.remove_all("Content-Length");
+    this->headers("Transfer-Encoding", "chunked");
+    this->headers("Trailer", name);
+    return;
+  }
+  if ( _location == checksum_location::aws_chunked )
+  {
+    if ( ! this->body.has_length() )
+      throw sid::exception("An aws-chunked payload needs a source of known length");
+    this->m_trailerChecksum = _type;
+    this->m_isAwsChunked = true;
+    // aws-chunked is the outermost content-coding (eg: "aws-chunked, gzip")
+    std::string contentEncoding;
+    if ( this->headers.exists("Content-Encoding", &contentEncoding) && ! contentEncoding.empty() )
+      this->headers("Content-Encoding", "aws-chunked, " + contentEncoding);
+    else
+      this->headers("Content-Encoding", "aws-chunked");
+    this->headers.remove_all("Transfer-Encoding");
+    this->headers("Content-Length", sid::to_str(aws_chunked_length(this->body.length(), _type)));
+    this->headers("x-amz-content-sha256", "STREAMING-UNSIGNED-PAYLOAD-TRAILER");
+    this->headers("x-amz-decoded-content-length", sid::to_str(this->body.length()));
+    this->headers("x-amz-trailer", name);
+    return;
+  }
+
+  sid::checksum::crc crc(_type);
+  if ( this->body.empty() )
+    crc = this->m_content.checksum(_type);
+  else
+  {
+    std::vector<char> buffer(BODY_PIECE_SIZE);
+    for ( size_t nread = 0; (nread = this->body.read(buffer.data(), buffer.size())) != 0; )
+      crc.update(buffer.data(), nread);
+    if ( ! this->body.rewind() )
+      throw sid::exception("The checksum of the payload cannot be sent as its source cannot be rewound");
+  }
+  this->headers(name, crc.to_base64());
+}
+
+bool request::verify_checksum(std::string* _pError/* = nullptr*/) const
+{
+  return http::verify_checksum(this->headers, this->m_content, _pError);
+}
+
 /**
  * @fn std::string to_str() const;
  * @brief Return the complete HTTP request as a string.
@@ -94,25 +200,24 @@ std::string request::to_str() const { return to_str(true); }
 
 std::string request::to_str(bool _withContent) const
 {
-  std::ostringstream out;
+  return sid::serialize([&](sid::sized_writer& _out) { this->write(_out, _withContent); });
+}
 
-  out << this->method.to_str() << " "
-      << this->uri << " "
-      << this->version.to_str()
-      << CRLF;
+void request::write(sid::sized_writer& _out, bool _withContent) const
+{
+  _out << this->method.to_str() << ' ' << this->uri << ' ' << this->version.to_str();
+  _out.write(CRLF, 2);
 
-  out << this->headers.to_str();
-  out << CRLF; // Extra CRLF to mark the start of data
+  this->headers.write(_out);
+  _out.write(CRLF, 2); // Extra CRLF to mark the start of data
 
   if ( _withContent )
   {
     if ( this->m_content.is_string() )
-      out << this->m_content.to_str();
+      _out << this->m_content.data();
     else
-      out << "File: " << this->m_content.file_path();
+      _out << "File: " << this->m_content.file_path();
   }
-
-  return out.str();
 }
 
 bool request::send(connection_ptr _conn)
@@ -159,11 +264,77 @@ bool request::send(connection_ptr _conn, const void* _buffer, size_t _count)
     if ( _conn.empty() || ! _conn->is_open() )
       throw sid::exception("Connection is not established");
 
-    ssize_t written = _conn->write(_buffer, _count);
-    if ( written < 0 || _count != (size_t) written)
+    _conn->write_fully(_buffer, _count);
+
+    // set the return status to true
+    isSuccess = true;
+  }
+  catch ( const sid::exception& e )
+  {
+    this->error = __func__ + std::string(": ") + e.what();
+  }
+  catch (...)
+  {
+    this->error = __func__ + std::string(": Unhandled exception occurred");
+  }
+
+  return isSuccess;
+}
+
+bool request::send_body(connection_ptr _conn)
+{
+  bool isSuccess = false;
+
+  try
+  {
+    this->error.clear();
+
+    if ( _conn.empty() || ! _conn->is_open() )
+      throw sid::exception("Connection is not established");
+
+    if ( this->body.empty() )
     {
-      cerr << _count << ": " << written << endl;
-      throw sid::exception("Failed to write data");
+      _conn->write_fully(this->m_content.data().data(), this->m_content.data().length());
+      return true;
+    }
+
+    // Only one piece of the payload is held at a time. A chunk is framed in place as
+    // <hex-size>CRLF<data>CRLF so that it goes out in a single write.
+    const bool isChunked = ! this->body.has_length() || this->m_trailerChecksum != sid::checksum::type::none;
+    sid::checksum::crc trailerCrc(this->m_trailerChecksum);
+    if ( isChunked && ! this->m_isAwsChunked && this->version == http::version_id::v10 )
+      throw sid::exception("A payload of unknown length cannot be sent with HTTP/1.0");
+    const size_t prefixLen = 18;
+    std::vector<char> buffer(prefixLen + BODY_PIECE_SIZE + 2);
+    char* piece = buffer.data() + prefixLen;
+    while ( true )
+    {
+      size_t nread = this->body.read(piece, BODY_PIECE_SIZE);
+      // The sizes of the aws-chunked pieces are part of Content-Length, so every piece but the last one is complete
+      for ( size_t more = nread; this->m_isAwsChunked && more != 0 && nread < BODY_PIECE_SIZE; nread += more )
+        more = this->body.read(piece + nread, BODY_PIECE_SIZE - nread);
+      if ( ! isChunked )
+      {
+        if ( nread == 0 ) break;
+        _conn->write_fully(piece, nread);
+        continue;
+      }
+      if ( nread == 0 )
+      {
+        std::string lastChunk = "0\r\n";
+        if ( this->m_trailerChecksum != sid::checksum::type::none )
+          lastChunk += http::checksum_header(this->m_trailerChecksum) + (this->m_isAwsChunked? ":" : ": ") + trailerCrc.to_base64() + CRLF;
+        lastChunk += CRLF;
+        _conn->write_fully(lastChunk.data(), lastChunk.length());
+        break;
+      }
+      if ( this->m_trailerChecksum != sid::checksum::type::none )
+        trailerCrc.update(piece, nread);
+      char sizeLine[prefixLen+1];
+      int sizeLen = ::snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", nread);
+      ::memcpy(piece - sizeLen, sizeLine, sizeLen);
+      ::memcpy(piece + nread, CRLF, 2);
+      _conn->write_fully(piece - sizeLen, sizeLen + nread + 2);
     }
 
     // set the return status to true
@@ -194,18 +365,138 @@ bool request::recv(connection_ptr _conn)
     if ( _conn.empty() || ! _conn->is_open() )
       throw sid::exception("Connection is not established");
 
-    ////////////////////////////////////////////////////
-    // NOTE: BASIC IMPLEMENTATION. TO BE CHANGED LATER.
-    ////////////////////////////////////////////////////
-    std::string csRequest;
-    while ( (nread = _conn->read(buffer, sizeof(buffer)-1)) > 0 )
+    // Read till the end of the headers and then the payload, as per Content-Length or the chunked encoding
+    // A pipelining client can have sent this request along with the previous one
+    std::string csRequest = _conn->take_unread();
+    bool isBuffered = ! csRequest.empty();
+    size_t headerEnd = std::string::npos;
+    size_t totalLen = std::string::npos;
+    bool isChunked = false, isComplete = false;
+    std::string chunkedData;  // Decoded chunked payload
+    size_t chunkPos = 0;      // Start of the chunk yet to be decoded
+    size_t chunkEnd = 0;      // End of the trailers, once the last chunk is received
+    std::string trailers;     // Trailer fields of the chunked payload
+
+    // Headers are looked up in the raw request, as they are parsed only once the request is complete
+    auto raw_header = [&](const std::string& _name, std::string& _value)->bool
+      {
+        const std::string key = "\r\n" + _name + ":";
+        auto it = std::search(csRequest.begin(), csRequest.begin() + headerEnd, key.begin(), key.end(),
+                              [](char a, char b) { return ::tolower(static_cast<unsigned char>(a)) == b; });
+        if ( it == csRequest.begin() + headerEnd ) return false;
+        size_t pos = (it - csRequest.begin()) + key.length();
+        _value = sid::trim(csRequest.substr(pos, csRequest.find(CRLF, pos) - pos));
+        return true;
+      };
+
+    // Decode the complete chunks received so far. Returns true once the last chunk and the trailers are received.
+    auto decode_chunks = [&]()->bool
+      {
+        bool isLast = false;
+        while ( ! isLast )
+        {
+          size_t eol = csRequest.find(CRLF, chunkPos);
+          if ( eol == std::string::npos ) break;
+          std::string sizeStr = csRequest.substr(chunkPos, eol - chunkPos);
+          size_t pos = sizeStr.find(';');
+          if ( pos != std::string::npos ) sizeStr.erase(pos);
+          uint64_t chunkSize = 0;
+          if ( ! sid::to_num(sid::trim(sizeStr), sid::num_base::hex, /*out*/ chunkSize) )
+            throw sid::exception("Invalid chunk size: " + sizeStr);
+          if ( chunkSize == 0 )
+          {
+            // Trailer fields end with an empty line
+            size_t trailerEnd = csRequest.find("\r\n\r\n", eol);
+            if ( trailerEnd == std::string::npos ) break;
+            isLast = true;
+            trailers = csRequest.substr(eol + 2, trailerEnd - eol);
+            chunkEnd = trailerEnd + 4 - (chunkPos - headerEnd);
+          }
+          else
+          {
+            if ( csRequest.length() < eol + 2 + chunkSize + 2 ) break;
+            chunkedData.append(csRequest, eol + 2, chunkSize);
+            chunkPos = eol + 2 + chunkSize + 2;
+          }
+        }
+        // Drop the raw chunks that have been decoded
+        csRequest.erase(headerEnd, chunkPos - headerEnd);
+        chunkPos = headerEnd;
+        return isLast;
+      };
+
+    while ( ! isComplete )
+    {
+      if ( isBuffered )
+      {
+        isBuffered = false;
+        nread = static_cast<int>(csRequest.length());
+      }
+      else
+      {
+        nread = _conn->read(buffer, sizeof(buffer)-1);
+        if ( nread <= 0 ) break;
+        csRequest.append(buffer, nread);
+      }
+      if ( headerEnd == std::string::npos )
+      {
+        headerEnd = csRequest.find("\r\n\r\n", (csRequest.length() > static_cast<size_t>(nread) + 3)? csRequest.length() - nread - 3 : 0);
+        if ( headerEnd == std::string::npos ) continue;
+        headerEnd += 2; // Keep the CRLF of the last header, the empty line is added back at the end
+        chunkPos = headerEnd + 2;
+
+        std::string value;
+        // The client waits for the interim response before sending the payload
+        if ( raw_header("expect", value) && ::strcasecmp(value.c_str(), "100-continue") == 0 )
+        {
+          const char continueStr[] = "HTTP/1.1 100 Continue\r\n\r\n";
+          if ( ! send(_conn, continueStr, sizeof(continueStr) - 1) )
+            throw sid::exception(this->error);
+        }
+        if ( raw_header("transfer-encoding", value) && sid::to_lower(value).find("chunked") != std::string::npos )
+          isChunked = true;
+        else
+        {
+          totalLen = headerEnd + 2;
+          if ( raw_header("content-length", value) )
+          {
+            uint64_t contentLength = 0;
+            if ( ! sid::to_num(value, /*out*/ contentLength) )
+              throw sid::exception("Invalid Content-Length: " + value);
+            totalLen += contentLength;
+          }
+        }
+      }
+      isComplete = isChunked? decode_chunks() : (csRequest.length() >= totalLen);
+    }
+    if ( ! isComplete )
+      throw sid::exception("Connection closed after " + sid::to_str(csRequest.length()) + " bytes of an incomplete request");
+
+    // Anything after this request is the start of the next one
+    size_t requestEnd = isChunked? chunkEnd : totalLen;
+    if ( csRequest.length() > requestEnd )
     {
-      csRequest.append(buffer, nread);
-      if ( nread >= 0 && static_cast<size_t>(nread) < sizeof(buffer)-1 ) break;
+      _conn->unread(csRequest.substr(requestEnd));
+      csRequest.erase(requestEnd);
     }
 
+    if ( isChunked )
+    {
+      // Replace the chunked encoding by the decoded payload
+      csRequest.erase(headerEnd);
+      csRequest += CRLF;
+      csRequest += chunkedData;
+    }
     this->set(csRequest);
-    ////////////////////////////////////////////////////
+    if ( isChunked )
+    {
+      this->headers.remove_all("Transfer-Encoding");
+      this->headers("Content-Length", sid::to_str(this->m_content.length()));
+      // The trailer fields are added to the headers
+      std::string line;
+      for ( size_t pos = 0; http::get_line(trailers, pos, line) && ! line.empty(); )
+        this->headers.add(line);
+    }
 
     // set the return status to true
     isSuccess = true;
@@ -241,7 +532,7 @@ void request::set(const std::string& _input)
     pos2 = _input.find(' ', pos1);
     if ( pos2 == std::string::npos || pos2 > eol )
       throw sid::exception("Invalid request from client");
-    this->method = method::get(_input.substr(pos1, pos2-pos1));
+    this->method = method::get(_input.data() + pos1, pos2 - pos1);
     pos1 = pos2+1;
 
     pos2 = _input.find(' ', pos1);
@@ -250,7 +541,7 @@ void request::set(const std::string& _input)
     this->uri = _input.substr(pos1, pos2-pos1);
     pos1 = pos2+1;
 
-    this->version = version::get(_input.substr(pos1, eol-pos1));
+    this->version = version::get(_input.data() + pos1, eol - pos1);
 
     pos1 = eol + 2;
     do
@@ -0,0 +1,144 @@
+//////////////////////////////////////////////////////
+//
+// request_template.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/request_template.hpp"
+#include "http/common.hpp"
+#include "common/convert.hpp"
+#include <cstring>
+#include <strings.h>
+
+using namespace sid;
+using namespace sid::http;
+
+request_template::request_template()
+{
+}
+
+void request_template::clear()
+{
+  m_prefix.clear();
+  m_suffix.clear();
+  m_keys.clear();
+  m_buffer.clear();
+}
+
+void request_template::set(const http::request& _prototype, const std::vector<std::string>& _variableHeaders/* = std::vector<std::string>()*/)
+{
+  http::headers constHeaders = _prototype.headers;
+
+  this->clear();
+
+  m_prefix = _prototype.method.to_str() + " ";
+  for ( const std::string& key : _variableHeaders )
+  {
+    constHeaders.remove_all(key);
+    m_keys.push_back(key + ": ");
+  }
+  m_suffix = " " + _prototype.version.to_str() + CRLF + constHeaders.to_str();
+}
+
+size_t request_template::index(const std::string& _key) const
+{
+  for ( size_t i = 0; i < m_keys.size(); i++ )
+  {
+    // Each key has ": " at the end
+    const std::string& key = m_keys[i];
+    if ( key.length() == _key.length() + 2 && ::strncasecmp(key.c_str(), _key.c_str(), _key.length()) == 0 )
+      return i;
+  }
+  return std::string::npos;
+}
+
+size_t request_template::length(const std::string& _uri, const std::vector<std::string>& _values) const
+{
+  if ( _values.size() != m_keys.size() )
+    throw sid::exception("Expecting " + sid::to_str(m_keys.size()) + " header values in request template");
+
+  size_t len = m_prefix.length() + _uri.length() + m_suffix.length() + 2;
+  for ( size_t i = 0; i < m_keys.size(); i++ )
+  {
+    if ( ! _values[i].empty() )
+      len += m_keys[i].length() + _values[i].length() + 2;
+  }
+  return len;
+}
+
+size_t request_template::render(char* _buffer, size_t _size, const std::string& _uri, const std::vector<std::string>& _values) const
+{
+  size_t len = this->length(_uri, _values);
+  if ( _size < len )
+    return 0;
+
+  char* p = _buffer;
+  auto copy = [&](const char* _data, size_t _len) { ::memcpy(p, _data, _len); p += _len; };
+
+  copy(m_prefix.data(), m_prefix.length());
+  copy(_uri.data(), _uri.length());
+  copy(m_suffix.data(), m_suffix.length());
+  for ( size_t i = 0; i < m_keys.size(); i++ )
+  {
+    if ( _values[i].empty() ) continue;
+    copy(m_keys[i].data(), m_keys[i].length());
+    copy(_values[i].data(), _values[i].length());
+    copy(CRLF, 2);
+  }
+  copy(CRLF, 2); // Extra CRLF to mark the start of data
+  return len;
+}
+
+void request_template::render(std::string& _out, const std::string& _uri, const std::vector<std::string>& _values) const
+{
+  size_t len = this->length(_uri, _values);
+  // resize() does not release the capacity, so the buffer is allocated only when it grows
+  _out.resize(len);
+  this->render(&_out[0], len, _uri, _values);
+}
+
+void request_template::send(connection_ptr _conn, const std::string& _uri, const std::vector<std::string>& _values,
+                            const std::string& _content/* = std::string()*/)
+{
+  if ( _conn.empty() || ! _conn->is_open() )
+    throw sid::exception("Connection is not established");
+
+  this->render(m_buffer, _uri, _values);
+  if ( ! _content.empty() )
+    m_buffer.append(_content);
+
+  _conn->write_fully(m_buffer.data(), m_buffer.length());
+}
@@ -38,6 +38,7 @@ LICENSE: END
 */
 
 #include "http/http.hpp"
+#include "http/compression.hpp"
 #include "common/convert.hpp"
 #include <sstream>
 
@@ -77,16 +78,18 @@ private: // should not be instantiated separately
   response_callback() {}
 };
 
+namespace sid {
+namespace http {
 /**
  * @class response_handler
  * @brief Class definition handling response parsing.
  *
- * This is an internal class that is used only in this file.
+ * This is an internal class. It is exposed only through http::response_parser.
  */
 class response_handler
 {
 public:
-response_handler(connection_ptr _conn) : m_conn(_conn)
+response_handler(connection_ptr _conn, bool _decodeContent) : m_conn(_conn), m_decodeContent(_decodeContent)
   {
     m_endOfStatus = false;
     m_endOfHeaders = false;
@@ -94,20 +97,27 @@ response_handler(connection_ptr _conn) : m_conn(_conn)
     m_forceStop = false;
     m_pos = 0;
     m_contentLength = 0;
+    m_hasContentLength = false;
     m_encoding = http::transfer_encoding::none;
     m_keepAlive = false;
     m_chunk.clear();
     m_chunkToBeRead = 0;
+    m_chunkCrlf = 0;
+    m_inTrailers = false;
+    m_rawLength = 0;
+    m_useSink = false;
     m_response_callback = response_callback::get_singleton();
   }
 
 public:
   void parse(const char* _buffer, int _nread, const method& _requestMethod, /*in/out*/ response& _response);
+  void end_of_input(/*in/out*/ response& _response);
   bool is_end_of_status() const { return m_endOfStatus; }
   bool is_end_of_headers() const { return m_endOfHeaders; }
   bool is_end_of_data() const { return m_endOfData; }
   bool is_force_stop() const { return m_forceStop; }
   bool continue_parsing() const { return ( ! (m_endOfData || m_forceStop) ); } 
+  std::string take_unparsed();
 
 
 private:
@@ -115,6 +125,9 @@ private:
   bool parse_headers(const method& _requestMethod, /*in/out*/ response& _response);
   void parse_data_normal(/*in/out*/ response& _response);
   void parse_data_chunked(/*in/out*/ response& _response);
+  void parse_trailers(/*in/out*/ response& _response);
+  void append_data(const std::string& _data, size_t _pos, size_t _len, /*in/out*/ response& _response);
+  void end_of_data(/*in/out*/ response& _response);
 
 private:
   http::connection_ptr       m_conn;          //! Pointer to the connection object
@@ -125,12 +138,22 @@ private:
   size_t                     m_pos;           //! Indicates current position of parsing
   bool                       m_endOfData;     //! Indicates end of data has been reached
   size_t                     m_contentLength; //! Content length
+  bool                       m_hasContentLength; //! Content-Length header is present
   http::transfer_encoding    m_encoding;      //! Transfer encoding
   bool                       m_keepAlive;     //! Is keep alive set?
   data_chunk                 m_chunk;         //! Current chunk object (if response is in chunks)
   int                        m_chunkToBeRead; //! Remaining chunk bytes to be read (if response is in chunks)
+  int                        m_chunkCrlf;     //! Bytes of the CRLF after the chunk data that are yet to be skipped
+  bool                       m_inTrailers;    //! The last chunk was read and the trailer section is being skipped
+  bool                       m_decodeContent; //! Decode the content as per Content-Encoding header
+  http::content_decoder      m_decoder;       //! Streaming decoder (empty if the content is used as it is)
+  std::string                m_decoded;       //! Scratch buffer for the decoded data
+  uint64_t                   m_rawLength;     //! Number of payload bytes received (before decoding)
+  bool                       m_useSink;       //! The payload is passed to the sink of the response
   response_callback*         m_response_callback; //! Response callback in case something needs to be processed
 };
+} // namespace http
+} // namespace sid
 
 //////////////////////////////////////////////////////////////////////////////////////
 //
@@ -149,26 +172,29 @@ void response::clear()
   status = http::status_code::InternalServerError;
   headers.clear();
   content.clear();
+  decoded = false;
   error.clear();
 }
 
 std::string response::to_str(bool _showContent/* = true*/) const
 {
-  std::ostringstream out;
+  return sid::serialize([&](sid::sized_writer& _out) { this->write(_out, _showContent); });
+}
 
-  out << this->version.to_str() << " "
-      << this->status.to_str()
-      << CRLF;
-  out << this->headers.to_str();
-  out << CRLF; // marks end of data
+void response::write(sid::sized_writer& _out, bool _showContent/* = true*/) const
+{
+  _out << this->version.to_str() << ' ';
+  this->status.write(_out);
+  _out.write(CRLF, 2);
+  this->headers.write(_out);
+  _out.write(CRLF, 2); // marks end of data
   if ( this->content.is_string() )
   {
     if ( _showContent )
-      out << this->content.to_str();
+      _out << this->content.data();
   }
   else
-    out << "File: " << this->content.file_path();
-  return out.str();
+    _out << "File: " << this->content.file_path();
 }
 
 bool response::send(connection_ptr _conn)
@@ -187,9 +213,14 @@ bool response::send(connection_ptr _conn)
     ////////////////////////////////////////////////////
     std::string csResponse = this->to_str();
 
-    ssize_t written = _conn->write(csResponse.c_str(), csResponse.length());
-    if ( written < 0 || csResponse.length() != static_cast<size_t>(written) )
-      throw sid::exception("Failed to write data");
+    // A single write can be partial for large payloads on the non-blocking socket
+    for ( size_t pos = 0; pos < csResponse.length(); )
+    {
+      ssize_t written = _conn->write(csResponse.c_str() + pos, csResponse.length() - pos);
+      if ( written <= 0 )
+        throw sid::exception("Failed to write data");
+      pos += written;
+    }
     ////////////////////////////////////////////////////
 
     // set the return status to true
@@ -207,7 +238,7 @@ bool response::send(connection_ptr _conn)
   return isSuccess;
 }
 
-bool response::recv(connection_ptr _conn, const method& _requestMethod)
+bool response::recv(connection_ptr _conn, const method& _requestMethod, bool _decodeContent/* = true*/)
 {
   bool isSuccess = false;
   char buffer[32*1024] = {0};
@@ -220,9 +251,11 @@ bool response::recv(connection_ptr _conn, const method& _requestMethod)
     if ( _conn.empty() || ! _conn->is_open() )
       throw sid::exception("Connection is not established");
 
-    response_handler rd(_conn);
+    response_handler rd(_conn, _decodeContent);
     while ( rd.continue_parsing() && (nread = _conn->read(buffer, sizeof(buffer)-1)) > 0 )
       rd.parse(buffer, nread, _requestMethod, /*in/out*/ *this);
+    if ( nread == 0 )
+      rd.end_of_input(/*in/out*/ *this);
 
     if ( rd.is_force_stop() )
       throw sid::exception("Application was force stopped");
@@ -248,6 +281,11 @@ bool response::recv(connection_ptr _conn, const method& _requestMethod)
   return isSuccess;
 }
 
+bool response::verify_checksum(std::string* _pError/* = nullptr*/) const
+{
+  return http::verify_checksum(this->headers, this->content, _pError);
+}
+
 void response::set(const std::string& _input)
 {
   size_t pos1, pos2;
@@ -262,13 +300,13 @@ void response::set(const std::string& _input)
     pos2 = _input.find(' ', pos1);
     if ( pos2 == std::string::npos || pos2 > eol )
       throw sid::exception("Invalid response from server");
-    version = http::version::get(_input.substr(pos1, (pos2-pos1)));
+    version = http::version::get(_input.data() + pos1, pos2 - pos1);
     pos1 = pos2+1;
 
     pos2 = _input.find(CRLF, pos1);
     if ( pos2 == std::string::npos || pos2 > eol )
       throw sid::exception("Invalid response from server");
-    status = http::status::get(_input.substr(pos1, (pos2-pos1)));
+    status = http::status::get(_input.data() + pos1, pos2 - pos1);
     pos1 = pos2+2;
 
     // Followed by response headers
@@ -301,15 +339,20 @@ bool response_handler::parse_status(/*in/out*/ response& _response)
 
   m_pos = 0;
   if ( ! http::get_line(m_csResponse, m_pos, line) )
-    throw sid::exception("Invalid response received");
+  {
+    // The status line can arrive over several reads
+    if ( m_csResponse.length() > 8192 )
+      throw sid::exception("Invalid response received");
+    return false;
+  }
 
   // HTTP/1.x <CODE> <CODESTR>\r\n
   size_t pos1 = 0;
   size_t pos2 = line.find(' ', pos1);
   if ( pos2 == std::string::npos )
     throw sid::exception("Invalid response from server");
-  _response.version = http::version::get(line.substr(pos1, (pos2-pos1)));
-  _response.status = http::status::get(line.substr(pos2+1));
+  _response.version = http::version::get(line.data() + pos1, pos2 - pos1);
+  _response.status = http::status::get(line.data() + pos2 + 1, line.length() - pos2 - 1);
   //cerr << "End of Status" << endl;
 
   m_endOfStatus = true;
@@ -360,7 +403,9 @@ bool response_handler::parse_headers(const method& _requestMethod, /*in/out*/ re
 
       if ( _requestMethod == http::method_type::head )
       {
+        m_keepAlive = ( _response.headers.connection() == http::header_connection::keep_alive );
         m_endOfData = true; // END OF DATA
+        end_of_data(_response);
         break;
       }
 
@@ -370,8 +415,19 @@ bool response_handler::parse_headers(const method& _requestMethod, /*in/out*/ re
 
       bool isFound;
       m_contentLength = _response.headers.content_length(&isFound);
+      m_hasContentLength = isFound;
       m_encoding = _response.headers.transfer_encoding();
       m_keepAlive = ( _response.headers.connection() == http::header_connection::keep_alive );
+      const int code = static_cast<int>(_response.status.code());
+      m_useSink = ( _response.sink && code >= 200 && code < 300 );
+
+      // Set up the streaming decoder if the content is encoded
+      std::string contentEncoding;
+      if ( m_decodeContent && _response.headers.exists("Content-Encoding", &contentEncoding) )
+      {
+        if ( m_decoder.set(contentEncoding) && ! m_decoder.empty() )
+          _response.decoded = true;
+      }
       break;
     }
   } // finished with all headers
@@ -380,10 +436,12 @@ bool response_handler::parse_headers(const method& _requestMethod, /*in/out*/ re
 
 void response_handler::parse_data_normal(/*in/out*/ response& _response)
 {
-  size_t copyLen = m_csResponse.length() - m_pos;
-  _response.content.append(m_csResponse, m_pos, copyLen);
-  //cerr << "Len: " << m_contentLength << "-" << _response.content.length() << endl;
-  if ( _response.content.length() >= m_contentLength )
+  // Bytes beyond Content-Length belong to the next (pipelined) response
+  size_t copyLen = std::min<uint64_t>(m_csResponse.length() - m_pos, m_contentLength - m_rawLength);
+  append_data(m_csResponse, m_pos, copyLen, _response);
+  m_pos += copyLen;
+  //cerr << "Len: " << m_contentLength << "-" << m_rawLength << endl;
+  if ( m_rawLength >= m_contentLength )
     m_endOfData = true; // END OF DATA
   else
   {
@@ -396,25 +454,39 @@ void response_handler::parse_data_normal(/*in/out*/ response& _response)
 void response_handler::parse_data_chunked(/*in/out*/ response& _response)
 {
   std::string line;
-  bool continueLoop = true;
 
-  while ( continueLoop && !m_forceStop && !m_endOfData )
+  if ( m_inTrailers )
   {
-    if ( m_chunkToBeRead <= 0 )
+    parse_trailers(_response);
+    return;
+  }
+
+  while ( !m_forceStop && !m_endOfData )
+  {
+    // Skip the CRLF that ends the data of the previous chunk. It can arrive over several reads.
+    if ( m_chunkCrlf > 0 )
+    {
+      size_t skipLen = std::min<size_t>(m_chunkCrlf, m_csResponse.length() - m_pos);
+      m_pos += skipLen;
+      m_chunkCrlf -= skipLen;
+      if ( m_chunkCrlf > 0 )
+        break;
+    }
+
+    if ( m_chunkToBeRead == 0 )
     {
-      if ( m_chunkToBeRead < 0 ) m_pos = 2+m_chunkToBeRead;
       if ( ! http::get_line(m_csResponse, m_pos, line) )
       {
-        // give the benefit of doubt, may be we aren't finised with Headers yet
-        // we'll try to continue after next read
-        //cerr << "S1: begin: " << m_csResponse.length() << ", " << m_pos << ", " << m_chunkToBeRead << endl;
+        // The chunk size line is incomplete. Continue after the next read.
         m_csResponse = m_csResponse.substr(m_pos);
-        //cerr << "S1: end" << endl;
         m_pos = 0;
-        break;
-        //throw sid::exception("No benefit of doubt");
+        return;
       }
-      if ( ! sid::to_num(line, sid::num_base::hex, /*out*/ m_chunk.length) )
+      // Chunk extensions (";name=value") are ignored
+      size_t extPos = line.find(';');
+      if ( extPos != std::string::npos )
+        line.erase(extPos);
+      if ( ! sid::to_num(sid::trim(line), sid::num_base::hex, /*out*/ m_chunk.length) || m_chunk.length < 0 )
         throw sid::exception("Expecting chunk length. Encountered " + line.substr(0, line.length() > 10? 10:line.length()));
       m_chunkToBeRead = m_chunk.length;
       if ( m_response_callback && ! m_response_callback->is_valid(m_conn, m_chunk, _response, true) )
@@ -425,69 +497,80 @@ void response_handler::parse_data_chunked(/*in/out*/ response& _response)
         if ( m_response_callback && ! m_response_callback->is_valid(m_conn, m_chunk, _response, false) )
           m_forceStop = true; // Force stop
         m_chunk.clear();
-        m_endOfData = true; // END OF DATA
-        break;
+        m_inTrailers = true;
+        parse_trailers(_response);
+        return;
       }
-      //cerr << "New chunklength: " << m_chunkToBeRead << endl;
-      // cerr << "********* Length: " << m_csResponse.length() << ", m_pos: " << m_pos << ", m_chunkToBeRead: " << m_chunkToBeRead << " 0x" << line << endl;
     }
-    //cerr << "m_csResponse: " << m_csResponse.length() << ", m_chunkToBeRead: " << m_chunkToBeRead << ", m_pos: " << m_pos << endl;
-    if ( (m_csResponse.length()-m_pos) < (size_t) m_chunkToBeRead )
-    {
-      size_t copyLen = m_csResponse.length() - m_pos;
-      //_response.content.append(m_csResponse, m_pos, copyLen);
-      m_chunk.data.append(m_csResponse, m_pos, copyLen);
-      m_chunkToBeRead -= copyLen;
-      // cerr << "********* Body Length-1: " << _response.content.length() << ", Response-Length: " << m_csResponse.length() << ", m_pos: " << m_pos << endl;
-      m_csResponse.clear(); m_pos = 0;
+
+    size_t copyLen = std::min<size_t>(m_csResponse.length() - m_pos, m_chunkToBeRead);
+    m_chunk.data.append(m_csResponse, m_pos, copyLen);
+    m_pos += copyLen;
+    m_chunkToBeRead -= copyLen;
+    if ( m_chunkToBeRead > 0 )
       break;
-    }
-    else
-    {
-      size_t balanceLen = m_csResponse.length() - m_pos - m_chunkToBeRead;
-      //_response.content.append(m_csResponse, m_pos, m_chunkToBeRead);
-      m_chunk.data.append(m_csResponse, m_pos, m_chunkToBeRead);
-      if ( balanceLen <= 2 )
-      {
-        //cerr << "S2: begin: " << m_csResponse.length() << ", " << balanceLen << ", " << m_chunk.data.length() << endl;
-        //cerr << m_csResponse << endl;
-        m_csResponse.clear();
-        /*
-          if ( balanceLen == 0 )
-          {
-          m_csResponse.clear();
-          //m_chunkToBeRead = 0;
-          //m_pos = 0;
-          }
-          else
-          {
-          m_csResponse = m_csResponse.substr(m_csResponse.length()-balanceLen);
-          }
-        */
-        m_chunkToBeRead = -balanceLen;
-        m_pos = 2-balanceLen;
-        //cerr << "S2: end: m_csResponse: " << m_csResponse.length() << ", m_chunkToBeRead: " << m_chunkToBeRead << ", m_pos: " << m_pos << endl;
-        continueLoop = false;
-      }
-      else
-      {
-        m_pos += (m_chunkToBeRead + 2);
-        m_chunkToBeRead = 0;//m_csResponse.length() - m_pos;
-        //cerr << "S3:: " << m_csResponse.length() << ", " << m_pos << endl;
-      }
-      // cerr << "********* Body Length-2: " << _response.content.length() << ", Response-Length: " << m_csResponse.length() << ", m_pos: " << m_pos << endl;
-    }
-    
-    if ( m_chunkToBeRead <= 0 )
+
+    append_data(m_chunk.data, 0, m_chunk.data.length(), _response);
+    if ( m_response_callback && ! m_response_callback->is_valid(m_conn, m_chunk, _response, false) )
+      m_forceStop = true; // Force stop
+    m_chunk.clear();
+    m_chunkCrlf = 2;
+  }
+
+  // Everything received so far has been consumed
+  if ( ! m_endOfData && m_pos >= m_csResponse.length() )
+  {
+    m_csResponse.clear();
+    m_pos = 0;
+  }
+}
+
+void response_handler::parse_trailers(/*in/out*/ response& _response)
+{
+  // The last chunk is followed by optional trailer fields and an empty line. The fields are added to the headers.
+  std::string line;
+  while ( http::get_line(m_csResponse, m_pos, line) )
+  {
+    if ( line.empty() )
     {
-      _response.content.append(m_chunk.data);
-      if ( m_response_callback && ! m_response_callback->is_valid(m_conn, m_chunk, _response, false) )
-        m_forceStop = true; // Force stop
-      m_chunk.clear();
+      m_inTrailers = false;
+      m_endOfData = true; // END OF DATA
+      return;
     }
+    _response.headers.add(line);
   }
+  m_csResponse = m_csResponse.substr(m_pos);
+  m_pos = 0;
+}
 
-  return;
+std::string response_handler::take_unparsed()
+{
+  std::string unparsed;
+  if ( m_endOfData && m_pos < m_csResponse.length() )
+    unparsed = m_csResponse.substr(m_pos);
+  m_csResponse.clear();
+  m_pos = 0;
+  return unparsed;
+}
+
+void response_handler::append_data(const std::string& _data, size_t _pos, size_t _len, /*in/out*/ response& _response)
+{
+  m_rawLength += _len;
+  const char* data = _data.data() + _pos;
+  if ( ! m_decoder.empty() )
+  {
+    // Decode one piece at a time so that the encoded content is never held as a whole
+    m_decoded.clear();
+    m_decoder.decode(data, _len, /*out*/ m_decoded);
+    data = m_decoded.data();
+    _len = m_decoded.length();
+  }
+  if ( _len == 0 )
+    return;
+  if ( ! m_useSink )
+    _response.content.append(data, _len);
+  else if ( ! _response.sink(_response, data, _len) )
+    m_forceStop = true; // Force stop
 }
 
 void response_handler::parse(const char* _buffer, int _nread, const method& _requestMethod, /*in/out*/ response& _response)
@@ -498,6 +581,9 @@ void response_handler::parse(const char* _buffer, int _nread, const method& _req
   {
     //cerr << "New data received: " << nread << endl;
     //cerr.write(buffer, nread);
+    request_timing* timing = m_conn.empty()? nullptr : m_conn->timing();
+    if ( timing && _nread > 0 )
+      timing->on_first_byte();
     m_csResponse.append(_buffer, _nread);
 
     // Parse status from the first line
@@ -507,6 +593,9 @@ void response_handler::parse(const char* _buffer, int _nread, const method& _req
     // From now on it's only HTTP headers
     if ( ! m_endOfHeaders && ! parse_headers(_requestMethod, _response) )
       return;
+    // Nothing is known about the payload until all the headers are received
+    if ( ! m_endOfHeaders )
+      return;
 
     if ( m_encoding == http::transfer_encoding::chunked )
     {
@@ -516,25 +605,24 @@ void response_handler::parse(const char* _buffer, int _nread, const method& _req
     {
       parse_data_normal(_response);
     }
-    else if ( m_endOfStatus && m_endOfHeaders )
+    else if ( m_hasContentLength || static_cast<int>(_response.status.code()) < 200
+              || _response.status.code() == http::status_code::NoContent
+              || _response.status.code() == http::status_code::NotModified )
+    {
+      // An explicit zero length (or a status that never has a body) ends the response, even if the connection is closed after it
+      m_endOfData = true; // END OF DATA
+    }
+    else
     {
       size_t copyLen = m_csResponse.length() - m_pos;
-      _response.content.append(m_csResponse, m_pos, copyLen);
+      append_data(m_csResponse, m_pos, copyLen, _response);
 
-      bool isFound;
-      http::header_connection header_conn = _response.headers.connection(&isFound);
-      if ( isFound && header_conn == http::header_connection::close )
-      {
-        m_csResponse.clear(); m_pos = 0;
-      }
-      else
-        m_endOfData = true; // END OF DATA
+      // Without Content-Length and chunked encoding, the data ends when the peer closes the connection (RFC 9112 section 6.3)
+      m_csResponse.clear(); m_pos = 0;
     }
 
     if ( m_endOfData )
-    {
-      if ( m_response_callback ) m_response_callback->is_valid(m_conn, _response);
-    }
+      end_of_data(_response);
   }
   catch ( const sid::exception& ) { /* Rethrow string exception */ throw; }
   catch (...)
@@ -543,6 +631,91 @@ void response_handler::parse(const char* _buffer, int _nread, const method& _req
   }
 }
 
+void response_handler::end_of_input(/*in/out*/ response& _response)
+{
+  // Without Content-Length and chunked encoding, the data ends when the peer closes the connection
+  if ( m_endOfHeaders && ! m_endOfData && ! m_forceStop
+       && m_encoding != http::transfer_encoding::chunked && m_contentLength == 0 )
+  {
+    m_endOfData = true; // END OF DATA
+    end_of_data(_response);
+  }
+}
+
+void response_handler::end_of_data(/*in/out*/ response& _response)
+{
+  if ( ! m_decoder.empty() )
+  {
+    // Make sure the encoded stream was not truncated
+    if ( m_rawLength > 0 )
+      m_decoder.finish();
+    m_decoder.update_headers(_response.headers);
+  }
+  if ( ! m_conn.empty() && m_conn->timing() )
+    m_conn->timing()->done = request_timing::clock::now();
+  if ( m_response_callback ) m_response_callback->is_valid(m_conn, _response);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// Implementation of response_parser class
+//
+//////////////////////////////////////////////////////////////////////////////////////
+response_parser::response_parser(connection_ptr _conn, const method& _requestMethod, bool _decodeContent/* = true*/)
+  : m_handler(new response_handler(_conn, _decodeContent)), m_requestMethod(_requestMethod)
+{
+}
+
+response_parser::~response_parser()
+{
+}
+
+bool response_parser::parse(const char* _buffer, size_t _len, /*in/out*/ response& _response)
+{
+  if ( _len > 0 )
+    m_handler->parse(_buffer, static_cast<int>(_len), m_requestMethod, /*in/out*/ _response);
+  if ( m_handler->is_force_stop() )
+    throw sid::exception("Application was force stopped");
+  return m_handler->continue_parsing();
+}
+
+void response_parser::end_of_input(/*in/out*/ response& _response)
+{
+  m_handler->end_of_input(/*in/out*/ _response);
+  if ( !m_handler->is_end_of_status() )
+    throw sid::exception("Did not receive response. The connection was possibly terminated.");
+  else if ( !m_handler->is_end_of_headers() )
+    throw sid::exception("Did not receive headers. The connection was possibly terminated.");
+  else if ( !m_handler->is_end_of_data() )
+    throw sid::exception("Did not receive data fully. The connection was possibly terminated.");
+}
+
+bool response_parser::is_complete() const
+{
+  return m_handler->is_end_of_data();
+}
+
+std::string response_parser::take_unparsed()
+{
+  return m_handler->take_unparsed();
+}
+
+/*static*/
+bool response_parser::keep_alive(const response& _response)
+{
+  bool isFound = false;
+  http::header_connection headerConn = _response.headers.connection(&isFound);
+  if ( isFound )
+    return ( headerConn == http::header_connection::keep_alive );
+  // A payload without Content-Length and chunked encoding is delimited by closing the connection
+  const int code = static_cast<int>(_response.status.code());
+  if ( code >= 200 && code != 204 && code != 304 && ! _response.headers.exists("Content-Length")
+       && _response.headers.transfer_encoding() != http::transfer_encoding::chunked )
+    return false;
+  // HTTP/1.1 connections are persistent unless the server says otherwise
+  return ( _response.version == http::version_id::v11 );
+}
+
 //////////////////////////////////////////////////////////////////////////
 /*static*/ response_callback* response_callback::get_singleton()
 {
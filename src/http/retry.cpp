@@ -0,0 +1,522 @@
+//////////////////////////////////////////////////////
+//
+// retry.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/http.hpp"
+#include "http/retry.hpp"
+#include "common/convert.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace sid;
+using namespace sid::http;
+
+namespace sid {
+namespace http {
+
+/**
+ * @struct attempt_result
+ * @brief Outcome of one attempt of a request
+ */
+struct attempt_result
+{
+  bool           ok;         //! A response was received
+  bool           connected;  //! The connection was established, so the server could have acted on the request
+  bool           retryable;  //! The failure was transient (connection::is_retryable())
+  http::response response;   //! Response, if ok
+  sid::exception error;      //! Reason for the failure, if not ok
+  uint64_t       elapsed_us; //! Time taken by the attempt
+
+  attempt_result() : ok(false), connected(false), retryable(false), elapsed_us(0) {}
+};
+
+/**
+ * @class hedge_race
+ * @brief Attempts of a request that are sent in parallel. The first response wins.
+ */
+class hedge_race
+{
+public:
+  hedge_race(const http::url& _url, const http::request& _request, size_t _maxAttempts) :
+    url(_url), request(_request), results(_maxAttempts), launched(0), pending(0), winner(-1), lastDone(-1) {}
+
+public:
+  const http::url             url;      //! Server of the request
+  const http::request         request;  //! Request sent by all the attempts
+  std::vector<attempt_result> results;  //! Result of each attempt
+  size_t                      launched; //! Attempts started
+  std::atomic<size_t>         pending;  //! Attempts not yet completed (read without the lock when joining the threads)
+  int                         winner;   //! First attempt that received a response (-1 if none yet)
+  int                         lastDone; //! Attempt that completed last
+  std::mutex                  lock;     //! Protects the members above
+  std::condition_variable     cv;       //! Signalled when an attempt completes
+};
+
+/**
+ * @class retry_state
+ * @brief State of a retry_client that is shared with the attempts running in the background. This is an internal class.
+ */
+class retry_state
+{
+public:
+  retry_state() : tokens(-1) {}
+
+  //! Take an idle connection to the server from the pool, or open a new one
+  connection_ptr acquire(const retry_policy& _policy, const http::url& _url);
+  //! Return the connection to the pool if it can be reused, close it otherwise
+  void release(const retry_policy& _policy, const http::url& _url, connection_ptr _conn, bool _keepAlive);
+
+  //! Make one attempt of the request
+  void attempt(const retry_policy& _policy, const http::url& _url, const http::request& _request, attempt_result& _result);
+  //! Make the attempt, hedging it if it is slower than the latencies observed so far
+  void hedged_attempt(const retry_policy& _policy, const http::url& _url, const http::request& _request, attempt_result& _result);
+
+  //! Account for a new request. Its share of the budget is deposited and finished background attempts are joined.
+  void begin(const retry_policy& _policy);
+  //! Take a token from the retry budget. Returns false if the budget is exhausted.
+  bool withdraw();
+  //! Join the background attempts (all of them, or the ones of completed races)
+  void join(bool _all);
+
+public:
+  struct background
+  {
+    std::shared_ptr<hedge_race> race;
+    std::thread                 thread;
+  };
+
+  std::mutex                                        lock;     //! Protects the members below
+  std::map<std::string, std::vector<connection_ptr>> idle;    //! Idle connections keyed by server
+  double                                            tokens;   //! Retry budget (-1 until the first request)
+  sid::histogram                                    latency;  //! Latencies of the successful attempts in micro-seconds
+  retry_stats                                       stats;    //! Counters
+  std::list<background>                             threads;  //! Attempts running (or completed) in the background
+};
+
+} // namespace http
+} // namespace sid
+
+//! Key of the pool of connections to the server
+static std::string pool_key(const http::url& _url)
+{
+  return std::string(( _url.type == connection_type::https )? "https://" : "http://") + _url.server + ":" + sid::to_str(_url.port);
+}
+
+//! Wait given by the Retry-After header of the response in milli-seconds (RFC 9110 section 10.2.3)
+static bool retry_after_ms(const http::response& _response, uint64_t& _delayMs)
+{
+  std::string value = _response.headers.get("Retry-After");
+  if ( value.empty() )
+    return false;
+  uint64_t secs = 0;
+  if ( sid::to_num(value, secs) )
+  {
+    _delayMs = secs * 1000;
+    return true;
+  }
+  time_t when = 0;
+  if ( ! http::date_from_str(value, when) )
+    return false;
+  time_t now = ::time(nullptr);
+  _delayMs = ( when > now )? static_cast<uint64_t>(when - now) * 1000 : 0;
+  return true;
+}
+
+//! Random wait up to the backoff ceiling of the retry ("full jitter"), so that clients that failed together do not retry together
+static uint64_t backoff_ms(const retry_policy& _policy, uint32_t _retry)
+{
+  static thread_local std::mt19937_64 rng(std::random_device{}());
+  uint64_t ceiling = _policy.base_delay_ms;
+  for ( uint32_t i = 1; i < _retry && ceiling < _policy.max_delay_ms; i++ )
+    ceiling *= 2;
+  if ( ceiling > _policy.max_delay_ms )
+    ceiling = _policy.max_delay_ms;
+  return std::uniform_int_distribution<uint64_t>(0, ceiling)(rng);
+}
+
+connection_ptr retry_state::acquire(const retry_policy& _policy, const http::url& _url)
+{
+  {
+    std::unique_lock<std::mutex> lk(lock);
+    std::vector<connection_ptr>& conns = idle[pool_key(_url)];
+    while ( ! conns.empty() )
+    {
+      connection_ptr conn = conns.back();
+      conns.pop_back();
+      if ( conn->is_open() )
+        return conn;
+    }
+  }
+  connection_ptr conn = ( _url.type == connection_type::https )?
+    http::connection::create(_policy.certificate, _policy.family) :
+    http::connection::create(_url.type, _policy.family);
+  if ( ! conn->open(_url.server, _url.port) )
+    throw sid::exception(conn->error());
+  conn->set_blocking(true, _policy.timeout);
+  return conn;
+}
+
+void retry_state::release(const retry_policy& _policy, const http::url& _url, connection_ptr _conn, bool _keepAlive)
+{
+  if ( _keepAlive && _conn->is_open() )
+  {
+    std::unique_lock<std::mutex> lk(lock);
+    std::vector<connection_ptr>& conns = idle[pool_key(_url)];
+    if ( conns.size() < _policy.max_idle )
+    {
+      conns.push_back(_conn);
+      return;
+    }
+  }
+  _conn->close();
+}
+
+void retry_state::attempt(const retry_policy& _policy, const http::url& _url, const http::request& _request, attempt_result& _result)
+{
+  auto start = std::chrono::steady_clock::now();
+  http::client client;
+  try
+  {
+    client.conn = acquire(_policy, _url);
+  }
+  catch ( const sid::exception& e )
+  {
+    _result.error = e;
+    return;
+  }
+
+  _result.connected = true;
+  client.request = _request;
+  // client::run() fails for error statuses as well. A failure without a status is a failure of the exchange.
+  if ( ! client.run() && client.exception().code() < 100 )
+  {
+    _result.error = client.exception();
+    _result.retryable = client.conn->is_retryable();
+    client.conn->close();
+    return;
+  }
+
+  _result.elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  _result.ok = true;
+  release(_policy, _url, client.conn, response_parser::keep_alive(client.response));
+  _result.response = std::move(client.response);
+
+  std::unique_lock<std::mutex> lk(lock);
+  latency.record(_result.elapsed_us);
+}
+
+void retry_state::hedged_attempt(const retry_policy& _policy, const http::url& _url, const http::request& _request, attempt_result& _result)
+{
+  uint64_t delayUs = 0;
+  {
+    std::unique_lock<std::mutex> lk(lock);
+    if ( latency.count() < _policy.hedge_min_samples )
+    {
+      // Too few latencies to know what is slow
+      lk.unlock();
+      attempt(_policy, _url, _request, _result);
+      return;
+    }
+    delayUs = std::max<uint64_t>(latency.percentile(_policy.hedge_percentile), _policy.hedge_min_delay_ms * 1000ULL);
+  }
+
+  std::shared_ptr<hedge_race> race = std::make_shared<hedge_race>(_url, _request, 1 + _policy.max_hedges);
+  std::unique_lock<std::mutex> rl(race->lock);
+
+  auto launch = [&]()
+    {
+      int index = static_cast<int>(race->launched++);
+      race->pending++;
+      background bg;
+      bg.race = race;
+      bg.thread = std::thread([this, &_policy, race, index]()
+        {
+          attempt_result result;
+          this->attempt(_policy, race->url, race->request, result);
+          std::unique_lock<std::mutex> lk(race->lock);
+          if ( result.ok && race->winner < 0 )
+            race->winner = index;
+          race->lastDone = index;
+          race->results[index] = std::move(result);
+          race->pending--;
+          race->cv.notify_all();
+        });
+      std::unique_lock<std::mutex> lk(lock);
+      threads.push_back(std::move(bg));
+    };
+  auto isDone = [&]() { return race->winner >= 0 || race->pending == 0; };
+
+  launch();
+  while ( ! isDone() )
+  {
+    if ( race->launched == race->results.size() )
+    {
+      race->cv.wait(rl, isDone);
+      break;
+    }
+    if ( race->cv.wait_for(rl, std::chrono::microseconds(delayUs), isDone) )
+      break;
+    // Slower than the percentile. Send a duplicate on another connection, if the budget allows it.
+    if ( ! withdraw() )
+    {
+      std::unique_lock<std::mutex> lk(lock);
+      stats.budget_exhausted++;
+      race->results.resize(race->launched);
+      continue;
+    }
+    {
+      std::unique_lock<std::mutex> lk(lock);
+      stats.hedges++;
+    }
+    launch();
+  }
+
+  int index = ( race->winner >= 0 )? race->winner : race->lastDone;
+  _result = std::move(race->results[index]);
+  if ( race->winner > 0 )
+  {
+    std::unique_lock<std::mutex> lk(lock);
+    stats.hedge_wins++;
+  }
+}
+
+void retry_state::begin(const retry_policy& _policy)
+{
+  join(false);
+  std::unique_lock<std::mutex> lk(lock);
+  stats.requests++;
+  tokens = ( tokens < 0 )? _policy.budget_tokens : std::min(tokens + _policy.budget_ratio, _policy.budget_tokens);
+}
+
+bool retry_state::withdraw()
+{
+  std::unique_lock<std::mutex> lk(lock);
+  if ( tokens < 1 )
+    return false;
+  tokens -= 1;
+  return true;
+}
+
+void retry_state::join(bool _all)
+{
+  std::list<background> done;
+  {
+    std::unique_lock<std::mutex> lk(lock);
+    for ( auto it = threads.begin(); it != threads.end(); )
+    {
+      // The race lock is not taken here since it is held by hedged_attempt() when it takes this lock
+      if ( _all || it->race->pending == 0 )
+        done.splice(done.end(), threads, it++);
+      else
+        ++it;
+    }
+  }
+  // Join outside the lock as the attempts need it to complete
+  for ( background& bg : done )
+    bg.thread.join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// retry_policy
+//
+retry_policy::retry_policy()
+{
+  clear();
+}
+
+void retry_policy::clear()
+{
+  max_attempts = 3;
+  base_delay_ms = 100;
+  max_delay_ms = 5000;
+  max_retry_after_secs = 30;
+  budget_ratio = 0.1;
+  budget_tokens = 10;
+  retry_non_idempotent = false;
+  retry_status = { status_code::TooManyRequests, status_code::BadGateway, status_code::ServiceUnavailable, status_code::GatewayTimeout };
+  hedge = false;
+  hedge_percentile = 95;
+  hedge_min_samples = 20;
+  hedge_min_delay_ms = 1;
+  max_hedges = 1;
+  max_idle = 8;
+  timeout = DEFAULT_IO_TIMEOUT_SECS;
+  family = connection_family::none;
+  certificate = ssl::certificate();
+}
+
+std::string retry_stats::to_str() const
+{
+  return "requests=" + sid::to_str(requests) + " attempts=" + sid::to_str(attempts) + " retries=" + sid::to_str(retries)
+    + " hedges=" + sid::to_str(hedges) + " hedge_wins=" + sid::to_str(hedge_wins)
+    + " budget_exhausted=" + sid::to_str(budget_exhausted) + " failures=" + sid::to_str(failures);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// retry_client
+//
+retry_client::retry_client() : m_state(std::make_shared<retry_state>())
+{
+}
+
+retry_client::~retry_client()
+{
+  m_state->join(true);
+}
+
+retry_stats retry_client::stats() const
+{
+  std::unique_lock<std::mutex> lk(m_state->lock);
+  return m_state->stats;
+}
+
+sid::histogram retry_client::latency() const
+{
+  std::unique_lock<std::mutex> lk(m_state->lock);
+  return m_state->latency;
+}
+
+bool retry_client::run(const std::string& _url, const http::request& _request, http::response& _response)
+{
+  try
+  {
+    http::url url;
+    if ( ! url.set(_url) )
+      throw sid::exception("Invalid URL: " + _url);
+
+    http::request request = _request;
+    request.uri = url.resource;
+    request.headers("Host", url.server, http::header_action::skip);
+
+    const bool isIdempotent = request.method.is_idempotent();
+    const bool canRetry = isIdempotent || policy.retry_non_idempotent;
+    // A streamed body cannot be read by two attempts at the same time
+    const bool canHedge = policy.hedge && isIdempotent && request.body.empty();
+
+    m_state->begin(policy);
+    attempt_result result;
+    for ( uint32_t attemptNum = 1; ; attemptNum++ )
+    {
+      {
+        std::unique_lock<std::mutex> lk(m_state->lock);
+        m_state->stats.attempts++;
+        if ( attemptNum > 1 ) m_state->stats.retries++;
+      }
+      result = attempt_result();
+      if ( canHedge )
+        m_state->hedged_attempt(policy, url, request, result);
+      else
+        m_state->attempt(policy, url, request, result);
+
+      bool isRetry = false;
+      bool hasDelay = false;
+      uint64_t delayMs = 0;
+      if ( result.ok )
+      {
+        status_code code = result.response.status.code();
+        // The server has not acted on a request rejected with 429
+        if ( policy.retry_status.count(code) != 0 && (canRetry || code == status_code::TooManyRequests) )
+        {
+          isRetry = true;
+          if ( retry_after_ms(result.response, delayMs) )
+          {
+            hasDelay = true;
+            if ( delayMs > policy.max_retry_after_secs * 1000ULL )
+              isRetry = false;
+          }
+        }
+      }
+      else
+      {
+        // A request that did not reach the server can always be sent again
+        isRetry = ( ! result.connected || (result.retryable && canRetry) );
+      }
+
+      if ( ! isRetry || attemptNum >= policy.max_attempts )
+        break;
+      if ( ! m_state->withdraw() )
+      {
+        std::unique_lock<std::mutex> lk(m_state->lock);
+        m_state->stats.budget_exhausted++;
+        break;
+      }
+      if ( ! hasDelay )
+        delayMs = backoff_ms(policy, attemptNum);
+      if ( delayMs > 0 )
+        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+    }
+
+    if ( ! result.ok )
+    {
+      {
+        std::unique_lock<std::mutex> lk(m_state->lock);
+        m_state->stats.failures++;
+      }
+      throw result.error;
+    }
+    _response = std::move(result.response);
+    // Same as client::run(), a response that is not 2xx is a failure
+    int code = static_cast<int>(_response.status.code());
+    if ( code < 200 || code >= 300 )
+    {
+      {
+        std::unique_lock<std::mutex> lk(m_state->lock);
+        m_state->stats.failures++;
+      }
+      throw sid::exception(code, "[" + sid::to_str(code) + "] " + _response.status.message());
+    }
+  }
+  catch ( const sid::exception& e )
+  {
+    std::unique_lock<std::mutex> lk(m_state->lock);
+    m_exception = e;
+    return false;
+  }
+  return true;
+}
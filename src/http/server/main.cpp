@@ -5,9 +5,12 @@
 #include <signal.h>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <memory>
 #include <http/http.hpp>
 #include "common/uuid.hpp"
 #include "common/optional.hpp"
+#include "s3_stub.h"
 
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -47,15 +50,19 @@ struct Global
   std::string           scriptName;
   bool                  exit;
   std::atomic<uint64_t> totalProcessed;
+  std::mutex            mapLock;   //! Serializes access to processMap and connectionMap from the process threads
   ProcessThreadMap      processMap;
   ConnectionMap         connectionMap;
+  std::unique_ptr<http::response_compressor> compressor; //! Set if the responses need to be compressed
+  bool                  h2c;       //! Serve HTTP/2 over plain connections (prior knowledge)
+  std::unique_ptr<s3_stub> s3;     //! Set if the server acts as a local S3-compatible object store
 
   http::connection_type type() const { return m_type; }
   void set_type(http::connection_type _type) { m_type = _type; }
   uint16_t port() const { return m_port > 0? m_port : m_type == http::connection_type::http? 5080 : 5443; }
   void set_port(uint16_t _port) { m_port = _port; }
 
-  Global() : scriptName(), totalProcessed(0), processMap(), connectionMap(), m_type(http::connection_type::http), m_port(0) {}
+  Global() : scriptName(), totalProcessed(0), mapLock(), processMap(), connectionMap(), compressor(), h2c(false), s3(), m_type(http::connection_type::http), m_port(0) {}
 
 private:
   http::connection_type m_type;
@@ -163,30 +170,15 @@ void input_thread()
   global.exit = true;
 }
 
-void process_client(http::connection_ptr _conn, const uint64_t _currentProcessId)
+void process_request(const http::request& request, http::response& response, const uint64_t _currentProcessId)
 {
-  try
+  bool sleepBlock = false;
+  std::string sleepStr;
+  if ( request.headers.exists("x-sid-server-sleep", &sleepStr) || (sleepBlock = request.headers.exists("x-sid-server-sleep-block", &sleepStr)) )
   {
-    // Remove the connection object from the connection map as the first step
-    global.connectionMap.erase(global.connectionMap.find(_currentProcessId));
-
-  if ( global.exit )
-      throw sid::exception("Exiting process " + sid::to_str(_currentProcessId) + " before reading request");
-
-    http::request request;
-    if ( ! request.recv(_conn) )
-      throw sid::exception("Failed to receive request: " + request.error);
-
-    cout << "============================================" << endl;
-    cout << request.to_str() << endl << endl;
-
-    bool sleepBlock = false;
-    std::string sleepStr;
-    if ( request.headers.exists("x-sid-server-sleep", &sleepStr) || (sleepBlock = request.headers.exists("x-sid-server-sleep-block", &sleepStr)) )
+    uint64_t sleepTime = 0;
+    if ( sid::to_num(sleepStr, /*out*/ sleepTime) && sleepTime > 0 )
     {
-      uint64_t sleepTime = 0;
-      if ( sid::to_num(sleepStr, /*out*/ sleepTime) && sleepTime > 0 )
-      {
 	// Restrict sleep time to a maximum of 1 minute
 	if ( sleepTime > 60 )
 	  sleepTime = 60;
@@ -207,38 +199,129 @@ void process_client(http::connection_ptr _conn, const uint64_t _currentProcessId
 	// Sleep for a few seconds
 	cout << "Sleeping for " << sleepTime << " second(s)" << endl;
 	sleep_for_secs(sleepTime, [&](){ return sleepBlock? false : global.exit; });
-      }
     }
+  }
 
-    if ( request.method == http::method_type::post )
+  if ( request.method == http::method_type::post )
+  {
+    if ( request.content().to_str() == "exit" )
     {
-      if ( request.content().to_str() == "exit" )
-      {
 	global.exit = true;
 	throw sid::exception("Exit command received from the client");
-      }
     }
+  }
 
-    if ( global.exit )
-      throw sid::exception("Exiting process " + sid::to_str(_currentProcessId) + " before sending response");
+  if ( global.exit )
+    throw sid::exception("Exiting process " + sid::to_str(_currentProcessId) + " before sending response");
 
-    if ( request.headers.exists("x-sid-server-kill") )
-      kill(getpid(), SIGKILL);
+  if ( request.headers.exists("x-sid-server-kill") )
+    kill(getpid(), SIGKILL);
 
-    // Construct the response object
-    http::response response;
-    response.status = http::status_code::OK;
-    response.version = http::version_id::v11;
-    response.headers("Date", http::date_to_str(::time(nullptr)));
-    response.headers("Content-Type", "text/xml");
-    response.headers.add("X-Server", "Anand's Server");
+  // Construct the response object
+  response.clear();
+  response.status = http::status_code::OK;
+  response.version = http::version_id::v11;
+  response.headers("Date", http::date_to_str(::time(nullptr)));
+  if ( global.s3 )
+  {
+    global.s3->handle(request, response);
+    if ( ! response.headers.exists("Content-Length") )
+      response.headers("Content-Length", sid::to_str(response.content.length()));
+    return;
+  }
+  response.headers("Content-Type", "text/xml");
+  response.headers.add("X-Server", "Anand's Server");
+  std::string contentSizeStr;
+  uint64_t contentSize = 0;
+  if ( request.headers.exists("x-sid-server-content-size", &contentSizeStr) && sid::to_num(contentSizeStr, /*out*/ contentSize) )
+  {
+    // Pad the response with repeated elements to get the requested size (restricted to 64 MB)
+    if ( contentSize > 64*1024*1024 ) contentSize = 64*1024*1024;
+    std::string data = "<Process>";
+    const std::string item = "<ProcessCount>" + sid::to_str(_currentProcessId) + "</ProcessCount>";
+    while ( data.length() + item.length() + 10 <= contentSize )
+      data += item;
+    data += "</Process>";
+    response.content.set_data(data);
+  }
+  else
     response.content.set_data("<ProcessCount>" + sid::to_str(_currentProcessId) + "</ProcessCount>");
-    response.headers("Content-Length", sid::to_str(response.content.length()));
+  response.headers("Content-Length", sid::to_str(response.content.length()));
+
+  // Compress the payload if the client accepts it
+  if ( global.compressor )
+    global.compressor->compress(request, response);
+}
+
+void process_client(http::connection_ptr _conn, const uint64_t _currentProcessId)
+{
+  try
+  {
+    // Remove the connection object from the connection map as the first step
+    {
+      std::lock_guard<std::mutex> lock(global.mapLock);
+      global.connectionMap.erase(_currentProcessId);
+    }
+
+  if ( global.exit )
+      throw sid::exception("Exiting process " + sid::to_str(_currentProcessId) + " before reading request");
 
-    // Send the response
-    if ( ! response.send(_conn) )
-      throw sid::exception(response.error);
-    cout << response.content.to_str() << endl;
+    if ( global.h2c )
+    {
+      // HTTP/2 with prior knowledge. All the streams of the connection are served here.
+      http::http2_session session(_conn, http::http2_session::role::server);
+      http::FNHttp2Handler handler = [&](const http::request& request, http::response& response)
+        {
+          cout << "============================================" << endl;
+          if ( request.content().length() > 1024 )
+            cout << request.to_str(false) << "<" << request.content().length() << " bytes of content>" << endl << endl;
+          else
+            cout << request.to_str() << endl << endl;
+          process_request(request, response, _currentProcessId);
+        };
+      if ( ! session.serve(handler) )
+        throw sid::exception("HTTP/2 session failed: " + session.error());
+    }
+    else
+    {
+      // Requests are served until the client closes the connection or asks for it to be closed
+      for ( bool keepAlive = true, isFirst = true; keepAlive && ! global.exit; isFirst = false )
+      {
+        http::request request;
+        if ( ! request.recv(_conn) || request.method.to_str().empty() )
+        {
+          // The client closing a kept-alive connection between requests is not an error
+          if ( ! isFirst ) break;
+          throw sid::exception("Failed to receive request: " + request.error);
+        }
+
+        cout << "============================================" << endl;
+        if ( request.content().length() > 1024 )
+          cout << request.to_str(false) << "<" << request.content().length() << " bytes of content>" << endl << endl;
+        else
+          cout << request.to_str() << endl << endl;
+
+        http::response response;
+        process_request(request, response, _currentProcessId);
+        // HTTP/1.1 connections are persistent unless the client says otherwise, HTTP/1.0 ones only if it asks
+        bool isFound = false;
+        const http::header_connection headerConn = request.headers.connection(&isFound);
+        keepAlive = isFound? ( headerConn == http::header_connection::keep_alive ) : ( request.version == http::version_id::v11 );
+        keepAlive = keepAlive && http::response_parser::keep_alive(response);
+        if ( ! keepAlive )
+          response.headers("Connection", "close");
+        else if ( request.version != http::version_id::v11 )
+          response.headers("Connection", "keep-alive");
+
+        // Send the response
+        if ( ! response.send(_conn) )
+          throw sid::exception(response.error);
+        if ( response.headers.exists("Content-Encoding") || response.content.length() > 1024 )
+          cout << "<" << response.content.length() << " bytes of " << response.headers.get("Content-Encoding") << " content>" << endl;
+        else
+          cout << response.content.to_str() << endl;
+      }
+    }
   }
   catch (const sid::exception& e)
   {
@@ -248,7 +331,8 @@ void process_client(http::connection_ptr _conn, const uint64_t _currentProcessId
   {
     cerr << "process_callback: An unhandled exception occurred" << endl;
   }
-  global.processMap.erase(global.processMap.find(_currentProcessId));
+  std::lock_guard<std::mutex> lock(global.mapLock);
+  global.processMap.erase(_currentProcessId);
 }
 
 void server_thread()
@@ -260,6 +344,8 @@ void server_thread()
     http::FNProcessCallback process_callback = [](http::connection_ptr conn)
       {
 	const uint64_t currentProcessId = ++global.totalProcessed;
+	// The process thread removes its entries, so they are added before it can run
+	std::lock_guard<std::mutex> lock(global.mapLock);
 	try
 	{
 	  // Add the connection object to the connection map
@@ -272,7 +358,7 @@ void server_thread()
 	catch (...)
 	{
 	  // Remove the connection object from the connection map
-	  global.connectionMap.erase(global.connectionMap.find(currentProcessId));
+	  global.connectionMap.erase(currentProcessId);
 	}
       };
 
@@ -307,11 +393,12 @@ void server_thread()
     cerr << __func__ << ": An unhandled exception occurred" << endl;
   }
   global.exit = true;
-  if ( ! global.processMap.empty() )
+  auto pending_processes = []() { std::lock_guard<std::mutex> lock(global.mapLock); return global.processMap.size(); };
+  if ( pending_processes() != 0 )
   {
     // Wait for completion of all the detached process threads
-    cout << "Process threads waiting to be completed: " << global.processMap.size() << endl;
-    while ( !global.processMap.empty() )
+    cout << "Process threads waiting to be completed: " << pending_processes() << endl;
+    while ( pending_processes() != 0 )
       usleep(10'000);
   }
   cout << __func__ << ": Exiting" << endl;
@@ -358,6 +445,8 @@ bool run_command(const std::string& cmdLine)
     }
     cout << "Waiting for " << (global.type() == http::connection_type::http? "HTTP" : "HTTPS") << " connections at port " << global.port() << endl;
     cout << "Total Processed: " << global.totalProcessed << endl;
+    if ( global.compressor )
+      cout << "Compression: " << global.compressor->stats().to_str() << endl;
   }
   return true;
 }
@@ -392,10 +481,25 @@ void parseCommandLine(const std::vector<std::string>& _args)
   {
     sid::optional<http::connection_type> type;
     sid::optional<uint16_t> port;
+    bool compress;
+    http::compression_config compression;
+    bool h2c;
+    bool s3;
     Cmd() { clear(); }
-    void clear() { type.clear(global.type()); port.clear(global.port()); }
+    void clear() { type.clear(global.type()); port.clear(global.port()); compress = false; compression = http::compression_config(); h2c = false; s3 = false; }
   } cmd;
 
+  auto get_size = [&](const Param& param)->uint64_t
+    {
+      uint64_t value = 0;
+      std::string errStr;
+      if ( !param.hasData )
+	throw sid::exception(param.key + " must have data");
+      if ( !sid::to_num(param.value, /*out*/ value, &errStr) )
+	throw sid::exception(param.key + " error: " + errStr);
+      return value;
+    };
+
   for ( size_t i = 0; i < _args.size(); i++ )
   {
     Param param;
@@ -414,7 +518,14 @@ void parseCommandLine(const std::vector<std::string>& _args)
     if ( param.key == "--help" )
     {
       cout << "Usage: " << endl;
-      cout << global.scriptName << " [--type=http|https] [--port=<port_number>]" << endl;
+      cout << global.scriptName << " [--type=http|https] [--port=<port_number>]" << endl
+	   << "    [--compress[=<encoding>,...]] [--compress-level=<level>]" << endl
+	   << "    [--compress-min-size=<bytes>] [--compress-cache=<bytes>] [--h2c] [--s3]" << endl
+	   << endl
+	   << "  --compress : Compress the responses as per Accept-Encoding of the request." << endl
+	   << "               Encodings are in the order of preference (gzip, deflate, br, zstd)" << endl
+	   << "  --h2c      : Speak HTTP/2 with prior knowledge on plain HTTP connections" << endl
+	   << "  --s3       : Act as an in-memory S3-compatible object store (objects, multipart uploads)" << endl;
       exit(0);
     }
     else if ( param.key == "--type" )
@@ -444,6 +555,33 @@ void parseCommandLine(const std::vector<std::string>& _args)
 	throw sid::exception(param.key + " cannot be 0");
       cmd.port = port;
     }
+    else if ( param.key == "--compress" )
+    {
+      cmd.compress = true;
+      if ( param.hasData )
+      {
+	std::vector<std::string> tokens;
+	cmd.compression.encodings.clear();
+	sid::split(/*out*/ tokens, param.value, ',', SPLIT_TRIM_SKIP_EMPTY);
+	for ( const std::string& token : tokens )
+	{
+	  http::content_encoding encoding;
+	  if ( ! http::get_content_encoding(token, /*out*/ encoding) || ! http::content_encoder::is_supported(encoding) )
+	    throw sid::exception(param.key + " has an unsupported encoding: " + token);
+	  cmd.compression.encodings.push_back(encoding);
+	}
+      }
+    }
+    else if ( param.key == "--compress-level" )
+      cmd.compression.level = static_cast<int>(get_size(param));
+    else if ( param.key == "--compress-min-size" )
+      cmd.compression.min_size = get_size(param);
+    else if ( param.key == "--compress-cache" )
+      cmd.compression.cache_size = get_size(param);
+    else if ( param.key == "--h2c" )
+      cmd.h2c = true;
+    else if ( param.key == "--s3" )
+      cmd.s3 = true;
     else
       throw sid::exception("Invalid command line parameter: " + param.key);
   } // end of for loop
@@ -453,4 +591,9 @@ void parseCommandLine(const std::vector<std::string>& _args)
     global.set_type(cmd.type());
   if ( cmd.port.exists() )
     global.set_port(cmd.port());
+  if ( cmd.compress )
+    global.compressor.reset(new http::response_compressor(cmd.compression));
+  global.h2c = cmd.h2c;
+  if ( cmd.s3 )
+    global.s3.reset(new s3_stub());
 }
@@ -0,0 +1,366 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// @file s3_stub.cpp
+// @brief Implementation of the in-memory S3-compatible object store
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+#include "s3_stub.h"
+
+#include <common/convert.hpp>
+#include <common/hash.hpp>
+#include <common/uuid.hpp>
+#include <strings.h>
+
+using namespace sid;
+
+namespace {
+
+const uint64_t S3_MIN_PART_SIZE = 5*1024*1024;
+
+//! Returns the lowercase hex MD5 of the data in quotes, which is how S3 reports ETags
+std::string quoted_md5(const std::string& _data)
+{
+  return "\"" + sid::hash::md5().get_hash(_data).to_hex_str(true) + "\"";
+}
+
+//! Decodes the percent-encoded characters of a path or query component
+std::string percent_decode(const std::string& _input)
+{
+  auto hex_value = [](char c)->int
+    {
+      if ( c >= '0' && c <= '9' ) return c - '0';
+      if ( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+      if ( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+      return -1;
+    };
+  std::string output;
+  output.reserve(_input.length());
+  for ( size_t i = 0; i < _input.length(); i++ )
+  {
+    int hi, lo;
+    if ( _input[i] == '%' && i + 2 < _input.length() &&
+         (hi = hex_value(_input[i+1])) >= 0 && (lo = hex_value(_input[i+2])) >= 0 )
+    {
+      output += static_cast<char>((hi << 4) | lo);
+      i += 2;
+    }
+    else
+      output += _input[i];
+  }
+  return output;
+}
+
+//! Returns the text between <_tag> and </_tag> starting at _pos, and moves _pos past the closing tag
+bool xml_value(const std::string& _xml, const std::string& _tag, size_t& _pos, std::string& _value)
+{
+  const std::string openTag = "<" + _tag + ">", closeTag = "</" + _tag + ">";
+  size_t start = _xml.find(openTag, _pos);
+  if ( start == std::string::npos ) return false;
+  start += openTag.length();
+  size_t end = _xml.find(closeTag, start);
+  if ( end == std::string::npos ) return false;
+  _value = _xml.substr(start, end - start);
+  _pos = end + closeTag.length();
+  return true;
+}
+
+//! Decodes an aws-chunked payload (<hex size>;chunk-signature=<signature>\r\n<data>\r\n ... ending with a 0 sized chunk).
+//! The chunk signatures must be present if _isSigned but are not verified. Unsigned chunks have the size alone.
+//! The trailer fields after the last chunk (<name>:<value>\r\n ... \r\n) are added to _trailers.
+bool aws_chunked_decode(const std::string& _input, bool _isSigned, std::string& _output, http::headers& _trailers)
+{
+  _output.clear();
+  for ( size_t pos = 0; pos < _input.length(); )
+  {
+    size_t eol = _input.find("\r\n", pos);
+    if ( eol == std::string::npos ) return false;
+    const std::string line = _input.substr(pos, eol - pos);
+    size_t sep = _isSigned? line.find(";chunk-signature=") : line.length();
+    uint64_t size = 0;
+    if ( sep == std::string::npos || (_isSigned && line.length() - sep != 17 + 64) ||
+         ! sid::to_num(line.substr(0, sep), num_base::hex, /*out*/ size) )
+      return false;
+    pos = eol + 2;
+    if ( size == 0 )
+    {
+      for ( ; (eol = _input.find("\r\n", pos)) != std::string::npos && eol != pos; pos = eol + 2 )
+      {
+        const std::string field = _input.substr(pos, eol - pos);
+        size_t colon = field.find(':');
+        if ( colon == std::string::npos ) return false;
+        _trailers(sid::trim(field.substr(0, colon)), sid::trim(field.substr(colon+1)));
+      }
+      return ( eol == pos && pos + 2 == _input.length() );
+    }
+    if ( _input.length() - pos < size + 2 || _input.compare(pos + size, 2, "\r\n") != 0 )
+      return false;
+    _output.append(_input, pos, size);
+    pos += size + 2;
+  }
+  return false;
+}
+
+} // anonymous namespace
+
+void s3_stub::p_error(http::response& _response, http::status_code _code, const std::string& _errCode, const std::string& _message) const
+{
+  _response.status = _code;
+  _response.headers("Content-Type", "application/xml");
+  _response.content.set_data("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Error><Code>" + _errCode +
+                             "</Code><Message>" + _message + "</Message></Error>");
+}
+
+void s3_stub::handle(const http::request& _request, http::response& _response)
+{
+  _response.status = http::status_code::OK;
+  _response.headers("Content-Type", "application/xml");
+
+  // Split the request uri into the object key and query parameters
+  std::string key = _request.uri, query;
+  size_t pos = key.find('?');
+  if ( pos != std::string::npos )
+  {
+    query = key.substr(pos+1);
+    key.erase(pos);
+  }
+  key = percent_decode(key);
+  std::map<std::string, std::string> params;
+  std::vector<std::string> tokens;
+  sid::split(/*out*/ tokens, query, '&', SPLIT_SKIP_EMPTY);
+  for ( const std::string& token : tokens )
+  {
+    pos = token.find('=');
+    if ( pos == std::string::npos )
+      params[percent_decode(token)] = std::string();
+    else
+      params[percent_decode(token.substr(0, pos))] = percent_decode(token.substr(pos+1));
+  }
+  auto param = [&](const std::string& _name, std::string* _value)->bool
+    {
+      auto it = params.find(_name);
+      if ( it == params.end() ) return false;
+      if ( _value ) *_value = it->second;
+      return true;
+    };
+
+  if ( ! _request.headers.exists("Authorization") )
+    return p_error(_response, http::status_code::Forbidden, "AccessDenied", "Missing Authorization header");
+
+  std::string payloadHash, decoded;
+  const bool hasPayloadHash = _request.headers.exists("x-amz-content-sha256", &payloadHash);
+  const bool isStreaming = ( hasPayloadHash && payloadHash.compare(0, 10, "STREAMING-") == 0 );
+  // Fields of the request with the trailers of an aws-chunked payload
+  http::headers fields = _request.headers;
+  if ( isStreaming )
+  {
+    // The payload is aws-chunked and the decoded length must match the one that was signed
+    uint64_t decodedLength = 0;
+    http::headers trailers;
+    if ( ! sid::to_num(_request.headers.get("x-amz-decoded-content-length"), /*out*/ decodedLength) )
+      return p_error(_response, http::status_code::LengthRequired, "MissingContentLength", "Missing x-amz-decoded-content-length");
+    if ( ! aws_chunked_decode(_request.content().data(), payloadHash.find("UNSIGNED") == std::string::npos, /*out*/ decoded, /*out*/ trailers) )
+      return p_error(_response, http::status_code::BadRequest, "InvalidChunkSizeError", "The aws-chunked payload is malformed");
+    if ( decoded.length() != decodedLength )
+      return p_error(_response, http::status_code::BadRequest, "IncompleteBody", "The decoded payload does not match x-amz-decoded-content-length");
+    // Every trailer must be announced in x-amz-trailer
+    std::string announced = _request.headers.get("x-amz-trailer");
+    for ( const http::header& trailer : trailers )
+    {
+      if ( ::strcasecmp(trailer.key.c_str(), announced.c_str()) != 0 )
+        return p_error(_response, http::status_code::BadRequest, "MalformedTrailerError", "The trailer " + trailer.key + " is not in x-amz-trailer");
+      fields(trailer.key, trailer.value);
+    }
+    if ( ! announced.empty() && trailers.empty() )
+      return p_error(_response, http::status_code::BadRequest, "MalformedTrailerError", "The trailer in x-amz-trailer is missing");
+  }
+  const std::string& payload = isStreaming? decoded : _request.content().data();
+  if ( hasPayloadHash && payloadHash != "UNSIGNED-PAYLOAD" && ! isStreaming &&
+       payloadHash != sid::hash::sha256().get_hash(payload).to_hex_str(true) )
+    return p_error(_response, http::status_code::BadRequest, "XAmzContentSHA256Mismatch",
+                   "The provided 'x-amz-content-sha256' header does not match what was computed");
+
+  // An x-amz-checksum-* header or trailer must match the (decoded) payload
+  std::string checksumError;
+  http::content decodedContent;
+  if ( isStreaming )
+    decodedContent.set_data(decoded);
+  if ( ! http::verify_checksum(fields, isStreaming? decodedContent : _request.content(), &checksumError) )
+    return p_error(_response, http::status_code::BadRequest, "BadDigest", checksumError);
+  std::string checksumName, checksumValue;
+  for ( sid::checksum::type type : { sid::checksum::type::crc32c, sid::checksum::type::crc64nvme } )
+    if ( fields.exists(http::checksum_header(type), &checksumValue) )
+    {
+      checksumName = http::checksum_header(type);
+      break;
+    }
+
+  std::string uploadId, partNumberStr;
+  const bool hasUploadId = param("uploadId", &uploadId);
+  std::unique_lock<std::mutex> lock(m_lock);
+
+  if ( _request.method == http::method_type::post && param("uploads", nullptr) )
+  {
+    // CreateMultipartUpload
+    uploadId = sid::uuid::create().to_str();
+    m_uploads[uploadId].key = key;
+    _response.content.set_data("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<InitiateMultipartUploadResult><Key>" + key +
+                               "</Key><UploadId>" + uploadId + "</UploadId></InitiateMultipartUploadResult>");
+    return;
+  }
+
+  if ( hasUploadId )
+  {
+    auto it = m_uploads.find(uploadId);
+    if ( it == m_uploads.end() || it->second.key != key )
+      return p_error(_response, http::status_code::NotFound, "NoSuchUpload", "The specified upload does not exist");
+    upload& up = it->second;
+
+    if ( _request.method == http::method_type::put && param("partNumber", &partNumberStr) )
+    {
+      // UploadPart
+      int partNumber = 0;
+      if ( ! sid::to_num(partNumberStr, /*out*/ partNumber) || partNumber < 1 || partNumber > 10000 )
+        return p_error(_response, http::status_code::BadRequest, "InvalidArgument", "Part number must be an integer between 1 and 10000");
+      object& part = up.parts[partNumber];
+      part.data = payload;
+      part.etag = quoted_md5(payload);
+      part.checksumName = checksumName;
+      part.checksumValue = checksumValue;
+      if ( ! checksumName.empty() )
+        _response.headers(checksumName, checksumValue);
+      _response.headers("ETag", part.etag);
+      return;
+    }
+    if ( _request.method == http::method_type::post )
+    {
+      // CompleteMultipartUpload. The listed parts must be in ascending order and match the uploaded ETags.
+      const std::string& xml = _request.content().data();
+      std::string partXml, value;
+      std::vector<const object*> parts;
+      int lastPart = 0;
+      for ( size_t xmlPos = 0; xml_value(xml, "Part", xmlPos, partXml); )
+      {
+        size_t partPos = 0;
+        int partNumber = 0;
+        if ( ! xml_value(partXml, "PartNumber", partPos, value) || ! sid::to_num(value, /*out*/ partNumber) )
+          return p_error(_response, http::status_code::BadRequest, "MalformedXML", "Invalid PartNumber");
+        if ( partNumber <= lastPart )
+          return p_error(_response, http::status_code::BadRequest, "InvalidPartOrder", "The list of parts was not in ascending order");
+        lastPart = partNumber;
+        partPos = 0;
+        if ( ! xml_value(partXml, "ETag", partPos, value) )
+          return p_error(_response, http::status_code::BadRequest, "MalformedXML", "Missing ETag");
+        auto partIt = up.parts.find(partNumber);
+        if ( partIt == up.parts.end() || (value != partIt->second.etag && "\"" + value + "\"" != partIt->second.etag) )
+          return p_error(_response, http::status_code::BadRequest, "InvalidPart", "Part " + sid::to_str(partNumber) + " was not found or its ETag did not match");
+        // Every part other than the last one must be at least 5 MB
+        if ( ! parts.empty() && parts.back()->data.length() < S3_MIN_PART_SIZE )
+          return p_error(_response, http::status_code::BadRequest, "EntityTooSmall", "A part is smaller than the minimum allowed size");
+        parts.push_back(&partIt->second);
+      }
+      if ( parts.empty() )
+        return p_error(_response, http::status_code::BadRequest, "MalformedXML", "No parts were specified");
+
+      // The multipart ETag is the MD5 of the concatenated binary part MD5s, suffixed by the part count
+      std::string data, md5s;
+      size_t totalSize = 0;
+      for ( const object* part : parts )
+        totalSize += part->data.length();
+      data.reserve(totalSize);
+      for ( const object* part : parts )
+      {
+        md5s += sid::hash::md5().get_hash(part->data).data();
+        data += part->data;
+      }
+      object& obj = m_objects[key];
+      obj.data.swap(data);
+      obj.checksumName.clear();
+      obj.checksumValue.clear();
+      obj.etag = "\"" + sid::hash::md5().get_hash(md5s).to_hex_str(true) + "-" + sid::to_str(parts.size()) + "\"";
+      m_uploads.erase(it);
+      _response.content.set_data("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<CompleteMultipartUploadResult><Key>" + key +
+                                 "</Key><ETag>" + obj.etag + "</ETag></CompleteMultipartUploadResult>");
+      return;
+    }
+    if ( _request.method == http::method_type::delete_ )
+    {
+      // AbortMultipartUpload
+      m_uploads.erase(it);
+      _response.status = http::status_code::NoContent;
+      return;
+    }
+    return p_error(_response, http::status_code::MethodNotAllowed, "MethodNotAllowed", "The method is not allowed for an upload");
+  }
+
+  if ( _request.method == http::method_type::put )
+  {
+    object& obj = m_objects[key];
+    obj.data = payload;
+    obj.etag = quoted_md5(payload);
+    obj.checksumName = checksumName;
+    obj.checksumValue = checksumValue;
+    _response.headers("ETag", obj.etag);
+    if ( ! checksumName.empty() )
+      _response.headers(checksumName, checksumValue);
+    return;
+  }
+  if ( _request.method == http::method_type::delete_ )
+  {
+    m_objects.erase(key);
+    _response.status = http::status_code::NoContent;
+    return;
+  }
+  if ( _request.method != http::method_type::get && _request.method != http::method_type::head )
+    return p_error(_response, http::status_code::MethodNotAllowed, "MethodNotAllowed", "The method is not allowed for an object");
+
+  auto it = m_objects.find(key);
+  if ( it == m_objects.end() )
+    return p_error(_response, http::status_code::NotFound, "NoSuchKey", "The specified key does not exist");
+  const object& obj = it->second;
+  _response.headers("ETag", obj.etag);
+  _response.headers("Accept-Ranges", "bytes");
+  _response.headers("Content-Type", "application/octet-stream", http::header_action::replace);
+
+  // A single byte range (bytes=first-last, bytes=first- or bytes=-suffix) is supported
+  uint64_t first = 0, last = obj.data.empty()? 0 : obj.data.length() - 1;
+  std::string range;
+  bool isRange = _request.headers.exists("Range", &range) && range.compare(0, 6, "bytes=") == 0;
+  if ( isRange )
+  {
+    std::string spec = range.substr(6);
+    pos = spec.find('-');
+    bool isValid = ( pos != std::string::npos );
+    if ( isValid && pos == 0 )
+    {
+      uint64_t suffix = 0;
+      isValid = sid::to_num(spec.substr(1), /*out*/ suffix) && suffix > 0;
+      if ( isValid && suffix < obj.data.length() )
+        first = obj.data.length() - suffix;
+    }
+    else if ( isValid )
+    {
+      isValid = sid::to_num(spec.substr(0, pos), /*out*/ first);
+      if ( isValid && pos + 1 < spec.length() )
+        isValid = sid::to_num(spec.substr(pos+1), /*out*/ last) && last >= first;
+      if ( last >= obj.data.length() )
+        last = obj.data.length() - 1;
+    }
+    if ( ! isValid || first >= obj.data.length() )
+    {
+      _response.headers("Content-Range", "bytes */" + sid::to_str(obj.data.length()));
+      return p_error(_response, http::status_code::RequestedRangeNotSatisfiable, "InvalidRange", "The requested range is not satisfiable");
+    }
+    _response.status = http::status_code::PartialContent;
+    _response.headers("Content-Range", "bytes " + sid::to_str(first) + "-" + sid::to_str(last) + "/" + sid::to_str(obj.data.length()));
+  }
+  // The checksum of the whole object is returned on request (it does not apply to a range)
+  std::string checksumMode;
+  if ( ! isRange && ! obj.checksumName.empty() &&
+       _request.headers.exists("x-amz-checksum-mode", &checksumMode) && checksumMode == "ENABLED" )
+    _response.headers(obj.checksumName, obj.checksumValue);
+  if ( _request.method == http::method_type::head )
+    _response.headers("Content-Length", sid::to_str(obj.data.empty()? 0 : last - first + 1));
+  else if ( ! obj.data.empty() )
+    _response.content.set_data(obj.data.substr(first, last - first + 1));
+}
@@ -0,0 +1,63 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// @file s3_stub.h
+// @brief A minimal in-memory S3-compatible object store used for local testing
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _S3_STUB_H_
+#define _S3_STUB_H_
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <http/http.hpp>
+
+/**
+ * @class s3_stub
+ * @brief Serves the subset of the S3 REST API needed to exercise the client without network access.
+ *
+ * Supported operations (the bucket is implied, objects are keyed by the request path):
+ *   PUT object, GET/HEAD object (with a single byte range), DELETE object,
+ *   CreateMultipartUpload, UploadPart, CompleteMultipartUpload and AbortMultipartUpload.
+ *
+ * Requests must carry an Authorization header and, when x-amz-content-sha256 holds a payload
+ * hash, it must match the payload. A STREAMING-* payload is decoded from aws-chunked and must match
+ * x-amz-decoded-content-length. Its trailers must be the one named in x-amz-trailer. Signatures themselves are not verified.
+ * An x-amz-checksum-crc32c or x-amz-checksum-crc64nvme header or trailer must match the payload (BadDigest
+ * otherwise). It is kept with the object and returned by GET/HEAD when x-amz-checksum-mode is ENABLED.
+ */
+class s3_stub
+{
+public:
+  s3_stub() = default;
+
+  /**
+   * @fn void handle(const sid::http::request& _request, sid::http::response& _response);
+   * @brief Process the S3 request and fill the response. Errors are returned as S3 XML error documents.
+   */
+  void handle(const sid::http::request& _request, sid::http::response& _response);
+
+private:
+  struct object
+  {
+    std::string data;
+    std::string etag;
+    std::string checksumName;   //! x-amz-checksum-* field the object was stored with, if any
+    std::string checksumValue;
+  };
+  struct upload
+  {
+    std::string key;
+    std::map<int, object> parts;
+  };
+
+  void p_error(sid::http::response& _response, sid::http::status_code _code, const std::string& _errCode, const std::string& _message) const;
+
+private:
+  std::mutex                    m_lock;
+  std::map<std::string, object> m_objects;  //! Objects keyed by path
+  std::map<std::string, upload> m_uploads;  //! In-progress multipart uploads keyed by upload id
+};
+
+#endif // _S3_STUB_H_
@@ -38,16 +38,16 @@ LICENSE: END
 */
 
 #include "http/status.hpp"
-#include <sstream>
+#include <vector>
 #include <stdlib.h>
 #include <common/convert.hpp>
 
 using namespace sid;
 using namespace sid::http;
 
-struct MapStatus { status_code code; std::string description; };
+struct MapStatus { status_code code; const char* description; };
 
-static MapStatus gMapStatus[] =
+static constexpr MapStatus gMapStatus[] =
   {
     /*100*/ {status_code::Continue, "Continue"},
     /*101*/ {status_code::SwitchingProtocols, "Switching Protocols"},
@@ -115,6 +115,44 @@ static MapStatus gMapStatus[] =
     /*510*/ {status_code::NotExtended, "Not Extended"},
     /*511*/ {status_code::NetworkAuthenticationRequired, "Network Authentication Required"}
   };
+static constexpr size_t gMapStatusCount = sizeof(gMapStatus)/sizeof(gMapStatus[0]);
+
+//! Status codes from 100 to 599 are mapped directly to the entries in gMapStatus
+#define STATUS_CODE_MIN 100
+#define STATUS_CODE_MAX 599
+
+struct StatusIndex
+{
+  uint8_t index[STATUS_CODE_MAX - STATUS_CODE_MIN + 1]; //! 1-based index in gMapStatus (0 if not defined)
+};
+
+static constexpr StatusIndex make_status_index()
+{
+  StatusIndex table = {};
+  for ( size_t i = 0; i < gMapStatusCount; i++ )
+    table.index[static_cast<size_t>(gMapStatus[i].code) - STATUS_CODE_MIN] = static_cast<uint8_t>(i + 1);
+  return table;
+}
+
+//! Generated at compile time
+static constexpr StatusIndex gStatusIndex = make_status_index();
+static_assert(gMapStatusCount < 256, "gStatusIndex can only handle 255 entries");
+
+//! Get the entry in gMapStatus for the code, or -1 if it is not defined
+static inline int get_status_index(int _code)
+{
+  if ( _code < STATUS_CODE_MIN || _code > STATUS_CODE_MAX ) return -1;
+  return static_cast<int>(gStatusIndex.index[_code - STATUS_CODE_MIN]) - 1;
+}
+
+//! Descriptions as std::string objects so that a reference can be returned
+static const std::vector<std::string> gStatusMessages = []()
+  {
+    std::vector<std::string> messages;
+    for ( size_t i = 0; i < gMapStatusCount; i++ )
+      messages.push_back(gMapStatus[i].description);
+    return messages;
+  }();
 
 
 status::status()
@@ -141,10 +179,10 @@ http::status& status::operator=(const status_code& _code)
 
 const std::string& status::message() const
 {
-  size_t cnt = sizeof(gMapStatus)/sizeof(gMapStatus[0]);
-  for ( size_t i = 0; i < cnt; i++ )
-    if ( m_code == gMapStatus[i].code ) return gMapStatus[i].description;
-  throw sid::exception("Invalid Status code");
+  int index = get_status_index(static_cast<int>(m_code));
+  if ( index < 0 )
+    throw sid::exception("Invalid Status code");
+  return gStatusMessages[index];
 }
 
 //! Check whether the current status is a redirect request
@@ -176,28 +214,36 @@ bool status::is_redirect(redirect_info* predirectInfo) const
 
 std::string status::to_str() const
 {
-  std::ostringstream out;
-  out << static_cast<int>(m_code) << " " << this->message();
-  return out.str();
+  return sid::serialize([&](sid::sized_writer& _out) { this->write(_out); });
+}
+
+void status::write(sid::sized_writer& _out) const
+{
+  _out.write_num(static_cast<uint64_t>(m_code));
+  _out << ' ' << this->message();
 }
 
 /*static*/
 http::status status::get(const std::string& _input)
 {
-  http::status status;
-  size_t pos = _input.find(' ');
-  if ( pos == std::string::npos ) throw sid::exception("Invalid status format");
-  std::string codeStr = _input.substr(0, pos);
-  int code = sid::to_num<int>(codeStr);
-  if ( code == 0 ) throw sid::exception("Invalid HTTP status code");
-  status = (status_code) code;
-
-  bool isFound = false;
-  size_t cnt = sizeof(gMapStatus)/sizeof(gMapStatus[0]);
-  for ( size_t i = 0; i < cnt; i++ )
-    if ( status.code() == gMapStatus[i].code ) { isFound = true; break; }
+  return status::get(_input.data(), _input.length());
+}
 
-  if ( !isFound ) throw sid::exception(code, std::string("Invalid HTTP status code: ") + codeStr);
+/*static*/
+http::status status::get(const char* _input, size_t _len)
+{
+  // <3-digit code>[ <reason phrase>]. The reason phrase is not validated.
+  if ( _len < 3 || (_len > 3 && _input[3] != ' ') )
+    throw sid::exception("Invalid status format");
+  int code = 0;
+  for ( size_t i = 0; i < 3; i++ )
+  {
+    if ( _input[i] < '0' || _input[i] > '9' )
+      throw sid::exception("Invalid HTTP status code");
+    code = code * 10 + (_input[i] - '0');
+  }
+  if ( get_status_index(code) < 0 )
+    throw sid::exception(code, std::string("Invalid HTTP status code: ") + std::string(_input, 3));
 
-  return status;
+  return http::status(static_cast<status_code>(code));
 }
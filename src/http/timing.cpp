@@ -0,0 +1,70 @@
+//////////////////////////////////////////////////////
+//
+// timing.cpp
+//
+//////////////////////////////////////////////////////
+
+/*
+LICENSE: BEGIN
+===============================================================================
+@author Shan Anand
+@email anand.gs@gmail.com
+@source https://github.com/shan-anand
+@brief HTTP library implementation in C++
+===============================================================================
+MIT License
+
+Copyright (c) 2017 Shanmuga (Anand) Gunasekaran
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+===============================================================================
+LICENSE: END
+*/
+
+#include "http/timing.hpp"
+#include <sstream>
+
+using namespace std;
+using namespace sid;
+using namespace sid::http;
+
+void request_timing::clear()
+{
+  open_start = resolved = connected = handshaken = clock::time_point();
+  request_start = sent = first_byte = done = clock::time_point();
+  phase = timing_phase::connect;
+  for ( io_counter& c : io )
+    c.clear();
+}
+
+std::string request_timing::to_str() const
+{
+  std::ostringstream out;
+  out << "dns=" << dns_us() << "us connect=" << connect_us() << "us tls=" << tls_us() << "us send=" << send_us()
+      << "us wait=" << wait_us() << "us transfer=" << transfer_us() << "us total=" << total_us() << "us";
+  const char* names[] = { "connect", "handshake", "send", "receive" };
+  for ( int i = 0; i < 4; i++ )
+  {
+    const io_counter& c = io[i];
+    if ( c.reads == 0 && c.writes == 0 && c.bytes_read == 0 && c.bytes_written == 0 ) continue;
+    out << " | " << names[i] << ": " << c.writes << " writes " << c.bytes_written << " bytes, "
+        << c.reads << " reads " << c.bytes_read << " bytes";
+  }
+  return out.str();
+}
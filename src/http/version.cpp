@@ -38,18 +38,14 @@ LICENSE: END
 */
 
 #include "http/version.hpp"
+#include <cstring>
 
 using namespace sid;
 using namespace sid::http;
 
-struct MapVersion { version_id id; std::string name, sname; };
-
-static MapVersion gMapVersion[] =
-  {
-    { version_id::v10, "HTTP/1.0", "1.0" },
-    { version_id::v11, "HTTP/1.1", "1.1" }
-  };
-
+//! HTTP version names indexed by version_id
+static const std::string gVersionNames[] = { "HTTP/1.0", "HTTP/1.1", "HTTP/2" };
+static_assert(sizeof(gVersionNames)/sizeof(gVersionNames[0]) == static_cast<size_t>(version_id::v20) + 1, "gVersionNames must match version_id");
 
 version::version()
 {
@@ -72,19 +68,35 @@ version& version::operator=(const version_id& _id)
   return *this;
 }
 
-std::string version::to_str() const
+const std::string& version::to_str() const
 {
-  size_t cnt = sizeof(gMapVersion)/sizeof(gMapVersion[0]);
-  for ( size_t i = 0; i < cnt; i++ )
-    if ( m_id == gMapVersion[i].id ) return gMapVersion[i].name;
-  throw sid::exception("Invalid Version ID");
+  if ( m_id > version_id::v20 ) throw sid::exception("Invalid Version ID");
+  return gVersionNames[static_cast<size_t>(m_id)];
 }
 
 /*static*/
 http::version version::get(const std::string& _name)
 {
-  size_t cnt = sizeof(gMapVersion)/sizeof(gMapVersion[0]);
-  for ( size_t i = 0; i < cnt; i++ )
-    if ( _name == gMapVersion[i].name || _name == gMapVersion[i].sname ) return gMapVersion[i].id;
-  throw sid::exception("Invalid Version: " + _name);
+  return version::get(_name.data(), _name.length());
+}
+
+/*static*/
+http::version version::get(const char* _name, size_t _len)
+{
+  // Accepts HTTP/1.0, HTTP/1.1, HTTP/2, HTTP/2.0 and the same without the HTTP/ prefix
+  const char* p = _name;
+  size_t len = _len;
+  if ( len > 5 && ::memcmp(_name, "HTTP/", 5) == 0 )
+  {
+    p += 5;
+    len -= 5;
+  }
+  if ( len == 3 && p[0] == '1' && p[1] == '.' )
+  {
+    if ( p[2] == '1' ) return version_id::v11;
+    if ( p[2] == '0' ) return version_id::v10;
+  }
+  if ( len > 0 && p[0] == '2' && (len == 1 || (len == 3 && p[1] == '.' && p[2] == '0')) )
+    return version_id::v20;
+  throw sid::exception("Invalid Version: " + std::string(_name, _len));
 }
@@ -41,6 +41,7 @@ LICENSE: END
 #include "common/convert.hpp"
 #include "common/hash.hpp"
 #include <sstream>
+#include <random>
 
 using namespace std;
 using namespace sid;
@@ -58,81 +59,117 @@ bool www_authenticate::exists(const std::string& _key, std::string& _value) cons
 }
 
 std::string www_authenticate::get_auth_string(const http::request& _request)
+{
+  auth_session session;
+  session.set(*this, _request.userName, _request.password);
+  return session.get_auth_string(_request);
+}
+
+//! Random client nonce of 16 hex digits
+static std::string new_cnonce()
+{
+  static thread_local std::mt19937_64 rng(std::random_device{}());
+  uint64_t value = rng();
+  std::string out(2 * sizeof(value), '\0');
+  sid::bytes_to_hex(&value, sizeof(value), &out[0], true);
+  return out;
+}
+
+void auth_session::set(const www_authenticate& _challenge, const std::string& _userName, const std::string& _password)
+{
+  std::string realm, newRealm, nonce;
+  this->challenge.exists("realm", /*out*/ realm);
+  _challenge.exists("realm", /*out*/ newRealm);
+  if ( _challenge.type != this->challenge.type || newRealm != realm || _userName != this->userName || _password != this->password )
+    this->ha1.clear();
+
+  this->challenge = _challenge;
+  this->userName = _userName;
+  this->password = _password;
+  _challenge.exists("nonce", /*out*/ nonce);
+  this->set_nonce(nonce);
+
+  if ( this->ha1.empty() && this->challenge.type == "Digest" )
+    this->ha1 = sid::hash::md5().get_hash(this->userName + ":" + newRealm + ":" + this->password).to_hex_str(true);
+}
+
+void auth_session::set_nonce(const std::string& _nonce)
+{
+  if ( this->challenge.type == "Digest" )
+    this->challenge.info["nonce"] = _nonce;
+  this->cnonce = new_cnonce();
+  this->nc = 0;
+}
+
+std::string auth_session::get_auth_string(const http::request& _request)
 {
   std::ostringstream out;
 
-  if ( this->type == "Basic" )
+  if ( this->challenge.type == "Basic" )
   {
-    out << this->type << " " << sid::base64::encode(_request.userName + ":" + _request.password);
+    out << this->challenge.type << " " << sid::base64::encode(this->userName + ":" + this->password);
   }
-  else if ( this->type == "Digest" )
+  else if ( this->challenge.type == "Digest" )
   {
-    std::string realm, nc, nonce, cnonce, opaque, temp;
-    enum class Algorithm { none, MD5, MD5_sess };
+    std::string realm, nonce, opaque, algorithm, temp;
     enum class QOP { none, auth, auth_int };
-    Algorithm alg = Algorithm::none;
     QOP qop = QOP::none;
 
-    this->exists("realm", /*out*/ realm);
-    if ( ! this->exists("nc", /*out*/ nc) || nc.empty() )
-      nc = "00000001";
-    this->exists("nonce", /*out*/ nonce);
-    if ( ! this->exists("cnonce", /*out*/ cnonce) || cnonce.empty() )
-      cnonce = "82973294";
-    this->exists("opaque", /*out*/ opaque);
-    if ( this->exists("algorithm", /*out*/ temp) )
-    {
-      if ( temp == "MD5-sess" )
-        alg = Algorithm::MD5_sess;
-      else if ( temp == "MD5" )
-        alg = Algorithm::MD5;
-    }
+    this->challenge.exists("realm", /*out*/ realm);
+    this->challenge.exists("nonce", /*out*/ nonce);
+    this->challenge.exists("opaque", /*out*/ opaque);
+    this->challenge.exists("algorithm", /*out*/ algorithm);
 
-    if ( this->exists("qop", /*out*/ temp) )
+    // The server may offer a list of options. "auth" is preferred as it does not need the payload.
+    if ( this->challenge.exists("qop", /*out*/ temp) )
     {
-      if ( temp == "auth-int" )
-        qop = QOP::auth_int;
-      else if ( temp == "auth" )
-        qop = QOP::auth;
+      std::vector<std::string> options;
+      sid::split(options, temp, ',', SPLIT_TRIM_SKIP_EMPTY);
+      for ( const std::string& option : options )
+      {
+        if ( option == "auth" )
+          qop = QOP::auth;
+        else if ( option == "auth-int" && qop == QOP::none )
+          qop = QOP::auth_int;
+      }
     }
+    const std::string qopStr = ( qop == QOP::auth_int )? "auth-int" : "auth";
 
-    std::string qopStr;
-    switch ( qop )
-    {
-    case QOP::auth_int: qopStr = "auth-int"; break;
-    default:            qopStr = "auth";     break;
-    }
+    char nc[9] = {0};
+    ::snprintf(nc, sizeof(nc), "%08x", ++this->nc);
 
     sid::hash::md5 md5;
-    std::string HA1, HA2, response;
-    HA1 = sid::to_lower(md5.get_hash(_request.userName + ":" + realm + ":" + _request.password).to_hex_str());
-    if ( alg == Algorithm::MD5_sess )
-      HA1 = sid::to_lower(md5.get_hash(HA1 + ":" + nonce + ":" + cnonce).to_hex_str());
-
-    if ( qop == QOP::auth || qop == QOP::none )
-      HA2 = sid::to_lower(md5.get_hash(_request.method.to_str() + ":" + _request.uri).to_hex_str());
-    else if ( qop == QOP::auth_int )
+    std::string HA1 = this->ha1, HA2, response;
+    if ( HA1.empty() )
+      HA1 = this->ha1 = md5.get_hash(this->userName + ":" + realm + ":" + this->password).to_hex_str(true);
+    if ( algorithm == "MD5-sess" )
+      HA1 = md5.get_hash(HA1 + ":" + nonce + ":" + this->cnonce).to_hex_str(true);
+
+    if ( qop == QOP::auth_int )
     {
-      std::string contentMD5 = sid::to_lower(md5.get_hash(_request.content().to_str()).to_hex_str());
-      HA2 = sid::to_lower(md5.get_hash(_request.method.to_str() + ":" + _request.uri + ":" + contentMD5).to_hex_str());
+      std::string contentMD5 = md5.get_hash(_request.content().to_str()).to_hex_str(true);
+      HA2 = md5.get_hash(_request.method.to_str() + ":" + _request.uri + ":" + contentMD5).to_hex_str(true);
     }
+    else
+      HA2 = md5.get_hash(_request.method.to_str() + ":" + _request.uri).to_hex_str(true);
 
-    if ( qop == QOP::auth || qop == QOP::auth_int )
-      response = sid::to_lower(md5.get_hash(HA1 + ":" + nonce + ":" + nc + ":" + cnonce + ":" + qopStr + ":" + HA2).to_hex_str());
+    if ( qop != QOP::none )
+      response = md5.get_hash(HA1 + ":" + nonce + ":" + nc + ":" + this->cnonce + ":" + qopStr + ":" + HA2).to_hex_str(true);
     else
-      response = sid::to_lower(md5.get_hash(HA1 + ":" + nonce + ":" + HA2).to_hex_str());
+      response = md5.get_hash(HA1 + ":" + nonce + ":" + HA2).to_hex_str(true);
 
-    out << this->type << " "
-        << "username=\"" << _request.userName << "\","
+    out << this->challenge.type << " "
+        << "username=\"" << this->userName << "\","
         << "realm=\"" << realm << "\","
         << "nonce=\"" << nonce << "\","
         << "uri=\"" << _request.uri << "\","
-        << "qop=\"" << qopStr << "\","
-        << "nc=\"" << nc << "\","
-        << "cnonce=\"" << cnonce << "\","
-        << "response=\"" << response << "\","
-        << "opaque=\"" << opaque << "\""
-      ;
+        << "response=\"" << response << "\"";
+    if ( ! algorithm.empty() )
+      out << ",algorithm=" << algorithm;
+    if ( ! opaque.empty() )
+      out << ",opaque=\"" << opaque << "\"";
+    if ( qop != QOP::none )
+      out << ",qop=" << qopStr << ",nc=" << nc << ",cnonce=\"" << this->cnonce << "\"";
   }
   std::string authStr = out.str();
 
@@ -147,6 +184,9 @@ void www_authenticate_list::set(const std::string& _wwwAuthStr)
   www_authenticate wwwAuth;
   for ( size_t pos = 0; pos != std::string::npos && !endOfData; )
   {
+    // Parameters are usually separated by ", "
+    pos = _wwwAuthStr.find_first_not_of(' ', pos);
+    if ( pos == std::string::npos ) break;
     size_t wpos = _wwwAuthStr.find_first_of(" =", pos);
     if ( wpos == std::string::npos )
     {
@@ -167,6 +207,9 @@ void www_authenticate_list::set(const std::string& _wwwAuthStr)
     }
     else if ( _wwwAuthStr[wpos] == ' ' )
     {
+      // The next challenge
+      if ( !wwwAuth.empty() )
+        this->push_back(wwwAuth);
       wwwAuth.clear();
       wwwAuth.type = _wwwAuthStr.substr(pos, wpos-pos);
       pos = wpos+1;